@@ -21,6 +21,7 @@ typedef struct {
     ngx_str_t              header_filter;
     ngx_str_t              body_filter;
     ngx_uint_t             buffer_type;
+    size_t                 buffer_size;
 } ngx_http_js_loc_conf_t;
 
 
@@ -51,6 +52,9 @@ typedef struct {
 #define NJS_HEADER_GET         0x8
 
 
+#define NGX_HTTP_JS_FILE_BUFFER_SIZE  32768
+
+
 typedef struct ngx_http_js_ctx_s  ngx_http_js_ctx_t;
 
 struct ngx_http_js_ctx_s {
@@ -67,6 +71,10 @@ struct ngx_http_js_ctx_s {
     ngx_chain_t          **last_out;
     ngx_chain_t           *free;
     ngx_chain_t           *busy;
+    ngx_chain_t           *pending;
+    ngx_chain_t           *pending_free;
+    ngx_chain_t           *pending_busy;
+    ngx_buf_t             *file_buf;
     ngx_int_t            (*body_filter)(ngx_http_request_t *r,
                                         ngx_http_js_loc_conf_t *jlcf,
                                         ngx_http_js_ctx_t *ctx,
@@ -76,6 +84,25 @@ struct ngx_http_js_ctx_s {
 };
 
 
+typedef struct {
+    ngx_http_complex_value_t  key;
+    ngx_rbtree_t              rbtree;
+    ngx_rbtree_node_t         sentinel;
+    ngx_queue_t               lru;
+    ngx_uint_t                count;
+    ngx_uint_t                size;
+    ngx_msec_t                ttl;
+} ngx_http_js_set_cache_t;
+
+
+typedef struct {
+    ngx_str_node_t            sn;
+    ngx_queue_t               queue;
+    ngx_msec_t                expires;
+    ngx_str_t                 value;
+} ngx_http_js_set_cache_node_t;
+
+
 typedef struct {
     ngx_str_t              name;
     unsigned               flags;
@@ -121,6 +148,10 @@ static ngx_int_t ngx_http_js_variable_set(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_js_variable_var(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_http_js_set_cache_node_t *ngx_http_js_set_cache_lookup(
+    ngx_http_js_set_cache_t *cache, ngx_str_t *key);
+static void ngx_http_js_set_cache_update(ngx_http_js_set_cache_t *cache,
+    ngx_str_t *key, ngx_str_t *value);
 static ngx_int_t ngx_http_js_init_vm(ngx_http_request_t *r, njs_int_t proto_id);
 static void ngx_http_js_cleanup_ctx(void *data);
 
@@ -384,6 +415,8 @@ static char *ngx_http_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_js_fetch_proxy(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_js_fetch_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static char *ngx_http_js_body_filter_set(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static ngx_int_t ngx_http_js_init_conf_vm(ngx_conf_t *cf,
@@ -439,6 +472,13 @@ static ngx_command_t  ngx_http_js_commands[] = {
       offsetof(ngx_http_js_loc_conf_t, reuse_max_size),
       NULL },
 
+    { ngx_string("js_bytecode_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_js_bytecode_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("js_import"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE13,
       ngx_js_import,
@@ -468,7 +508,7 @@ static ngx_command_t  ngx_http_js_commands[] = {
       NULL },
 
     { ngx_string("js_set"),
-      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE23,
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_2MORE,
       ngx_http_js_set,
       0,
       0,
@@ -496,7 +536,7 @@ static ngx_command_t  ngx_http_js_commands[] = {
       NULL },
 
     { ngx_string("js_body_filter"),
-      NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF|NGX_HTTP_LMT_CONF|NGX_CONF_TAKE12,
+      NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF|NGX_HTTP_LMT_CONF|NGX_CONF_TAKE123,
       ngx_http_js_body_filter_set,
       NGX_HTTP_LOC_CONF_OFFSET,
       0,
@@ -597,6 +637,13 @@ static ngx_command_t  ngx_http_js_commands[] = {
       offsetof(ngx_http_js_loc_conf_t, fetch_keepalive_timeout),
       NULL },
 
+    { ngx_string("js_fetch_max_conns"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_js_loc_conf_t, fetch_max_conns),
+      NULL },
+
     { ngx_string("js_fetch_proxy"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_http_js_fetch_proxy,
@@ -604,6 +651,20 @@ static ngx_command_t  ngx_http_js_commands[] = {
       0,
       NULL },
 
+    { ngx_string("js_fetch_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_http_js_fetch_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("js_fetch_resolver_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_js_fetch_resolver_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -1429,25 +1490,46 @@ ngx_http_njs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
     c = r->connection;
     vm = ctx->engine->u.njs.vm;
 
-    njs_value_assign(&arguments[0], &ctx->args[0]);
-
     njs_vm_value_string_create(vm, njs_value_arg(&last_key),
                                last_str.start, last_str.length);
 
+    /*
+     * The flags object of all the chunks but the last one is
+     * created once per request, its "last" property is reset
+     * before each chunk as the filter may change it.
+     */
+
+    if (!njs_value_is_object(njs_value_arg(&ctx->args[2]))) {
+        njs_value_boolean_set(njs_value_arg(&last), 0);
+
+        ret = njs_vm_object_alloc(vm, njs_value_arg(&ctx->args[2]),
+                                  njs_value_arg(&last_key),
+                                  njs_value_arg(&last), NULL);
+        if (ret != NJS_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    njs_value_assign(&arguments[0], &ctx->args[0]);
+
     while (in != NULL) {
         ctx->buf = in->buf;
         b = ctx->buf;
 
         if (!ctx->done) {
             len = b->last - b->pos;
+            p = b->pos;
 
-            p = ngx_pnalloc(r->pool, len);
-            if (p == NULL) {
-                njs_vm_memory_error(vm);
-                return NJS_ERROR;
-            }
+            if (jlcf->buffer_type == NGX_JS_BUFFER && len) {
+
+                /* a Buffer references its memory, which the chain reuses */
+
+                p = ngx_pnalloc(r->pool, len);
+                if (p == NULL) {
+                    njs_vm_memory_error(vm);
+                    return NJS_ERROR;
+                }
 
-            if (len) {
                 ngx_memcpy(p, b->pos, len);
             }
 
@@ -1457,13 +1539,26 @@ ngx_http_njs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
                 return ret;
             }
 
-            njs_value_boolean_set(njs_value_arg(&last), b->last_buf);
+            if (b->last_buf) {
+                njs_value_boolean_set(njs_value_arg(&last), 1);
 
-            ret = njs_vm_object_alloc(vm, njs_value_arg(&arguments[2]),
-                                       njs_value_arg(&last_key),
-                                       njs_value_arg(&last), NULL);
-            if (ret != NJS_OK) {
-                return ret;
+                ret = njs_vm_object_alloc(vm, njs_value_arg(&arguments[2]),
+                                          njs_value_arg(&last_key),
+                                          njs_value_arg(&last), NULL);
+                if (ret != NJS_OK) {
+                    return ret;
+                }
+
+            } else {
+                njs_value_boolean_set(njs_value_arg(&last), 0);
+
+                ret = njs_vm_object_prop_set(vm, njs_value_arg(&ctx->args[2]),
+                                             &last_str, &last);
+                if (ret != NJS_OK) {
+                    return ret;
+                }
+
+                njs_value_assign(&arguments[2], &ctx->args[2]);
             }
 
             pending = ngx_js_ctx_pending(ctx);
@@ -1506,11 +1601,241 @@ ngx_http_njs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
 }
 
 
+static ngx_int_t
+ngx_http_js_body_filter_file(ngx_http_request_t *r,
+    ngx_http_js_loc_conf_t *jlcf, ngx_http_js_ctx_t *ctx, ngx_buf_t *b)
+{
+    off_t         size;
+    ssize_t       n;
+    ngx_int_t     rc;
+    ngx_buf_t    *fb;
+    ngx_chain_t   ln;
+
+    fb = ctx->file_buf;
+
+    if (fb == NULL) {
+        fb = ngx_create_temp_buf(r->pool, jlcf->buffer_size
+                                          ? jlcf->buffer_size
+                                          : NGX_HTTP_JS_FILE_BUFFER_SIZE);
+        if (fb == NULL) {
+            return NGX_ERROR;
+        }
+
+        ctx->file_buf = fb;
+    }
+
+    ln.buf = fb;
+    ln.next = NULL;
+
+    while (b->file_pos < b->file_last && !ctx->done) {
+        size = ngx_min(b->file_last - b->file_pos,
+                       (off_t) (fb->end - fb->start));
+
+        n = ngx_read_file(b->file, fb->start, (size_t) size, b->file_pos);
+
+        if (n == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        if (n != size) {
+            ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                          ngx_read_file_n " read only %z of %O from \"%s\"",
+                          n, size, b->file->name.data);
+            return NGX_ERROR;
+        }
+
+        b->file_pos += n;
+
+        fb->pos = fb->start;
+        fb->last = fb->start + n;
+
+        if (b->file_pos == b->file_last) {
+            fb->last_buf = b->last_buf;
+            fb->last_in_chain = b->last_in_chain;
+            fb->flush = b->flush;
+
+        } else {
+            fb->last_buf = 0;
+            fb->last_in_chain = 0;
+            fb->flush = 0;
+        }
+
+        rc = ctx->body_filter(r, jlcf, ctx, &ln);
+        if (rc != NGX_OK) {
+            return rc;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_js_body_filter_call(ngx_http_request_t *r,
+    ngx_http_js_loc_conf_t *jlcf, ngx_http_js_ctx_t *ctx, ngx_chain_t *in)
+{
+    ngx_int_t     rc;
+    ngx_buf_t    *b;
+    ngx_chain_t  *cl, ln;
+
+    for (cl = in; cl != NULL; cl = cl->next) {
+        if (cl->buf->in_file && !ngx_buf_in_memory(cl->buf)) {
+            break;
+        }
+    }
+
+    if (cl == NULL) {
+        return ctx->body_filter(r, jlcf, ctx, in);
+    }
+
+    /*
+     * File buffers are read in parts into ctx->file_buf, each part is
+     * passed to the filter function separately.  After r.done() the rest
+     * of a file buffer is passed on as is.
+     */
+
+    ln.next = NULL;
+
+    for (cl = in; cl != NULL; cl = cl->next) {
+        b = cl->buf;
+
+        if (b->in_file && !ngx_buf_in_memory(b)
+            && b->file_pos != b->file_last && !ctx->done)
+        {
+            rc = ngx_http_js_body_filter_file(r, jlcf, ctx, b);
+            if (rc != NGX_OK) {
+                return rc;
+            }
+
+            if (b->file_pos == b->file_last) {
+                continue;
+            }
+        }
+
+        ln.buf = b;
+
+        rc = ctx->body_filter(r, jlcf, ctx, &ln);
+        if (rc != NGX_OK) {
+            return rc;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_js_body_filter_coalesce(ngx_http_request_t *r,
+    ngx_http_js_loc_conf_t *jlcf, ngx_http_js_ctx_t *ctx, ngx_chain_t *in,
+    ngx_chain_t **out)
+{
+    size_t        size;
+    ngx_buf_t    *b, *p;
+    ngx_chain_t  *cl, **ll;
+
+    /*
+     * Copies in-memory input into buffers of jlcf->buffer_size bytes,
+     * a buffer is passed to the filter function when it is full, or
+     * when the input has the last_buf or flush flag set.  Input which
+     * is not in memory is passed as is after the data collected so far.
+     */
+
+    ll = out;
+
+    for ( /* void */ ; in != NULL; in = in->next) {
+        b = in->buf;
+
+        if (!ngx_buf_in_memory(b) && !ngx_buf_special(b)) {
+            if (ctx->pending != NULL) {
+                *ll = ctx->pending;
+                ll = &ctx->pending->next;
+                ctx->pending = NULL;
+            }
+
+            cl = ngx_alloc_chain_link(r->pool);
+            if (cl == NULL) {
+                return NGX_ERROR;
+            }
+
+            cl->buf = b;
+            *ll = cl;
+            ll = &cl->next;
+
+            continue;
+        }
+
+        for ( ;; ) {
+            if (ctx->pending == NULL) {
+                if (b->pos == b->last && !b->last_buf && !b->flush) {
+                    break;
+                }
+
+                cl = ngx_chain_get_free_buf(r->pool, &ctx->pending_free);
+                if (cl == NULL) {
+                    return NGX_ERROR;
+                }
+
+                p = cl->buf;
+
+                if (p->start == NULL) {
+                    p->start = ngx_pnalloc(r->pool, jlcf->buffer_size);
+                    if (p->start == NULL) {
+                        return NGX_ERROR;
+                    }
+
+                    p->end = p->start + jlcf->buffer_size;
+                    p->temporary = 1;
+                    p->tag = (ngx_buf_tag_t) &ngx_http_js_body_filter_coalesce;
+                }
+
+                p->pos = p->start;
+                p->last = p->start;
+                p->last_buf = 0;
+                p->flush = 0;
+
+                ctx->pending = cl;
+            }
+
+            p = ctx->pending->buf;
+
+            size = ngx_min((size_t) (b->last - b->pos),
+                           (size_t) (p->end - p->last));
+
+            p->last = ngx_cpymem(p->last, b->pos, size);
+            b->pos += size;
+
+            if (b->pos == b->last) {
+                if (!b->last_buf && !b->flush) {
+                    break;
+                }
+
+                p->last_buf = b->last_buf;
+                p->flush = b->flush;
+            }
+
+            /* the buffer is full, or the input is flushed */
+
+            *ll = ctx->pending;
+            ll = &ctx->pending->next;
+            ctx->pending = NULL;
+
+            if (b->pos == b->last) {
+                break;
+            }
+        }
+    }
+
+    *ll = NULL;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_js_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
     ngx_int_t                rc;
-    ngx_chain_t             *out;
+    ngx_chain_t             *out, *cl;
     ngx_http_js_ctx_t       *ctx;
     ngx_http_js_loc_conf_t  *jlcf;
 
@@ -1532,13 +1857,37 @@ ngx_http_js_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
     ctx = ngx_http_get_module_ctx(r, ngx_http_js_module);
 
     if (ctx->done) {
+        if (ctx->pending != NULL) {
+            cl = ctx->pending;
+            cl->next = in;
+            in = cl;
+
+            ctx->pending = NULL;
+        }
+
         return ngx_http_next_body_filter(r, in);
     }
 
     ctx->filter = 1;
     ctx->last_out = &out;
 
-    rc = ctx->body_filter(r, jlcf, ctx, in);
+    if (jlcf->buffer_size) {
+        if (ngx_http_js_body_filter_coalesce(r, jlcf, ctx, in, &cl)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        rc = ngx_http_js_body_filter_call(r, jlcf, ctx, cl);
+
+        ngx_chain_update_chains(r->pool, &ctx->pending_free,
+                            &ctx->pending_busy, &cl,
+                            (ngx_buf_tag_t) &ngx_http_js_body_filter_coalesce);
+
+    } else {
+        rc = ngx_http_js_body_filter_call(r, jlcf, ctx, in);
+    }
+
     if (rc != NGX_OK) {
         return NGX_ERROR;
     }
@@ -1565,12 +1914,67 @@ ngx_http_js_variable_set(ngx_http_request_t *r, ngx_http_variable_value_t *v,
 {
     ngx_js_set_t *vdata = (ngx_js_set_t *) data;
 
-    ngx_int_t           rc;
-    njs_int_t           pending;
-    ngx_str_t          *fname, value;
-    ngx_http_js_ctx_t  *ctx;
+    u_char                        *p;
+    ngx_int_t                      rc;
+    njs_int_t                      pending;
+    ngx_str_t                     *fname, value, key;
+    ngx_http_js_ctx_t             *ctx;
+    ngx_http_js_loc_conf_t        *jlcf;
+    ngx_http_js_set_cache_t       *cache;
+    ngx_http_js_set_cache_node_t  *node;
 
     fname = &vdata->fname;
+    cache = vdata->cache;
+
+    ngx_str_null(&key);
+
+    if (cache != NULL) {
+        if (ngx_http_complex_value(r, &cache->key, &value) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        /*
+         * js_import is location-scoped, so the same function name may
+         * refer to different functions in different locations, the key
+         * is prefixed with the engine the function is resolved in
+         */
+
+        jlcf = ngx_http_get_module_loc_conf(r, ngx_http_js_module);
+
+        key.len = sizeof(ngx_engine_t *) + value.len;
+        key.data = ngx_pnalloc(r->pool, key.len);
+        if (key.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        p = ngx_cpymem(key.data, &jlcf->engine, sizeof(ngx_engine_t *));
+        ngx_memcpy(p, value.data, value.len);
+
+        node = ngx_http_js_set_cache_lookup(cache, &key);
+
+        if (node != NULL) {
+            ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http js variable cache hit \"%V\" key:\"%V\"",
+                           fname, &value);
+
+            /* the node may be evicted while the request is still alive */
+
+            p = ngx_pnalloc(r->pool, node->value.len);
+            if (p == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_memcpy(p, node->value.data, node->value.len);
+
+            v->len = node->value.len;
+            v->valid = 1;
+            v->no_cacheable = vdata->flags & NGX_NJS_VAR_NOCACHE;
+            v->not_found = 0;
+            v->data = p;
+
+            return NGX_OK;
+        }
+    }
 
     rc = ngx_http_js_init_vm(r, ngx_http_js_request_proto_id);
 
@@ -1610,6 +2014,10 @@ ngx_http_js_variable_set(ngx_http_request_t *r, ngx_http_variable_value_t *v,
         return NGX_ERROR;
     }
 
+    if (cache != NULL && rc == NGX_OK) {
+        ngx_http_js_set_cache_update(cache, &key, &value);
+    }
+
     v->len = value.len;
     v->valid = 1;
     v->no_cacheable = vdata->flags & NGX_NJS_VAR_NOCACHE;
@@ -1620,6 +2028,87 @@ ngx_http_js_variable_set(ngx_http_request_t *r, ngx_http_variable_value_t *v,
 }
 
 
+static ngx_http_js_set_cache_node_t *
+ngx_http_js_set_cache_lookup(ngx_http_js_set_cache_t *cache, ngx_str_t *key)
+{
+    uint32_t                       hash;
+    ngx_http_js_set_cache_node_t  *node;
+
+    hash = ngx_crc32_short(key->data, key->len);
+
+    node = (ngx_http_js_set_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->rbtree, key, hash);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (cache->ttl
+        && (ngx_msec_int_t) (node->expires - ngx_current_msec) <= 0)
+    {
+        return NULL;
+    }
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&cache->lru, &node->queue);
+
+    return node;
+}
+
+
+static void
+ngx_http_js_set_cache_update(ngx_http_js_set_cache_t *cache, ngx_str_t *key,
+    ngx_str_t *value)
+{
+    uint32_t                       hash;
+    ngx_queue_t                   *q;
+    ngx_http_js_set_cache_node_t  *node;
+
+    hash = ngx_crc32_short(key->data, key->len);
+
+    node = (ngx_http_js_set_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->rbtree, key, hash);
+
+    if (node == NULL && cache->count >= cache->size) {
+        q = ngx_queue_last(&cache->lru);
+        node = ngx_queue_data(q, ngx_http_js_set_cache_node_t, queue);
+    }
+
+    if (node != NULL) {
+        ngx_queue_remove(&node->queue);
+        ngx_rbtree_delete(&cache->rbtree, &node->sn.node);
+        ngx_free(node);
+
+        cache->count--;
+    }
+
+    /* the key and the value are stored after the node */
+
+    node = ngx_alloc(sizeof(ngx_http_js_set_cache_node_t) + key->len
+                     + value->len, ngx_cycle->log);
+    if (node == NULL) {
+        return;
+    }
+
+    node->sn.str.len = key->len;
+    node->sn.str.data = (u_char *) node + sizeof(ngx_http_js_set_cache_node_t);
+    ngx_memcpy(node->sn.str.data, key->data, key->len);
+
+    node->sn.node.key = hash;
+
+    node->value.len = value->len;
+    node->value.data = node->sn.str.data + key->len;
+    ngx_memcpy(node->value.data, value->data, value->len);
+
+    node->expires = ngx_current_msec + cache->ttl;
+
+    ngx_rbtree_insert(&cache->rbtree, &node->sn.node);
+    ngx_queue_insert_head(&cache->lru, &node->queue);
+
+    cache->count++;
+}
+
+
 static ngx_int_t
 ngx_http_js_variable_var(ngx_http_request_t *r, ngx_http_variable_value_t *v,
     uintptr_t data)
@@ -7469,13 +7958,31 @@ ngx_http_qjs_headers_out_delete_property(JSContext *cx,
 }
 
 
+static JSValue
+ngx_http_qjs_body_filter_flags(JSContext *cx, ngx_uint_t last)
+{
+    JSValue  flags;
+
+    flags = JS_NewObject(cx);
+    if (JS_IsException(flags)) {
+        return JS_EXCEPTION;
+    }
+
+    if (JS_SetPropertyStr(cx, flags, "last", JS_NewBool(cx, last)) < 0) {
+        JS_FreeValue(cx, flags);
+        return JS_EXCEPTION;
+    }
+
+    return flags;
+}
+
+
 static ngx_int_t
 ngx_http_qjs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
     ngx_http_js_ctx_t *ctx, ngx_chain_t *in)
 {
     size_t             len;
-    JSAtom             last_key;
-    JSValue            arguments[3], last;
+    JSValue            arguments[3];
     ngx_int_t          rc;
     njs_int_t          pending;
     ngx_buf_t         *b;
@@ -7486,13 +7993,23 @@ ngx_http_qjs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
     c = r->connection;
     cx = ctx->engine->u.qjs.ctx;
 
-    arguments[0] = ngx_qjs_arg(ctx->args[0]);
+    /*
+     * The flags object of all the chunks but the last one is
+     * created once per request, its "last" property is reset
+     * before each chunk as the filter may change it.
+     */
 
-    last_key = JS_NewAtom(cx, "last");
-    if (last_key == JS_ATOM_NULL) {
-        return NGX_ERROR;
+    if (!JS_IsObject(ngx_qjs_arg(ctx->args[2]))) {
+        arguments[2] = ngx_http_qjs_body_filter_flags(cx, 0);
+        if (JS_IsException(arguments[2])) {
+            return NGX_ERROR;
+        }
+
+        ngx_qjs_arg(ctx->args[2]) = arguments[2];
     }
 
+    arguments[0] = ngx_qjs_arg(ctx->args[0]);
+
     while (in != NULL) {
         ctx->buf = in->buf;
         b = ctx->buf;
@@ -7502,24 +8019,26 @@ ngx_http_qjs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
 
             arguments[1] = ngx_qjs_prop(cx, jlcf->buffer_type, b->pos, len);
             if (JS_IsException(arguments[1])) {
-                JS_FreeAtom(cx, last_key);
                 return NGX_ERROR;
             }
 
-            last = JS_NewBool(cx, b->last_buf);
+            if (b->last_buf) {
+                arguments[2] = ngx_http_qjs_body_filter_flags(cx, 1);
+                if (JS_IsException(arguments[2])) {
+                    JS_FreeValue(cx, arguments[1]);
+                    return NGX_ERROR;
+                }
 
-            arguments[2] = JS_NewObject(cx);
-            if (JS_IsException(arguments[2])) {
-                JS_FreeAtom(cx, last_key);
-                JS_FreeValue(cx, arguments[1]);
-                return NGX_ERROR;
-            }
+            } else {
+                if (JS_SetPropertyStr(cx, ngx_qjs_arg(ctx->args[2]), "last",
+                                      JS_FALSE)
+                    < 0)
+                {
+                    JS_FreeValue(cx, arguments[1]);
+                    return NGX_ERROR;
+                }
 
-            if (JS_SetProperty(cx, arguments[2], last_key, last) < 0) {
-                JS_FreeAtom(cx, last_key);
-                JS_FreeValue(cx, arguments[1]);
-                JS_FreeValue(cx, arguments[2]);
-                return NGX_ERROR;
+                arguments[2] = JS_DupValue(cx, ngx_qjs_arg(ctx->args[2]));
             }
 
             pending = ngx_js_ctx_pending(ctx);
@@ -7530,7 +8049,6 @@ ngx_http_qjs_body_filter(ngx_http_request_t *r, ngx_http_js_loc_conf_t *jlcf,
             rc = ctx->engine->call((ngx_js_ctx_t *) ctx, &jlcf->body_filter,
                                    (njs_opaque_value_t *) &arguments[0], 3);
 
-            JS_FreeAtom(cx, last_key);
             JS_FreeValue(cx, arguments[1]);
             JS_FreeValue(cx, arguments[2]);
 
@@ -7978,9 +8496,13 @@ invalid:
 static char *
 ngx_http_js_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
-    ngx_str_t            *value;
-    ngx_js_set_t         *data, *prev;
-    ngx_http_variable_t  *v;
+    ngx_int_t                          n;
+    ngx_str_t                         *value, s;
+    ngx_uint_t                         i;
+    ngx_js_set_t                      *data, *prev;
+    ngx_http_variable_t               *v;
+    ngx_http_js_set_cache_t           *cache;
+    ngx_http_compile_complex_value_t   ccv;
 
     value = cf->args->elts;
 
@@ -8007,6 +8529,7 @@ ngx_http_js_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     data->flags = 0;
     data->file_name = cf->conf_file->file.name.data;
     data->line = cf->conf_file->line;
+    data->cache = NULL;
 
     if (v->get_handler == ngx_http_js_variable_set) {
         prev = (ngx_js_set_t *) v->data;
@@ -8021,21 +8544,102 @@ ngx_http_js_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         }
     }
 
-    if (cf->args->nelts == 4) {
-        if (ngx_strcmp(value[3].data, "nocache") == 0) {
+    cache = NULL;
+
+    for (i = 3; i < cf->args->nelts; i++) {
+
+        if (ngx_strcmp(value[i].data, "nocache") == 0) {
             data->flags |= NGX_NJS_VAR_NOCACHE;
+            continue;
+        }
 
-        } else {
+        if (cache == NULL
+            && (ngx_strncmp(value[i].data, "cache=", 6) == 0
+                || ngx_strncmp(value[i].data, "size=", 5) == 0
+                || ngx_strncmp(value[i].data, "ttl=", 4) == 0))
+        {
+            cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_js_set_cache_t));
+            if (cache == NULL) {
+                return NGX_CONF_ERROR;
+            }
+
+            cache->size = 1024;
+        }
+
+        if (ngx_strncmp(value[i].data, "cache=", 6) == 0) {
+            s.data = value[i].data + 6;
+            s.len = value[i].len - 6;
+
+            if (s.len == 0) {
+                goto invalid;
+            }
+
+            ngx_memzero(&ccv, sizeof(ngx_http_compile_complex_value_t));
+
+            ccv.cf = cf;
+            ccv.value = &s;
+            ccv.complex_value = &cache->key;
+
+            if (ngx_http_compile_complex_value(&ccv) != NGX_OK) {
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "size=", 5) == 0) {
+            n = ngx_atoi(value[i].data + 5, value[i].len - 5);
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            cache->size = n;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "ttl=", 4) == 0) {
+            s.data = value[i].data + 4;
+            s.len = value[i].len - 4;
+
+            cache->ttl = ngx_parse_time(&s, 0);
+            if (cache->ttl == (ngx_msec_t) NGX_ERROR) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "unrecognized flag \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (cache != NULL) {
+        if (cache->key.value.data == NULL) {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                "unrecognized flag \"%V\"", &value[3]);
+                               "\"size\" and \"ttl\" require \"cache\" "
+                               "in js_set \"%V\"", &value[1]);
             return NGX_CONF_ERROR;
         }
+
+        ngx_rbtree_init(&cache->rbtree, &cache->sentinel,
+                        ngx_str_rbtree_insert_value);
+        ngx_queue_init(&cache->lru);
+
+        data->cache = cache;
     }
 
     v->get_handler = ngx_http_js_variable_set;
     v->data = (uintptr_t) data;
 
     return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
 }
 
 
@@ -8179,12 +8783,21 @@ ngx_http_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd,
 }
 
 
+static char *
+ngx_http_js_fetch_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    return ngx_js_fetch_cache(cf, cmd, conf, &ngx_http_js_module);
+}
+
+
 static char *
 ngx_http_js_body_filter_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_js_loc_conf_t *jlcf = conf;
 
-    ngx_str_t  *value;
+    ssize_t     size;
+    ngx_str_t  *value, s;
+    ngx_uint_t  i;
 
     if (jlcf->body_filter.data) {
         return "is duplicate";
@@ -8194,27 +8807,47 @@ ngx_http_js_body_filter_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     jlcf->body_filter = value[1];
 
     jlcf->buffer_type = NGX_JS_STRING;
+    jlcf->buffer_size = 0;
 
-    if (cf->args->nelts == 3) {
-        if (ngx_strncmp(value[2].data, "buffer_type=", 12) == 0) {
-            if (ngx_strcmp(&value[2].data[12], "string") == 0) {
+    for (i = 2; i < cf->args->nelts; i++) {
+        if (ngx_strncmp(value[i].data, "buffer_type=", 12) == 0) {
+            if (ngx_strcmp(&value[i].data[12], "string") == 0) {
                 jlcf->buffer_type = NGX_JS_STRING;
 
-            } else if (ngx_strcmp(&value[2].data[12], "buffer") == 0) {
+            } else if (ngx_strcmp(&value[i].data[12], "buffer") == 0) {
                 jlcf->buffer_type = NGX_JS_BUFFER;
 
             } else {
                 ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                    "invalid buffer_type value \"%V\", "
                                    "it must be \"string\" or \"buffer\"",
-                                   &value[2]);
+                                   &value[i]);
                 return NGX_CONF_ERROR;
             }
-        } else {
-            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                               "invalid parameter \"%V\"", &value[2]);
-            return NGX_CONF_ERROR;
+
+            continue;
         }
+
+        if (ngx_strncmp(value[i].data, "buffer_size=", 12) == 0) {
+            s.data = value[i].data + 12;
+            s.len = value[i].len - 12;
+
+            size = ngx_parse_size(&s);
+            if (size == NGX_ERROR || size == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid buffer_size value \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            jlcf->buffer_size = size;
+
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
     }
 
     return NGX_CONF_OK;
@@ -8252,6 +8885,8 @@ ngx_http_js_create_loc_conf(ngx_conf_t *cf)
         return NULL;
     }
 
+    conf->buffer_size = NGX_CONF_UNSET_SIZE;
+
 #if (NGX_SSL)
     conf->ssl_verify = NGX_CONF_UNSET;
     conf->ssl_verify_depth = NGX_CONF_UNSET;
@@ -8271,6 +8906,7 @@ ngx_http_js_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_str_value(conf->body_filter, prev->body_filter, "");
     ngx_conf_merge_uint_value(conf->buffer_type, prev->buffer_type,
                               NGX_JS_STRING);
+    ngx_conf_merge_size_value(conf->buffer_size, prev->buffer_size, 0);
 
     if (ngx_js_merge_conf(cf, parent, child, ngx_http_js_init_conf_vm)
         != NGX_CONF_OK)
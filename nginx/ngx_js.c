@@ -13,6 +13,16 @@
 #include "ngx_js_http.h"
 
 
+/*
+ * js_context_reuse is inherited unset and defaults per engine:
+ * a retained njs VM pool keeps the memory of the largest request,
+ * so pools are reused by the njs engine only if configured.
+ */
+
+#define ngx_js_conf_reuse(conf, dflt)                                         \
+    (((conf)->reuse == NGX_CONF_UNSET_SIZE) ? (dflt) : (conf)->reuse)
+
+
 typedef struct {
     ngx_queue_t          labels;
 } ngx_js_console_t;
@@ -40,12 +50,22 @@ typedef struct {
 } njs_module_info_t;
 
 
+typedef struct {
+    u_char              *name;
+    njs_opaque_value_t   value;
+} ngx_js_function_t;
+
+
 static ngx_int_t ngx_engine_njs_init(ngx_engine_t *engine,
     ngx_engine_opts_t *opts);
 static ngx_int_t ngx_engine_njs_compile(ngx_js_loc_conf_t *conf, ngx_log_t *log,
     u_char *start, size_t size);
 static ngx_int_t ngx_engine_njs_call(ngx_js_ctx_t *ctx, ngx_str_t *fname,
     njs_opaque_value_t *args, njs_uint_t nargs);
+static ngx_js_function_t *ngx_js_function(ngx_engine_t *engine,
+    ngx_str_t *fname);
+static ngx_js_function_t *ngx_js_function_add(ngx_engine_t *engine,
+    ngx_str_t *fname);
 static void *ngx_engine_njs_external(ngx_engine_t *engine);
 static ngx_int_t ngx_engine_njs_pending(ngx_engine_t *engine);
 static ngx_int_t ngx_engine_njs_string(ngx_engine_t *e,
@@ -98,6 +118,14 @@ static void ngx_qjs_console_finalizer(JSRuntime *rt, JSValue val);
 
 static JSModuleDef *ngx_qjs_module_loader(JSContext *ctx,
     const char *module_name, void *opaque);
+static ngx_int_t ngx_qjs_bytecode_cache_name(ngx_js_loc_conf_t *conf,
+    const char *module_name, njs_module_info_t *info, u_char *name);
+static u_char *ngx_qjs_bytecode_cache_read(JSContext *cx,
+    ngx_js_loc_conf_t *conf, const char *module_name, njs_module_info_t *info,
+    struct stat *sb, size_t *code_size);
+static void ngx_qjs_bytecode_cache_write(ngx_js_loc_conf_t *conf,
+    const char *module_name, njs_module_info_t *info, struct stat *sb,
+    u_char *code, size_t code_size);
 static int ngx_qjs_unhandled_rejection(ngx_js_ctx_t *ctx);
 static void ngx_qjs_rejection_tracker(JSContext *ctx, JSValueConst promise,
     JSValueConst reason, JS_BOOL is_handled, void *opaque);
@@ -237,6 +265,17 @@ static njs_external_t  ngx_js_ext_core[] = {
         }
     },
 
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("fetchAll"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = ngx_js_ext_fetch_all,
+        }
+    },
+
     {
         .flags = NJS_EXTERN_PROPERTY,
         .name.string = njs_str("INFO"),
@@ -444,6 +483,7 @@ static const JSCFunctionListEntry ngx_qjs_ext_ngx[] = {
                          NGX_LOG_ERR),
     JS_CGETSET_DEF("error_log_path", ngx_qjs_ext_error_log_path, NULL),
     JS_CFUNC_DEF("fetch", 2, ngx_qjs_ext_fetch),
+    JS_CFUNC_DEF("fetchAll", 2, ngx_qjs_ext_fetch_all),
     JS_CGETSET_MAGIC_DEF("INFO", ngx_qjs_ext_constant_integer, NULL,
                          NGX_LOG_INFO),
     JS_CFUNC_MAGIC_DEF("log", 1, ngx_qjs_ext_log, 0),
@@ -717,14 +757,33 @@ ngx_njs_await(njs_vm_t *vm, ngx_log_t *log, njs_value_t *value)
 ngx_engine_t *
 ngx_njs_clone(ngx_js_ctx_t *ctx, ngx_js_loc_conf_t *cf, void *external)
 {
+    njs_mp_t            *mp;
     njs_vm_t            *vm;
     njs_int_t            ret;
     ngx_engine_t        *engine;
     njs_opaque_value_t   retval;
 
-    vm = njs_vm_clone(cf->engine->u.njs.vm, external);
-    if (vm == NULL) {
-        return NULL;
+    mp = NULL;
+
+    if (cf->reuse_queue != NULL) {
+        mp = ngx_js_queue_pop(cf->reuse_queue);
+    }
+
+    if (mp != NULL) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ctx->log, 0,
+                       "js reused vm pool: %p", mp);
+
+        vm = njs_vm_clone_reuse(cf->engine->u.njs.vm, mp, external);
+        if (vm == NULL) {
+            njs_mp_destroy(mp);
+            return NULL;
+        }
+
+    } else {
+        vm = njs_vm_clone(cf->engine->u.njs.vm, external);
+        if (vm == NULL) {
+            return NULL;
+        }
     }
 
     engine = njs_mp_alloc(njs_vm_memory_pool(vm), sizeof(ngx_engine_t));
@@ -734,6 +793,7 @@ ngx_njs_clone(ngx_js_ctx_t *ctx, ngx_js_loc_conf_t *cf, void *external)
 
     memcpy(engine, cf->engine, sizeof(ngx_engine_t));
     engine->pool = njs_vm_memory_pool(vm);
+    engine->functions = NULL;
     engine->u.njs.vm = vm;
 
     if (njs_vm_start(vm, njs_value_arg(&retval)) == NJS_ERROR) {
@@ -760,21 +820,34 @@ static ngx_int_t
 ngx_engine_njs_call(ngx_js_ctx_t *ctx, ngx_str_t *fname,
     njs_opaque_value_t *args, njs_uint_t nargs)
 {
-    njs_vm_t        *vm;
-    njs_int_t        ret;
-    njs_str_t        name;
-    njs_function_t  *func;
-
-    name.start = fname->data;
-    name.length = fname->len;
+    njs_vm_t           *vm;
+    njs_int_t           ret;
+    njs_str_t           name;
+    njs_function_t     *func;
+    ngx_js_function_t  *f;
 
     vm = ctx->engine->u.njs.vm;
 
-    func = njs_vm_function(vm, &name);
-    if (func == NULL) {
-        ngx_log_error(NGX_LOG_ERR, ctx->log, 0,
-                      "js function \"%V\" not found", fname);
-        return NGX_ERROR;
+    f = ngx_js_function(ctx->engine, fname);
+
+    if (f != NULL) {
+        func = njs_value_function(njs_value_arg(&f->value));
+
+    } else {
+        name.start = fname->data;
+        name.length = fname->len;
+
+        func = njs_vm_function(vm, &name);
+        if (func == NULL) {
+            ngx_log_error(NGX_LOG_ERR, ctx->log, 0,
+                          "js function \"%V\" not found", fname);
+            return NGX_ERROR;
+        }
+
+        f = ngx_js_function_add(ctx->engine, fname);
+        if (f != NULL) {
+            njs_value_function_set(njs_value_arg(&f->value), func);
+        }
     }
 
     ret = njs_vm_invoke(vm, func, njs_value_arg(args), nargs,
@@ -794,6 +867,63 @@ ngx_engine_njs_call(ngx_js_ctx_t *ctx, ngx_str_t *fname,
 }
 
 
+static ngx_js_function_t *
+ngx_js_function(ngx_engine_t *engine, ngx_str_t *fname)
+{
+    ngx_uint_t          i;
+    ngx_js_function_t  *f;
+
+    /*
+     * Functions are looked up by their path once per engine.  Handler
+     * names are configuration strings, so their addresses are used
+     * as keys.
+     *
+     * An engine is cloned for each request and the module code is run
+     * again in the clone, so the table only saves lookups of handlers
+     * called repeatedly in one request, such as the body filter called
+     * for each chunk.
+     */
+
+    if (engine->functions == NULL) {
+        return NULL;
+    }
+
+    f = engine->functions->start;
+
+    for (i = 0; i < engine->functions->items; i++) {
+        if (f[i].name == fname->data) {
+            return &f[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static ngx_js_function_t *
+ngx_js_function_add(ngx_engine_t *engine, ngx_str_t *fname)
+{
+    ngx_js_function_t  *f;
+
+    if (engine->functions == NULL) {
+        engine->functions = njs_arr_create(engine->pool, 4,
+                                           sizeof(ngx_js_function_t));
+        if (engine->functions == NULL) {
+            return NULL;
+        }
+    }
+
+    f = njs_arr_add(engine->functions);
+    if (f == NULL) {
+        return NULL;
+    }
+
+    f->name = fname->data;
+
+    return f;
+}
+
+
 static void *
 ngx_engine_njs_external(ngx_engine_t *engine)
 {
@@ -823,13 +953,34 @@ ngx_engine_njs_string(ngx_engine_t *e, njs_opaque_value_t *value,
 }
 
 
+static void
+ngx_js_cleanup_reuse_vm(void *data)
+{
+    njs_mp_t  *mp;
+
+    ngx_js_queue_t  *reuse = data;
+
+    for ( ;; ) {
+        mp = ngx_js_queue_pop(reuse);
+        if (mp == NULL) {
+            break;
+        }
+
+        njs_mp_destroy(mp);
+    }
+}
+
+
 static void
 ngx_engine_njs_destroy(ngx_engine_t *e, ngx_js_ctx_t *ctx,
     ngx_js_loc_conf_t *conf)
 {
-    njs_int_t           ret;
-    ngx_js_event_t     *event;
-    njs_rbtree_node_t  *node;
+    njs_mp_t            *mp;
+    njs_int_t            ret;
+    njs_mp_stat_t        stat;
+    ngx_js_event_t      *event;
+    njs_rbtree_node_t   *node;
+    ngx_pool_cleanup_t  *cln;
 
     if (ctx != NULL) {
         ret = njs_vm_call_exit_hook(e->u.njs.vm);
@@ -855,8 +1006,52 @@ ngx_engine_njs_destroy(ngx_engine_t *e, ngx_js_ctx_t *ctx,
         if (ngx_js_unhandled_rejection(ctx)) {
             ngx_js_log_exception(e->u.njs.vm, ctx->log, "unhandled rejection");
         }
+
+        if (conf != NULL && ngx_js_conf_reuse(conf, 0) != 0) {
+            if (conf->reuse_queue == NULL) {
+                conf->reuse_queue = ngx_js_queue_create(ngx_cycle->pool,
+                                                        conf->reuse);
+                if (conf->reuse_queue == NULL) {
+                    goto free_vm;
+                }
+
+                cln = ngx_pool_cleanup_add(ngx_cycle->pool, 0);
+                if (cln == NULL) {
+                    goto free_vm;
+                }
+
+                cln->handler = ngx_js_cleanup_reuse_vm;
+                cln->data = conf->reuse_queue;
+            }
+
+            /*
+             * The VM memory is freed, but the pool clusters are kept
+             * to serve the next clone without going to malloc().
+             */
+
+            mp = njs_vm_release(e->u.njs.vm);
+
+            njs_mp_stat(mp, &stat);
+
+            if (stat.size > conf->reuse_max_size) {
+                ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ctx->log, 0,
+                               "js vm pool size %uz exceeds "
+                               "\"js_context_reuse_max_size\", not reusing it",
+                               stat.size);
+                njs_mp_destroy(mp);
+                return;
+            }
+
+            if (ngx_js_queue_push(conf->reuse_queue, mp) != NGX_OK) {
+                njs_mp_destroy(mp);
+            }
+
+            return;
+        }
     }
 
+free_vm:
+
     njs_vm_destroy(e->u.njs.vm);
 
     /*
@@ -1020,6 +1215,7 @@ ngx_qjs_clone(ngx_js_ctx_t *ctx, ngx_js_loc_conf_t *cf, void *external)
 
     memcpy(engine, cf->engine, sizeof(ngx_engine_t));
     engine->pool = mp;
+    engine->functions = NULL;
 
     if (cf->reuse_queue != NULL) {
         engine->u.qjs.ctx = ngx_js_queue_pop(cf->reuse_queue);
@@ -1103,19 +1299,32 @@ static ngx_int_t
 ngx_engine_qjs_call(ngx_js_ctx_t *ctx, ngx_str_t *fname,
     njs_opaque_value_t *args, njs_uint_t nargs)
 {
-    JSValue     fn, val;
-    ngx_int_t   rc;
-    JSContext  *cx;
+    JSValue             fn, val;
+    ngx_int_t           rc;
+    JSContext          *cx;
+    ngx_js_function_t  *f;
 
     cx = ctx->engine->u.qjs.ctx;
 
-    fn = ngx_qjs_value(cx, fname);
-    if (!JS_IsFunction(cx, fn)) {
-        JS_FreeValue(cx, fn);
-        ngx_log_error(NGX_LOG_ERR, ctx->log, 0, "js function \"%V\" not found",
-                      fname);
+    f = ngx_js_function(ctx->engine, fname);
 
-        return NGX_ERROR;
+    if (f != NULL) {
+        fn = JS_DupValue(cx, ngx_qjs_arg(f->value));
+
+    } else {
+        fn = ngx_qjs_value(cx, fname);
+        if (!JS_IsFunction(cx, fn)) {
+            JS_FreeValue(cx, fn);
+            ngx_log_error(NGX_LOG_ERR, ctx->log, 0,
+                          "js function \"%V\" not found", fname);
+
+            return NGX_ERROR;
+        }
+
+        f = ngx_js_function_add(ctx->engine, fname);
+        if (f != NULL) {
+            ngx_qjs_arg(f->value) = JS_DupValue(cx, fn);
+        }
     }
 
     val = JS_Call(cx, fn, JS_UNDEFINED, nargs, &ngx_qjs_arg(args[0]));
@@ -1193,6 +1402,7 @@ ngx_engine_qjs_destroy(ngx_engine_t *e, ngx_js_ctx_t *ctx,
     JSClassID             class_id;
     JSMemoryUsage         stats;
     ngx_qjs_event_t      *event;
+    ngx_js_function_t    *f;
     ngx_js_opaque_t      *opaque;
     njs_rbtree_node_t    *node;
     ngx_pool_cleanup_t   *cln;
@@ -1232,8 +1442,17 @@ ngx_engine_qjs_destroy(ngx_engine_t *e, ngx_js_ctx_t *ctx,
         opaque->external = NULL;
 
         JS_FreeValue(cx, ngx_qjs_arg(ctx->args[0]));
+        JS_FreeValue(cx, ngx_qjs_arg(ctx->args[2]));
         JS_FreeValue(cx, ngx_qjs_arg(ctx->retval));
 
+        if (e->functions != NULL) {
+            f = e->functions->start;
+
+            for (i = 0; i < e->functions->items; i++) {
+                JS_FreeValue(cx, ngx_qjs_arg(f[i].value));
+            }
+        }
+
     } else if (e->precompiled != NULL) {
         pc = e->precompiled->start;
         length = e->precompiled->items;
@@ -1245,10 +1464,10 @@ ngx_engine_qjs_destroy(ngx_engine_t *e, ngx_js_ctx_t *ctx,
 
     njs_mp_destroy(e->pool);
 
-    if (conf != NULL && conf->reuse != 0) {
+    if (conf != NULL && ngx_js_conf_reuse(conf, 128) != 0) {
         if (conf->reuse_queue == NULL) {
             conf->reuse_queue = ngx_js_queue_create(ngx_cycle->pool,
-                                                    conf->reuse);
+                                                ngx_js_conf_reuse(conf, 128));
             if (conf->reuse_queue == NULL) {
                 goto free_ctx;
             }
@@ -2029,9 +2248,13 @@ not_found:
 static JSModuleDef *
 ngx_qjs_module_loader(JSContext *cx, const char *module_name, void *opaque)
 {
+    u_char               *code;
+    size_t                code_size;
     JSValue               func_val;
     njs_int_t             ret;
     njs_str_t             text;
+    ngx_uint_t            cache;
+    struct stat           sb;
     JSModuleDef          *m;
     njs_module_info_t     info;
     ngx_js_loc_conf_t    *conf;
@@ -2056,6 +2279,29 @@ ngx_qjs_module_loader(JSContext *cx, const char *module_name, void *opaque)
         return NULL;
     }
 
+    cache = (conf->bytecode_cache.len != 0 && fstat(info.fd, &sb) != -1);
+
+    if (cache) {
+        code = ngx_qjs_bytecode_cache_read(cx, conf, module_name, &info, &sb,
+                                           &code_size);
+        if (code != NULL) {
+            func_val = JS_ReadObject(cx, code, code_size,
+                                     JS_READ_OBJ_BYTECODE);
+
+            if (!JS_IsException(func_val)) {
+                (void) close(info.fd);
+                goto done;
+            }
+
+            JS_FreeValue(cx, JS_GetException(cx));
+            js_free(cx, code);
+
+            ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                          "js bytecode cache for \"%s\" is not loadable, "
+                          "recompiling", info.file.start);
+        }
+    }
+
     ret = ngx_js_module_read(conf->engine->pool, info.fd, &text);
 
     (void) close(info.fd);
@@ -2075,35 +2321,303 @@ ngx_qjs_module_loader(JSContext *cx, const char *module_name, void *opaque)
         return NULL;
     }
 
+    code = JS_WriteObject(cx, &code_size, func_val, JS_WRITE_OBJ_BYTECODE);
+    if (code == NULL) {
+        JS_FreeValue(cx, func_val);
+        JS_ThrowInternalError(cx, "could not write module bytecode");
+        return NULL;
+    }
+
+    if (cache) {
+        ngx_qjs_bytecode_cache_write(conf, module_name, &info, &sb, code,
+                                     code_size);
+    }
+
+done:
+
     if (conf->engine->precompiled == NULL) {
         conf->engine->precompiled = njs_arr_create(conf->engine->pool, 4,
                                                   sizeof(ngx_js_code_entry_t));
         if (conf->engine->precompiled == NULL) {
-            JS_FreeValue(cx, func_val);
-            JS_ThrowOutOfMemory(cx);
-            return NULL;
+            goto failed;
         }
     }
 
     pc = njs_arr_add(conf->engine->precompiled);
     if (pc == NULL) {
-        JS_FreeValue(cx, func_val);
-        JS_ThrowOutOfMemory(cx);
-        return NULL;
+        goto failed;
     }
 
-    pc->code = JS_WriteObject(cx, &pc->code_size, func_val,
-                              JS_WRITE_OBJ_BYTECODE);
-    if (pc->code == NULL) {
-        JS_FreeValue(cx, func_val);
-        JS_ThrowInternalError(cx, "could not write module bytecode");
-        return NULL;
-    }
+    pc->code = code;
+    pc->code_size = code_size;
 
     m = JS_VALUE_GET_PTR(func_val);
     JS_FreeValue(cx, func_val);
 
     return m;
+
+failed:
+
+    js_free(cx, code);
+    JS_FreeValue(cx, func_val);
+    JS_ThrowOutOfMemory(cx);
+
+    return NULL;
+}
+
+
+/*
+ * Bytecode cache file layout: the header, the module file path and
+ * the module name, both null-terminated, and the module bytecode.
+ * The file is named after the CRC32 of the path and the name.
+ */
+
+#define NGX_QJS_BYTECODE_MAGIC     "NJSQJSBC"
+
+/*
+ * The bytecode format is private to QuickJS and changes between its
+ * releases, so the cache is tied to the njs and QuickJS versions
+ * and to the pointer size of the build.
+ */
+
+#ifdef NJS_QUICKJS_VERSION
+#define NGX_QJS_BYTECODE_BUILD     NJS_VERSION " QuickJS " NJS_QUICKJS_VERSION
+#else
+#define NGX_QJS_BYTECODE_BUILD     NJS_VERSION
+#endif
+
+
+typedef struct {
+    u_char                      magic[8];
+    uint32_t                    build;
+    uint32_t                    crc32;
+    uint64_t                    mtime;
+    uint64_t                    size;
+    uint32_t                    name_len;
+    uint32_t                    code_size;
+} ngx_qjs_bytecode_header_t;
+
+
+static uint32_t
+ngx_qjs_bytecode_build(void)
+{
+    u_char       ptr_size;
+    uint32_t     crc;
+#if defined(QJS_VERSION_MAJOR)
+    const char  *version;
+#endif
+
+    ptr_size = sizeof(void *);
+
+    ngx_crc32_init(crc);
+    ngx_crc32_update(&crc, (u_char *) NGX_QJS_BYTECODE_BUILD,
+                     sizeof(NGX_QJS_BYTECODE_BUILD) - 1);
+    ngx_crc32_update(&crc, &ptr_size, 1);
+
+#if defined(QJS_VERSION_MAJOR)
+    /* a shared library may be updated without rebuilding nginx */
+
+    version = JS_GetVersion();
+    ngx_crc32_update(&crc, (u_char *) version, ngx_strlen(version));
+#endif
+
+    ngx_crc32_final(crc);
+
+    return crc;
+}
+
+
+static ngx_int_t
+ngx_qjs_bytecode_cache_name(ngx_js_loc_conf_t *conf, const char *module_name,
+    njs_module_info_t *info, u_char *name)
+{
+    u_char    *p;
+    uint32_t   crc;
+
+    if (conf->bytecode_cache.len + sizeof("/12345678.qjsbc") > NGX_MAX_PATH) {
+        return NGX_ERROR;
+    }
+
+    ngx_crc32_init(crc);
+    ngx_crc32_update(&crc, info->file.start, info->file.length + 1);
+    ngx_crc32_update(&crc, (u_char *) module_name, info->name.length + 1);
+    ngx_crc32_final(crc);
+
+    p = ngx_sprintf(name, "%V/%08xD.qjsbc", &conf->bytecode_cache, crc);
+    *p = '\0';
+
+    return NGX_OK;
+}
+
+
+static u_char *
+ngx_qjs_bytecode_cache_read(JSContext *cx, ngx_js_loc_conf_t *conf,
+    const char *module_name, njs_module_info_t *info, struct stat *sb,
+    size_t *code_size)
+{
+    u_char                     *buf, *p, *code;
+    size_t                      size, name_len;
+    ssize_t                     n;
+    ngx_fd_t                    fd;
+    ngx_file_info_t             fi;
+    ngx_qjs_bytecode_header_t  *h;
+    u_char                      name[NGX_MAX_PATH + 1];
+
+    if (ngx_qjs_bytecode_cache_name(conf, module_name, info, name)
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+    if (fd == NGX_INVALID_FILE) {
+        return NULL;
+    }
+
+    buf = NULL;
+    code = NULL;
+
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        goto done;
+    }
+
+    size = ngx_file_size(&fi);
+    name_len = info->file.length + info->name.length + 2;
+
+    if (size <= sizeof(ngx_qjs_bytecode_header_t) + name_len) {
+        goto done;
+    }
+
+    buf = njs_mp_alloc(conf->engine->pool, size);
+    if (buf == NULL) {
+        goto done;
+    }
+
+    n = ngx_read_fd(fd, buf, size);
+    if (n == -1 || (size_t) n != size) {
+        goto done;
+    }
+
+    h = (ngx_qjs_bytecode_header_t *) buf;
+    p = buf + sizeof(ngx_qjs_bytecode_header_t);
+
+    if (ngx_memcmp(h->magic, NGX_QJS_BYTECODE_MAGIC, sizeof(h->magic)) != 0
+        || h->build != ngx_qjs_bytecode_build()
+        || h->mtime != (uint64_t) sb->st_mtime
+        || h->size != (uint64_t) sb->st_size
+        || h->name_len != name_len
+        || h->code_size != size - sizeof(ngx_qjs_bytecode_header_t) - name_len
+        || ngx_memcmp(p, info->file.start, info->file.length + 1) != 0
+        || ngx_memcmp(p + info->file.length + 1, module_name,
+                      info->name.length + 1) != 0)
+    {
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                       "js bytecode cache \"%s\" is stale", name);
+        goto done;
+    }
+
+    p += name_len;
+
+    if (h->crc32 != ngx_crc32_long(p, h->code_size)) {
+        ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                      "js bytecode cache \"%s\" is corrupted", name);
+        goto done;
+    }
+
+    code = js_malloc(cx, h->code_size);
+    if (code == NULL) {
+        goto done;
+    }
+
+    ngx_memcpy(code, p, h->code_size);
+    *code_size = h->code_size;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "js bytecode cache \"%s\" loaded for \"%s\"",
+                   name, info->file.start);
+
+done:
+
+    if (buf != NULL) {
+        njs_mp_free(conf->engine->pool, buf);
+    }
+
+    (void) ngx_close_file(fd);
+
+    return code;
+}
+
+
+static void
+ngx_qjs_bytecode_cache_write(ngx_js_loc_conf_t *conf, const char *module_name,
+    njs_module_info_t *info, struct stat *sb, u_char *code, size_t code_size)
+{
+    u_char                     *p;
+    ngx_fd_t                    fd;
+    ngx_err_t                   err;
+    ngx_qjs_bytecode_header_t   h;
+    u_char                      name[NGX_MAX_PATH + 1];
+    u_char                      temp[NGX_MAX_PATH + 1 + NGX_INT_T_LEN];
+
+    if (ngx_qjs_bytecode_cache_name(conf, module_name, info, name)
+        != NGX_OK)
+    {
+        return;
+    }
+
+    ngx_memcpy(h.magic, NGX_QJS_BYTECODE_MAGIC, sizeof(h.magic));
+    h.build = ngx_qjs_bytecode_build();
+    h.crc32 = ngx_crc32_long(code, code_size);
+    h.mtime = sb->st_mtime;
+    h.size = sb->st_size;
+    h.name_len = info->file.length + info->name.length + 2;
+    h.code_size = code_size;
+
+    p = ngx_sprintf(temp, "%s.%P", name, ngx_pid);
+    *p = '\0';
+
+    fd = ngx_open_file(temp, NGX_FILE_WRONLY, NGX_FILE_TRUNCATE,
+                       NGX_FILE_DEFAULT_ACCESS);
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", temp);
+        return;
+    }
+
+    if (ngx_write_fd(fd, &h, sizeof(h)) != (ssize_t) sizeof(h)
+        || ngx_write_fd(fd, info->file.start, info->file.length + 1)
+           != (ssize_t) info->file.length + 1
+        || ngx_write_fd(fd, (u_char *) module_name, info->name.length + 1)
+           != (ssize_t) info->name.length + 1
+        || ngx_write_fd(fd, code, code_size) != (ssize_t) code_size)
+    {
+        err = ngx_errno;
+        (void) ngx_close_file(fd);
+        (void) ngx_delete_file(temp);
+
+        ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, err,
+                      ngx_write_fd_n " \"%s\" failed", temp);
+        return;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", temp);
+    }
+
+    if (ngx_rename_file(temp, name) == NGX_FILE_ERROR) {
+        err = ngx_errno;
+        (void) ngx_delete_file(temp);
+
+        ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, err,
+                      ngx_rename_file_n " \"%s\" to \"%s\" failed",
+                      temp, name);
+        return;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "js bytecode cache \"%s\" saved for \"%s\"",
+                   name, info->file.start);
 }
 
 
@@ -3182,6 +3696,34 @@ ngx_js_import(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+char *
+ngx_js_bytecode_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_js_loc_conf_t *jscf = conf;
+
+    ngx_str_t  *value;
+
+    if (jscf->bytecode_cache.data != NULL) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        ngx_str_set(&jscf->bytecode_cache, "");
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_conf_full_name(cf->cycle, &value[1], 0) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    jscf->bytecode_cache = value[1];
+
+    return NGX_CONF_OK;
+}
+
+
 char *
 ngx_js_engine(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -4119,6 +4661,11 @@ ngx_js_init_conf_vm(ngx_conf_t *cf, ngx_js_loc_conf_t *conf,
     options->file.length = file.len;
     options->conf = conf;
 
+    if (conf->type == NGX_ENGINE_NJS && conf->bytecode_cache.len != 0) {
+        ngx_log_error(NGX_LOG_WARN, cf->log, 0,
+                      "\"js_bytecode_cache\" is ignored by the njs engine");
+    }
+
     conf->engine = ngx_create_engine(options);
     if (conf->engine == NULL) {
         ngx_log_error(NGX_LOG_EMERG, cf->log, 0, "failed to create js VM");
@@ -4197,6 +4744,7 @@ ngx_js_create_conf(ngx_conf_t *cf, size_t size)
      * set by ngx_pcalloc():
      *
      *     conf->reuse_queue = NULL;
+     *     conf->bytecode_cache = { 0, NULL };
      *     conf->fetch_proxy_auth_header = { 0, NULL };
      */
 
@@ -4215,8 +4763,12 @@ ngx_js_create_conf(ngx_conf_t *cf, size_t size)
     conf->fetch_keepalive_requests = NGX_CONF_UNSET_UINT;
     conf->fetch_keepalive_time = NGX_CONF_UNSET_MSEC;
     conf->fetch_keepalive_timeout = NGX_CONF_UNSET_MSEC;
+    conf->fetch_max_conns = NGX_CONF_UNSET_UINT;
     conf->fetch_proxy_url = NGX_CONF_UNSET_PTR;
     conf->eval_proxy_url = NGX_CONF_UNSET_PTR;
+    conf->fetch_cache = NGX_CONF_UNSET_PTR;
+    conf->fetch_cache_max_size = NGX_CONF_UNSET_SIZE;
+    conf->fetch_resolver_cache = NGX_CONF_UNSET_PTR;
 
     return conf;
 }
@@ -4322,9 +4874,16 @@ ngx_js_merge_conf(ngx_conf_t *cf, void *parent, void *child,
     }
 
     ngx_conf_merge_msec_value(conf->timeout, prev->timeout, 60000);
-    ngx_conf_merge_size_value(conf->reuse, prev->reuse, 128);
+
+    /* the default depends on the engine, see ngx_js_conf_reuse() */
+
+    if (conf->reuse == NGX_CONF_UNSET_SIZE) {
+        conf->reuse = prev->reuse;
+    }
+
     ngx_conf_merge_size_value(conf->reuse_max_size, prev->reuse_max_size,
                               4 * 1024 * 1024);
+    ngx_conf_merge_str_value(conf->bytecode_cache, prev->bytecode_cache, "");
     ngx_conf_merge_size_value(conf->buffer_size, prev->buffer_size, 16384);
     ngx_conf_merge_size_value(conf->max_response_body_size,
                               prev->max_response_body_size, 1048576);
@@ -4339,12 +4898,22 @@ ngx_js_merge_conf(ngx_conf_t *cf, void *parent, void *child,
     ngx_queue_init(&conf->fetch_keepalive_cache);
     ngx_queue_init(&conf->fetch_keepalive_free);
 
+    ngx_conf_merge_uint_value(conf->fetch_max_conns, prev->fetch_max_conns, 0);
+    ngx_rbtree_init(&conf->fetch_hosts, &conf->fetch_hosts_sentinel,
+                    ngx_str_rbtree_insert_value);
+
     ngx_conf_merge_ptr_value(conf->fetch_proxy_url, prev->fetch_proxy_url,
                              NULL);
     ngx_conf_merge_ptr_value(conf->eval_proxy_url, prev->eval_proxy_url, NULL);
     ngx_conf_merge_str_value(conf->fetch_proxy_auth_header,
                              prev->fetch_proxy_auth_header, "");
 
+    ngx_conf_merge_ptr_value(conf->fetch_cache, prev->fetch_cache, NULL);
+    ngx_conf_merge_size_value(conf->fetch_cache_max_size,
+                              prev->fetch_cache_max_size, 1048576);
+    ngx_conf_merge_ptr_value(conf->fetch_resolver_cache,
+                             prev->fetch_resolver_cache, NULL);
+
     if (ngx_js_merge_vm(cf, (ngx_js_loc_conf_t *) conf,
                         (ngx_js_loc_conf_t *) prev,
                         init_vm)
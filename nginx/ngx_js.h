@@ -66,6 +66,7 @@ enum {
     NGX_QJS_CLASS_ID_FETCH_HEADERS,
     NGX_QJS_CLASS_ID_FETCH_REQUEST,
     NGX_QJS_CLASS_ID_FETCH_RESPONSE,
+    NGX_QJS_CLASS_ID_FETCH_BODY,
 };
 #endif
 
@@ -75,6 +76,7 @@ typedef struct ngx_js_event_s ngx_js_event_t;
 typedef struct ngx_js_dict_s  ngx_js_dict_t;
 typedef struct ngx_js_ctx_s  ngx_js_ctx_t;
 typedef struct ngx_engine_s  ngx_engine_t;
+typedef struct ngx_js_resolver_cache_s  ngx_js_resolver_cache_t;
 
 
 typedef ngx_pool_t *(*ngx_external_pool_pt)(njs_external_ptr_t e);
@@ -129,6 +131,7 @@ typedef struct {
     ngx_str_t              cwd;                                               \
     ngx_array_t           *imports;                                           \
     ngx_array_t           *paths;                                             \
+    ngx_str_t              bytecode_cache;                                    \
                                                                               \
     ngx_array_t           *preload_objects;                                   \
                                                                               \
@@ -142,10 +145,18 @@ typedef struct {
     ngx_msec_t             fetch_keepalive_timeout;                           \
     ngx_queue_t            fetch_keepalive_cache;                             \
     ngx_queue_t            fetch_keepalive_free;                              \
+    ngx_uint_t             fetch_max_conns;                                   \
+    ngx_rbtree_t           fetch_hosts;                                       \
+    ngx_rbtree_node_t      fetch_hosts_sentinel;                              \
                                                                               \
     ngx_url_t              *fetch_proxy_url;                                  \
     ngx_str_t               fetch_proxy_auth_header;                          \
                                                                               \
+    ngx_shm_zone_t        *fetch_cache;                                       \
+    size_t                 fetch_cache_max_size;                              \
+                                                                              \
+    ngx_js_resolver_cache_t *fetch_resolver_cache;                            \
+                                                                              \
     ngx_int_t             (*eval_proxy_url)(ngx_pool_t *pool,                 \
                                             void *request,                    \
                                             void *module_conf,                \
@@ -216,6 +227,7 @@ typedef struct {
     unsigned     flags;
     u_char      *file_name;
     ngx_uint_t   line;
+    void        *cache;
 } ngx_js_set_t;
 
 
@@ -292,6 +304,7 @@ struct ngx_engine_s {
     const char                 *name;
     njs_mp_t                   *pool;
     njs_arr_t                  *precompiled;
+    njs_arr_t                  *functions;
 };
 
 
@@ -387,6 +400,8 @@ ngx_int_t ngx_qjs_string(JSContext *cx, ngx_pool_t *pool, JSValueConst val,
 
 JSValue ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
      JSValueConst *argv);
+JSValue ngx_qjs_ext_fetch_all(JSContext *cx, JSValueConst this_val, int argc,
+     JSValueConst *argv);
 
 #define ngx_qjs_prop(cx, type, start, len)                                   \
     ((type == NGX_JS_STRING) ? qjs_string_create(cx, start, len)             \
@@ -440,8 +455,13 @@ void ngx_js_logger(ngx_connection_t *c, ngx_uint_t level,
     const u_char *start, size_t length);
 char * ngx_js_import(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 char * ngx_js_engine(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+char * ngx_js_bytecode_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 char * ngx_js_preload_object(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 char * ngx_js_fetch_proxy(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+char *ngx_js_fetch_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
+    void *tag);
+char *ngx_js_fetch_resolver_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 ngx_int_t ngx_js_parse_proxy_url(ngx_pool_t *pool, ngx_log_t *log,
     ngx_str_t *url_str, ngx_url_t **url_out, ngx_str_t *auth_header_out);
 ngx_int_t ngx_js_merge_vm(ngx_conf_t *cf, ngx_js_loc_conf_t *conf,
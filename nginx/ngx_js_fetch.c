@@ -17,6 +17,9 @@ typedef struct {
 } ngx_js_entry_t;
 
 
+typedef struct ngx_js_fetch_batch_s  ngx_js_fetch_batch_t;
+
+
 typedef struct {
     ngx_js_http_t                  http;
 
@@ -27,9 +30,35 @@ typedef struct {
 
     njs_opaque_value_t             promise;
     njs_opaque_value_t             promise_callbacks[2];
+
+    uint8_t                        reading;
+    njs_opaque_value_t             read_callbacks[2];
+
+    ngx_js_fetch_batch_t          *batch;
+    ngx_uint_t                     index;
 } ngx_js_fetch_t;
 
 
+/*
+ * remaining: the number of responses not received yet,
+ * 0 once the promise is settled.
+ */
+
+struct ngx_js_fetch_batch_s {
+    ngx_js_http_batch_t            http;
+
+    njs_opaque_value_t             promise;
+    njs_opaque_value_t             promise_callbacks[2];
+    njs_opaque_value_t             results;
+
+    ngx_uint_t                     remaining;
+    ngx_js_fetch_t               **fetches;
+};
+
+
+static njs_int_t ngx_js_fetch(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, ngx_js_fetch_batch_t *batch, ngx_uint_t index,
+    njs_value_t *retval);
 static njs_int_t ngx_js_method_process(njs_vm_t *vm, ngx_js_request_t *r);
 static njs_int_t ngx_js_headers_inherit(njs_vm_t *vm, ngx_js_headers_t *headers,
     ngx_js_headers_t *orig);
@@ -43,6 +72,8 @@ static njs_int_t ngx_js_fetch_promissified_result(njs_vm_t *vm,
     njs_value_t *result, njs_int_t rc, njs_value_t *retval);
 static void ngx_js_fetch_done(ngx_js_fetch_t *fetch, njs_opaque_value_t *retval,
                               njs_int_t rc);
+static njs_int_t ngx_js_fetch_batch_settle(ngx_js_fetch_t *fetch,
+    njs_opaque_value_t *retval, njs_int_t rc);
 static njs_int_t ngx_js_http_promise_trampoline(njs_vm_t *vm,
     njs_value_t *args, njs_uint_t nargs, njs_index_t unused,
     njs_value_t *retval);
@@ -50,11 +81,20 @@ static njs_int_t ngx_js_http_promise_trampoline(njs_vm_t *vm,
 static njs_int_t ngx_js_request_constructor(njs_vm_t *vm,
     ngx_js_request_t *request, ngx_url_t *u, njs_external_ptr_t external,
     njs_value_t *args, njs_uint_t nargs);
+static njs_int_t ngx_js_request_body_stream(njs_vm_t *vm,
+    ngx_js_request_t *request, ngx_js_response_t *response);
 
 static ngx_int_t ngx_js_fetch_append_headers(ngx_js_http_t *http,
     ngx_js_headers_t *headers, u_char *name, size_t len, u_char *value,
     size_t vlen);
 static void ngx_js_fetch_process_done(ngx_js_http_t *http);
+static ngx_int_t ngx_js_fetch_stream_handler(ngx_js_http_t *http,
+    ngx_uint_t event);
+static ngx_int_t ngx_js_fetch_stream_finalize(ngx_js_fetch_t *fetch,
+    ngx_int_t rc);
+static ngx_int_t ngx_js_fetch_read_settle(ngx_js_fetch_t *fetch);
+static njs_int_t ngx_js_fetch_read_result(njs_vm_t *vm,
+    ngx_js_response_t *response, njs_value_t *retval);
 static njs_int_t ngx_js_headers_append(njs_vm_t *vm, ngx_js_headers_t *headers,
     u_char *name, size_t len, u_char *value, size_t vlen);
 
@@ -112,6 +152,15 @@ static njs_int_t ngx_response_js_ext_type(njs_vm_t *vm,
     njs_value_t *setval, njs_value_t *retval);
 static njs_int_t ngx_response_js_ext_body(njs_vm_t *vm, njs_value_t *args,
      njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
+static njs_int_t ngx_response_js_ext_body_stream(njs_vm_t *vm,
+    njs_object_prop_t *prop, uint32_t unused, njs_value_t *value,
+    njs_value_t *setval, njs_value_t *retval);
+static njs_int_t ngx_body_js_ext_cancel(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
+static njs_int_t ngx_body_js_ext_get_reader(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
+static njs_int_t ngx_body_js_ext_read(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
 
 static njs_int_t ngx_fetch_flag(njs_vm_t *vm, const ngx_js_entry_t *entries,
     njs_int_t value, njs_value_t *retval);
@@ -389,6 +438,15 @@ static njs_external_t  ngx_js_ext_http_response[] = {
         }
     },
 
+    {
+        .flags = NJS_EXTERN_PROPERTY,
+        .name.string = njs_str("body"),
+        .enumerable = 1,
+        .u.property = {
+            .handler = ngx_response_js_ext_body_stream,
+        }
+    },
+
     {
         .flags = NJS_EXTERN_PROPERTY,
         .name.string = njs_str("bodyUsed"),
@@ -490,9 +548,56 @@ static njs_external_t  ngx_js_ext_http_response[] = {
 };
 
 
+static njs_external_t  ngx_js_ext_http_body[] = {
+
+    {
+        .flags = NJS_EXTERN_PROPERTY | NJS_EXTERN_SYMBOL,
+        .name.symbol = NJS_SYMBOL_TO_STRING_TAG,
+        .u.property = {
+            .value = "ReadableStream",
+        }
+    },
+
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("cancel"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = ngx_body_js_ext_cancel,
+        }
+    },
+
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("getReader"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = ngx_body_js_ext_get_reader,
+        }
+    },
+
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("read"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = ngx_body_js_ext_read,
+        }
+    },
+
+};
+
+
 static njs_int_t    ngx_http_js_fetch_request_proto_id;
 static njs_int_t    ngx_http_js_fetch_response_proto_id;
 static njs_int_t    ngx_http_js_fetch_headers_proto_id;
+static njs_int_t    ngx_http_js_fetch_body_proto_id;
 
 
 njs_module_t  ngx_js_fetch_module = {
@@ -505,8 +610,172 @@ njs_module_t  ngx_js_fetch_module = {
 njs_int_t
 ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     njs_index_t unused, njs_value_t *retval)
+{
+    return ngx_js_fetch(vm, args, nargs, NULL, 0, retval);
+}
+
+
+njs_int_t
+ngx_js_ext_fetch_all(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    njs_index_t unused, njs_value_t *retval)
+{
+    int64_t                i, length;
+    njs_int_t              ret;
+    ngx_int_t              connections, timeout;
+    ngx_pool_t            *pool;
+    njs_value_t           *resources, *options, *value;
+    ngx_js_ctx_t          *ctx;
+    ngx_connection_t      *c;
+    njs_external_ptr_t     external;
+    njs_opaque_value_t     lvalue, arguments[3];
+    ngx_js_fetch_batch_t  *batch;
+
+    static const njs_str_t connections_key = njs_str("connections");
+    static const njs_str_t stream_key = njs_str("stream");
+    static const njs_str_t timeout_key = njs_str("timeout");
+
+    resources = njs_arg(args, nargs, 1);
+
+    if (!njs_value_is_array(resources)) {
+        njs_vm_type_error(vm, "\"resources\" is not an array");
+        return NJS_ERROR;
+    }
+
+    ret = njs_vm_array_length(vm, resources, &length);
+    if (ret != NJS_OK) {
+        return NJS_ERROR;
+    }
+
+    connections = NGX_JS_HTTP_BATCH_CONNECTIONS;
+    timeout = 0;
+
+    options = njs_arg(args, nargs, 2);
+
+    if (njs_value_is_object(options)) {
+        value = njs_vm_object_prop(vm, options, &connections_key, &lvalue);
+        if (value != NULL) {
+            if (ngx_js_integer(vm, value, &connections) != NGX_OK) {
+                return NJS_ERROR;
+            }
+
+            if (connections <= 0) {
+                njs_vm_range_error(vm, "\"connections\" must be positive");
+                return NJS_ERROR;
+            }
+        }
+
+        value = njs_vm_object_prop(vm, options, &timeout_key, &lvalue);
+        if (value != NULL) {
+            if (ngx_js_integer(vm, value, &timeout) != NGX_OK) {
+                return NJS_ERROR;
+            }
+
+            if (timeout < 0) {
+                njs_vm_range_error(vm, "\"timeout\" must be non-negative");
+                return NJS_ERROR;
+            }
+        }
+
+        value = njs_vm_object_prop(vm, options, &stream_key, &lvalue);
+        if (value != NULL && njs_value_bool(value)) {
+            njs_vm_type_error(vm, "\"stream\" is not supported by fetchAll()");
+            return NJS_ERROR;
+        }
+    }
+
+    external = njs_vm_external_ptr(vm);
+    c = ngx_external_connection(vm, external);
+    pool = ngx_external_pool(vm, external);
+
+    batch = ngx_pcalloc(pool, sizeof(ngx_js_fetch_batch_t)
+                              + length * sizeof(ngx_js_fetch_t *));
+    if (batch == NULL) {
+        njs_vm_memory_error(vm);
+        return NJS_ERROR;
+    }
+
+    batch->fetches = (ngx_js_fetch_t **) &batch[1];
+    batch->remaining = length;
+
+    ret = njs_vm_promise_create(vm, njs_value_arg(&batch->promise),
+                                njs_value_arg(&batch->promise_callbacks));
+    if (ret != NJS_OK) {
+        return NJS_ERROR;
+    }
+
+    ret = njs_vm_array_alloc(vm, njs_value_arg(&batch->results), length);
+    if (ret != NJS_OK) {
+        return NJS_ERROR;
+    }
+
+    for (i = 0; i < length; i++) {
+        value = njs_vm_array_push(vm, njs_value_arg(&batch->results));
+        if (value == NULL) {
+            return NJS_ERROR;
+        }
+
+        njs_value_undefined_set(value);
+    }
+
+    ngx_js_http_batch_init(&batch->http, c->log, connections);
+
+    /* the options are also the init argument of every request */
+
+    njs_value_undefined_set(njs_value_arg(&arguments[0]));
+    njs_value_assign(&arguments[2], options);
+
+    for (i = 0; i < length; i++) {
+        value = njs_vm_array_prop(vm, resources, i, &lvalue);
+        if (value == NULL) {
+            njs_value_undefined_set(njs_value_arg(&arguments[1]));
+
+        } else {
+            njs_value_assign(&arguments[1], value);
+        }
+
+        ret = ngx_js_fetch(vm, njs_value_arg(&arguments), 3, batch, i,
+                           njs_value_arg(&lvalue));
+        if (ret != NJS_OK) {
+            goto fail;
+        }
+    }
+
+    if (batch->remaining == 0) {
+        /* all the responses are served from cache */
+
+        return ngx_js_fetch_promissified_result(vm,
+                                            njs_value_arg(&batch->results),
+                                            NJS_OK, retval);
+    }
+
+    ngx_js_http_batch_run(&batch->http, timeout);
+
+    njs_value_assign(retval, njs_value_arg(&batch->promise));
+
+    return NJS_OK;
+
+fail:
+
+    batch->remaining = 0;
+
+    ctx = ngx_external_ctx(vm, external);
+
+    while (i-- > 0) {
+        if (batch->fetches[i] != NULL) {
+            ngx_js_del_event(ctx, batch->fetches[i]->event);
+        }
+    }
+
+    return ngx_js_fetch_promissified_result(vm, NULL, NJS_ERROR, retval);
+}
+
+
+static njs_int_t
+ngx_js_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    ngx_js_fetch_batch_t *batch, ngx_uint_t index, njs_value_t *retval)
 {
     njs_int_t            ret;
+    ngx_int_t            rc;
     ngx_url_t            u;
     ngx_str_t           *resolve_host;
     ngx_pool_t          *pool;
@@ -515,12 +784,13 @@ ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     ngx_js_fetch_t      *fetch;
     ngx_js_request_t     request;
     ngx_connection_t    *c;
-    ngx_resolver_ctx_t  *ctx;
     njs_external_ptr_t   external;
     njs_opaque_value_t   lvalue;
 
     static const njs_str_t buffer_size_key = njs_str("buffer_size");
     static const njs_str_t body_size_key = njs_str("max_response_body_size");
+    static const njs_str_t stream_key = njs_str("stream");
+    static const njs_str_t coalesce_key = njs_str("coalesce");
 #if (NGX_SSL)
     static const njs_str_t verify_key = njs_str("verify");
 #endif
@@ -537,6 +807,12 @@ ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
 
     http = &fetch->http;
 
+    if (batch != NULL) {
+        fetch->batch = batch;
+        fetch->index = index;
+        batch->fetches[index] = fetch;
+    }
+
     ret = ngx_js_request_constructor(vm, &request, &u, external, args, nargs);
     if (ret != NJS_OK) {
         goto fail;
@@ -579,6 +855,16 @@ ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
             goto fail;
         }
 
+        value = njs_vm_object_prop(vm, init, &stream_key, &lvalue);
+        if (value != NULL) {
+            http->stream = njs_value_bool(value);
+        }
+
+        value = njs_vm_object_prop(vm, init, &coalesce_key, &lvalue);
+        if (value != NULL) {
+            http->coalesce = njs_value_bool(value);
+        }
+
 #if (NGX_SSL)
         value = njs_vm_object_prop(vm, init, &verify_key, &lvalue);
         if (value != NULL) {
@@ -596,6 +882,47 @@ ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     NJS_CHB_MP_INIT(&http->chain, njs_vm_memory_pool(vm));
     NJS_CHB_MP_INIT(&http->response.chain, njs_vm_memory_pool(vm));
 
+    rc = ngx_js_fetch_cache_lookup(http, &request);
+
+    if (rc == NGX_OK) {
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js http fetch:%p served from cache", fetch);
+
+        ret = njs_vm_external_create(vm, njs_value_arg(&fetch->response_value),
+                                     ngx_http_js_fetch_response_proto_id,
+                                     &http->response, 0);
+        if (ret != NJS_OK) {
+            njs_vm_error(vm, "fetch response creation failed");
+            goto fail;
+        }
+
+        ngx_js_del_event(ngx_external_ctx(vm, external), fetch->event);
+
+        if (batch != NULL) {
+            batch->fetches[index] = NULL;
+            batch->remaining--;
+
+            value = njs_vm_array_start(vm, njs_value_arg(&batch->results));
+            njs_value_assign(&value[index], &fetch->response_value);
+
+            return NJS_OK;
+        }
+
+        return ngx_js_fetch_promissified_result(vm,
+                                        njs_value_arg(&fetch->response_value),
+                                        NJS_OK, retval);
+    }
+
+    if (rc == NGX_BUSY) {
+        njs_vm_error(vm, "fetch response is not cached");
+        goto fail;
+    }
+
+    if (rc == NGX_ERROR) {
+        njs_vm_memory_error(vm);
+        goto fail;
+    }
+
     resolve_host = NULL;
     http->connect_port = http->port;
 
@@ -627,20 +954,59 @@ ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     ngx_js_fetch_build_request(http, &request, &u.uri, &u,
                                ngx_js_http_proxy(http) && !ngx_js_https(&u));
 
+    if (resolve_host == NULL) {
+        http->naddrs = 1;
+        http->addrs = &http->addr;
+
+        if (ngx_js_http_proxy(http)) {
+            ngx_memcpy(&http->addr, &http->proxy.url->addrs[0],
+                       sizeof(ngx_addr_t));
+
+        } else {
+            ngx_memcpy(&http->addr, &u.addrs[0], sizeof(ngx_addr_t));
+        }
+    }
+
+    if (http->coalesce) {
+        rc = ngx_js_http_coalesce(http, &request,
+                                  ngx_external_resolver(vm, external),
+                                  resolve_host,
+                                  ngx_external_resolver_timeout(vm, external));
+
+        if (rc == NGX_ERROR) {
+            njs_vm_memory_error(vm);
+            goto fail;
+        }
+
+        if (rc == NGX_OK) {
+            njs_value_assign(retval, njs_value_arg(&fetch->promise));
+
+            return NJS_OK;
+        }
+    }
+
+    if (batch != NULL) {
+        ngx_js_http_batch_add(&batch->http, http,
+                              ngx_external_resolver(vm, external),
+                              resolve_host,
+                              ngx_external_resolver_timeout(vm, external));
+        return NJS_OK;
+    }
+
     if (resolve_host != NULL) {
         ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0,
                        "js http fetch: resolving");
 
-        ctx = ngx_js_http_resolve(http, ngx_external_resolver(vm, external),
-                                  resolve_host,
-                                  ngx_external_resolver_timeout(vm, external));
+        rc = ngx_js_http_resolve(http, ngx_external_resolver(vm, external),
+                                 resolve_host,
+                                 ngx_external_resolver_timeout(vm, external));
 
-        if (ctx == NULL) {
+        if (rc == NGX_ERROR) {
             njs_vm_memory_error(vm);
             return NJS_ERROR;
         }
 
-        if (ctx == NGX_NO_RESOLVER) {
+        if (rc == NGX_DECLINED) {
             njs_vm_error(vm, "no resolver defined");
             goto fail;
         }
@@ -650,16 +1016,6 @@ ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
         return NJS_OK;
     }
 
-    http->naddrs = 1;
-    http->addrs = &http->addr;
-
-    if (ngx_js_http_proxy(http)) {
-        ngx_memcpy(&http->addr, &http->proxy.url->addrs[0], sizeof(ngx_addr_t));
-
-    } else {
-        ngx_memcpy(&http->addr, &u.addrs[0], sizeof(ngx_addr_t));
-    }
-
     ngx_js_http_connect(http);
 
     njs_value_assign(retval, njs_value_arg(&fetch->promise));
@@ -674,6 +1030,11 @@ fail:
     ngx_js_del_event(ngx_external_ctx(vm,  njs_vm_external_ptr(vm)),
                      fetch->event);
 
+    if (batch != NULL) {
+        batch->fetches[index] = NULL;
+        return NJS_ERROR;
+    }
+
     return ngx_js_fetch_promissified_result(vm, NULL, NJS_ERROR, retval);
 }
 
@@ -739,6 +1100,11 @@ ngx_js_ext_request_constructor(njs_vm_t *vm, njs_value_t *args,
         return NJS_ERROR;
     }
 
+    if (request->body_stream != NULL) {
+        njs_vm_error(vm, "body stream is supported only by fetch()");
+        return NJS_ERROR;
+    }
+
     return njs_vm_external_create(vm, retval,
                                   ngx_http_js_fetch_request_proto_id, request,
                                   0);
@@ -1089,6 +1455,7 @@ ngx_js_fetch_alloc(njs_vm_t *vm, ngx_pool_t *pool, ngx_log_t *log,
     http->append_headers = ngx_js_fetch_append_headers;
     http->ready_handler = ngx_js_fetch_process_done;
     http->error_handler = ngx_js_fetch_error;
+    http->stream_handler = ngx_js_fetch_stream_handler;
 
     ret = njs_vm_promise_create(vm, njs_value_arg(&fetch->promise),
                                 njs_value_arg(&fetch->promise_callbacks));
@@ -1138,6 +1505,16 @@ ngx_js_fetch_error(ngx_js_http_t *http, const char *err)
 
     fetch = (ngx_js_fetch_t *) http;
 
+    if (http->response.stream != NULL) {
+        /* the response is already passed to JS, failing the body read */
+
+        ngx_js_http_close_peer(http);
+
+        (void) ngx_js_fetch_stream_finalize(fetch,
+                                            ngx_js_fetch_read_settle(fetch));
+        return;
+    }
+
     njs_vm_error(fetch->vm, err);
 
     njs_vm_exception_get(fetch->vm, njs_value_arg(&fetch->response_value));
@@ -1158,6 +1535,7 @@ ngx_js_fetch_destructor(ngx_js_event_t *event)
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0, "js http destructor:%p",
                    fetch);
 
+    ngx_js_http_coalesce_leave(http);
     ngx_js_http_resolve_done(http);
     ngx_js_http_close_peer(http);
 }
@@ -1226,15 +1604,22 @@ ngx_js_fetch_done(ngx_js_fetch_t *fetch, njs_opaque_value_t *retval,
     ngx_js_http_close_peer(http);
 
     if (fetch->event != NULL) {
-        action = &fetch->promise_callbacks[(rc != NJS_OK)];
-        njs_value_assign(&arguments[0], action);
-        njs_value_assign(&arguments[1], retval);
-
         vm = fetch->vm;
         event = fetch->event;
 
-        rc = ngx_js_call(vm, njs_value_function(njs_value_arg(&event->function)),
-                         &arguments[0], 2);
+        if (fetch->batch != NULL) {
+            rc = ngx_js_fetch_batch_settle(fetch, retval, rc);
+
+        } else {
+            action = &fetch->promise_callbacks[(rc != NJS_OK)];
+            njs_value_assign(&arguments[0], action);
+            njs_value_assign(&arguments[1], retval);
+
+            rc = ngx_js_call(vm,
+                             njs_value_function(
+                                         njs_value_arg(&event->function)),
+                             &arguments[0], 2);
+        }
 
         ctx = ngx_external_ctx(vm,  njs_vm_external_ptr(vm));
         ngx_js_del_event(ctx, event);
@@ -1244,6 +1629,46 @@ ngx_js_fetch_done(ngx_js_fetch_t *fetch, njs_opaque_value_t *retval,
 }
 
 
+static njs_int_t
+ngx_js_fetch_batch_settle(ngx_js_fetch_t *fetch, njs_opaque_value_t *retval,
+    njs_int_t rc)
+{
+    njs_value_t           *results;
+    ngx_js_fetch_batch_t  *batch;
+    njs_opaque_value_t     arguments[2];
+
+    batch = fetch->batch;
+
+    if (batch->remaining == 0) {
+        /* the batch is already rejected */
+        return NJS_OK;
+    }
+
+    if (rc != NJS_OK) {
+        batch->remaining = 0;
+
+        njs_value_assign(&arguments[0], &batch->promise_callbacks[1]);
+        njs_value_assign(&arguments[1], retval);
+
+    } else {
+        results = njs_vm_array_start(fetch->vm, njs_value_arg(&batch->results));
+        njs_value_assign(&results[fetch->index], retval);
+
+        if (--batch->remaining != 0) {
+            return NJS_OK;
+        }
+
+        njs_value_assign(&arguments[0], &batch->promise_callbacks[0]);
+        njs_value_assign(&arguments[1], &batch->results);
+    }
+
+    return ngx_js_call(fetch->vm,
+                       njs_value_function(
+                                   njs_value_arg(&fetch->event->function)),
+                       &arguments[0], 2);
+}
+
+
 static njs_int_t
 ngx_js_http_promise_trampoline(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval)
@@ -1270,6 +1695,7 @@ ngx_js_request_constructor(njs_vm_t *vm, ngx_js_request_t *request,
     ngx_pool_t          *pool;
     njs_value_t         *input, *init, *value, *headers;
     ngx_js_request_t    *orig;
+    ngx_js_response_t   *response;
     njs_opaque_value_t   lvalue;
 
     static const njs_str_t body_key = njs_str("body");
@@ -1455,6 +1881,12 @@ ngx_js_request_constructor(njs_vm_t *vm, ngx_js_request_t *request,
 
         value = njs_vm_object_prop(vm, init, &body_key, &lvalue);
         if (value != NULL) {
+            response = njs_vm_external(vm, ngx_http_js_fetch_body_proto_id,
+                                       value);
+            if (response != NULL) {
+                return ngx_js_request_body_stream(vm, request, response);
+            }
+
             if (ngx_js_ngx_string(vm, value, &request->body) != NGX_OK) {
                 njs_vm_error(vm, "invalid Request body");
                 return NJS_ERROR;
@@ -1479,6 +1911,37 @@ ngx_js_request_constructor(njs_vm_t *vm, ngx_js_request_t *request,
 }
 
 
+static njs_int_t
+ngx_js_request_body_stream(njs_vm_t *vm, ngx_js_request_t *request,
+    ngx_js_response_t *response)
+{
+    njs_str_t  str;
+
+    if (response->body_used) {
+        njs_vm_error(vm, "body stream already read");
+        return NJS_ERROR;
+    }
+
+    response->body_used = 1;
+
+    if (response->stream != NULL) {
+        /* relayed by ngx_js_http_write_handler() as it is received */
+        request->body_stream = response->stream;
+        return NJS_OK;
+    }
+
+    if (njs_chb_join(&response->chain, &str) != NJS_OK) {
+        njs_vm_memory_error(vm);
+        return NJS_ERROR;
+    }
+
+    request->body.data = str.start;
+    request->body.len = str.length;
+
+    return NJS_OK;
+}
+
+
 static ngx_int_t
 ngx_js_fetch_append_headers(ngx_js_http_t *http, ngx_js_headers_t *headers,
     u_char *name, size_t len, u_char *value, size_t vlen)
@@ -1512,6 +1975,166 @@ ngx_js_fetch_process_done(ngx_js_http_t *http)
 }
 
 
+static ngx_int_t
+ngx_js_fetch_stream_handler(ngx_js_http_t *http, ngx_uint_t event)
+{
+    njs_int_t            ret;
+    ngx_int_t            rc;
+    ngx_js_fetch_t      *fetch;
+    njs_opaque_value_t   arguments[2];
+
+    fetch = (ngx_js_fetch_t *) http;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js http stream fetch:%p event:%ui", fetch, event);
+
+    switch (event) {
+
+    case NGX_JS_HTTP_STREAM_HEADERS:
+        ret = njs_vm_external_create(fetch->vm,
+                                     njs_value_arg(&fetch->response_value),
+                                     ngx_http_js_fetch_response_proto_id,
+                                     &http->response, 0);
+        if (ret != NJS_OK) {
+            http->response.stream = NULL;
+            ngx_js_fetch_error(http, "fetch response creation failed");
+            return NGX_DONE;
+        }
+
+        njs_value_assign(&arguments[0], &fetch->promise_callbacks[0]);
+        njs_value_assign(&arguments[1], &fetch->response_value);
+
+        rc = ngx_js_call(fetch->vm,
+                         njs_value_function(
+                                  njs_value_arg(&fetch->event->function)),
+                         &arguments[0], 2);
+
+        return ngx_js_fetch_stream_finalize(fetch, rc);
+
+    case NGX_JS_HTTP_STREAM_DATA:
+        return ngx_js_fetch_stream_finalize(fetch,
+                                            ngx_js_fetch_read_settle(fetch));
+
+    default:
+        /* NGX_JS_HTTP_STREAM_LAST */
+
+        ngx_js_http_close_peer(http);
+
+        (void) ngx_js_fetch_stream_finalize(fetch,
+                                            ngx_js_fetch_read_settle(fetch));
+        return NGX_DONE;
+    }
+}
+
+
+static ngx_int_t
+ngx_js_fetch_stream_finalize(ngx_js_fetch_t *fetch, ngx_int_t rc)
+{
+    njs_vm_t  *vm;
+
+    if (rc != NGX_ERROR && !fetch->http.finished) {
+        return NGX_OK;
+    }
+
+    vm = fetch->vm;
+
+    if (fetch->event != NULL) {
+        ngx_js_del_event(ngx_external_ctx(vm, njs_vm_external_ptr(vm)),
+                         fetch->event);
+        fetch->event = NULL;
+    }
+
+    ngx_external_event_finalize(vm)(njs_vm_external_ptr(vm), rc);
+
+    return NGX_DONE;
+}
+
+
+static ngx_int_t
+ngx_js_fetch_read_settle(ngx_js_fetch_t *fetch)
+{
+    njs_int_t            ret;
+    njs_vm_t            *vm;
+    njs_opaque_value_t   arguments[2];
+
+    if (!fetch->reading) {
+        return NGX_OK;
+    }
+
+    vm = fetch->vm;
+
+    ret = ngx_js_fetch_read_result(vm, &fetch->http.response,
+                                   njs_value_arg(&arguments[1]));
+    if (ret == NJS_DECLINED) {
+        return NGX_OK;
+    }
+
+    if (ret != NJS_OK) {
+        njs_vm_exception_get(vm, njs_value_arg(&arguments[1]));
+    }
+
+    fetch->reading = 0;
+    njs_value_assign(&arguments[0], &fetch->read_callbacks[ret != NJS_OK]);
+
+    return ngx_js_call(vm,
+                       njs_value_function(
+                                  njs_value_arg(&fetch->event->function)),
+                       &arguments[0], 2);
+}
+
+
+static njs_int_t
+ngx_js_fetch_read_result(njs_vm_t *vm, ngx_js_response_t *response,
+    njs_value_t *retval)
+{
+    njs_int_t            ret;
+    njs_str_t            chunk;
+    ngx_js_http_t       *http;
+    njs_opaque_value_t   value, done, value_key, done_key;
+
+    http = response->stream;
+
+    ret = njs_chb_join(&response->chain, &chunk);
+    if (ret != NJS_OK) {
+        njs_vm_memory_error(vm);
+        return NJS_ERROR;
+    }
+
+    if (chunk.length != 0) {
+        ngx_js_http_stream_consumed(response);
+
+        ret = njs_vm_value_buffer_set(vm, njs_value_arg(&value), chunk.start,
+                                      chunk.length);
+        if (ret != NJS_OK) {
+            njs_vm_memory_error(vm);
+            return NJS_ERROR;
+        }
+
+        njs_value_boolean_set(njs_value_arg(&done), 0);
+
+    } else if (http != NULL && http->error.len != 0) {
+        njs_vm_error(vm, "%*s", http->error.len, http->error.data);
+        return NJS_ERROR;
+
+    } else if (http == NULL || http->finished) {
+        njs_value_undefined_set(njs_value_arg(&value));
+        njs_value_boolean_set(njs_value_arg(&done), 1);
+
+    } else {
+        return NJS_DECLINED;
+    }
+
+    njs_vm_value_string_create(vm, njs_value_arg(&value_key),
+                               (u_char *) "value", njs_length("value"));
+    njs_vm_value_string_create(vm, njs_value_arg(&done_key),
+                               (u_char *) "done", njs_length("done"));
+
+    return njs_vm_object_alloc(vm, retval, njs_value_arg(&value_key),
+                               njs_value_arg(&value), njs_value_arg(&done_key),
+                               njs_value_arg(&done), NULL);
+}
+
+
 static njs_int_t
 ngx_js_headers_append(njs_vm_t *vm, ngx_js_headers_t *headers,
     u_char *name, size_t len, u_char *value, size_t vlen)
@@ -2281,6 +2904,7 @@ ngx_response_js_ext_body(njs_vm_t *vm, njs_value_t *args,
 {
     njs_int_t            ret;
     njs_str_t            string;
+    ngx_js_http_t       *http;
     ngx_js_response_t   *response;
     njs_opaque_value_t   result;
 
@@ -2296,6 +2920,18 @@ ngx_response_js_ext_body(njs_vm_t *vm, njs_value_t *args,
         return NJS_ERROR;
     }
 
+    http = response->stream;
+
+    if (http != NULL && http->error.len != 0) {
+        njs_vm_error(vm, "%*s", http->error.len, http->error.data);
+        return NJS_ERROR;
+    }
+
+    if (http != NULL && !http->finished) {
+        njs_vm_error(vm, "body stream is not fully received");
+        return NJS_ERROR;
+    }
+
     response->body_used = 1;
 
     ret = njs_chb_join(&response->chain, &string);
@@ -2336,6 +2972,153 @@ ngx_response_js_ext_body(njs_vm_t *vm, njs_value_t *args,
 }
 
 
+static njs_int_t
+ngx_response_js_ext_body_stream(njs_vm_t *vm, njs_object_prop_t *prop,
+    uint32_t unused, njs_value_t *value, njs_value_t *setval,
+    njs_value_t *retval)
+{
+    ngx_js_response_t  *response;
+
+    response = njs_vm_external(vm, ngx_http_js_fetch_response_proto_id, value);
+    if (response == NULL) {
+        njs_value_undefined_set(retval);
+        return NJS_DECLINED;
+    }
+
+    return njs_vm_external_create(vm, retval, ngx_http_js_fetch_body_proto_id,
+                                  response, 0);
+}
+
+
+static njs_int_t
+ngx_body_js_ext_cancel(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    njs_index_t unused, njs_value_t *retval)
+{
+    njs_int_t            ret;
+    njs_function_t      *callback;
+    ngx_js_fetch_t      *fetch;
+    ngx_js_response_t   *response;
+    njs_opaque_value_t   arguments[2];
+
+    response = njs_vm_external(vm, ngx_http_js_fetch_body_proto_id,
+                               njs_argument(args, 0));
+    if (response == NULL) {
+        njs_value_undefined_set(retval);
+        return NJS_DECLINED;
+    }
+
+    response->body_used = 1;
+
+    fetch = (ngx_js_fetch_t *) response->stream;
+
+    if (fetch != NULL && !fetch->http.finished) {
+        ngx_js_http_stream_cancel(&fetch->http);
+
+        if (fetch->reading) {
+            fetch->reading = 0;
+
+            njs_value_assign(&arguments[0], &fetch->read_callbacks[0]);
+
+            ret = ngx_js_fetch_read_result(vm, response,
+                                           njs_value_arg(&arguments[1]));
+            if (ret != NJS_OK) {
+                return NJS_ERROR;
+            }
+
+            callback = njs_value_function(
+                                   njs_value_arg(&fetch->event->function));
+
+            ret = njs_vm_enqueue_job(vm, callback, njs_value_arg(&arguments),
+                                     2);
+            if (ret != NJS_OK) {
+                return NJS_ERROR;
+            }
+        }
+
+        ngx_js_del_event(ngx_external_ctx(vm, njs_vm_external_ptr(vm)),
+                         fetch->event);
+        fetch->event = NULL;
+    }
+
+    ngx_js_http_stream_consumed(response);
+
+    njs_value_undefined_set(njs_value_arg(&arguments[0]));
+
+    return ngx_js_fetch_promissified_result(vm, njs_value_arg(&arguments[0]),
+                                            NJS_OK, retval);
+}
+
+
+static njs_int_t
+ngx_body_js_ext_get_reader(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    njs_index_t unused, njs_value_t *retval)
+{
+    ngx_js_response_t  *response;
+
+    response = njs_vm_external(vm, ngx_http_js_fetch_body_proto_id,
+                               njs_argument(args, 0));
+    if (response == NULL) {
+        njs_value_undefined_set(retval);
+        return NJS_DECLINED;
+    }
+
+    if (response->body_used) {
+        njs_vm_error(vm, "body stream already read");
+        return NJS_ERROR;
+    }
+
+    response->body_used = 1;
+
+    njs_value_assign(retval, njs_argument(args, 0));
+
+    return NJS_OK;
+}
+
+
+static njs_int_t
+ngx_body_js_ext_read(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    njs_index_t unused, njs_value_t *retval)
+{
+    njs_int_t            ret;
+    ngx_js_fetch_t      *fetch;
+    ngx_js_response_t   *response;
+    njs_opaque_value_t   result;
+
+    response = njs_vm_external(vm, ngx_http_js_fetch_body_proto_id,
+                               njs_argument(args, 0));
+    if (response == NULL) {
+        njs_value_undefined_set(retval);
+        return NJS_DECLINED;
+    }
+
+    fetch = (ngx_js_fetch_t *) response->stream;
+
+    if (fetch != NULL && fetch->reading) {
+        njs_vm_error(vm, "body stream read is already pending");
+        return NJS_ERROR;
+    }
+
+    response->body_used = 1;
+
+    ret = ngx_js_fetch_read_result(vm, response, njs_value_arg(&result));
+    if (ret != NJS_DECLINED) {
+        return ngx_js_fetch_promissified_result(vm, njs_value_arg(&result),
+                                                ret, retval);
+    }
+
+    ret = njs_vm_promise_create(vm, retval,
+                                njs_value_arg(&fetch->read_callbacks));
+    if (ret != NJS_OK) {
+        njs_vm_memory_error(vm);
+        return NJS_ERROR;
+    }
+
+    fetch->reading = 1;
+
+    return NJS_OK;
+}
+
+
 static njs_int_t
 ngx_response_js_ext_body_used(njs_vm_t *vm, njs_object_prop_t *prop,
     uint32_t unused, njs_value_t *value, njs_value_t *setval,
@@ -2552,6 +3335,13 @@ ngx_js_fetch_init(njs_vm_t *vm)
         return NJS_ERROR;
     }
 
+    ngx_http_js_fetch_body_proto_id = njs_vm_external_prototype(vm,
+                                          ngx_js_ext_http_body,
+                                          njs_nitems(ngx_js_ext_http_body));
+    if (ngx_http_js_fetch_body_proto_id < 0) {
+        return NJS_ERROR;
+    }
+
     ret = ngx_js_fetch_function_bind(vm, &headers,
                                      ngx_js_ext_headers_constructor, 1);
     if (ret != NJS_OK) {
@@ -11,6 +11,8 @@
 
 njs_int_t ngx_js_ext_fetch(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     njs_index_t level, njs_value_t *retval);
+njs_int_t ngx_js_ext_fetch_all(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t level, njs_value_t *retval);
 
 extern njs_module_t  ngx_js_fetch_module;
 
@@ -0,0 +1,938 @@
+/*
+ * Copyright (C) Dmitry Volyntsev
+ * Copyright (C) NGINX, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include "ngx_js.h"
+#include "ngx_js_http.h"
+
+
+typedef struct {
+    ngx_rbtree_t                rbtree;
+    ngx_rbtree_node_t           sentinel;
+    ngx_queue_t                 lru;
+} ngx_js_fetch_cache_sh_t;
+
+
+typedef struct {
+    ngx_js_fetch_cache_sh_t    *sh;
+    ngx_slab_pool_t            *shpool;
+} ngx_js_fetch_cache_t;
+
+
+/*
+ * data: key, status text, headers as "name: value" CRLF lines, body.
+ */
+
+typedef struct {
+    ngx_str_node_t              sn;
+    ngx_queue_t                 queue;
+    time_t                      expires;
+    ngx_uint_t                  code;
+    size_t                      status_len;
+    size_t                      headers_len;
+    size_t                      body_len;
+    u_char                      data[1];
+} ngx_js_fetch_cache_node_t;
+
+
+#define ngx_js_fetch_cache_node_size(node)                                   \
+    (offsetof(ngx_js_fetch_cache_node_t, data) + (node)->sn.str.len          \
+     + (node)->status_len + (node)->headers_len + (node)->body_len)
+
+
+static ngx_int_t ngx_js_fetch_cache_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_js_fetch_cache_node_t *ngx_js_fetch_cache_find(ngx_js_http_t *http,
+    ngx_js_fetch_cache_t *cache);
+static ngx_js_fetch_cache_node_t *ngx_js_fetch_cache_copy(ngx_js_http_t *http,
+    ngx_js_fetch_cache_node_t *node);
+static void ngx_js_fetch_cache_delete(ngx_js_fetch_cache_t *cache,
+    ngx_js_fetch_cache_node_t *node);
+static ngx_int_t ngx_js_fetch_cache_response(ngx_js_http_t *http,
+    ngx_js_fetch_cache_node_t *node);
+static void ngx_js_fetch_cache_validators(ngx_js_http_t *http,
+    ngx_js_fetch_cache_node_t *node);
+static void ngx_js_fetch_cache_store(ngx_js_http_t *http);
+static time_t ngx_js_fetch_cache_valid(ngx_js_headers_t *headers);
+static ngx_str_t *ngx_js_fetch_cache_header(ngx_js_headers_t *headers,
+    const char *name, size_t len);
+static ngx_int_t ngx_js_fetch_cache_skip_header(ngx_str_t *name);
+
+
+ngx_int_t
+ngx_js_fetch_cache_lookup(ngx_js_http_t *http, ngx_js_request_t *request)
+{
+    ngx_int_t                   rc;
+    ngx_uint_t                  mode;
+    ngx_js_fetch_cache_t       *cache;
+    ngx_js_fetch_cache_node_t  *node;
+
+    if (http->conf->fetch_cache == NULL) {
+        return NGX_DECLINED;
+    }
+
+    mode = request->cache_mode;
+
+    if (mode == CACHE_MODE_NO_STORE
+        || http->stream
+        || request->body_stream != NULL
+        || request->method.len != 3
+        || ngx_strncmp(request->method.data, "GET", 3) != 0)
+    {
+        return NGX_DECLINED;
+    }
+
+    /* conditional and range requests are passed as is */
+
+    if (ngx_js_fetch_cache_header(&request->headers, "If-None-Match", 13)
+        || ngx_js_fetch_cache_header(&request->headers, "If-Modified-Since",
+                                     17)
+        || ngx_js_fetch_cache_header(&request->headers, "If-Match", 8)
+        || ngx_js_fetch_cache_header(&request->headers,
+                                     "If-Unmodified-Since", 19)
+        || ngx_js_fetch_cache_header(&request->headers, "Range", 5))
+    {
+        return NGX_DECLINED;
+    }
+
+    if (ngx_js_fetch_cache_key(http, request) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    http->cache = http->conf->fetch_cache;
+
+    if (mode == CACHE_MODE_RELOAD) {
+        return NGX_DECLINED;
+    }
+
+    cache = http->cache->data;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = ngx_js_fetch_cache_find(http, cache);
+
+    if (node == NULL) {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js fetch cache miss: \"%V\"", &http->cache_key);
+
+        return (mode == CACHE_MODE_ONLY_IF_CACHED) ? NGX_BUSY : NGX_DECLINED;
+    }
+
+    if (mode != CACHE_MODE_NO_CACHE
+        && (node->expires > ngx_time()
+            || mode == CACHE_MODE_FORCE_CACHE
+            || mode == CACHE_MODE_ONLY_IF_CACHED))
+    {
+        ngx_queue_remove(&node->queue);
+        ngx_queue_insert_head(&cache->sh->lru, &node->queue);
+
+        node = ngx_js_fetch_cache_copy(http, node);
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        if (node == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js fetch cache hit: \"%V\"", &http->cache_key);
+
+        rc = ngx_js_fetch_cache_response(http, node);
+        if (rc != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        http->cache = NULL;
+
+        return NGX_OK;
+    }
+
+    node = ngx_js_fetch_cache_copy(http, node);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (node == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js fetch cache revalidate: \"%V\"", &http->cache_key);
+
+    ngx_js_fetch_cache_validators(http, node);
+
+    return NGX_DECLINED;
+}
+
+
+void
+ngx_js_fetch_cache_update(ngx_js_http_t *http)
+{
+    time_t                      valid;
+    ngx_js_fetch_cache_t       *cache;
+    ngx_js_fetch_cache_node_t  *node;
+
+    cache = http->cache->data;
+
+    if (http->response.code == 304
+        && (http->cache_etag.len != 0 || http->cache_last_modified.len != 0))
+    {
+        valid = ngx_js_fetch_cache_valid(&http->response.headers);
+
+        ngx_shmtx_lock(&cache->shpool->mutex);
+
+        node = ngx_js_fetch_cache_find(http, cache);
+
+        if (node != NULL) {
+            if (valid >= 0) {
+                node->expires = ngx_time() + valid;
+            }
+
+            node = ngx_js_fetch_cache_copy(http, node);
+        }
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        if (node == NULL) {
+            return;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js fetch cache revalidated: \"%V\"", &http->cache_key);
+
+        (void) ngx_js_fetch_cache_response(http, node);
+
+        return;
+    }
+
+    if (http->response.code == 200) {
+        ngx_js_fetch_cache_store(http);
+    }
+}
+
+
+ngx_int_t
+ngx_js_fetch_cache_key(ngx_js_http_t *http, ngx_js_request_t *request)
+{
+    u_char     *p;
+    size_t      len;
+    ngx_str_t  *auth, *cookie;
+
+    /*
+     * responses are cached per credentials,
+     * a shared entry is never served to another user
+     */
+
+    auth = ngx_js_fetch_cache_header(&request->headers, "Authorization", 13);
+    cookie = ngx_js_fetch_cache_header(&request->headers, "Cookie", 6);
+
+    len = request->url.len + 2;
+
+    if (auth != NULL) {
+        len += auth->len;
+    }
+
+    if (cookie != NULL) {
+        len += cookie->len;
+    }
+
+    p = ngx_pnalloc(http->pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    http->cache_key.data = p;
+
+    p = ngx_cpymem(p, request->url.data, request->url.len);
+    *p++ = LF;
+
+    if (auth != NULL) {
+        p = ngx_cpymem(p, auth->data, auth->len);
+    }
+
+    *p++ = LF;
+
+    if (cookie != NULL) {
+        p = ngx_cpymem(p, cookie->data, cookie->len);
+    }
+
+    http->cache_key.len = p - http->cache_key.data;
+
+    return NGX_OK;
+}
+
+
+static ngx_js_fetch_cache_node_t *
+ngx_js_fetch_cache_find(ngx_js_http_t *http, ngx_js_fetch_cache_t *cache)
+{
+    uint32_t         hash;
+    ngx_str_node_t  *sn;
+
+    hash = ngx_crc32_short(http->cache_key.data, http->cache_key.len);
+
+    sn = ngx_str_rbtree_lookup(&cache->sh->rbtree, &http->cache_key, hash);
+
+    return (ngx_js_fetch_cache_node_t *) sn;
+}
+
+
+static ngx_js_fetch_cache_node_t *
+ngx_js_fetch_cache_copy(ngx_js_http_t *http, ngx_js_fetch_cache_node_t *node)
+{
+    size_t                      size;
+    ngx_js_fetch_cache_node_t  *copy;
+
+    size = ngx_js_fetch_cache_node_size(node);
+
+    copy = ngx_palloc(http->pool, size);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    ngx_memcpy(copy, node, size);
+
+    copy->sn.str.data = copy->data;
+
+    return copy;
+}
+
+
+static void
+ngx_js_fetch_cache_delete(ngx_js_fetch_cache_t *cache,
+    ngx_js_fetch_cache_node_t *node)
+{
+    ngx_queue_remove(&node->queue);
+    ngx_rbtree_delete(&cache->sh->rbtree, &node->sn.node);
+    ngx_slab_free_locked(cache->shpool, node);
+}
+
+
+static ngx_int_t
+ngx_js_fetch_cache_response(ngx_js_http_t *http,
+    ngx_js_fetch_cache_node_t *node)
+{
+    u_char      *p, *last, *name, *value, *end;
+    njs_chb_t   *chain;
+    ngx_int_t    rc;
+
+    p = node->data + node->sn.str.len;
+
+    http->response.code = node->code;
+    http->response.status_text.data = p;
+    http->response.status_text.len = node->status_len;
+
+    p += node->status_len;
+    last = p + node->headers_len;
+
+    rc = ngx_list_init(&http->response.headers.header_list, http->pool, 4,
+                       sizeof(ngx_js_tb_elt_t));
+    if (rc != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    http->response.headers.guard = GUARD_NONE;
+    http->response.headers.content_type = NULL;
+
+    while (p < last) {
+        name = p;
+
+        while (*p != ':') {
+            p++;
+        }
+
+        value = p + 2;
+
+        end = ngx_strlchr(value, last, CR);
+        if (end == NULL) {
+            return NGX_ERROR;
+        }
+
+        rc = http->append_headers(http, &http->response.headers, name,
+                                  p - name, value, end - value);
+        if (rc != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        p = end + 2;
+    }
+
+    http->response.headers.guard = GUARD_IMMUTABLE;
+
+    chain = &http->response.chain;
+
+    njs_chb_destroy(chain);
+    njs_chb_init(chain, chain->pool, chain->alloc, chain->free);
+
+    if (node->body_len != 0) {
+        njs_chb_append(chain, last, node->body_len);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_js_fetch_cache_validators(ngx_js_http_t *http,
+    ngx_js_fetch_cache_node_t *node)
+{
+    u_char     *p, *last, *value, *end;
+    size_t      len;
+    ngx_str_t  *dst;
+
+    p = node->data + node->sn.str.len + node->status_len;
+    last = p + node->headers_len;
+
+    while (p < last) {
+        end = ngx_strlchr(p, last, CR);
+        if (end == NULL) {
+            return;
+        }
+
+        value = ngx_strlchr(p, end, ':');
+        if (value == NULL) {
+            return;
+        }
+
+        len = value - p;
+
+        if (len == 4 && ngx_strncasecmp(p, (u_char *) "ETag", 4) == 0) {
+            dst = &http->cache_etag;
+
+        } else if (len == 13
+                   && ngx_strncasecmp(p, (u_char *) "Last-Modified", 13) == 0)
+        {
+            dst = &http->cache_last_modified;
+
+        } else {
+            dst = NULL;
+        }
+
+        if (dst != NULL) {
+            dst->data = value + 2;
+            dst->len = end - dst->data;
+        }
+
+        p = end + 2;
+    }
+}
+
+
+static void
+ngx_js_fetch_cache_store(ngx_js_http_t *http)
+{
+    u_char                     *p;
+    size_t                      size, headers_len;
+    time_t                      valid;
+    int64_t                     body_len;
+    ngx_str_t                  *vary;
+    ngx_uint_t                  i;
+    ngx_queue_t                *q;
+    ngx_list_part_t            *part;
+    ngx_js_tb_elt_t            *h;
+    ngx_js_fetch_cache_t       *cache;
+    ngx_js_fetch_cache_node_t  *node;
+
+    cache = http->cache->data;
+
+    valid = ngx_js_fetch_cache_valid(&http->response.headers);
+
+    vary = ngx_js_fetch_cache_header(&http->response.headers, "Vary", 4);
+
+    if (vary != NULL && vary->len != 0) {
+        /* responses varying on request headers are not cached */
+        valid = -1;
+    }
+
+    if (ngx_js_fetch_cache_header(&http->response.headers, "Set-Cookie", 10)
+        != NULL)
+    {
+        /* cookies are specific to a client */
+        valid = -1;
+    }
+
+    if (valid == 0
+        && ngx_js_fetch_cache_header(&http->response.headers, "ETag", 4)
+           == NULL
+        && ngx_js_fetch_cache_header(&http->response.headers,
+                                     "Last-Modified", 13)
+           == NULL)
+    {
+        /* cannot be revalidated */
+        valid = -1;
+    }
+
+    body_len = njs_chb_size(&http->response.chain);
+
+    if (body_len < 0 || (size_t) body_len > http->conf->fetch_cache_max_size) {
+        valid = -1;
+    }
+
+    headers_len = 0;
+
+    part = &http->response.headers.header_list.part;
+    h = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (h[i].hash == 0 || ngx_js_fetch_cache_skip_header(&h[i].key)) {
+            continue;
+        }
+
+        headers_len += h[i].key.len + sizeof(": ") - 1 + h[i].value.len
+                       + sizeof(CRLF) - 1;
+    }
+
+    size = offsetof(ngx_js_fetch_cache_node_t, data) + http->cache_key.len
+           + http->response.status_text.len + headers_len + body_len;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = ngx_js_fetch_cache_find(http, cache);
+
+    if (node != NULL) {
+        ngx_js_fetch_cache_delete(cache, node);
+    }
+
+    if (valid < 0) {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+        return;
+    }
+
+    for ( ;; ) {
+        node = ngx_slab_alloc_locked(cache->shpool, size);
+        if (node != NULL) {
+            break;
+        }
+
+        if (ngx_queue_empty(&cache->sh->lru)) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+
+            ngx_log_error(NGX_LOG_WARN, http->log, 0,
+                          "js fetch cache \"%V\": response of %uz bytes "
+                          "does not fit", &http->cache->shm.name, size);
+            return;
+        }
+
+        q = ngx_queue_last(&cache->sh->lru);
+
+        ngx_js_fetch_cache_delete(cache,
+                                  ngx_queue_data(q, ngx_js_fetch_cache_node_t,
+                                                 queue));
+    }
+
+    node->expires = ngx_time() + valid;
+    node->code = http->response.code;
+    node->status_len = http->response.status_text.len;
+    node->headers_len = headers_len;
+    node->body_len = body_len;
+
+    p = ngx_cpymem(node->data, http->cache_key.data, http->cache_key.len);
+    p = ngx_cpymem(p, http->response.status_text.data,
+                   http->response.status_text.len);
+
+    part = &http->response.headers.header_list.part;
+    h = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (h[i].hash == 0 || ngx_js_fetch_cache_skip_header(&h[i].key)) {
+            continue;
+        }
+
+        p = ngx_cpymem(p, h[i].key.data, h[i].key.len);
+        *p++ = ':'; *p++ = ' ';
+        p = ngx_cpymem(p, h[i].value.data, h[i].value.len);
+        *p++ = CR; *p++ = LF;
+    }
+
+    njs_chb_join_to(&http->response.chain, p);
+
+    node->sn.str.data = node->data;
+    node->sn.str.len = http->cache_key.len;
+    node->sn.node.key = ngx_crc32_short(http->cache_key.data,
+                                        http->cache_key.len);
+
+    ngx_rbtree_insert(&cache->sh->rbtree, &node->sn.node);
+    ngx_queue_insert_head(&cache->sh->lru, &node->queue);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js fetch cache store: \"%V\" valid:%T",
+                   &http->cache_key, valid);
+}
+
+
+static time_t
+ngx_js_fetch_cache_valid(ngx_js_headers_t *headers)
+{
+    u_char     *p, *last, *end;
+    size_t      len;
+    time_t      max_age, s_maxage, age, expires, date;
+    ngx_str_t  *value;
+    ngx_uint_t  no_cache;
+
+    max_age = -1;
+    s_maxage = -1;
+    no_cache = 0;
+
+    value = ngx_js_fetch_cache_header(headers, "Cache-Control", 13);
+
+    if (value != NULL) {
+        p = value->data;
+        last = p + value->len;
+
+        while (p < last) {
+            while (p < last && (*p == ' ' || *p == '\t' || *p == ',')) {
+                p++;
+            }
+
+            end = ngx_strlchr(p, last, ',');
+            if (end == NULL) {
+                end = last;
+            }
+
+            len = end - p;
+
+            if (len == 8 && ngx_strncasecmp(p, (u_char *) "no-store", 8) == 0) {
+                return -1;
+            }
+
+            if (len >= 7 && ngx_strncasecmp(p, (u_char *) "private", 7) == 0
+                && (len == 7 || p[7] == '='))
+            {
+                /* the cache is shared */
+                return -1;
+            }
+
+            if (len == 8 && ngx_strncasecmp(p, (u_char *) "no-cache", 8) == 0) {
+                /* no-store and private found later take precedence */
+                no_cache = 1;
+            }
+
+            if (len > 8 && ngx_strncasecmp(p, (u_char *) "max-age=", 8) == 0) {
+                max_age = ngx_atotm(p + 8, len - 8);
+            }
+
+            if (len > 9 && ngx_strncasecmp(p, (u_char *) "s-maxage=", 9) == 0)
+            {
+                s_maxage = ngx_atotm(p + 9, len - 9);
+            }
+
+            p = end;
+        }
+    }
+
+    if (no_cache) {
+        return 0;
+    }
+
+    if (s_maxage >= 0) {
+        max_age = s_maxage;
+    }
+
+    if (max_age < 0) {
+        value = ngx_js_fetch_cache_header(headers, "Expires", 7);
+        if (value == NULL) {
+            return 0;
+        }
+
+        expires = ngx_parse_http_time(value->data, value->len);
+        if (expires == NGX_ERROR) {
+            return 0;
+        }
+
+        value = ngx_js_fetch_cache_header(headers, "Date", 4);
+
+        date = (value != NULL) ? ngx_parse_http_time(value->data, value->len)
+                               : NGX_ERROR;
+
+        if (date == NGX_ERROR) {
+            date = ngx_time();
+        }
+
+        max_age = expires - date;
+    }
+
+    value = ngx_js_fetch_cache_header(headers, "Age", 3);
+
+    if (value != NULL) {
+        age = ngx_atotm(value->data, value->len);
+        if (age > 0) {
+            max_age -= age;
+        }
+    }
+
+    return ngx_max(max_age, 0);
+}
+
+
+static ngx_str_t *
+ngx_js_fetch_cache_header(ngx_js_headers_t *headers, const char *name,
+    size_t len)
+{
+    ngx_uint_t        i;
+    ngx_list_part_t  *part;
+    ngx_js_tb_elt_t  *h;
+
+    if (headers->header_list.size == 0) {
+        return NULL;
+    }
+
+    part = &headers->header_list.part;
+    h = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (h[i].hash == 0) {
+            continue;
+        }
+
+        if (h[i].key.len == len
+            && ngx_strncasecmp(h[i].key.data, (u_char *) name, len) == 0)
+        {
+            return &h[i].value;
+        }
+    }
+
+    return NULL;
+}
+
+
+static ngx_int_t
+ngx_js_fetch_cache_skip_header(ngx_str_t *name)
+{
+    ngx_uint_t  i;
+
+    static ngx_str_t  hop_by_hop[] = {
+        ngx_string("Connection"),
+        ngx_string("Keep-Alive"),
+        ngx_string("Transfer-Encoding"),
+        ngx_string("Age"),
+        ngx_null_string
+    };
+
+    for (i = 0; hop_by_hop[i].len != 0; i++) {
+        if (name->len == hop_by_hop[i].len
+            && ngx_strncasecmp(name->data, hop_by_hop[i].data, name->len) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static ngx_int_t
+ngx_js_fetch_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_js_fetch_cache_t  *prev = data;
+
+    size_t                 len;
+    ngx_js_fetch_cache_t  *cache;
+
+    cache = shm_zone->data;
+
+    if (prev) {
+        cache->sh = prev->sh;
+        cache->shpool = prev->shpool;
+        return NGX_OK;
+    }
+
+    cache->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->sh = cache->shpool->data;
+        return NGX_OK;
+    }
+
+    cache->sh = ngx_slab_alloc(cache->shpool, sizeof(ngx_js_fetch_cache_sh_t));
+    if (cache->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->shpool->data = cache->sh;
+
+    ngx_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+    ngx_queue_init(&cache->sh->lru);
+
+    /* the least recently used responses are evicted when full */
+    cache->shpool->log_nomem = 0;
+
+    len = sizeof(" in js fetch cache zone \"\"") + shm_zone->shm.name.len;
+
+    cache->shpool->log_ctx = ngx_slab_alloc(cache->shpool, len);
+    if (cache->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->shpool->log_ctx, " in js fetch cache zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    return NGX_OK;
+}
+
+
+char *
+ngx_js_fetch_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf, void *tag)
+{
+    ngx_js_loc_conf_t *jscf = conf;
+
+    u_char                *p;
+    ssize_t                size, max_size;
+    ngx_str_t             *value, name, s;
+    ngx_uint_t             i;
+    ngx_shm_zone_t        *shm_zone;
+    ngx_js_fetch_cache_t  *cache;
+
+    if (jscf->fetch_cache != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        if (cf->args->nelts != 2) {
+            return "has invalid parameters";
+        }
+
+        jscf->fetch_cache = NULL;
+        return NGX_CONF_OK;
+    }
+
+    size = 0;
+    max_size = NGX_CONF_UNSET_SIZE;
+    name.len = 0;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "zone=", 5) == 0) {
+
+            name.data = value[i].data + 5;
+            name.len = value[i].len - 5;
+
+            p = (u_char *) ngx_strchr(name.data, ':');
+
+            if (p != NULL) {
+                name.len = p - name.data;
+
+                s.data = p + 1;
+                s.len = value[i].data + value[i].len - s.data;
+
+                size = ngx_parse_size(&s);
+
+                if (size == NGX_ERROR) {
+                    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                       "invalid zone size \"%V\"", &value[i]);
+                    return NGX_CONF_ERROR;
+                }
+
+                if (size < (ssize_t) (8 * ngx_pagesize)) {
+                    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                       "zone \"%V\" is too small", &value[i]);
+                    return NGX_CONF_ERROR;
+                }
+            }
+
+            if (name.len == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid zone name \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "max_size=", 9) == 0) {
+
+            s.data = value[i].data + 9;
+            s.len = value[i].len - 9;
+
+            max_size = ngx_parse_size(&s);
+
+            if (max_size == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid max_size value \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (name.len == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"%V\" must have \"zone\" parameter", &cmd->name);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, size, tag);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data != NULL
+        && shm_zone->init != ngx_js_fetch_cache_init_zone)
+    {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "duplicate zone \"%V\"",
+                           &name);
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data == NULL) {
+        cache = ngx_pcalloc(cf->pool, sizeof(ngx_js_fetch_cache_t));
+        if (cache == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        shm_zone->data = cache;
+        shm_zone->init = ngx_js_fetch_cache_init_zone;
+    }
+
+    jscf->fetch_cache = shm_zone;
+    jscf->fetch_cache_max_size = max_size;
+
+    return NGX_CONF_OK;
+}
@@ -11,18 +11,42 @@
 #include "ngx_js_http.h"
 
 
+/*
+ * a destination: host, port, SSL and proxy,
+ * indexed by ngx_js_http_dest_lookup() in conf->fetch_hosts;
+ *
+ * destinations are kept per location like the cached keepalive
+ * connections, which depend on its SSL settings, so js_fetch_max_conns
+ * limits the connections made from a single location in a worker,
+ * also when it is specified on the server or http level
+ */
+
+struct ngx_js_http_dest_s {
+    ngx_str_node_t         sn;
+    ngx_js_loc_conf_t     *conf;
+    ngx_queue_t            cache;
+    ngx_queue_t            waiting;
+    ngx_uint_t             active;
+};
+
+
 typedef struct {
     ngx_js_loc_conf_t     *conf;
     ngx_queue_t            queue;
     ngx_connection_t      *connection;
 
-    ngx_flag_t             ssl;
-    size_t                 host_len;
-    u_char                 host[NGX_JS_HOST_MAX_LEN];
-    in_port_t              port;
+    ngx_js_http_dest_t    *dest;
+    ngx_queue_t            dest_queue;
 } ngx_js_http_keepalive_cache_t;
 
 
+struct ngx_js_http_flight_s {
+    ngx_str_node_t         sn;
+    ngx_js_http_t         *leader;
+    ngx_queue_t            waiters;
+};
+
+
 #define ngx_js_http_version(major, minor)  ((major) * 1000 + (minor))
 #define NGX_JS_USER_AGENT  "nginx-js"
 
@@ -32,11 +56,30 @@ static void ngx_js_http_next(ngx_js_http_t *http);
 static void ngx_js_http_write_handler(ngx_event_t *wev);
 static void ngx_js_http_read_handler(ngx_event_t *rev);
 static void ngx_js_http_dummy_handler(ngx_event_t *ev);
+static void ngx_js_http_resume(ngx_js_http_t *http);
+static ngx_int_t ngx_js_http_send(ngx_js_http_t *http, ngx_buf_t *b);
+static ngx_int_t ngx_js_http_next_body(ngx_js_http_t *http);
+static ngx_int_t ngx_js_http_pipe_chunk(ngx_js_http_t *http);
+static void ngx_js_http_pipe_notify(ngx_js_http_t *http);
+static void ngx_js_http_pipe_abort(ngx_js_http_t *http);
+static void ngx_js_http_flight_done(ngx_js_http_t *http, const char *err);
+static ngx_int_t ngx_js_http_flight_response(ngx_js_http_t *http,
+    ngx_js_response_t *response);
+static void ngx_js_http_flight_start(ngx_event_t *ev);
+static void ngx_js_http_start(ngx_js_http_t *http);
+static void ngx_js_http_batch_leave(ngx_js_http_t *http);
+static void ngx_js_http_batch_handler(ngx_event_t *ev);
+static void ngx_js_http_batch_timeout_handler(ngx_event_t *ev);
 static void ngx_js_http_keepalive_close_handler(ngx_event_t *ev);
 static void ngx_js_http_keepalive_dummy_handler(ngx_event_t *ev);
 
 static ngx_int_t ngx_js_http_get_keepalive_connection(ngx_js_http_t *http);
 static ngx_int_t ngx_js_http_free_keepalive_connection(ngx_js_http_t *http);
+static ngx_int_t ngx_js_http_dest_acquire(ngx_js_http_t *http);
+static void ngx_js_http_dest_release(ngx_js_http_t *http);
+static void ngx_js_http_dest_wait_handler(ngx_event_t *ev);
+static ngx_js_http_dest_t *ngx_js_http_dest_lookup(ngx_js_http_t *http);
+static void ngx_js_http_dest_free(ngx_js_http_dest_t *dest);
 
 static ngx_int_t ngx_js_http_process_status_line(ngx_js_http_t *http);
 static ngx_int_t ngx_js_http_process_headers(ngx_js_http_t *http);
@@ -61,6 +104,12 @@ static ngx_int_t ngx_js_http_process_connect_response(ngx_js_http_t *http);
 #endif
 
 
+/* identical requests in flight in this worker */
+
+static ngx_rbtree_t       ngx_js_http_flights;
+static ngx_rbtree_node_t  ngx_js_http_flights_sentinel;
+
+
 static void
 ngx_js_http_error(ngx_js_http_t *http, const char *fmt, ...)
 {
@@ -75,24 +124,61 @@ ngx_js_http_error(ngx_js_http_t *http, const char *fmt, ...)
     *p = '\0';
     va_end(args);
 
+    ngx_js_http_pipe_abort(http);
+
+    if (http->response.stream != NULL && !http->finished) {
+        http->finished = 1;
+
+        http->error.data = ngx_pnalloc(http->pool, p - err);
+        if (http->error.data != NULL) {
+            http->error.len = p - err;
+            ngx_memcpy(http->error.data, err, p - err);
+        }
+
+        ngx_js_http_pipe_notify(http);
+    }
+
+    if (http->flight != NULL) {
+        ngx_js_http_flight_done(http, (const char *) err);
+    }
+
     http->error_handler(http, (const char *) err);
 }
 
 
-ngx_resolver_ctx_t *
+ngx_int_t
 ngx_js_http_resolve(ngx_js_http_t *http, ngx_resolver_t *r, ngx_str_t *host,
     ngx_msec_t timeout)
 {
     ngx_int_t            ret;
     ngx_resolver_ctx_t  *ctx;
 
+    if (http->conf->fetch_resolver_cache != NULL) {
+        ret = ngx_js_resolver_cache_lookup(http, r, host, timeout);
+
+        if (ret == NGX_OK) {
+            ngx_js_http_connect(http);
+            return NGX_OK;
+        }
+
+        if (ret == NGX_ABORT) {
+            ngx_js_http_error(http, "\"%V\" could not be resolved (cached)",
+                              host);
+            return NGX_OK;
+        }
+
+        if (ret == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
     ctx = ngx_resolve_start(r, NULL);
     if (ctx == NULL) {
-        return NULL;
+        return NGX_ERROR;
     }
 
     if (ctx == NGX_NO_RESOLVER) {
-        return ctx;
+        return NGX_DECLINED;
     }
 
     http->ctx = ctx;
@@ -105,25 +191,24 @@ ngx_js_http_resolve(ngx_js_http_t *http, ngx_resolver_t *r, ngx_str_t *host,
     ret = ngx_resolve_name(ctx);
     if (ret != NGX_OK) {
         http->ctx = NULL;
-        return NULL;
+        return NGX_ERROR;
     }
 
-    return ctx;
+    return NGX_OK;
 }
 
 
 static void
 ngx_js_http_resolve_handler(ngx_resolver_ctx_t *ctx)
 {
-    u_char           *p;
-    size_t            len;
-    socklen_t         socklen;
-    ngx_uint_t        i;
-    ngx_js_http_t    *http;
-    struct sockaddr  *sockaddr;
+    ngx_js_http_t  *http;
 
     http = ctx->data;
 
+    if (http->conf->fetch_resolver_cache != NULL) {
+        ngx_js_resolver_cache_update(http->conf->fetch_resolver_cache, ctx);
+    }
+
     if (ctx->state) {
         ngx_js_http_error(http, "\"%V\" could not be resolved (%i: %s)",
                           &ctx->name, ctx->state,
@@ -152,22 +237,43 @@ ngx_js_http_resolve_handler(ngx_resolver_ctx_t *ctx)
     }
 #endif
 
-    http->naddrs = ctx->naddrs;
-    http->addrs = ngx_pcalloc(http->pool, http->naddrs * sizeof(ngx_addr_t));
+    if (ngx_js_http_set_addrs(http, ctx->addrs, ctx->naddrs) != NGX_OK) {
+        ngx_js_http_error(http, "memory error");
+        return;
+    }
+
+    ngx_js_http_resolve_done(http);
+
+    ngx_js_http_connect(http);
+}
+
+
+ngx_int_t
+ngx_js_http_set_addrs(ngx_js_http_t *http, ngx_resolver_addr_t *addrs,
+    ngx_uint_t naddrs)
+{
+    u_char           *p;
+    size_t            len;
+    socklen_t         socklen;
+    ngx_uint_t        i;
+    struct sockaddr  *sockaddr;
+
+    http->naddrs = naddrs;
+    http->addrs = ngx_pcalloc(http->pool, naddrs * sizeof(ngx_addr_t));
 
     if (http->addrs == NULL) {
-        goto failed;
+        return NGX_ERROR;
     }
 
-    for (i = 0; i < ctx->naddrs; i++) {
-        socklen = ctx->addrs[i].socklen;
+    for (i = 0; i < naddrs; i++) {
+        socklen = addrs[i].socklen;
 
         sockaddr = ngx_palloc(http->pool, socklen);
         if (sockaddr == NULL) {
-            goto failed;
+            return NGX_ERROR;
         }
 
-        ngx_memcpy(sockaddr, ctx->addrs[i].sockaddr, socklen);
+        ngx_memcpy(sockaddr, addrs[i].sockaddr, socklen);
         ngx_inet_set_port(sockaddr, http->connect_port);
 
         http->addrs[i].sockaddr = sockaddr;
@@ -175,7 +281,7 @@ ngx_js_http_resolve_handler(ngx_resolver_ctx_t *ctx)
 
         p = ngx_pnalloc(http->pool, NGX_SOCKADDR_STRLEN);
         if (p == NULL) {
-            goto failed;
+            return NGX_ERROR;
         }
 
         len = ngx_sock_ntop(sockaddr, socklen, p, NGX_SOCKADDR_STRLEN, 1);
@@ -183,15 +289,7 @@ ngx_js_http_resolve_handler(ngx_resolver_ctx_t *ctx)
         http->addrs[i].name.data = p;
     }
 
-    ngx_js_http_resolve_done(http);
-
-    ngx_js_http_connect(http);
-
-    return;
-
-failed:
-
-    ngx_js_http_error(http, "memory error");
+    return NGX_OK;
 }
 
 
@@ -233,7 +331,14 @@ ngx_js_http_resolve_done(ngx_js_http_t *http)
 void
 ngx_js_http_close_peer(ngx_js_http_t *http)
 {
+    if (http->source != NULL) {
+        http->source->pipe = NULL;
+        http->source = NULL;
+    }
+
     if (http->peer.connection == NULL) {
+        ngx_js_http_dest_release(http);
+        ngx_js_http_batch_leave(http);
         return;
     }
 
@@ -250,6 +355,9 @@ ngx_js_http_close_peer(ngx_js_http_t *http)
     }
 
     http->peer.connection = NULL;
+
+    ngx_js_http_dest_release(http);
+    ngx_js_http_batch_leave(http);
 }
 
 
@@ -272,6 +380,17 @@ ngx_js_http_connect(ngx_js_http_t *http)
     http->peer.log = http->log;
     http->peer.log_error = NGX_ERROR_ERR;
 
+    rc = ngx_js_http_dest_acquire(http);
+
+    if (rc == NGX_ERROR) {
+        ngx_js_http_error(http, "memory error");
+        return;
+    }
+
+    if (rc == NGX_BUSY) {
+        return;
+    }
+
     rc = ngx_js_http_get_keepalive_connection(http);
     if (rc != NGX_OK) {
         rc = ngx_event_connect_peer(&http->peer);
@@ -608,6 +727,12 @@ ngx_js_http_next(ngx_js_http_t *http)
 {
     ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0, "js http next addr");
 
+    if (http->sending_body && http->source != NULL) {
+        /* a part of the body stream is already consumed */
+        ngx_js_http_error(http, "request body stream interrupted");
+        return;
+    }
+
     if (++http->naddr >= http->naddrs) {
         ngx_js_http_error(http, "connect failed");
         return;
@@ -619,6 +744,8 @@ ngx_js_http_next(ngx_js_http_t *http)
     }
 
     http->buffer = NULL;
+    http->out = NULL;
+    http->sending_body = 0;
 
     ngx_js_http_connect(http);
 }
@@ -627,7 +754,7 @@ ngx_js_http_next(ngx_js_http_t *http)
 static void
 ngx_js_http_write_handler(ngx_event_t *wev)
 {
-    ssize_t            n, size;
+    ngx_int_t          rc;
     ngx_buf_t         *b;
     ngx_js_http_t     *http;
     ngx_connection_t  *c;
@@ -651,186 +778,447 @@ ngx_js_http_write_handler(ngx_event_t *wev)
     }
 #endif
 
-    b = http->buffer;
+    if (!http->sending_body) {
+        b = http->buffer;
 
-    if (b == NULL) {
-        b = ngx_js_chain_to_buf(http->pool, &http->chain);
         if (b == NULL) {
-            ngx_js_http_error(http, "memory error");
-            return;
-        }
-
-        http->buffer = b;
-    }
-
-    size = b->last - b->pos;
-
-    n = c->send(c, b->pos, size);
-
-    if (n == NGX_ERROR) {
-        ngx_js_http_next(http);
-        return;
-    }
-
-    if (n > 0) {
-        b->pos += n;
-
-        if (n == size) {
-            wev->handler = ngx_js_http_dummy_handler;
-
-            http->buffer = NULL;
-
-            if (wev->timer_set) {
-                ngx_del_timer(wev);
-            }
-
-            if (ngx_handle_write_event(wev, 0) != NGX_OK) {
-                ngx_js_http_error(http, "write failed");
+            b = ngx_js_chain_to_buf(http->pool, &http->chain);
+            if (b == NULL) {
+                ngx_js_http_error(http, "memory error");
+                return;
             }
 
-            return;
+            http->buffer = b;
         }
-    }
-
-    if (!wev->timer_set) {
-        ngx_add_timer(wev, http->conf->timeout);
-    }
-}
-
 
-static void
-ngx_js_http_read_handler(ngx_event_t *rev)
-{
-    ssize_t            n, size;
-    ngx_int_t          rc;
-    ngx_buf_t         *b;
-    ngx_js_http_t     *http;
-    ngx_connection_t  *c;
+        rc = ngx_js_http_send(http, b);
 
-    c = rev->data;
-    http = c->data;
+        if (rc == NGX_ERROR) {
+            ngx_js_http_next(http);
+            return;
+        }
 
-    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, rev->log, 0, "js http read handler");
+        if (rc == NGX_AGAIN) {
+            goto again;
+        }
 
-    if (rev->timedout) {
-        ngx_js_http_error(http, "read timed out");
-        return;
-    }
+        http->buffer = NULL;
 
-    if (http->buffer == NULL) {
-        b = ngx_create_temp_buf(http->pool, http->buffer_size);
-        if (b == NULL) {
-            ngx_js_http_error(http, "memory error");
-            return;
+        if (http->proxy.state == HTTP_STATE_PROXY_CONNECT_PENDING
+            || (http->body.len == 0 && http->source == NULL))
+        {
+            goto done;
         }
 
-        http->buffer = b;
+        http->sending_body = 1;
     }
 
-    for ( ;; ) {
-        b = http->buffer;
-        size = b->end - b->last;
-
-        n = c->recv(c, b->last, size);
+    /*
+     * the body is sent directly from the memory it was passed in,
+     * a body stream is relayed chunk by chunk as it is received
+     */
 
-        if (n > 0) {
-            b->last += n;
+    for ( ;; ) {
+        b = http->out;
 
-            rc = http->process(http);
+        if (b == NULL || b->pos == b->last) {
+            rc = ngx_js_http_next_body(http);
 
             if (rc == NGX_ERROR) {
                 return;
             }
 
             if (rc == NGX_DONE) {
-                break;
+                goto done;
             }
 
-            continue;
-        }
+            if (rc == NGX_AGAIN) {
+                /* waiting for the body stream, it has its own timeout */
 
-        if (n == NGX_AGAIN) {
-            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
-                ngx_js_http_error(http, "read failed");
+                http->body_waiting = 1;
+
+                if (wev->timer_set) {
+                    ngx_del_timer(wev);
+                }
+
+                return;
             }
 
-            return;
+            b = http->out;
         }
 
-        if (n == NGX_ERROR) {
+        rc = ngx_js_http_send(http, b);
+
+        if (rc == NGX_ERROR) {
             ngx_js_http_next(http);
             return;
         }
 
-        break;
+        if (http->source != NULL) {
+            ngx_add_timer(c->read, http->conf->timeout);
+        }
+
+        if (rc == NGX_AGAIN) {
+            goto again;
+        }
     }
 
-    http->done = 1;
+done:
 
-    rc = http->process(http);
+    wev->handler = ngx_js_http_dummy_handler;
 
-    if (rc == NGX_DONE) {
-        /* handler was called */
-        return;
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
     }
 
-    if (rc == NGX_AGAIN) {
-        ngx_js_http_error(http, "prematurely closed connection");
+    if (ngx_handle_write_event(wev, 0) != NGX_OK) {
+        ngx_js_http_error(http, "write failed");
     }
-}
 
+    return;
 
-static void
-ngx_js_http_dummy_handler(ngx_event_t *ev)
-{
-    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0, "js http dummy handler");
+again:
+
+    if (!wev->timer_set) {
+        ngx_add_timer(wev, http->conf->timeout);
+    }
 }
 
 
 static ngx_int_t
-ngx_js_http_process_status_line(ngx_js_http_t *http)
+ngx_js_http_send(ngx_js_http_t *http, ngx_buf_t *b)
 {
-    ngx_int_t             rc;
-    ngx_js_http_parse_t  *hp;
+    ssize_t            n, size;
+    ngx_connection_t  *c;
 
-    hp = &http->http_parse;
+    c = http->peer.connection;
 
-    rc = ngx_js_http_parse_status_line(hp, http->buffer);
+    size = b->last - b->pos;
 
-    if (rc == NGX_OK) {
-        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0, "js http status %ui",
-                       hp->code);
+    n = c->send(c, b->pos, size);
 
-        http->response.code = hp->code;
-        http->response.status_text.data = hp->status_text;
-        http->response.status_text.len = hp->status_text_end - hp->status_text;
-        http->process = ngx_js_http_process_headers;
+    if (n == NGX_ERROR) {
+        return NGX_ERROR;
+    }
 
-        if (http->keepalive) {
-            http->keepalive = (hp->http_version >= ngx_js_http_version(1, 1));
+    if (n > 0) {
+        b->pos += n;
+
+        if (n == size) {
+            return NGX_OK;
         }
+    }
 
-        return http->process(http);
+    return NGX_AGAIN;
+}
+
+
+static ngx_int_t
+ngx_js_http_next_body(ngx_js_http_t *http)
+{
+    ngx_buf_t  *b;
+
+    if (http->source != NULL) {
+        return ngx_js_http_pipe_chunk(http);
     }
 
-    if (rc == NGX_AGAIN) {
-        return NGX_AGAIN;
+    if (http->out != NULL) {
+        return NGX_DONE;
     }
 
-    /* rc == NGX_ERROR */
+    b = ngx_calloc_buf(http->pool);
+    if (b == NULL) {
+        ngx_js_http_error(http, "memory error");
+        return NGX_ERROR;
+    }
 
-    ngx_js_http_error(http, "invalid http status line");
+    b->memory = 1;
+    b->start = http->body.data;
+    b->pos = b->start;
+    b->last = b->start + http->body.len;
+    b->end = b->last;
 
-    return NGX_ERROR;
+    http->out = b;
+
+    return NGX_OK;
 }
 
 
 static ngx_int_t
-ngx_js_http_process_headers(ngx_js_http_t *http)
+ngx_js_http_pipe_chunk(ngx_js_http_t *http)
 {
-    size_t                len, vlen;
-    ngx_int_t             rc;
-    ngx_js_http_parse_t  *hp;
+    size_t          len;
+    int64_t         size;
+    ngx_buf_t      *b;
+    ngx_js_http_t  *source;
+
+    source = http->source;
+
+    size = njs_chb_size(&source->response.chain);
+    if (size < 0) {
+        ngx_js_http_error(http, "memory error");
+        return NGX_ERROR;
+    }
+
+    if (size == 0) {
+        if (source->error.len != 0) {
+            ngx_js_http_error(http, "request body stream failed: %*s",
+                              source->error.len, source->error.data);
+            return NGX_ERROR;
+        }
+
+        if (!source->finished) {
+            return NGX_AGAIN;
+        }
+
+        if (http->body_sent) {
+            return NGX_DONE;
+        }
+
+        http->body_sent = 1;
+    }
+
+    len = NGX_OFF_T_LEN + size + 2 * (sizeof(CRLF) - 1);
+
+    b = http->out;
+
+    if (b == NULL || (size_t) (b->end - b->start) < len) {
+        /*
+         * the body stream is paused once buffer_size bytes are pending,
+         * so the same buffer is normally reused for all the chunks
+         */
+
+        b = ngx_create_temp_buf(http->pool,
+                                ngx_max(len, 2 * (size_t) source->buffer_size));
+        if (b == NULL) {
+            ngx_js_http_error(http, "memory error");
+            return NGX_ERROR;
+        }
+
+        http->out = b;
+    }
+
+    b->pos = b->start;
+    b->last = ngx_sprintf(b->start, "%xL" CRLF, size);
+
+    if (size != 0) {
+        njs_chb_join_to(&source->response.chain, b->last);
+        b->last += size;
+
+        ngx_js_http_stream_consumed(&source->response);
+    }
+
+    *b->last++ = CR; *b->last++ = LF;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js http body stream chunk: %L", size);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_js_http_pipe_notify(ngx_js_http_t *http)
+{
+    ngx_js_http_t  *pipe;
+
+    pipe = http->pipe;
+
+    if (pipe == NULL || !pipe->body_waiting || pipe->peer.connection == NULL) {
+        return;
+    }
+
+    pipe->body_waiting = 0;
+
+    ngx_post_event(pipe->peer.connection->write, &ngx_posted_events);
+}
+
+
+static void
+ngx_js_http_pipe_abort(ngx_js_http_t *http)
+{
+    ngx_js_http_t  *source;
+
+    source = http->source;
+
+    if (source == NULL) {
+        return;
+    }
+
+    http->source = NULL;
+    source->pipe = NULL;
+
+    if (!source->finished) {
+        ngx_js_http_error(source, "request body stream aborted");
+    }
+}
+
+
+static void
+ngx_js_http_read_handler(ngx_event_t *rev)
+{
+    ssize_t            n, size;
+    ngx_int_t          rc;
+    ngx_buf_t         *b;
+    ngx_js_http_t     *http;
+    ngx_connection_t  *c;
+
+    c = rev->data;
+    http = c->data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, rev->log, 0, "js http read handler");
+
+    if (rev->timedout) {
+        ngx_js_http_error(http, "read timed out");
+        return;
+    }
+
+    if (http->paused) {
+        if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+            ngx_js_http_error(http, "read failed");
+        }
+
+        return;
+    }
+
+    if (http->buffer == NULL) {
+        b = ngx_create_temp_buf(http->pool, http->buffer_size);
+        if (b == NULL) {
+            ngx_js_http_error(http, "memory error");
+            return;
+        }
+
+        http->buffer = b;
+    }
+
+    for ( ;; ) {
+        b = http->buffer;
+        size = b->end - b->last;
+
+        n = c->recv(c, b->last, size);
+
+        if (n > 0) {
+            b->last += n;
+
+            if (http->stream) {
+                ngx_add_timer(rev, http->conf->timeout);
+            }
+
+            rc = http->process(http);
+
+            if (rc == NGX_ERROR) {
+                return;
+            }
+
+            if (rc == NGX_DONE) {
+                break;
+            }
+
+            if (http->paused) {
+                /* the timer is armed again by ngx_js_http_resume() */
+
+                if (rev->timer_set) {
+                    ngx_del_timer(rev);
+                }
+
+                if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+                    ngx_js_http_error(http, "read failed");
+                }
+
+                return;
+            }
+
+            continue;
+        }
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+                ngx_js_http_error(http, "read failed");
+            }
+
+            return;
+        }
+
+        if (n == NGX_ERROR) {
+            if (http->response.stream != NULL) {
+                /* the response is already passed to JS */
+                ngx_js_http_error(http, "read failed");
+                return;
+            }
+
+            ngx_js_http_next(http);
+            return;
+        }
+
+        break;
+    }
+
+    http->done = 1;
+
+    rc = http->process(http);
+
+    if (rc == NGX_DONE) {
+        /* handler was called */
+        return;
+    }
+
+    if (rc == NGX_AGAIN) {
+        ngx_js_http_error(http, "prematurely closed connection");
+    }
+}
+
+
+static void
+ngx_js_http_dummy_handler(ngx_event_t *ev)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0, "js http dummy handler");
+}
+
+
+static ngx_int_t
+ngx_js_http_process_status_line(ngx_js_http_t *http)
+{
+    ngx_int_t             rc;
+    ngx_js_http_parse_t  *hp;
+
+    hp = &http->http_parse;
+
+    rc = ngx_js_http_parse_status_line(hp, http->buffer);
+
+    if (rc == NGX_OK) {
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0, "js http status %ui",
+                       hp->code);
+
+        http->response.code = hp->code;
+        http->response.status_text.data = hp->status_text;
+        http->response.status_text.len = hp->status_text_end - hp->status_text;
+        http->process = ngx_js_http_process_headers;
+
+        if (http->keepalive) {
+            http->keepalive = (hp->http_version >= ngx_js_http_version(1, 1));
+        }
+
+        return http->process(http);
+    }
+
+    if (rc == NGX_AGAIN) {
+        return NGX_AGAIN;
+    }
+
+    /* rc == NGX_ERROR */
+
+    ngx_js_http_error(http, "invalid http status line");
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_js_http_process_headers(ngx_js_http_t *http)
+{
+    size_t                len, vlen;
+    ngx_int_t             rc;
+    ngx_js_http_parse_t  *hp;
 
     ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0,
                    "js http process headers");
@@ -899,6 +1287,7 @@ ngx_js_http_process_headers(ngx_js_http_t *http)
                 }
 
                 if (!http->header_only
+                    && !http->stream
                     && http->content_length_n
                        > (off_t) http->max_response_body_size)
                 {
@@ -931,6 +1320,14 @@ ngx_js_http_process_headers(ngx_js_http_t *http)
 
     http->process = ngx_js_http_process_body;
 
+    if (http->stream && !http->header_only) {
+        http->response.stream = http;
+
+        if (http->stream_handler(http, NGX_JS_HTTP_STREAM_HEADERS) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
     return http->process(http);
 }
 
@@ -938,7 +1335,8 @@ ngx_js_http_process_headers(ngx_js_http_t *http)
 static ngx_int_t
 ngx_js_http_process_body(ngx_js_http_t *http)
 {
-    ssize_t     size, chsize, need;
+    off_t       need;
+    ssize_t     size, chsize;
     ngx_int_t   rc;
     ngx_buf_t  *b;
 
@@ -962,13 +1360,32 @@ ngx_js_http_process_body(ngx_js_http_t *http)
 
         if (http->header_only
             || http->content_length_n == -1
-            || size == http->content_length_n)
+            || http->received == http->content_length_n)
         {
-            http->ready_handler(http);
+            ngx_js_http_pipe_abort(http);
+
+            if (http->response.stream != NULL) {
+                http->finished = 1;
+                ngx_js_http_pipe_notify(http);
+
+                (void) http->stream_handler(http, NGX_JS_HTTP_STREAM_LAST);
+
+            } else {
+                if (http->cache != NULL) {
+                    ngx_js_fetch_cache_update(http);
+                }
+
+                if (http->flight != NULL) {
+                    ngx_js_http_flight_done(http, NULL);
+                }
+
+                http->ready_handler(http);
+            }
+
             return NGX_DONE;
         }
 
-        if (size < http->content_length_n) {
+        if (http->received < http->content_length_n) {
             return NGX_AGAIN;
         }
 
@@ -978,6 +1395,8 @@ ngx_js_http_process_body(ngx_js_http_t *http)
 
     b = http->buffer;
 
+    size = njs_chb_size(&http->response.chain);
+
     if (http->chunked) {
         rc = ngx_js_http_parse_chunked(&http->http_chunk_parse, b,
                                        &http->response.chain);
@@ -986,13 +1405,16 @@ ngx_js_http_process_body(ngx_js_http_t *http)
             return NGX_ERROR;
         }
 
-        size = njs_chb_size(&http->response.chain);
+        chsize = njs_chb_size(&http->response.chain) - size;
+        http->received += chsize;
 
         if (rc == NGX_OK) {
-            http->content_length_n = size;
+            http->content_length_n = http->received;
         }
 
-        if (size > http->max_response_body_size * 10) {
+        if (!http->stream
+            && http->received > http->max_response_body_size * 10)
+        {
             ngx_js_http_error(http, "very large http chunked response");
             return NGX_ERROR;
         }
@@ -1000,21 +1422,22 @@ ngx_js_http_process_body(ngx_js_http_t *http)
         b->pos = http->http_chunk_parse.pos;
 
     } else {
-        size = njs_chb_size(&http->response.chain);
-
         if (http->header_only) {
             need = 0;
 
         } else  if (http->content_length_n == -1) {
-            need = http->max_response_body_size - size;
+            need = http->stream ? NGX_MAX_OFF_T_VALUE
+                                : http->max_response_body_size - http->received;
 
         } else {
-            need = http->content_length_n - size;
+            need = http->content_length_n - http->received;
         }
 
         chsize = ngx_min(need, b->last - b->pos);
 
-        if (size + chsize > http->max_response_body_size) {
+        if (!http->stream
+            && http->received + chsize > http->max_response_body_size)
+        {
             ngx_js_http_error(http, "http response body is too large");
             return NGX_ERROR;
         }
@@ -1022,6 +1445,7 @@ ngx_js_http_process_body(ngx_js_http_t *http)
         if (chsize > 0) {
             njs_chb_append(&http->response.chain, b->pos, chsize);
             b->pos += chsize;
+            http->received += chsize;
         }
 
         rc = (need > chsize) ? NGX_AGAIN : NGX_DONE;
@@ -1044,6 +1468,21 @@ ngx_js_http_process_body(ngx_js_http_t *http)
         }
     }
 
+    if (http->response.stream != NULL && chsize > 0) {
+        if (http->stream_handler(http, NGX_JS_HTTP_STREAM_DATA) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        ngx_js_http_pipe_notify(http);
+
+        if (njs_chb_size(&http->response.chain) >= http->buffer_size) {
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                           "js http stream paused");
+
+            http->paused = 1;
+        }
+    }
+
     return rc;
 }
 
@@ -1742,57 +2181,565 @@ ngx_js_check_header_name(u_char *name, size_t len)
 }
 
 
-static ngx_int_t
-ngx_js_http_get_keepalive_connection(ngx_js_http_t *http)
+static void
+ngx_js_http_resume(ngx_js_http_t *http)
 {
-    ngx_str_t                      *host;
-    ngx_queue_t                    *q;
-    ngx_connection_t               *c;
-    ngx_js_loc_conf_t              *conf;
-    ngx_js_http_keepalive_cache_t  *cache;
+    ngx_connection_t  *c;
 
-    if (!http->keepalive) {
-        return NGX_DECLINED;
-    }
+    c = http->peer.connection;
 
-    conf = http->conf;
+    if (!http->paused || c == NULL) {
+        return;
+    }
 
-    host = &http->host;
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js http stream resumed");
 
-    for (q = ngx_queue_head(&conf->fetch_keepalive_cache);
-         q != ngx_queue_sentinel(&conf->fetch_keepalive_cache);
-         q = ngx_queue_next(q))
+    http->paused = 0;
+
+    ngx_add_timer(c->read, http->conf->timeout);
+    ngx_post_event(c->read, &ngx_posted_events);
+}
+
+
+void
+ngx_js_http_stream_consumed(ngx_js_response_t *response)
+{
+    njs_chb_t  *chain;
+
+    chain = &response->chain;
+
+    njs_chb_destroy(chain);
+    njs_chb_init(chain, chain->pool, chain->alloc, chain->free);
+
+    if (response->stream != NULL) {
+        ngx_js_http_resume(response->stream);
+    }
+}
+
+
+void
+ngx_js_http_stream_cancel(ngx_js_http_t *http)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js http stream cancelled");
+
+    http->finished = 1;
+    http->keepalive = 0;
+
+    ngx_js_http_close_peer(http);
+}
+
+
+ngx_int_t
+ngx_js_http_coalesce(ngx_js_http_t *http, ngx_js_request_t *request,
+    ngx_resolver_t *r, ngx_str_t *host, ngx_msec_t timeout)
+{
+    u_char                *p;
+    size_t                 len;
+    uint32_t               hash;
+    ngx_str_t              key;
+    ngx_js_http_flight_t  *flight;
+
+    if (http->stream
+        || request->body.len != 0
+        || request->body_stream != NULL
+        || request->method.len != 3
+        || ngx_strncmp(request->method.data, "GET", 3) != 0)
     {
-        cache = ngx_queue_data(q, ngx_js_http_keepalive_cache_t, queue);
+        return NGX_DECLINED;
+    }
+
+    /*
+     * the flights are shared by all locations and modules of the worker,
+     * requests are joined only if they use the same configuration,
+     * connection settings and are rendered to the same bytes
+     */
+
+    len = sizeof(ngx_js_loc_conf_t *) + 2 * sizeof(ngx_int_t) + 1
+          + request->url.len + 1 + njs_chb_size(&http->chain);
+
+    if (ngx_js_http_proxy(http)) {
+        len += http->proxy.url->url.len + 1 + http->proxy.auth.len;
+    }
+
+    p = ngx_pnalloc(http->pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    key.data = p;
+
+    p = ngx_cpymem(p, &http->conf, sizeof(ngx_js_loc_conf_t *));
+    p = ngx_cpymem(p, &http->buffer_size, sizeof(ngx_int_t));
+    p = ngx_cpymem(p, &http->max_response_body_size, sizeof(ngx_int_t));
+
+#if (NGX_SSL)
+    *p++ = http->ssl_verify ? '1' : '0';
+#else
+    *p++ = '0';
+#endif
+
+    if (ngx_js_http_proxy(http)) {
+        p = ngx_cpymem(p, http->proxy.url->url.data, http->proxy.url->url.len);
+        *p++ = LF;
+        p = ngx_cpymem(p, http->proxy.auth.data, http->proxy.auth.len);
+    }
+
+    p = ngx_cpymem(p, request->url.data, request->url.len);
+    *p++ = LF;
+
+    njs_chb_join_to(&http->chain, p);
+    p += njs_chb_size(&http->chain);
+
+    key.len = p - key.data;
+
+    if (ngx_js_http_flights.root == NULL) {
+        ngx_rbtree_init(&ngx_js_http_flights, &ngx_js_http_flights_sentinel,
+                        ngx_str_rbtree_insert_value);
+    }
+
+    hash = ngx_crc32_short(key.data, key.len);
+
+    flight = (ngx_js_http_flight_t *)
+                ngx_str_rbtree_lookup(&ngx_js_http_flights, &key, hash);
+
+    if (flight != NULL) {
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js http coalesced with:%p \"%V\"",
+                       flight->leader, &request->url);
+
+        /* the request is sent only if the leader goes away */
+
+        http->resolver = r;
+        http->resolver_timeout = timeout;
+
+        if (host != NULL) {
+            http->resolve_host = *host;
+        }
+
+        http->flight = flight;
+        ngx_queue_insert_tail(&flight->waiters, &http->flight_queue);
+
+        return NGX_OK;
+    }
+
+    flight = ngx_alloc(sizeof(ngx_js_http_flight_t) + key.len, ngx_cycle->log);
+    if (flight == NULL) {
+        return NGX_ERROR;
+    }
+
+    flight->sn.node.key = hash;
+    flight->sn.str.len = key.len;
+    flight->sn.str.data = (u_char *) flight + sizeof(ngx_js_http_flight_t);
+    ngx_memcpy(flight->sn.str.data, key.data, key.len);
+
+    flight->leader = http;
+    ngx_queue_init(&flight->waiters);
+
+    ngx_rbtree_insert(&ngx_js_http_flights, &flight->sn.node);
+
+    http->flight = flight;
+
+    return NGX_DECLINED;
+}
+
+
+void
+ngx_js_http_coalesce_leave(ngx_js_http_t *http)
+{
+    ngx_queue_t           *q;
+    ngx_js_http_t         *waiter;
+    ngx_js_http_flight_t  *flight;
+
+    flight = http->flight;
+
+    if (flight == NULL) {
+        return;
+    }
+
+    http->flight = NULL;
+
+    if (http->flight_event.posted) {
+        ngx_delete_posted_event(&http->flight_event);
+    }
+
+    if (flight->leader != http) {
+        ngx_queue_remove(&http->flight_queue);
+        return;
+    }
+
+    if (ngx_queue_empty(&flight->waiters)) {
+        ngx_rbtree_delete(&ngx_js_http_flights, &flight->sn.node);
+        ngx_free(flight);
+        return;
+    }
+
+    /*
+     * the first waiter sends its own request instead,
+     * it is started from a posted event as the leader
+     * may be destroyed together with the waiter's VM
+     */
+
+    q = ngx_queue_head(&flight->waiters);
+    ngx_queue_remove(q);
+
+    waiter = ngx_queue_data(q, ngx_js_http_t, flight_queue);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js http coalesced leader:%p replaced by:%p",
+                   http, waiter);
+
+    flight->leader = waiter;
+
+    waiter->flight_event.handler = ngx_js_http_flight_start;
+    waiter->flight_event.data = waiter;
+    waiter->flight_event.log = waiter->log;
+
+    ngx_post_event(&waiter->flight_event, &ngx_posted_events);
+}
+
+
+static void
+ngx_js_http_flight_start(ngx_event_t *ev)
+{
+    ngx_js_http_start(ev->data);
+}
+
+
+static void
+ngx_js_http_start(ngx_js_http_t *http)
+{
+    ngx_int_t  rc;
+
+    if (http->resolve_host.len == 0) {
+        ngx_js_http_connect(http);
+        return;
+    }
+
+    rc = ngx_js_http_resolve(http, http->resolver, &http->resolve_host,
+                             http->resolver_timeout);
+
+    if (rc == NGX_ERROR) {
+        ngx_js_http_error(http, "memory error");
+        return;
+    }
+
+    if (rc == NGX_DECLINED) {
+        ngx_js_http_error(http, "no resolver defined");
+    }
+}
+
+
+static void
+ngx_js_http_flight_done(ngx_js_http_t *http, const char *err)
+{
+    ngx_queue_t           *q;
+    ngx_js_http_t         *waiter;
+    ngx_js_http_flight_t  *flight;
+
+    flight = http->flight;
+    http->flight = NULL;
+
+    ngx_rbtree_delete(&ngx_js_http_flights, &flight->sn.node);
+
+    /*
+     * a waiter is detached before its handler is called,
+     * the handler may destroy it or leave the flight
+     */
 
-        if (host->len != cache->host_len) {
+    while (!ngx_queue_empty(&flight->waiters)) {
+        q = ngx_queue_head(&flight->waiters);
+        ngx_queue_remove(q);
+
+        waiter = ngx_queue_data(q, ngx_js_http_t, flight_queue);
+        waiter->flight = NULL;
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js http coalesced done:%p waiter:%p", http, waiter);
+
+        if (err != NULL) {
+            waiter->error_handler(waiter, err);
             continue;
         }
 
-#if (NGX_SSL)
-        if ((http->ssl != NULL) != (cache->ssl != 0)) {
+        if (ngx_js_http_flight_response(waiter, &http->response) != NGX_OK) {
+            waiter->error_handler(waiter, "memory error");
             continue;
         }
-#endif
 
-        if (ngx_strncasecmp(host->data, cache->host, host->len) != 0) {
+        waiter->ready_handler(waiter);
+    }
+
+    ngx_free(flight);
+}
+
+
+static ngx_int_t
+ngx_js_http_flight_response(ngx_js_http_t *http, ngx_js_response_t *response)
+{
+    ngx_int_t         rc;
+    ngx_uint_t        i;
+    njs_chb_node_t   *n;
+    ngx_list_part_t  *part;
+    ngx_js_tb_elt_t  *h;
+
+    http->response.code = response->code;
+    http->response.status_text.len = response->status_text.len;
+    http->response.status_text.data = ngx_pstrdup(http->pool,
+                                                  &response->status_text);
+    if (http->response.status_text.data == NULL) {
+        return NGX_ERROR;
+    }
+
+    rc = ngx_list_init(&http->response.headers.header_list, http->pool, 4,
+                       sizeof(ngx_js_tb_elt_t));
+    if (rc != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    http->response.headers.guard = GUARD_NONE;
+    http->response.headers.content_type = NULL;
+
+    part = &response->headers.header_list.part;
+    h = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (h[i].hash == 0) {
             continue;
         }
 
-        if (http->port != cache->port) {
+        rc = http->append_headers(http, &http->response.headers,
+                                  h[i].key.data, h[i].key.len,
+                                  h[i].value.data, h[i].value.len);
+        if (rc != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    http->response.headers.guard = GUARD_IMMUTABLE;
+
+    for (n = response->chain.nodes; n != NULL; n = n->next) {
+        njs_chb_append(&http->response.chain, n->start, njs_chb_node_size(n));
+    }
+
+    if (njs_chb_size(&http->response.chain) < 0) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+void
+ngx_js_http_batch_init(ngx_js_http_batch_t *batch, ngx_log_t *log,
+    ngx_uint_t connections)
+{
+    ngx_queue_init(&batch->members);
+
+    batch->active = 0;
+    batch->connections = connections;
+
+    batch->event.handler = ngx_js_http_batch_handler;
+    batch->event.data = batch;
+    batch->event.log = log;
+
+    batch->timer.handler = ngx_js_http_batch_timeout_handler;
+    batch->timer.data = batch;
+    batch->timer.log = log;
+}
+
+
+void
+ngx_js_http_batch_add(ngx_js_http_batch_t *batch, ngx_js_http_t *http,
+    ngx_resolver_t *r, ngx_str_t *host, ngx_msec_t timeout)
+{
+    http->resolver = r;
+    http->resolver_timeout = timeout;
+
+    if (host != NULL) {
+        http->resolve_host = *host;
+    }
+
+    http->batch = batch;
+    http->batch_pending = 1;
+
+    ngx_queue_insert_tail(&batch->members, &http->batch_queue);
+}
+
+
+void
+ngx_js_http_batch_run(ngx_js_http_batch_t *batch, ngx_msec_t timeout)
+{
+    if (ngx_queue_empty(&batch->members)) {
+        return;
+    }
+
+    if (timeout != 0) {
+        ngx_add_timer(&batch->timer, timeout);
+    }
+
+    ngx_post_event(&batch->event, &ngx_posted_events);
+}
+
+
+static void
+ngx_js_http_batch_leave(ngx_js_http_t *http)
+{
+    ngx_js_http_batch_t  *batch;
+
+    batch = http->batch;
+
+    if (batch == NULL) {
+        return;
+    }
+
+    http->batch = NULL;
+    ngx_queue_remove(&http->batch_queue);
+
+    if (http->batch_pending) {
+        http->batch_pending = 0;
+
+    } else {
+        batch->active--;
+    }
+
+    if (ngx_queue_empty(&batch->members)) {
+        if (batch->timer.timer_set) {
+            ngx_del_timer(&batch->timer);
+        }
+
+        if (batch->timer.posted) {
+            ngx_delete_posted_event(&batch->timer);
+        }
+
+        if (batch->event.posted) {
+            ngx_delete_posted_event(&batch->event);
+        }
+
+        return;
+    }
+
+    if (!batch->timer.timedout && !batch->event.posted) {
+        ngx_post_event(&batch->event, &ngx_posted_events);
+    }
+}
+
+
+static void
+ngx_js_http_batch_handler(ngx_event_t *ev)
+{
+    ngx_queue_t          *q;
+    ngx_js_http_t        *http;
+    ngx_js_http_batch_t  *batch;
+
+    batch = ev->data;
+
+    if (batch->active >= batch->connections) {
+        return;
+    }
+
+    /*
+     * one request is started at a time, its failure may finalize
+     * the request which owns the batch
+     */
+
+    for (q = ngx_queue_head(&batch->members);
+         q != ngx_queue_sentinel(&batch->members);
+         q = ngx_queue_next(q))
+    {
+        http = ngx_queue_data(q, ngx_js_http_t, batch_queue);
+
+        if (!http->batch_pending) {
             continue;
         }
 
-        c = cache->connection;
-        ngx_queue_remove(q);
-        ngx_queue_insert_head(&conf->fetch_keepalive_free, q);
+        http->batch_pending = 0;
+        batch->active++;
+
+        if (batch->active < batch->connections
+            && ngx_queue_next(q) != ngx_queue_sentinel(&batch->members))
+        {
+            ngx_post_event(ev, &ngx_posted_events);
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js http batch start:%p active:%ui",
+                       http, batch->active);
 
-        goto found;
+        ngx_js_http_start(http);
+
+        return;
     }
+}
 
-    return NGX_DECLINED;
 
-found:
+static void
+ngx_js_http_batch_timeout_handler(ngx_event_t *ev)
+{
+    ngx_queue_t          *q;
+    ngx_js_http_t        *http;
+    ngx_js_http_batch_t  *batch;
+
+    batch = ev->data;
+
+    q = ngx_queue_head(&batch->members);
+    http = ngx_queue_data(q, ngx_js_http_t, batch_queue);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "js http batch timed out:%p", http);
+
+    /* the remaining members are failed by the posted timer */
+
+    ngx_js_http_batch_leave(http);
+
+    if (!ngx_queue_empty(&batch->members)) {
+        ngx_post_event(ev, &ngx_posted_events);
+    }
+
+    ngx_js_http_error(http, "fetch batch timed out");
+}
+
+
+static ngx_int_t
+ngx_js_http_get_keepalive_connection(ngx_js_http_t *http)
+{
+    ngx_queue_t                    *q;
+    ngx_connection_t               *c;
+    ngx_js_loc_conf_t              *conf;
+    ngx_js_http_keepalive_cache_t  *cache;
+
+    if (!http->keepalive
+        || http->dest == NULL
+        || ngx_queue_empty(&http->dest->cache))
+    {
+        return NGX_DECLINED;
+    }
+
+    conf = http->conf;
+
+    /* the most recently used connection to the destination */
+
+    q = ngx_queue_head(&http->dest->cache);
+    ngx_queue_remove(q);
+
+    cache = ngx_queue_data(q, ngx_js_http_keepalive_cache_t, dest_queue);
+
+    ngx_queue_remove(&cache->queue);
+    ngx_queue_insert_head(&conf->fetch_keepalive_free, &cache->queue);
+
+    c = cache->connection;
 
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
                    "js http keepalive using cached connection: %p:%d",
@@ -1832,6 +2779,7 @@ ngx_js_http_free_keepalive_connection(ngx_js_http_t *http)
     c = http->peer.connection;
 
     if (c == NULL
+        || http->dest == NULL
         || c->read->eof
         || c->read->error
         || c->read->timedout
@@ -1890,6 +2838,9 @@ ngx_js_http_free_keepalive_connection(ngx_js_http_t *http)
                        cache->connection->fd);
         ngx_js_http_close_connection(cache->connection);
 
+        ngx_queue_remove(&cache->dest_queue);
+        ngx_js_http_dest_free(cache->dest);
+
     } else {
         q = ngx_queue_head(&conf->fetch_keepalive_free);
         ngx_queue_remove(q);
@@ -1902,13 +2853,9 @@ ngx_js_http_free_keepalive_connection(ngx_js_http_t *http)
     http->peer.connection = NULL;
 
     cache->connection = c;
+    cache->dest = http->dest;
 
-#if (NGX_SSL)
-    cache->ssl = (http->ssl != NULL);
-#endif
-    ngx_memcpy(cache->host, http->host.data, http->host.len);
-    cache->host_len = http->host.len;
-    cache->port = http->port;
+    ngx_queue_insert_head(&http->dest->cache, &cache->dest_queue);
 
     c->read->delayed = 0;
     ngx_add_timer(c->read, conf->fetch_keepalive_timeout);
@@ -1982,6 +2929,222 @@ close:
 
     ngx_queue_remove(&cache->queue);
     ngx_queue_insert_head(&conf->fetch_keepalive_free, &cache->queue);
+
+    ngx_queue_remove(&cache->dest_queue);
+    ngx_js_http_dest_free(cache->dest);
+}
+
+
+static ngx_int_t
+ngx_js_http_dest_acquire(ngx_js_http_t *http)
+{
+    ngx_js_loc_conf_t   *conf;
+    ngx_js_http_dest_t  *dest;
+
+    conf = http->conf;
+
+    if (!http->keepalive && conf->fetch_max_conns == 0) {
+        return NGX_OK;
+    }
+
+    if (http->dest_active) {
+        /* the next address is tried, the slot is already held */
+        return NGX_OK;
+    }
+
+    if (http->dest == NULL) {
+        http->dest = ngx_js_http_dest_lookup(http);
+        if (http->dest == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    dest = http->dest;
+
+    if (conf->fetch_max_conns != 0 && dest->active >= conf->fetch_max_conns) {
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js http waiting for connection to \"%V\", "
+                       "active:%ui", &dest->sn.str, dest->active);
+
+        http->dest_waiting = 1;
+        ngx_queue_insert_tail(&dest->waiting, &http->dest_queue);
+
+        http->dest_event.handler = ngx_js_http_dest_wait_handler;
+        http->dest_event.data = http;
+        http->dest_event.log = http->log;
+
+        ngx_add_timer(&http->dest_event, conf->timeout);
+
+        return NGX_BUSY;
+    }
+
+    http->dest_active = 1;
+    dest->active++;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_js_http_dest_release(ngx_js_http_t *http)
+{
+    ngx_queue_t         *q;
+    ngx_js_http_t       *next;
+    ngx_js_http_dest_t  *dest;
+
+    /*
+     * a woken waiter has no "dest" but its event is posted,
+     * so the event is removed before the check below
+     */
+
+    if (http->dest_event.timer_set) {
+        ngx_del_timer(&http->dest_event);
+    }
+
+    if (http->dest_event.posted) {
+        ngx_delete_posted_event(&http->dest_event);
+    }
+
+    dest = http->dest;
+
+    if (dest == NULL) {
+        return;
+    }
+
+    http->dest = NULL;
+
+    if (http->dest_waiting) {
+        http->dest_waiting = 0;
+        ngx_queue_remove(&http->dest_queue);
+    }
+
+    if (http->dest_active) {
+        http->dest_active = 0;
+        dest->active--;
+
+        if (!ngx_queue_empty(&dest->waiting)) {
+            q = ngx_queue_head(&dest->waiting);
+            ngx_queue_remove(q);
+
+            next = ngx_queue_data(q, ngx_js_http_t, dest_queue);
+
+            /* the connection is retried from a posted event */
+
+            next->dest = NULL;
+            next->dest_waiting = 0;
+
+            ngx_del_timer(&next->dest_event);
+            ngx_post_event(&next->dest_event, &ngx_posted_events);
+        }
+    }
+
+    ngx_js_http_dest_free(dest);
+}
+
+
+static void
+ngx_js_http_dest_wait_handler(ngx_event_t *ev)
+{
+    ngx_js_http_t  *http;
+
+    http = ev->data;
+
+    if (ev->timedout) {
+        ngx_js_http_dest_release(http);
+        ngx_js_http_error(http, "connection wait timed out");
+        return;
+    }
+
+    ngx_js_http_connect(http);
+}
+
+
+static ngx_js_http_dest_t *
+ngx_js_http_dest_lookup(ngx_js_http_t *http)
+{
+    u_char              *p;
+    size_t               len;
+    uint32_t             hash;
+    ngx_str_t            key;
+    ngx_url_t           *proxy;
+    ngx_js_loc_conf_t   *conf;
+    ngx_js_http_dest_t  *dest;
+
+    conf = http->conf;
+    proxy = http->proxy.url;
+
+    /* "[s:]host:port[ proxy:port]" */
+
+    len = 2 + http->host.len + 1 + NGX_INT_T_LEN;
+
+    if (proxy != NULL) {
+        len += 1 + proxy->host.len + 1 + NGX_INT_T_LEN;
+    }
+
+    p = ngx_pnalloc(http->pool, len);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    key.data = p;
+
+#if (NGX_SSL)
+    if (http->ssl != NULL) {
+        p = ngx_cpymem(p, "s:", 2);
+    }
+#endif
+
+    p = ngx_sprintf(p, "%V:%ui", &http->host, (ngx_uint_t) http->port);
+
+    if (proxy != NULL) {
+        p = ngx_sprintf(p, " %V:%ui", &proxy->host, (ngx_uint_t) proxy->port);
+    }
+
+    key.len = p - key.data;
+
+    ngx_strlow(key.data, key.data, key.len);
+
+    hash = ngx_crc32_short(key.data, key.len);
+
+    dest = (ngx_js_http_dest_t *) ngx_str_rbtree_lookup(&conf->fetch_hosts,
+                                                        &key, hash);
+    if (dest != NULL) {
+        return dest;
+    }
+
+    dest = ngx_alloc(sizeof(ngx_js_http_dest_t) + key.len, http->log);
+    if (dest == NULL) {
+        return NULL;
+    }
+
+    dest->sn.node.key = hash;
+    dest->sn.str.len = key.len;
+    dest->sn.str.data = (u_char *) dest + sizeof(ngx_js_http_dest_t);
+    ngx_memcpy(dest->sn.str.data, key.data, key.len);
+
+    dest->conf = conf;
+    dest->active = 0;
+    ngx_queue_init(&dest->cache);
+    ngx_queue_init(&dest->waiting);
+
+    ngx_rbtree_insert(&conf->fetch_hosts, &dest->sn.node);
+
+    return dest;
+}
+
+
+static void
+ngx_js_http_dest_free(ngx_js_http_dest_t *dest)
+{
+    if (dest->active != 0
+        || !ngx_queue_empty(&dest->cache)
+        || !ngx_queue_empty(&dest->waiting))
+    {
+        return;
+    }
+
+    ngx_rbtree_delete(&dest->conf->fetch_hosts, &dest->sn.node);
+    ngx_free(dest);
 }
 
 
@@ -2055,6 +3218,13 @@ ngx_js_fetch_append_request_headers(njs_chb_t *chain,
             continue;
         }
 
+        if (h[i].key.len == 17
+            && ngx_strncasecmp(h[i].key.data, (u_char *) "Transfer-Encoding",
+                               17) == 0)
+        {
+            continue;
+        }
+
         if (is_proxy && h[i].key.len == 19
             && ngx_strncasecmp(h[i].key.data, (u_char *) "Proxy-Authorization",
                                19) == 0)
@@ -2170,10 +3340,34 @@ ngx_js_fetch_build_request(ngx_js_http_t *http, ngx_js_request_t *request,
         njs_chb_append_literal(&http->chain, "Connection: close" CRLF);
     }
 
-    if (request->body.len != 0) {
+    if (http->cache_etag.len != 0) {
+        njs_chb_append_literal(&http->chain, "If-None-Match: ");
+        njs_chb_append(&http->chain, http->cache_etag.data,
+                       http->cache_etag.len);
+        njs_chb_append_literal(&http->chain, CRLF);
+    }
+
+    if (http->cache_last_modified.len != 0) {
+        njs_chb_append_literal(&http->chain, "If-Modified-Since: ");
+        njs_chb_append(&http->chain, http->cache_last_modified.data,
+                       http->cache_last_modified.len);
+        njs_chb_append_literal(&http->chain, CRLF);
+    }
+
+    if (request->body_stream != NULL) {
+        njs_chb_append_literal(&http->chain,
+                               "Transfer-Encoding: chunked" CRLF CRLF);
+
+        http->source = request->body_stream;
+        http->source->pipe = http;
+
+    } else if (request->body.len != 0) {
         njs_chb_sprintf(&http->chain, 32, "Content-Length: %uz" CRLF CRLF,
                         request->body.len);
-        njs_chb_append(&http->chain, request->body.data, request->body.len);
+
+        /* the body is sent by ngx_js_http_write_handler() without copying */
+
+        http->body = request->body;
 
     } else {
         method = request->method;
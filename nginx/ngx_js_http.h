@@ -15,10 +15,15 @@
 #define NGX_JS_HTTP_DEFAULT_PORT   80
 #define NGX_JS_HTTPS_DEFAULT_PORT  443
 
+#define NGX_JS_HTTP_BATCH_CONNECTIONS  4
+
 #define ngx_js_https(u) ((u)->default_port == NGX_JS_HTTPS_DEFAULT_PORT)
 
 
 typedef struct ngx_js_http_s  ngx_js_http_t;
+typedef struct ngx_js_http_flight_s  ngx_js_http_flight_t;
+typedef struct ngx_js_http_dest_s  ngx_js_http_dest_t;
+typedef struct ngx_js_http_batch_s  ngx_js_http_batch_t;
 
 typedef struct {
     ngx_uint_t                     state;
@@ -93,6 +98,7 @@ typedef struct {
     u_char                         m[8];
     uint8_t                        body_used;
     ngx_str_t                      body;
+    ngx_js_http_t                 *body_stream;
     ngx_js_headers_t               headers;
     njs_opaque_value_t             header_value;
 } ngx_js_request_t;
@@ -106,9 +112,30 @@ typedef struct {
     njs_chb_t                      chain;
     ngx_js_headers_t               headers;
     njs_opaque_value_t             header_value;
+    ngx_js_http_t                 *stream;
 } ngx_js_response_t;
 
 
+/*
+ * a batch of requests started by fetchAll(): at most "connections"
+ * of the "members" are sent at once, the rest wait for a connection
+ * to be released and reuse it if it is kept alive.
+ */
+
+struct ngx_js_http_batch_s {
+    ngx_queue_t                    members;
+    ngx_uint_t                     active;
+    ngx_uint_t                     connections;
+    ngx_event_t                    event;
+    ngx_event_t                    timer;
+};
+
+
+#define NGX_JS_HTTP_STREAM_HEADERS  0
+#define NGX_JS_HTTP_STREAM_DATA     1
+#define NGX_JS_HTTP_STREAM_LAST     2
+
+
 struct ngx_js_http_s {
     ngx_log_t                     *log;
     ngx_pool_t                    *pool;
@@ -123,6 +150,9 @@ struct ngx_js_http_s {
     in_port_t                      connect_port;
 
     ngx_peer_connection_t          peer;
+    ngx_js_http_dest_t            *dest;
+    ngx_queue_t                    dest_queue;
+    ngx_event_t                    dest_event;
 
     ngx_js_loc_conf_t             *conf;
     ngx_int_t                      buffer_size;
@@ -130,9 +160,60 @@ struct ngx_js_http_s {
 
     unsigned                       header_only;
 
+    /*
+     * stream: the response is handed over to JS once the headers
+     * are parsed, the body is passed by stream_handler() as it arrives;
+     * paused: more than buffer_size bytes are waiting to be read by JS,
+     * reading from the peer is suspended until ngx_js_http_resume();
+     * finished: the body is fully received, failed or cancelled.
+     */
+
+    unsigned                       stream:1;
+    unsigned                       paused:1;
+    unsigned                       finished:1;
+
+    /*
+     * sending_body: the request headers are sent, the body is being sent
+     * from "out";
+     * body_waiting: the body stream "source" has no data yet, the write
+     * event is posted by the source once it receives more;
+     * body_sent: the last chunk of the body stream is prepared.
+     */
+
+    unsigned                       sending_body:1;
+    unsigned                       body_waiting:1;
+    unsigned                       body_sent:1;
+
+    /*
+     * coalesce: an identical GET request already in flight in this
+     * worker is joined instead of sending a new one, the "flight" leader
+     * passes its response to all waiters.
+     */
+
+    unsigned                       coalesce:1;
+
+    /*
+     * dest_active: the request holds one of js_fetch_max_conns
+     * connections to "dest";
+     * dest_waiting: the limit is reached, the request waits in "dest"
+     * until a connection is released.
+     */
+
+    unsigned                       dest_active:1;
+    unsigned                       dest_waiting:1;
+
+    /*
+     * batch_pending: the request is a member of "batch" and is not
+     * sent yet.
+     */
+
+    unsigned                       batch_pending:1;
+
     ngx_flag_t                     chunked;
     ngx_flag_t                     keepalive;
     off_t                          content_length_n;
+    off_t                          received;
+    ngx_str_t                      error;
 
 #if (NGX_SSL)
     ngx_ssl_t                     *ssl;
@@ -143,6 +224,26 @@ struct ngx_js_http_s {
     ngx_buf_t                     *chunk;
     njs_chb_t                      chain;
 
+    ngx_str_t                      body;
+    ngx_buf_t                     *out;
+    ngx_js_http_t                 *source;
+    ngx_js_http_t                 *pipe;
+
+    ngx_shm_zone_t                *cache;
+    ngx_str_t                      cache_key;
+    ngx_str_t                      cache_etag;
+    ngx_str_t                      cache_last_modified;
+
+    ngx_js_http_flight_t          *flight;
+    ngx_queue_t                    flight_queue;
+    ngx_event_t                    flight_event;
+    ngx_resolver_t                *resolver;
+    ngx_msec_t                     resolver_timeout;
+    ngx_str_t                      resolve_host;
+
+    ngx_js_http_batch_t           *batch;
+    ngx_queue_t                    batch_queue;
+
     ngx_js_response_t              response;
 
     uint8_t                        done;
@@ -156,6 +257,8 @@ struct ngx_js_http_s {
     void                         (*ready_handler)(ngx_js_http_t *http);
     void                         (*error_handler)(ngx_js_http_t *http,
                                                   const char *err);
+    ngx_int_t                    (*stream_handler)(ngx_js_http_t *http,
+                                                   ngx_uint_t event);
 
     struct {
         enum {
@@ -173,19 +276,42 @@ struct ngx_js_http_s {
 };
 
 
-ngx_resolver_ctx_t *ngx_js_http_resolve(ngx_js_http_t *http, ngx_resolver_t *r,
+ngx_int_t ngx_js_http_resolve(ngx_js_http_t *http, ngx_resolver_t *r,
     ngx_str_t *host, ngx_msec_t timeout);
+ngx_int_t ngx_js_http_set_addrs(ngx_js_http_t *http,
+    ngx_resolver_addr_t *addrs, ngx_uint_t naddrs);
 void ngx_js_http_connect(ngx_js_http_t *http);
 void ngx_js_http_resolve_done(ngx_js_http_t *http);
 void ngx_js_http_close_peer(ngx_js_http_t *http);
 void ngx_js_http_trim(u_char **value, size_t *len,
     int trim_c0_control_or_space);
 ngx_int_t ngx_js_check_header_name(u_char *name, size_t len);
+void ngx_js_http_stream_consumed(ngx_js_response_t *response);
+void ngx_js_http_stream_cancel(ngx_js_http_t *http);
+ngx_int_t ngx_js_http_coalesce(ngx_js_http_t *http, ngx_js_request_t *request,
+    ngx_resolver_t *r, ngx_str_t *host, ngx_msec_t timeout);
+void ngx_js_http_coalesce_leave(ngx_js_http_t *http);
+void ngx_js_http_batch_init(ngx_js_http_batch_t *batch, ngx_log_t *log,
+    ngx_uint_t connections);
+void ngx_js_http_batch_add(ngx_js_http_batch_t *batch, ngx_js_http_t *http,
+    ngx_resolver_t *r, ngx_str_t *host, ngx_msec_t timeout);
+void ngx_js_http_batch_run(ngx_js_http_batch_t *batch, ngx_msec_t timeout);
 
 ngx_buf_t *ngx_js_chain_to_buf(ngx_pool_t *pool, njs_chb_t *chain);
 
 void ngx_js_fetch_build_request(ngx_js_http_t *http, ngx_js_request_t *request,
     ngx_str_t *path, ngx_url_t *u, njs_bool_t is_proxy);
 
+ngx_int_t ngx_js_fetch_cache_lookup(ngx_js_http_t *http,
+    ngx_js_request_t *request);
+ngx_int_t ngx_js_fetch_cache_key(ngx_js_http_t *http,
+    ngx_js_request_t *request);
+
+ngx_int_t ngx_js_resolver_cache_lookup(ngx_js_http_t *http, ngx_resolver_t *r,
+    ngx_str_t *host, ngx_msec_t timeout);
+void ngx_js_resolver_cache_update(ngx_js_resolver_cache_t *cache,
+    ngx_resolver_ctx_t *ctx);
+void ngx_js_fetch_cache_update(ngx_js_http_t *http);
+
 
 #endif /* _NGX_JS_HTTP_H_INCLUDED_ */
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) Dmitry Volyntsev
+ * Copyright (C) NGINX, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include "ngx_js.h"
+#include "ngx_js_http.h"
+
+
+struct ngx_js_resolver_cache_s {
+    ngx_rbtree_t                  rbtree;
+    ngx_rbtree_node_t             sentinel;
+    ngx_queue_t                   lru;
+    ngx_uint_t                    count;
+
+    ngx_uint_t                    size;
+    time_t                        valid;
+    time_t                        stale;
+    time_t                        negative;
+};
+
+
+/*
+ * naddrs: 0 for a negative entry;
+ * ctx: the stale entry is being refreshed.
+ */
+
+typedef struct {
+    ngx_str_node_t                sn;
+    ngx_queue_t                   queue;
+    ngx_js_resolver_cache_t      *cache;
+    ngx_resolver_ctx_t           *ctx;
+    time_t                        expires;
+    ngx_uint_t                    naddrs;
+    ngx_resolver_addr_t          *addrs;
+} ngx_js_resolver_cache_node_t;
+
+
+static ngx_js_resolver_cache_node_t *ngx_js_resolver_cache_find(
+    ngx_js_resolver_cache_t *cache, ngx_str_t *name);
+static ngx_js_resolver_cache_node_t *ngx_js_resolver_cache_create(
+    ngx_js_resolver_cache_t *cache, ngx_str_t *name);
+static void ngx_js_resolver_cache_delete(ngx_js_resolver_cache_node_t *node);
+static ngx_int_t ngx_js_resolver_cache_set(ngx_js_resolver_cache_node_t *node,
+    ngx_resolver_ctx_t *ctx);
+static void ngx_js_resolver_cache_refresh(ngx_js_resolver_cache_node_t *node,
+    ngx_resolver_t *r, ngx_msec_t timeout);
+static void ngx_js_resolver_cache_refresh_handler(ngx_resolver_ctx_t *ctx);
+
+
+ngx_int_t
+ngx_js_resolver_cache_lookup(ngx_js_http_t *http, ngx_resolver_t *r,
+    ngx_str_t *host, ngx_msec_t timeout)
+{
+    time_t                         now;
+    ngx_js_resolver_cache_t       *cache;
+    ngx_js_resolver_cache_node_t  *node;
+
+    cache = http->conf->fetch_resolver_cache;
+
+    node = ngx_js_resolver_cache_find(cache, host);
+    if (node == NULL) {
+        return NGX_DECLINED;
+    }
+
+    now = ngx_time();
+
+    if (node->naddrs == 0) {
+        if (now < node->expires) {
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                           "js resolver cache negative: \"%V\"", host);
+            return NGX_ABORT;
+        }
+
+        ngx_js_resolver_cache_delete(node);
+        return NGX_DECLINED;
+    }
+
+    if (now >= node->expires) {
+        if (now >= node->expires + cache->stale) {
+            ngx_js_resolver_cache_delete(node);
+            return NGX_DECLINED;
+        }
+
+        /* the stale addresses are used while the name is resolved again */
+
+        if (node->ctx == NULL) {
+            ngx_js_resolver_cache_refresh(node, r, timeout);
+        }
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js resolver cache hit: \"%V\" naddrs:%ui",
+                   host, node->naddrs);
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&cache->lru, &node->queue);
+
+    return ngx_js_http_set_addrs(http, node->addrs, node->naddrs);
+}
+
+
+void
+ngx_js_resolver_cache_update(ngx_js_resolver_cache_t *cache,
+    ngx_resolver_ctx_t *ctx)
+{
+    ngx_js_resolver_cache_node_t  *node;
+
+    /* only definite answers are cached */
+
+    if (ctx->state != NGX_OK
+        && (ctx->state != NGX_RESOLVE_NXDOMAIN || cache->negative == 0))
+    {
+        return;
+    }
+
+    node = ngx_js_resolver_cache_find(cache, &ctx->name);
+
+    if (node == NULL) {
+        node = ngx_js_resolver_cache_create(cache, &ctx->name);
+        if (node == NULL) {
+            return;
+        }
+    }
+
+    if (ctx->state == NGX_OK) {
+        if (ngx_js_resolver_cache_set(node, ctx) != NGX_OK) {
+            ngx_js_resolver_cache_delete(node);
+        }
+
+        return;
+    }
+
+    if (node->addrs != NULL) {
+        ngx_free(node->addrs);
+        node->addrs = NULL;
+    }
+
+    node->naddrs = 0;
+    node->expires = ngx_time() + cache->negative;
+}
+
+
+static ngx_js_resolver_cache_node_t *
+ngx_js_resolver_cache_find(ngx_js_resolver_cache_t *cache, ngx_str_t *name)
+{
+    uint32_t   hash;
+    ngx_str_t  key;
+    u_char     buf[NGX_JS_HOST_MAX_LEN];
+
+    if (name->len > NGX_JS_HOST_MAX_LEN) {
+        return NULL;
+    }
+
+    ngx_strlow(buf, name->data, name->len);
+
+    key.data = buf;
+    key.len = name->len;
+
+    hash = ngx_crc32_short(key.data, key.len);
+
+    return (ngx_js_resolver_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->rbtree, &key, hash);
+}
+
+
+static ngx_js_resolver_cache_node_t *
+ngx_js_resolver_cache_create(ngx_js_resolver_cache_t *cache, ngx_str_t *name)
+{
+    ngx_queue_t                   *q;
+    ngx_js_resolver_cache_node_t  *node;
+
+    if (name->len > NGX_JS_HOST_MAX_LEN) {
+        return NULL;
+    }
+
+    if (cache->count >= cache->size) {
+        q = ngx_queue_last(&cache->lru);
+        node = ngx_queue_data(q, ngx_js_resolver_cache_node_t, queue);
+
+        ngx_js_resolver_cache_delete(node);
+    }
+
+    node = ngx_alloc(sizeof(ngx_js_resolver_cache_node_t) + name->len,
+                     ngx_cycle->log);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    node->sn.str.len = name->len;
+    node->sn.str.data = (u_char *) node + sizeof(ngx_js_resolver_cache_node_t);
+    ngx_strlow(node->sn.str.data, name->data, name->len);
+
+    node->sn.node.key = ngx_crc32_short(node->sn.str.data, node->sn.str.len);
+
+    node->cache = cache;
+    node->ctx = NULL;
+    node->expires = 0;
+    node->naddrs = 0;
+    node->addrs = NULL;
+
+    ngx_rbtree_insert(&cache->rbtree, &node->sn.node);
+    ngx_queue_insert_head(&cache->lru, &node->queue);
+
+    cache->count++;
+
+    return node;
+}
+
+
+static void
+ngx_js_resolver_cache_delete(ngx_js_resolver_cache_node_t *node)
+{
+    ngx_js_resolver_cache_t  *cache;
+
+    cache = node->cache;
+
+    if (node->ctx != NULL) {
+        ngx_resolve_name_done(node->ctx);
+    }
+
+    ngx_queue_remove(&node->queue);
+    ngx_rbtree_delete(&cache->rbtree, &node->sn.node);
+
+    cache->count--;
+
+    if (node->addrs != NULL) {
+        ngx_free(node->addrs);
+    }
+
+    ngx_free(node);
+}
+
+
+static ngx_int_t
+ngx_js_resolver_cache_set(ngx_js_resolver_cache_node_t *node,
+    ngx_resolver_ctx_t *ctx)
+{
+    u_char               *p;
+    ngx_uint_t            i;
+    ngx_resolver_addr_t  *addrs;
+
+    if (ctx->naddrs == 0) {
+        return NGX_ERROR;
+    }
+
+    addrs = ngx_alloc(ctx->naddrs
+                      * (sizeof(ngx_resolver_addr_t) + sizeof(ngx_sockaddr_t)),
+                      ngx_cycle->log);
+    if (addrs == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = (u_char *) &addrs[ctx->naddrs];
+
+    for (i = 0; i < ctx->naddrs; i++) {
+        ngx_memzero(&addrs[i], sizeof(ngx_resolver_addr_t));
+
+        addrs[i].sockaddr = (struct sockaddr *) p;
+        addrs[i].socklen = ctx->addrs[i].socklen;
+
+        ngx_memcpy(p, ctx->addrs[i].sockaddr, ctx->addrs[i].socklen);
+
+        p += sizeof(ngx_sockaddr_t);
+    }
+
+    if (node->addrs != NULL) {
+        ngx_free(node->addrs);
+    }
+
+    node->addrs = addrs;
+    node->naddrs = ctx->naddrs;
+    node->expires = ngx_time() + node->cache->valid;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_js_resolver_cache_refresh(ngx_js_resolver_cache_node_t *node,
+    ngx_resolver_t *r, ngx_msec_t timeout)
+{
+    ngx_resolver_ctx_t  *ctx;
+
+    ctx = ngx_resolve_start(r, NULL);
+    if (ctx == NULL || ctx == NGX_NO_RESOLVER) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
+                   "js resolver cache refresh: \"%V\"", &node->sn.str);
+
+    node->ctx = ctx;
+
+    ctx->name = node->sn.str;
+    ctx->handler = ngx_js_resolver_cache_refresh_handler;
+    ctx->data = node;
+    ctx->timeout = timeout;
+
+    if (ngx_resolve_name(ctx) != NGX_OK) {
+        node->ctx = NULL;
+    }
+}
+
+
+static void
+ngx_js_resolver_cache_refresh_handler(ngx_resolver_ctx_t *ctx)
+{
+    ngx_js_resolver_cache_node_t  *node;
+
+    node = ctx->data;
+    node->ctx = NULL;
+
+    /*
+     * a failed refresh keeps the stale addresses,
+     * so fetch() survives a short resolver outage
+     */
+
+    if (ctx->state == NGX_OK) {
+        (void) ngx_js_resolver_cache_set(node, ctx);
+
+    } else {
+        ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, 0,
+                      "js resolver cache: \"%V\" could not be resolved "
+                      "(%i: %s), using stale addresses", &ctx->name,
+                      ctx->state, ngx_resolver_strerror(ctx->state));
+    }
+
+    ngx_resolve_name_done(ctx);
+}
+
+
+char *
+ngx_js_fetch_resolver_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_js_loc_conf_t *jscf = conf;
+
+    time_t                    *tp;
+    ngx_int_t                  n;
+    ngx_str_t                 *value, s;
+    ngx_uint_t                 i;
+    ngx_js_resolver_cache_t   *cache;
+
+    if (jscf->fetch_resolver_cache != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        if (cf->args->nelts != 2) {
+            return "has invalid parameters";
+        }
+
+        jscf->fetch_resolver_cache = NULL;
+        return NGX_CONF_OK;
+    }
+
+    cache = ngx_pcalloc(cf->pool, sizeof(ngx_js_resolver_cache_t));
+    if (cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    cache->size = 1024;
+    cache->valid = 30;
+    cache->stale = 30;
+    cache->negative = 5;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "size=", 5) == 0) {
+            n = ngx_atoi(value[i].data + 5, value[i].len - 5);
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            cache->size = n;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "valid=", 6) == 0) {
+            s.data = value[i].data + 6;
+            s.len = value[i].len - 6;
+            tp = &cache->valid;
+
+        } else if (ngx_strncmp(value[i].data, "stale=", 6) == 0) {
+            s.data = value[i].data + 6;
+            s.len = value[i].len - 6;
+            tp = &cache->stale;
+
+        } else if (ngx_strncmp(value[i].data, "negative=", 9) == 0) {
+            s.data = value[i].data + 9;
+            s.len = value[i].len - 9;
+            tp = &cache->negative;
+
+        } else {
+            goto invalid;
+        }
+
+        *tp = ngx_parse_time(&s, 1);
+
+        if (*tp == (time_t) NGX_ERROR) {
+            goto invalid;
+        }
+    }
+
+    ngx_rbtree_init(&cache->rbtree, &cache->sentinel,
+                    ngx_str_rbtree_insert_value);
+    ngx_queue_init(&cache->lru);
+
+    jscf->fetch_resolver_cache = cache;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
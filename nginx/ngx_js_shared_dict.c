@@ -10,17 +10,94 @@
 #include "ngx_js.h"
 #include "ngx_js_shared_dict.h"
 
+#if (NGX_THREADS)
+#include <ngx_thread_pool.h>
+#endif
+
+
+typedef struct ngx_js_dict_node_s  ngx_js_dict_node_t;
+
+
+typedef struct {
+    uint32_t               hash;
+    ngx_js_dict_node_t    *node;
+} ngx_js_dict_slot_t;
+
 
 typedef struct {
-    ngx_rbtree_t           rbtree;
-    ngx_rbtree_node_t      sentinel;
     ngx_atomic_t           rwlock;
 
+    /*
+     * The sequence counter is odd while a writer modifies the shard,
+     * readers of a single key copy the value out without taking the lock
+     * and retry under the lock if the counter changed meanwhile.
+     */
+    ngx_atomic_t           seq;
+
+    /*
+     * Keys are looked up in an open addressing hash index with linear
+     * probing.  The index size is a power of two, deleted slots are
+     * marked with NGX_JS_DICT_SLOT_DELETED until the next resize.
+     */
+    ngx_js_dict_slot_t    *slots;
+    ngx_uint_t             size;
+    ngx_uint_t             used;
+    ngx_uint_t             deleted;
+
+    /* the position of the clock hand in the index for evict=lru */
+    ngx_uint_t             hand;
+
+    /*
+     * Nodes changed and keys deleted since the last save, kept
+     * for the state journal.
+     */
+    ngx_queue_t            journal;
+    ngx_queue_t            tombstones;
+
     ngx_rbtree_t           rbtree_expire;
     ngx_rbtree_node_t      sentinel_expire;
+} ngx_js_dict_shard_t;
+
+
+/*
+ * The binary state file starts with the "NJSD" magic followed by
+ * the version, the dict type and flags as 32-bit integers in host byte
+ * order.  Each entry is the key length and the key, the value length
+ * and the value or a double, and the 64-bit expire time in timeout dicts.
+ */
+
+#define NGX_JS_DICT_BINARY_MAGIC   "NJSD"
+#define NGX_JS_DICT_BINARY_VERSION 1
+#define NGX_JS_DICT_BINARY_TIMEOUT 0x01
+#define NGX_JS_DICT_BINARY_HEADER  16
+
+
+#define NGX_JS_DICT_SLOT_DELETED   ((ngx_js_dict_node_t *) 1)
+#define NGX_JS_DICT_NODE_PINNED    2
+#define NGX_JS_DICT_INDEX_SIZE     8
+#define NGX_JS_DICT_OPTIMISTIC_MAX 1024
+
+
+typedef struct {
+    /*
+     * Keys are partitioned by hash into independent shards.  Each shard
+     * is allocated separately, so the shard locks do not share a cache
+     * line.  The slab pool is shared by all shards and is protected by
+     * its own mutex.
+     */
+    ngx_uint_t             nshards;
+    ngx_js_dict_shard_t  **shards;
+
+    ngx_atomic_t           dirty;
+    ngx_atomic_t           writing;
 
-    unsigned               dirty:1;
-    unsigned               writing:1;
+    /*
+     * The journal is compacted into a full snapshot once it grows
+     * larger than the last snapshot, or if a change was not recorded.
+     */
+    ngx_atomic_t           compact;
+    size_t                 snapshot_size;
+    size_t                 journal_size;
 } ngx_js_dict_sh_t;
 
 
@@ -37,7 +114,11 @@ struct ngx_js_dict_s {
     ngx_socket_t           fd;
 
     ngx_msec_t             timeout;
-    ngx_flag_t             evict;
+#define NGX_JS_DICT_EVICT_OFF     0
+#define NGX_JS_DICT_EVICT_EXPIRE  1
+#define NGX_JS_DICT_EVICT_LRU     2
+    ngx_uint_t             evict;
+    ngx_uint_t             nshards;
 #define NGX_JS_DICT_TYPE_STRING  0
 #define NGX_JS_DICT_TYPE_NUMBER  1
     ngx_uint_t             type;
@@ -45,6 +126,17 @@ struct ngx_js_dict_s {
     ngx_event_t            save_event;
     ngx_str_t              state_file;
     ngx_str_t              state_temp_file;
+    ngx_str_t              journal_file;
+    ngx_str_t              journal_old_file;
+    ngx_flag_t             journal;
+#define NGX_JS_DICT_STATE_JSON    0
+#define NGX_JS_DICT_STATE_BINARY  1
+    ngx_uint_t             state_format;
+
+#if (NGX_THREADS)
+    ngx_thread_pool_t     *thread_pool;
+    ngx_thread_task_t     *save_task;
+#endif
 
     ngx_js_dict_t         *next;
 };
@@ -56,20 +148,66 @@ typedef union {
 } ngx_js_dict_value_t;
 
 
-typedef struct {
-    ngx_str_node_t         sn;
+struct ngx_js_dict_node_s {
+    ngx_str_t              key;
+    uint32_t               hash;
+    u_char                 accessed;
+    ngx_queue_t            journal;
     ngx_rbtree_node_t      expire;
     ngx_js_dict_value_t    value;
-} ngx_js_dict_node_t;
+};
+
+
+typedef struct {
+    ngx_queue_t            queue;
+    ngx_str_t              key;
+} ngx_js_dict_tombstone_t;
 
 
 typedef struct {
     ngx_str_t              key;
     ngx_js_dict_value_t    value;
     ngx_msec_t             expire;
+    ngx_uint_t             deleted;
 } ngx_js_dict_entry_t;
 
 
+typedef struct ngx_js_dict_batch_s  ngx_js_dict_batch_t;
+
+typedef ngx_int_t (*ngx_js_dict_batch_handler_pt)(ngx_js_dict_t *dict,
+    ngx_js_dict_batch_t *batch, ngx_js_dict_node_t *node, ngx_uint_t i);
+
+
+typedef struct {
+    ngx_str_t              key;
+    uint32_t               hash;
+    ngx_uint_t             done;
+    ngx_js_dict_shard_t   *shard;
+
+    /* the value to set, the delta or the new value after increment */
+    ngx_js_dict_value_t    value;
+} ngx_js_dict_batch_item_t;
+
+
+struct ngx_js_dict_batch_s {
+#define NGX_JS_DICT_BATCH_GET   0
+#define NGX_JS_DICT_BATCH_SET   1
+#define NGX_JS_DICT_BATCH_INCR  2
+    ngx_uint_t                     op;
+
+    ngx_js_dict_batch_item_t      *items;
+    ngx_uint_t                     n;
+
+    double                         init;
+    ngx_msec_t                     timeout;
+
+    /* called for each found key of NGX_JS_DICT_BATCH_GET */
+    ngx_js_dict_batch_handler_pt   handler;
+    void                          *vm;
+    void                          *retval;
+};
+
+
 static njs_int_t njs_js_ext_shared_dict_capacity(njs_vm_t *vm,
     njs_object_prop_t *prop, uint32_t unused, njs_value_t *value,
     njs_value_t *setval, njs_value_t *retval);
@@ -82,12 +220,18 @@ static njs_int_t njs_js_ext_shared_dict_free_space(njs_vm_t *vm,
     njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_get(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
+static njs_int_t njs_js_ext_shared_dict_get_many(njs_vm_t *vm,
+    njs_value_t *args, njs_uint_t nargs, njs_index_t unused,
+    njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_has(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_keys(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_incr(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
+static njs_int_t njs_js_ext_shared_dict_incr_many(njs_vm_t *vm,
+    njs_value_t *args, njs_uint_t nargs, njs_index_t unused,
+    njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_items(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_name(njs_vm_t *vm,
@@ -97,13 +241,20 @@ static njs_int_t njs_js_ext_shared_dict_pop(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_set(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t flags, njs_value_t *retval);
+static njs_int_t njs_js_ext_shared_dict_set_many(njs_vm_t *vm,
+    njs_value_t *args, njs_uint_t nargs, njs_index_t unused,
+    njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_size(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval);
 static njs_int_t njs_js_ext_shared_dict_type(njs_vm_t *vm,
     njs_object_prop_t *prop, uint32_t unused, njs_value_t *value,
     njs_value_t *setval, njs_value_t *retval);
-static ngx_js_dict_node_t *ngx_js_dict_lookup(ngx_js_dict_t *dict,
-    ngx_str_t *key);
+static ngx_js_dict_shard_t *ngx_js_dict_shard(ngx_js_dict_t *dict,
+    ngx_str_t *key, uint32_t *hash);
+static ngx_js_dict_node_t *ngx_js_dict_lookup(ngx_js_dict_shard_t *shard,
+    ngx_str_t *key, uint32_t hash);
+
+#define NGX_JS_DICT_MAX_SHARDS            256
 
 #define NGX_JS_DICT_FLAG_MUST_EXIST       1
 #define NGX_JS_DICT_FLAG_MUST_NOT_EXIST   2
@@ -111,10 +262,11 @@ static ngx_js_dict_node_t *ngx_js_dict_lookup(ngx_js_dict_t *dict,
 static ngx_int_t ngx_js_dict_set(njs_vm_t *vm, ngx_js_dict_t *dict,
     ngx_str_t *key, njs_value_t *value, ngx_msec_t timeout, unsigned flags);
 static ngx_int_t ngx_js_dict_add(njs_vm_t *vm, ngx_js_dict_t *dict,
-    ngx_str_t *key, njs_value_t *value, ngx_msec_t timeout, ngx_msec_t now);
+    ngx_js_dict_shard_t *shard, ngx_str_t *key, uint32_t hash,
+    njs_value_t *value, ngx_msec_t timeout, ngx_msec_t now);
 static ngx_int_t ngx_js_dict_update(njs_vm_t *vm, ngx_js_dict_t *dict,
-    ngx_js_dict_node_t *node, njs_value_t *value, ngx_msec_t timeout,
-    ngx_msec_t now);
+    ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node, njs_value_t *value,
+    ngx_msec_t timeout, ngx_msec_t now);
 static ngx_int_t ngx_js_dict_get(njs_vm_t *vm, ngx_js_dict_t *dict,
     ngx_str_t *key, njs_value_t *retval);
 static ngx_int_t ngx_js_dict_incr(njs_vm_t *vm, ngx_js_dict_t *dict,
@@ -122,11 +274,32 @@ static ngx_int_t ngx_js_dict_incr(njs_vm_t *vm, ngx_js_dict_t *dict,
     ngx_msec_t timeout);
 static ngx_int_t ngx_js_dict_delete(njs_vm_t *vm, ngx_js_dict_t *dict,
     ngx_str_t *key, njs_value_t *retval);
+static ngx_int_t ngx_js_dict_batch_keys(njs_vm_t *vm, njs_value_t *keys,
+    ngx_js_dict_batch_t *batch);
+static ngx_int_t ngx_js_dict_batch_timeout(njs_vm_t *vm, ngx_js_dict_t *dict,
+    njs_value_t *value, ngx_msec_t *timeout);
+static ngx_int_t ngx_js_dict_batch_get(ngx_js_dict_t *dict,
+    ngx_js_dict_batch_t *batch, ngx_js_dict_node_t *node, ngx_uint_t i);
 static ngx_int_t ngx_js_dict_copy_value_locked(njs_vm_t *vm,
     ngx_js_dict_t *dict, ngx_js_dict_node_t *node, njs_value_t *retval);
 
-static void ngx_js_dict_expire(ngx_js_dict_t *dict, ngx_msec_t now);
-static void ngx_js_dict_evict(ngx_js_dict_t *dict, ngx_int_t count);
+static void ngx_js_dict_expire(ngx_js_dict_t *dict,
+    ngx_js_dict_shard_t *shard, ngx_msec_t now);
+static void ngx_js_dict_evict(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_int_t count);
+static void ngx_js_dict_evict_lru(ngx_js_dict_t *dict,
+    ngx_js_dict_shard_t *shard, ngx_int_t count);
+static void ngx_js_dict_clear(ngx_js_dict_t *dict);
+static void ngx_js_dict_journal_add(ngx_js_dict_t *dict,
+    ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node);
+static void ngx_js_dict_journal_delete(ngx_js_dict_t *dict,
+    ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node);
+static void ngx_js_dict_journal_reset(ngx_js_dict_t *dict,
+    ngx_js_dict_shard_t *shard);
+static ngx_int_t ngx_js_dict_batch(ngx_js_dict_t *dict,
+    ngx_js_dict_batch_t *batch);
+static size_t ngx_js_dict_free_space(ngx_js_dict_t *dict);
+static ngx_uint_t ngx_js_dict_size(ngx_js_dict_t *dict);
 
 static njs_int_t ngx_js_dict_shared_error_name(njs_vm_t *vm,
     njs_object_prop_t *prop, uint32_t unused, njs_value_t *value,
@@ -155,10 +328,14 @@ static JSValue ngx_qjs_ext_shared_dict_free_space(JSContext *cx,
     JSValueConst this_val, int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_get(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv);
+static JSValue ngx_qjs_ext_shared_dict_get_many(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_has(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_incr(JSContext *cx,
     JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue ngx_qjs_ext_shared_dict_incr_many(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_items(JSContext *cx,
     JSValueConst this_val, int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_keys(JSContext *cx,
@@ -169,6 +346,8 @@ static JSValue ngx_qjs_ext_shared_dict_pop(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_set(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv, int flags);
+static JSValue ngx_qjs_ext_shared_dict_set_many(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
 static JSValue ngx_qjs_ext_shared_dict_size(JSContext *cx,
     JSValueConst this_val, int argc, JSValueConst *argv);
     static JSValue ngx_qjs_ext_shared_dict_type(JSContext *cx,
@@ -176,10 +355,17 @@ static JSValue ngx_qjs_ext_shared_dict_size(JSContext *cx,
 
 static JSValue ngx_qjs_dict_copy_value_locked(JSContext *cx,
     ngx_js_dict_t *dict, ngx_js_dict_node_t *node);
-static ngx_js_dict_node_t *ngx_qjs_dict_lookup(ngx_js_dict_t *dict,
-    ngx_str_t *key);
+static ngx_int_t ngx_qjs_dict_batch_keys(JSContext *cx, JSValueConst keys,
+    ngx_js_dict_batch_t *batch);
+static void ngx_qjs_dict_batch_free(JSContext *cx, ngx_js_dict_t *dict,
+    ngx_js_dict_batch_t *batch);
+static ngx_int_t ngx_qjs_dict_batch_timeout(JSContext *cx, ngx_js_dict_t *dict,
+    JSValueConst value, ngx_msec_t *timeout);
+static ngx_int_t ngx_qjs_dict_batch_get(ngx_js_dict_t *dict,
+    ngx_js_dict_batch_t *batch, ngx_js_dict_node_t *node, ngx_uint_t i);
 static ngx_int_t ngx_qjs_dict_add(JSContext *cx, ngx_js_dict_t *dict,
-    ngx_str_t *key, JSValue value, ngx_msec_t timeout, ngx_msec_t now);
+    ngx_js_dict_shard_t *shard, ngx_str_t *key, uint32_t hash, JSValue value,
+    ngx_msec_t timeout, ngx_msec_t now);
 static JSValue ngx_qjs_dict_delete(JSContext *cx, ngx_js_dict_t *dict,
     ngx_str_t *key, int retval);
 static JSValue ngx_qjs_dict_get(JSContext *cx, ngx_js_dict_t *dict,
@@ -189,8 +375,8 @@ static JSValue ngx_qjs_dict_incr(JSContext *cx, ngx_js_dict_t *dict,
 static JSValue ngx_qjs_dict_set(JSContext *cx, ngx_js_dict_t *dict,
     ngx_str_t *key, JSValue value, ngx_msec_t timeout, unsigned flags);
 static ngx_int_t ngx_qjs_dict_update(JSContext *cx, ngx_js_dict_t *dict,
-    ngx_js_dict_node_t *node, JSValue value, ngx_msec_t timeout,
-    ngx_msec_t now);
+    ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node, JSValue value,
+    ngx_msec_t timeout, ngx_msec_t now);
 
 static JSValue ngx_qjs_throw_shared_memory_error(JSContext *cx);
 
@@ -274,6 +460,17 @@ static njs_external_t  ngx_js_ext_shared_dict[] = {
         }
     },
 
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("incrMany"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = njs_js_ext_shared_dict_incr_many,
+        }
+    },
+
     {
         .flags = NJS_EXTERN_METHOD,
         .name.string = njs_str("items"),
@@ -296,6 +493,17 @@ static njs_external_t  ngx_js_ext_shared_dict[] = {
         }
     },
 
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("getMany"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = njs_js_ext_shared_dict_get_many,
+        }
+    },
+
     {
         .flags = NJS_EXTERN_METHOD,
         .name.string = njs_str("has"),
@@ -361,6 +569,17 @@ static njs_external_t  ngx_js_ext_shared_dict[] = {
         }
     },
 
+    {
+        .flags = NJS_EXTERN_METHOD,
+        .name.string = njs_str("setMany"),
+        .writable = 1,
+        .configurable = 1,
+        .enumerable = 1,
+        .u.method = {
+            .native = njs_js_ext_shared_dict_set_many,
+        }
+    },
+
     {
         .flags = NJS_EXTERN_METHOD,
         .name.string = njs_str("size"),
@@ -457,8 +676,10 @@ static const JSCFunctionListEntry ngx_qjs_ext_shared_dict[] = {
     JS_CFUNC_DEF("delete", 1, ngx_qjs_ext_shared_dict_delete),
     JS_CFUNC_DEF("freeSpace", 0, ngx_qjs_ext_shared_dict_free_space),
     JS_CFUNC_DEF("get", 1, ngx_qjs_ext_shared_dict_get),
+    JS_CFUNC_DEF("getMany", 1, ngx_qjs_ext_shared_dict_get_many),
     JS_CFUNC_DEF("has", 1, ngx_qjs_ext_shared_dict_has),
     JS_CFUNC_DEF("incr", 3, ngx_qjs_ext_shared_dict_incr),
+    JS_CFUNC_DEF("incrMany", 3, ngx_qjs_ext_shared_dict_incr_many),
     JS_CFUNC_DEF("items", 0, ngx_qjs_ext_shared_dict_items),
     JS_CFUNC_DEF("keys", 0, ngx_qjs_ext_shared_dict_keys),
     JS_CGETSET_DEF("name", ngx_qjs_ext_shared_dict_name, NULL),
@@ -466,6 +687,7 @@ static const JSCFunctionListEntry ngx_qjs_ext_shared_dict[] = {
     JS_CFUNC_MAGIC_DEF("replace", 3, ngx_qjs_ext_shared_dict_set,
                        NGX_JS_DICT_FLAG_MUST_EXIST),
     JS_CFUNC_MAGIC_DEF("set", 3, ngx_qjs_ext_shared_dict_set, 0),
+    JS_CFUNC_DEF("setMany", 3, ngx_qjs_ext_shared_dict_set_many),
     JS_CFUNC_DEF("size", 0, ngx_qjs_ext_shared_dict_size),
     JS_CGETSET_DEF("type", ngx_qjs_ext_shared_dict_type, NULL),
 };
@@ -606,10 +828,7 @@ static njs_int_t
 njs_js_ext_shared_dict_clear(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     njs_index_t unused, njs_value_t *retval)
 {
-    ngx_rbtree_t       *rbtree;
-    ngx_js_dict_t      *dict;
-    ngx_shm_zone_t     *shm_zone;
-    ngx_rbtree_node_t  *rn, *next;
+    ngx_shm_zone_t  *shm_zone;
 
     shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
                                njs_argument(args, 0));
@@ -618,41 +837,7 @@ njs_js_ext_shared_dict_clear(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
         return NJS_ERROR;
     }
 
-    dict = shm_zone->data;
-
-    ngx_rwlock_wlock(&dict->sh->rwlock);
-
-    if (dict->timeout) {
-        ngx_js_dict_evict(dict, 0x7fffffff /* INT_MAX */);
-
-    } else {
-        rbtree = &dict->sh->rbtree;
-
-        if (rbtree->root == rbtree->sentinel) {
-            goto done;
-        }
-
-        for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-             rn != NULL;
-             rn = next)
-        {
-            next = ngx_rbtree_next(rbtree, rn);
-
-            ngx_rbtree_delete(rbtree, rn);
-
-            ngx_js_dict_node_free(dict, (ngx_js_dict_node_t *) rn);
-        }
-    }
-
-done:
-
-    dict->sh->dirty = 1;
-
-    ngx_rwlock_unlock(&dict->sh->rwlock);
-
-    if (dict->state_file.data && !dict->save_event.timer_set) {
-        ngx_add_timer(&dict->save_event, 1000);
-    }
+    ngx_js_dict_clear(shm_zone->data);
 
     njs_value_undefined_set(retval);
 
@@ -665,7 +850,6 @@ njs_js_ext_shared_dict_free_space(njs_vm_t *vm, njs_value_t *args,
     njs_uint_t nargs, njs_index_t unused, njs_value_t *retval)
 {
     size_t           bytes;
-    ngx_js_dict_t   *dict;
     ngx_shm_zone_t  *shm_zone;
 
     shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
@@ -675,11 +859,7 @@ njs_js_ext_shared_dict_free_space(njs_vm_t *vm, njs_value_t *args,
         return NJS_ERROR;
     }
 
-    dict = shm_zone->data;
-
-    ngx_rwlock_rlock(&dict->sh->rwlock);
-    bytes = dict->shpool->pfree * ngx_pagesize;
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    bytes = ngx_js_dict_free_space(shm_zone->data);
 
     njs_value_number_set(retval, bytes);
 
@@ -743,16 +923,79 @@ njs_js_ext_shared_dict_get(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
 }
 
 
+static njs_int_t
+njs_js_ext_shared_dict_get_many(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t unused, njs_value_t *retval)
+{
+    ngx_int_t             rc;
+    ngx_uint_t            i;
+    njs_value_t          *value;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_batch_t   batch;
+
+    shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
+                               njs_argument(args, 0));
+    if (shm_zone == NULL) {
+        njs_vm_type_error(vm, "\"this\" is not a shared dict");
+        return NJS_ERROR;
+    }
+
+    if (ngx_js_dict_batch_keys(vm, njs_arg(args, nargs, 1), &batch)
+        != NGX_OK)
+    {
+        return NJS_ERROR;
+    }
+
+    if (njs_vm_array_alloc(vm, retval, batch.n) != NJS_OK) {
+        goto fail;
+    }
+
+    for (i = 0; i < batch.n; i++) {
+        value = njs_vm_array_push(vm, retval);
+        if (value == NULL) {
+            goto fail;
+        }
+
+        njs_value_undefined_set(value);
+    }
+
+    batch.op = NGX_JS_DICT_BATCH_GET;
+    batch.handler = ngx_js_dict_batch_get;
+    batch.vm = vm;
+    batch.retval = njs_vm_array_start(vm, retval);
+
+    rc = ngx_js_dict_batch(shm_zone->data, &batch);
+
+    ngx_free(batch.items);
+
+    if (njs_slow_path(rc == NGX_ERROR)) {
+        njs_vm_error(vm, "failed to get value from shared dict");
+        return NJS_ERROR;
+    }
+
+    return NJS_OK;
+
+fail:
+
+    ngx_free(batch.items);
+
+    return NJS_ERROR;
+}
+
+
 static njs_int_t
 njs_js_ext_shared_dict_has(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     njs_index_t unused, njs_value_t *retval)
 {
-    ngx_str_t            key;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_t       *dict;
-    ngx_shm_zone_t      *shm_zone;
-    ngx_js_dict_node_t  *node;
+    uint32_t              hash;
+    ngx_int_t             rc;
+    ngx_str_t             key;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
     shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
                                njs_argument(args, 0));
@@ -766,10 +1009,18 @@ njs_js_ext_shared_dict_has(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     }
 
     dict = shm_zone->data;
+    shard = ngx_js_dict_shard(dict, &key, &hash);
+
+    rc = ngx_js_dict_lookup_optimistic(dict, shard, &key, hash, NULL, NULL, 0);
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    if (rc != NGX_AGAIN) {
+        njs_value_boolean_set(retval, rc == NGX_OK);
+        return NJS_OK;
+    }
+
+    ngx_rwlock_rlock(&shard->rwlock);
 
-    node = ngx_js_dict_lookup(dict, &key);
+    node = ngx_js_dict_lookup(shard, &key, hash);
 
     if (node != NULL && dict->timeout) {
         tp = ngx_timeofday();
@@ -780,7 +1031,7 @@ njs_js_ext_shared_dict_has(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
         }
     }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_rwlock_unlock(&shard->rwlock);
 
     njs_value_boolean_set(retval, node != NULL);
 
@@ -792,16 +1043,16 @@ static njs_int_t
 njs_js_ext_shared_dict_keys(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
     njs_index_t unused, njs_value_t *retval)
 {
-    njs_int_t            rc;
-    ngx_int_t            max_count;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    njs_value_t         *value;
-    ngx_rbtree_t        *rbtree;
-    ngx_js_dict_t       *dict;
-    ngx_shm_zone_t      *shm_zone;
-    ngx_rbtree_node_t   *rn;
-    ngx_js_dict_node_t  *node;
+    njs_int_t             rc;
+    ngx_int_t             max_count;
+    ngx_uint_t            i, j;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    njs_value_t          *value;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
     shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
                                njs_argument(args, 0));
@@ -825,51 +1076,52 @@ njs_js_ext_shared_dict_keys(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
         return NJS_ERROR;
     }
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
 
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
-        ngx_js_dict_expire(dict, now);
-    }
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
 
-    rbtree = &dict->sh->rbtree;
+        if (dict->timeout) {
+            ngx_js_dict_write_lock(shard);
+            ngx_js_dict_expire(dict, shard, now);
+            ngx_js_dict_write_unlock(shard);
+        }
 
-    if (rbtree->root == rbtree->sentinel) {
-        goto done;
-    }
+        ngx_rwlock_rlock(&shard->rwlock);
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = ngx_rbtree_next(rbtree, rn))
-    {
-        if (max_count-- == 0) {
-            break;
-        }
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
 
-        node = (ngx_js_dict_node_t *) rn;
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
 
-        value = njs_vm_array_push(vm, retval);
-        if (value == NULL) {
-            goto fail;
-        }
+            if (max_count-- == 0) {
+                ngx_rwlock_unlock(&shard->rwlock);
+                return NJS_OK;
+            }
 
-        rc = njs_vm_value_string_create(vm, value, node->sn.str.data,
-                                        node->sn.str.len);
-        if (rc != NJS_OK) {
-            goto fail;
-        }
-    }
+            value = njs_vm_array_push(vm, retval);
+            if (value == NULL) {
+                goto fail;
+            }
 
-done:
+            rc = njs_vm_value_string_create(vm, value, node->key.data,
+                                            node->key.len);
+            if (rc != NJS_OK) {
+                goto fail;
+            }
+        }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+        ngx_rwlock_unlock(&shard->rwlock);
+    }
 
     return NJS_OK;
 
 fail:
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_rwlock_unlock(&shard->rwlock);
 
     return NJS_ERROR;
 }
@@ -959,19 +1211,17 @@ njs_js_ext_shared_dict_incr(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
 
 
 static njs_int_t
-njs_js_ext_shared_dict_items(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
-    njs_index_t unused, njs_value_t *retval)
+njs_js_ext_shared_dict_incr_many(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t unused, njs_value_t *retval)
 {
-    njs_int_t            rc;
-    ngx_int_t            max_count;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    njs_value_t         *value, *kv;
-    ngx_rbtree_t        *rbtree;
-    ngx_js_dict_t       *dict;
-    ngx_shm_zone_t      *shm_zone;
-    ngx_rbtree_node_t   *rn;
-    ngx_js_dict_node_t  *node;
+    int64_t               length;
+    ngx_int_t             rc;
+    ngx_uint_t            i;
+    njs_value_t          *deltas, *delta, *init, *value;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    njs_opaque_value_t    lvalue;
+    ngx_js_dict_batch_t   batch;
 
     shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
                                njs_argument(args, 0));
@@ -982,84 +1232,199 @@ njs_js_ext_shared_dict_items(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
 
     dict = shm_zone->data;
 
-    max_count = 1024;
-
-    if (nargs > 1) {
-        if (ngx_js_integer(vm, njs_arg(args, nargs, 1), &max_count) != NGX_OK) {
-            return NJS_ERROR;
-        }
+    if (dict->type != NGX_JS_DICT_TYPE_NUMBER) {
+        njs_vm_type_error(vm, "shared dict is not a number dict");
+        return NJS_ERROR;
     }
 
-    rc = njs_vm_array_alloc(vm, retval, 8);
-    if (rc != NJS_OK) {
+    if (ngx_js_dict_batch_keys(vm, njs_arg(args, nargs, 1), &batch)
+        != NGX_OK)
+    {
         return NJS_ERROR;
     }
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    deltas = njs_arg(args, nargs, 2);
 
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
-        ngx_js_dict_expire(dict, now);
-    }
+    if (njs_value_is_array(deltas)) {
+        if (njs_vm_array_length(vm, deltas, &length) != NJS_OK) {
+            goto fail;
+        }
 
-    rbtree = &dict->sh->rbtree;
+        if ((ngx_uint_t) length != batch.n) {
+            njs_vm_type_error(vm, "deltas length does not match keys");
+            goto fail;
+        }
 
-    if (rbtree->root == rbtree->sentinel) {
-        goto done;
+    } else if (!njs_value_is_number(deltas)) {
+        njs_vm_type_error(vm, "delta is not a number");
+        goto fail;
     }
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = ngx_rbtree_next(rbtree, rn))
-    {
-        if (max_count-- == 0) {
-            break;
-        }
-
-        node = (ngx_js_dict_node_t *) rn;
+    for (i = 0; i < batch.n; i++) {
+        delta = deltas;
 
-        kv = njs_vm_array_push(vm, retval);
-        if (kv == NULL) {
-            goto fail;
+        if (njs_value_is_array(deltas)) {
+            delta = njs_vm_array_prop(vm, deltas, i, &lvalue);
+            if (delta == NULL || !njs_value_is_number(delta)) {
+                njs_vm_type_error(vm, "delta is not a number");
+                goto fail;
+            }
         }
 
-        rc = njs_vm_array_alloc(vm, kv, 2);
-        if (rc != NJS_OK) {
-            goto fail;
-        }
+        batch.items[i].value.number = njs_value_number(delta);
+    }
 
-        value = njs_vm_array_push(vm, kv);
-        if (value == NULL) {
-            goto fail;
-        }
+    init = njs_arg(args, nargs, 3);
+    if (!njs_value_is_number(init) && !njs_value_is_undefined(init)) {
+        njs_vm_type_error(vm, "init value is not a number");
+        goto fail;
+    }
 
-        rc = njs_vm_value_string_create(vm, value, node->sn.str.data,
-                                        node->sn.str.len);
-        if (rc != NJS_OK) {
-            goto fail;
-        }
+    batch.init = njs_value_is_number(init) ? njs_value_number(init) : 0;
+
+    if (ngx_js_dict_batch_timeout(vm, dict, njs_arg(args, nargs, 4),
+                                  &batch.timeout)
+        != NGX_OK)
+    {
+        goto fail;
+    }
+
+    batch.op = NGX_JS_DICT_BATCH_INCR;
+
+    rc = ngx_js_dict_batch(dict, &batch);
+    if (rc == NGX_ERROR) {
+        njs_vm_error3(vm, ngx_js_shared_dict_error_id, "", 0);
+        goto fail;
+    }
+
+    if (njs_vm_array_alloc(vm, retval, batch.n) != NJS_OK) {
+        goto fail;
+    }
 
-        value = njs_vm_array_push(vm, kv);
+    for (i = 0; i < batch.n; i++) {
+        value = njs_vm_array_push(vm, retval);
         if (value == NULL) {
             goto fail;
         }
 
-        rc = ngx_js_dict_copy_value_locked(vm, dict, node, value);
-        if (rc != NJS_OK) {
-            goto fail;
+        njs_value_number_set(value, batch.items[i].value.number);
+    }
+
+    ngx_free(batch.items);
+
+    return NJS_OK;
+
+fail:
+
+    ngx_free(batch.items);
+
+    return NJS_ERROR;
+}
+
+
+static njs_int_t
+njs_js_ext_shared_dict_items(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    njs_index_t unused, njs_value_t *retval)
+{
+    njs_int_t             rc;
+    ngx_int_t             max_count;
+    ngx_uint_t            i, j;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    njs_value_t          *value, *kv;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
+                               njs_argument(args, 0));
+    if (shm_zone == NULL) {
+        njs_vm_type_error(vm, "\"this\" is not a shared dict");
+        return NJS_ERROR;
+    }
+
+    dict = shm_zone->data;
+
+    max_count = 1024;
+
+    if (nargs > 1) {
+        if (ngx_js_integer(vm, njs_arg(args, nargs, 1), &max_count) != NGX_OK) {
+            return NJS_ERROR;
         }
     }
 
-done:
+    rc = njs_vm_array_alloc(vm, retval, 8);
+    if (rc != NJS_OK) {
+        return NJS_ERROR;
+    }
+
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
+
+        if (dict->timeout) {
+            ngx_js_dict_write_lock(shard);
+            ngx_js_dict_expire(dict, shard, now);
+            ngx_js_dict_write_unlock(shard);
+        }
+
+        ngx_rwlock_rlock(&shard->rwlock);
+
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
+
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
+
+            if (max_count-- == 0) {
+                ngx_rwlock_unlock(&shard->rwlock);
+                return NJS_OK;
+            }
+
+            kv = njs_vm_array_push(vm, retval);
+            if (kv == NULL) {
+                goto fail;
+            }
+
+            rc = njs_vm_array_alloc(vm, kv, 2);
+            if (rc != NJS_OK) {
+                goto fail;
+            }
+
+            value = njs_vm_array_push(vm, kv);
+            if (value == NULL) {
+                goto fail;
+            }
+
+            rc = njs_vm_value_string_create(vm, value, node->key.data,
+                                            node->key.len);
+            if (rc != NJS_OK) {
+                goto fail;
+            }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+            value = njs_vm_array_push(vm, kv);
+            if (value == NULL) {
+                goto fail;
+            }
+
+            rc = ngx_js_dict_copy_value_locked(vm, dict, node, value);
+            if (rc != NJS_OK) {
+                goto fail;
+            }
+        }
+
+        ngx_rwlock_unlock(&shard->rwlock);
+    }
 
     return NJS_OK;
 
 fail:
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_rwlock_unlock(&shard->rwlock);
 
     return NJS_ERROR;
 }
@@ -1191,16 +1556,17 @@ njs_js_ext_shared_dict_set(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
 
 
 static njs_int_t
-njs_js_ext_shared_dict_size(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
-    njs_index_t unused, njs_value_t *retval)
+njs_js_ext_shared_dict_set_many(njs_vm_t *vm, njs_value_t *args,
+    njs_uint_t nargs, njs_index_t unused, njs_value_t *retval)
 {
-    njs_int_t           items;
-    ngx_msec_t          now;
-    ngx_time_t         *tp;
-    ngx_rbtree_t       *rbtree;
-    ngx_js_dict_t      *dict;
-    ngx_shm_zone_t     *shm_zone;
-    ngx_rbtree_node_t  *rn;
+    int64_t               length;
+    njs_str_t             string;
+    ngx_uint_t            i;
+    njs_value_t          *values, *value;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    njs_opaque_value_t    lvalue;
+    ngx_js_dict_batch_t   batch;
 
     shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
                                njs_argument(args, 0));
@@ -1211,33 +1577,94 @@ njs_js_ext_shared_dict_size(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
 
     dict = shm_zone->data;
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    if (ngx_js_dict_batch_keys(vm, njs_arg(args, nargs, 1), &batch)
+        != NGX_OK)
+    {
+        return NJS_ERROR;
+    }
 
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
-        ngx_js_dict_expire(dict, now);
+    values = njs_arg(args, nargs, 2);
+
+    if (!njs_value_is_array(values)) {
+        njs_vm_type_error(vm, "values is not an array");
+        goto fail;
     }
 
-    rbtree = &dict->sh->rbtree;
+    if (njs_vm_array_length(vm, values, &length) != NJS_OK) {
+        goto fail;
+    }
 
-    if (rbtree->root == rbtree->sentinel) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        njs_value_number_set(retval, 0);
-        return NJS_OK;
+    if ((ngx_uint_t) length != batch.n) {
+        njs_vm_type_error(vm, "values length does not match keys");
+        goto fail;
     }
 
-    items = 0;
+    for (i = 0; i < batch.n; i++) {
+        value = njs_vm_array_prop(vm, values, i, &lvalue);
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = ngx_rbtree_next(rbtree, rn))
+        if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+            if (value == NULL || !njs_value_is_string(value)) {
+                njs_vm_type_error(vm, "string value is expected");
+                goto fail;
+            }
+
+            njs_value_string_get(vm, value, &string);
+
+            batch.items[i].value.str.data = string.start;
+            batch.items[i].value.str.len = string.length;
+
+        } else {
+            if (value == NULL || !njs_value_is_number(value)) {
+                njs_vm_type_error(vm, "number value is expected");
+                goto fail;
+            }
+
+            batch.items[i].value.number = njs_value_number(value);
+        }
+    }
+
+    if (ngx_js_dict_batch_timeout(vm, dict, njs_arg(args, nargs, 3),
+                                  &batch.timeout)
+        != NGX_OK)
     {
-        items++;
+        goto fail;
+    }
+
+    batch.op = NGX_JS_DICT_BATCH_SET;
+
+    if (ngx_js_dict_batch(dict, &batch) != NGX_OK) {
+        njs_vm_error3(vm, ngx_js_shared_dict_error_id, "", 0);
+        goto fail;
+    }
+
+    ngx_free(batch.items);
+
+    njs_value_assign(retval, njs_argument(args, 0));
+
+    return NJS_OK;
+
+fail:
+
+    ngx_free(batch.items);
+
+    return NJS_ERROR;
+}
+
+
+static njs_int_t
+njs_js_ext_shared_dict_size(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
+    njs_index_t unused, njs_value_t *retval)
+{
+    ngx_shm_zone_t  *shm_zone;
+
+    shm_zone = njs_vm_external(vm, ngx_js_shared_dict_proto_id,
+                               njs_argument(args, 0));
+    if (shm_zone == NULL) {
+        njs_vm_type_error(vm, "\"this\" is not a shared dict");
+        return NJS_ERROR;
     }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
-    njs_value_number_set(retval, items);
+    njs_value_number_set(retval, ngx_js_dict_size(shm_zone->data));
 
     return NJS_OK;
 }
@@ -1283,729 +1710,1784 @@ ngx_js_dict_shared_error_name(njs_vm_t *vm, njs_object_prop_t *prop,
 }
 
 
-static ngx_js_dict_node_t *
-ngx_js_dict_lookup(ngx_js_dict_t *dict, ngx_str_t *key)
+static ngx_js_dict_shard_t *
+ngx_js_dict_shard(ngx_js_dict_t *dict, ngx_str_t *key, uint32_t *hash)
 {
-    uint32_t       hash;
-    ngx_rbtree_t  *rbtree;
+    *hash = ngx_crc32_long(key->data, key->len);
+
+    return dict->sh->shards[*hash % dict->sh->nshards];
+}
 
-    rbtree = &dict->sh->rbtree;
 
-    hash = ngx_crc32_long(key->data, key->len);
+static ngx_inline ngx_uint_t
+ngx_js_dict_slot(ngx_js_dict_shard_t *shard, uint32_t hash)
+{
+    /* the low bits of the hash are shared by all keys of the shard */
 
-    return (ngx_js_dict_node_t *) ngx_str_rbtree_lookup(rbtree, key, hash);
+    return (hash ^ (hash >> 16)) & (shard->size - 1);
 }
 
 
-static void *
-ngx_js_dict_alloc(ngx_js_dict_t *dict, size_t n)
+static ngx_js_dict_node_t *
+ngx_js_dict_lookup(ngx_js_dict_shard_t *shard, ngx_str_t *key, uint32_t hash)
 {
-    void  *p;
+    ngx_uint_t           i, mask;
+    ngx_js_dict_slot_t  *slot;
+    ngx_js_dict_node_t  *node;
 
-    p = ngx_slab_alloc_locked(dict->shpool, n);
+    mask = shard->size - 1;
 
-    if (p == NULL && dict->evict) {
-        ngx_js_dict_evict(dict, 16);
-        p = ngx_slab_alloc_locked(dict->shpool, n);
+    for (i = ngx_js_dict_slot(shard, hash); /* void */ ; i = (i + 1) & mask) {
+        slot = &shard->slots[i];
+        node = slot->node;
+
+        if (node == NULL) {
+            return NULL;
+        }
+
+        if (slot->hash == hash
+            && node != NGX_JS_DICT_SLOT_DELETED
+            && node->key.len == key->len
+            && ngx_memcmp(node->key.data, key->data, key->len) == 0)
+        {
+            return node;
+        }
     }
+}
 
-    return p;
+
+static ngx_inline void
+ngx_js_dict_write_lock(ngx_js_dict_shard_t *shard)
+{
+    ngx_rwlock_wlock(&shard->rwlock);
+
+    shard->seq++;
+    ngx_memory_barrier();
 }
 
 
-static void
-ngx_js_dict_node_free(ngx_js_dict_t *dict, ngx_js_dict_node_t *node)
+static ngx_inline void
+ngx_js_dict_write_unlock(ngx_js_dict_shard_t *shard)
 {
-    ngx_slab_pool_t  *shpool;
+    ngx_memory_barrier();
+    shard->seq++;
 
-    shpool = dict->shpool;
+    ngx_rwlock_unlock(&shard->rwlock);
+}
 
-    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-        ngx_slab_free_locked(shpool, node->value.str.data);
+
+static ngx_inline ngx_uint_t
+ngx_js_dict_write_trylock(ngx_js_dict_shard_t *shard)
+{
+    /* ngx_rwlock_wlock() without spinning */
+
+    if (shard->rwlock != 0
+        || !ngx_atomic_cmp_set(&shard->rwlock, 0, (ngx_atomic_uint_t) -1))
+    {
+        return 0;
     }
 
-    ngx_slab_free_locked(shpool, node);
+    shard->seq++;
+    ngx_memory_barrier();
+
+    return 1;
 }
 
 
+static ngx_inline ngx_uint_t
+ngx_js_dict_in_zone(ngx_js_dict_t *dict, void *p, size_t size)
+{
+    return (u_char *) p >= dict->shpool->start
+           && (u_char *) p <= dict->shpool->end
+           && size <= (size_t) (dict->shpool->end - (u_char *) p);
+}
+
+
+/*
+ * Looks up a key without taking the shard lock.  The memory read may be
+ * modified or freed concurrently, so every pointer is checked to be
+ * within the zone before it is dereferenced, and the result is only
+ * trusted if the shard sequence counter did not change.  A string value
+ * is copied to the provided buffer.
+ *
+ * Returns NGX_OK if the key is found, NGX_DECLINED if it is not found or
+ * expired, and NGX_AGAIN if the lookup has to be repeated under the lock.
+ */
+
 static ngx_int_t
-ngx_js_dict_set(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
-    njs_value_t *value, ngx_msec_t timeout, unsigned flags)
+ngx_js_dict_lookup_optimistic(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_str_t *key, uint32_t hash, ngx_js_dict_value_t *value, u_char *buf,
+    size_t size)
 {
-    ngx_msec_t           now;
+    u_char              *data;
+    size_t               len;
+    ngx_int_t            rc;
+    ngx_uint_t           i, n, mask, seq;
+    ngx_msec_t           now, expire;
     ngx_time_t          *tp;
+    ngx_js_dict_slot_t  *slots;
     ngx_js_dict_node_t  *node;
 
-    tp = ngx_timeofday();
-    now = tp->sec * 1000 + tp->msec;
+    seq = shard->seq;
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
+    if (seq & 1) {
+        return NGX_AGAIN;
+    }
 
-    node = ngx_js_dict_lookup(dict, key);
+    ngx_memory_barrier();
 
-    if (node == NULL) {
-        if (flags & NGX_JS_DICT_FLAG_MUST_EXIST) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            return NGX_DECLINED;
+    slots = shard->slots;
+    mask = shard->size - 1;
+
+    if (shard->size == 0
+        || (shard->size & mask) != 0
+        || !ngx_js_dict_in_zone(dict, slots,
+                                shard->size * sizeof(ngx_js_dict_slot_t)))
+    {
+        return NGX_AGAIN;
+    }
+
+    rc = NGX_AGAIN;
+    expire = 0;
+
+    i = (hash ^ (hash >> 16)) & mask;
+
+    for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+        node = slots[i].node;
+
+        if (node == NULL) {
+            rc = NGX_DECLINED;
+            break;
         }
 
-        if (ngx_js_dict_add(vm, dict, key, value, timeout, now) != NGX_OK) {
-            goto memory_error;
+        if (node == NGX_JS_DICT_SLOT_DELETED || slots[i].hash != hash) {
+            continue;
         }
 
-    } else {
-        if (flags & NGX_JS_DICT_FLAG_MUST_NOT_EXIST) {
-            if (!dict->timeout || now < node->expire.key) {
-                ngx_rwlock_unlock(&dict->sh->rwlock);
-                return NGX_DECLINED;
-            }
+        if (!ngx_js_dict_in_zone(dict, node, sizeof(ngx_js_dict_node_t))) {
+            return NGX_AGAIN;
         }
 
-        if (ngx_js_dict_update(vm, dict, node, value, timeout, now) != NGX_OK) {
-            goto memory_error;
+        data = node->key.data;
+        len = node->key.len;
+
+        if (len != key->len) {
+            continue;
         }
-    }
 
-    dict->sh->dirty = 1;
+        if (!ngx_js_dict_in_zone(dict, data, len)) {
+            return NGX_AGAIN;
+        }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+        if (ngx_memcmp(data, key->data, len) != 0) {
+            continue;
+        }
 
-    if (dict->state_file.data && !dict->save_event.timer_set) {
-        ngx_add_timer(&dict->save_event, 1000);
-    }
+        expire = node->expire.key;
 
-    return NGX_OK;
+        if (value != NULL) {
+            if (dict->evict == NGX_JS_DICT_EVICT_LRU && !node->accessed) {
+                /* the access is recorded under the lock */
+                return NGX_AGAIN;
+            }
 
-memory_error:
+            if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+                data = node->value.str.data;
+                len = node->value.str.len;
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+                if (len > size) {
+                    /* too long to copy, the locked path will do it */
+                    return NGX_AGAIN;
+                }
 
-    njs_vm_error3(vm, ngx_js_shared_dict_error_id, "", 0);
+                if (!ngx_js_dict_in_zone(dict, data, len)) {
+                    return NGX_AGAIN;
+                }
 
-    return NGX_ERROR;
-}
+                ngx_memcpy(buf, data, len);
 
+                value->str.data = buf;
+                value->str.len = len;
 
-static ngx_int_t
-ngx_js_dict_add_value(ngx_js_dict_t *dict, ngx_str_t *key,
-    ngx_js_dict_value_t *value, ngx_msec_t timeout, ngx_msec_t now)
-{
-    size_t               n;
-    uint32_t             hash;
-    ngx_js_dict_node_t  *node;
+            } else {
+                value->number = node->value.number;
+            }
+        }
 
-    if (dict->timeout) {
-        ngx_js_dict_expire(dict, now);
+        rc = NGX_OK;
+        break;
     }
 
-    n = sizeof(ngx_js_dict_node_t) + key->len;
-    hash = ngx_crc32_long(key->data, key->len);
+    ngx_memory_barrier();
 
-    node = ngx_js_dict_alloc(dict, n);
-    if (node == NULL) {
-        return NGX_ERROR;
+    if (rc == NGX_AGAIN || shard->seq != seq) {
+        return NGX_AGAIN;
     }
 
-    node->sn.str.data = (u_char *) node + sizeof(ngx_js_dict_node_t);
+    if (rc == NGX_OK && dict->timeout) {
+        tp = ngx_timeofday();
+        now = tp->sec * 1000 + tp->msec;
 
-    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-        node->value.str.data = ngx_js_dict_alloc(dict, value->str.len);
-        if (node->value.str.data == NULL) {
-            ngx_slab_free_locked(dict->shpool, node);
-            return NGX_ERROR;
+        if (now >= expire) {
+            return NGX_DECLINED;
         }
-
-        ngx_memcpy(node->value.str.data, value->str.data, value->str.len);
-        node->value.str.len = value->str.len;
-
-    } else {
-        node->value.number = value->number;
     }
 
-    node->sn.node.key = hash;
+    return rc;
+}
 
-    ngx_memcpy(node->sn.str.data, key->data, key->len);
-    node->sn.str.len = key->len;
 
-    ngx_rbtree_insert(&dict->sh->rbtree, &node->sn.node);
+static void *
+ngx_js_dict_alloc(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard, size_t n)
+{
+    void                 *p;
+    ngx_uint_t            i;
+    ngx_js_dict_shard_t  *other;
 
-    if (dict->timeout) {
-        node->expire.key = now + timeout;
-        ngx_rbtree_insert(&dict->sh->rbtree_expire, &node->expire);
-    }
+    p = ngx_slab_alloc(dict->shpool, n);
 
-    return NGX_OK;
-}
+    if (p == NULL && dict->evict) {
+        ngx_js_dict_evict(dict, shard, 16);
+        p = ngx_slab_alloc(dict->shpool, n);
 
+        /*
+         * the memory may be held by other shards, they are evicted
+         * only if not locked as waiting for the lock of another shard
+         * while holding this one may deadlock
+         */
 
-static ngx_int_t
-ngx_js_dict_add(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
-    njs_value_t *value, ngx_msec_t timeout, ngx_msec_t now)
-{
-    njs_str_t            string;
-    ngx_js_dict_value_t  entry;
+        for (i = 0; p == NULL && i < dict->sh->nshards; i++) {
+            other = dict->sh->shards[i];
 
-    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-        njs_value_string_get(vm, value, &string);
+            if (other == shard || !ngx_js_dict_write_trylock(other)) {
+                continue;
+            }
 
-        entry.str.data = string.start;
-        entry.str.len = string.length;
+            ngx_js_dict_evict(dict, other, 16);
+            ngx_js_dict_write_unlock(other);
 
-    } else {
-        /* GCC complains about uninitialized entry.str.data. */
-        entry.str.data = NULL;
-        entry.number = njs_value_number(value);
+            p = ngx_slab_alloc(dict->shpool, n);
+        }
     }
 
-    return ngx_js_dict_add_value(dict, key, &entry, timeout, now);
+    return p;
 }
 
 
-static ngx_int_t
-ngx_js_dict_update(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_js_dict_node_t *node,
-    njs_value_t *value, ngx_msec_t timeout, ngx_msec_t now)
+static void
+ngx_js_dict_node_free(ngx_js_dict_t *dict, ngx_js_dict_node_t *node)
 {
-    u_char     *p;
-    njs_str_t   string;
-
-    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-        njs_value_string_get(vm, value, &string);
+    ngx_slab_pool_t  *shpool;
 
-        p = ngx_js_dict_alloc(dict, string.length);
-        if (p == NULL) {
-            return NGX_ERROR;
-        }
+    shpool = dict->shpool;
 
-        ngx_slab_free_locked(dict->shpool, node->value.str.data);
-        ngx_memcpy(p, string.start, string.length);
+    if (node->journal.prev != NULL) {
+        ngx_queue_remove(&node->journal);
+    }
 
-        node->value.str.data = p;
-        node->value.str.len = string.length;
+    ngx_shmtx_lock(&shpool->mutex);
 
-    } else {
-        node->value.number = njs_value_number(value);
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        ngx_slab_free_locked(shpool, node->value.str.data);
     }
 
-    if (dict->timeout) {
-        ngx_rbtree_delete(&dict->sh->rbtree_expire, &node->expire);
-        node->expire.key = now + timeout;
-        ngx_rbtree_insert(&dict->sh->rbtree_expire, &node->expire);
-    }
+    ngx_slab_free_locked(shpool, node);
 
-    return NGX_OK;
+    ngx_shmtx_unlock(&shpool->mutex);
 }
 
 
 static ngx_int_t
-ngx_js_dict_delete(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
-    njs_value_t *retval)
+ngx_js_dict_index_resize(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_uint_t size)
 {
-    ngx_int_t            rc;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
+    ngx_uint_t           i, j, mask;
+    ngx_js_dict_slot_t  *slots, *old;
     ngx_js_dict_node_t  *node;
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
-
-    node = ngx_js_dict_lookup(dict, key);
-
-    if (node == NULL) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        return NGX_DECLINED;
-    }
-
-    if (dict->timeout) {
-        ngx_rbtree_delete(&dict->sh->rbtree_expire, &node->expire);
+    slots = ngx_js_dict_alloc(dict, shard, size * sizeof(ngx_js_dict_slot_t));
+    if (slots == NULL) {
+        return NGX_ERROR;
     }
 
-    ngx_rbtree_delete(&dict->sh->rbtree, (ngx_rbtree_node_t *) node);
+    ngx_memzero(slots, size * sizeof(ngx_js_dict_slot_t));
 
-    if (retval != NULL) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
+    old = shard->slots;
+    mask = size - 1;
 
-        if (!dict->timeout || now < node->expire.key) {
-            rc = ngx_js_dict_copy_value_locked(vm, dict, node, retval);
+    for (i = 0; i < shard->size; i++) {
+        node = old[i].node;
 
-        } else {
-            rc = NGX_DECLINED;
+        if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+            continue;
         }
 
-    } else {
-        rc = NGX_OK;
-    }
+        j = (node->hash ^ (node->hash >> 16)) & mask;
 
-    ngx_js_dict_node_free(dict, node);
+        while (slots[j].node != NULL) {
+            j = (j + 1) & mask;
+        }
 
-    dict->sh->dirty = 1;
+        slots[j].hash = node->hash;
+        slots[j].node = node;
+    }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    shard->slots = slots;
+    shard->size = size;
+    shard->deleted = 0;
 
-    if (dict->state_file.data && !dict->save_event.timer_set) {
-        ngx_add_timer(&dict->save_event, 1000);
-    }
+    ngx_slab_free(dict->shpool, old);
 
-    return rc;
+    return NGX_OK;
 }
 
 
 static ngx_int_t
-ngx_js_dict_incr(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
-    njs_value_t *delta, njs_value_t *init, double *value, ngx_msec_t timeout)
+ngx_js_dict_index_insert(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_js_dict_node_t *node)
 {
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_node_t  *node;
+    ngx_uint_t           i, size, mask;
+    ngx_js_dict_slot_t  *slot;
 
-    tp = ngx_timeofday();
-    now = tp->sec * 1000 + tp->msec;
+    /* keep the load factor including deleted slots below 3/4 */
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
+    if ((shard->used + shard->deleted + 1) * 4 > shard->size * 3) {
+        size = shard->size;
 
-    node = ngx_js_dict_lookup(dict, key);
+        if ((shard->used + 1) * 2 > size) {
+            size *= 2;
+        }
 
-    if (node == NULL) {
-        njs_value_number_set(init, njs_value_number(init)
-                                   + njs_value_number(delta));
-        if (ngx_js_dict_add(vm, dict, key, init, timeout, now) != NGX_OK) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
+        if (ngx_js_dict_index_resize(dict, shard, size) != NGX_OK
+            && shard->used + shard->deleted + 1 >= shard->size)
+        {
             return NGX_ERROR;
         }
+    }
 
-        *value = njs_value_number(init);
+    mask = shard->size - 1;
 
-    } else {
-        node->value.number += njs_value_number(delta);
-        *value = node->value.number;
+    for (i = ngx_js_dict_slot(shard, node->hash); /* void */ ;
+         i = (i + 1) & mask)
+    {
+        slot = &shard->slots[i];
 
-        if (dict->timeout) {
-            ngx_rbtree_delete(&dict->sh->rbtree_expire, &node->expire);
-            node->expire.key = now + timeout;
-            ngx_rbtree_insert(&dict->sh->rbtree_expire, &node->expire);
+        if (slot->node == NULL) {
+            break;
         }
-    }
-
-    dict->sh->dirty = 1;
-
-    ngx_rwlock_unlock(&dict->sh->rwlock);
 
-    if (dict->state_file.data && !dict->save_event.timer_set) {
-        ngx_add_timer(&dict->save_event, 1000);
+        if (slot->node == NGX_JS_DICT_SLOT_DELETED) {
+            shard->deleted--;
+            break;
+        }
     }
 
+    slot->hash = node->hash;
+    slot->node = node;
+    shard->used++;
+
     return NGX_OK;
 }
 
 
-static ngx_int_t
-ngx_js_dict_get(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
-    njs_value_t *retval)
+static void
+ngx_js_dict_index_delete(ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node)
 {
-    ngx_int_t            rc;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_node_t  *node;
+    ngx_uint_t           i, mask;
+    ngx_js_dict_slot_t  *slot;
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    mask = shard->size - 1;
 
-    node = ngx_js_dict_lookup(dict, key);
+    for (i = ngx_js_dict_slot(shard, node->hash); /* void */ ;
+         i = (i + 1) & mask)
+    {
+        slot = &shard->slots[i];
 
-    if (node == NULL) {
-        goto not_found;
+        if (slot->node == node) {
+            break;
+        }
     }
 
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
+    shard->used--;
 
-        if (now >= node->expire.key) {
-            goto not_found;
-        }
+    if (shard->used == 0) {
+        ngx_memzero(shard->slots, shard->size * sizeof(ngx_js_dict_slot_t));
+        shard->deleted = 0;
+        return;
     }
 
-    rc = ngx_js_dict_copy_value_locked(vm, dict, node, retval);
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    if (shard->slots[(i + 1) & mask].node == NULL) {
+        /* the end of a probe chain, no need for a tombstone */
+        slot->node = NULL;
+        return;
+    }
 
-    return rc;
+    slot->node = NGX_JS_DICT_SLOT_DELETED;
+    shard->deleted++;
+}
 
-not_found:
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
-    njs_value_undefined_set(retval);
+static void
+ngx_js_dict_clear(ngx_js_dict_t *dict)
+{
+    ngx_uint_t            i, j;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
-    return NGX_OK;
-}
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
 
+        ngx_js_dict_write_lock(shard);
 
-static ngx_int_t
-ngx_js_dict_copy_value_locked(njs_vm_t *vm, ngx_js_dict_t *dict,
-    ngx_js_dict_node_t *node, njs_value_t *retval)
-{
-    njs_int_t   ret;
-    ngx_uint_t  type;
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
 
-    type = dict->type;
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
 
-    if (type == NGX_JS_DICT_TYPE_STRING) {
-        ret = njs_vm_value_string_create(vm, retval, node->value.str.data,
-                                         node->value.str.len);
-        if (ret != NJS_OK) {
-            return NGX_ERROR;
+            if (dict->timeout) {
+                ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+            }
+
+            ngx_js_dict_node_free(dict, node);
         }
 
-    } else {
-        njs_value_number_set(retval, node->value.number);
+        ngx_memzero(shard->slots, shard->size * sizeof(ngx_js_dict_slot_t));
+        shard->used = 0;
+        shard->deleted = 0;
+
+        if (dict->journal) {
+            ngx_js_dict_journal_reset(dict, shard);
+            dict->sh->compact = 1;
+        }
+
+        dict->sh->dirty = 1;
+
+        ngx_js_dict_write_unlock(shard);
     }
 
-    return NGX_OK;
+    if (dict->state_file.data && !dict->save_event.timer_set) {
+        ngx_add_timer(&dict->save_event, 1000);
+    }
 }
 
 
 static void
-ngx_js_dict_expire(ngx_js_dict_t *dict, ngx_msec_t now)
+ngx_js_dict_journal_add(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_js_dict_node_t *node)
 {
-    ngx_rbtree_t        *rbtree;
-    ngx_rbtree_node_t   *rn, *next;
-    ngx_js_dict_node_t  *node;
+    if (dict->journal && node->journal.prev == NULL) {
+        ngx_queue_insert_tail(&shard->journal, &node->journal);
+    }
+}
 
-    rbtree = &dict->sh->rbtree_expire;
 
-    if (rbtree->root == rbtree->sentinel) {
+static void
+ngx_js_dict_journal_delete(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_js_dict_node_t *node)
+{
+    ngx_js_dict_tombstone_t  *ts;
+
+    if (!dict->journal) {
         return;
     }
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = next)
-    {
-        if (rn->key > now) {
-            return;
-        }
-
-        node = (ngx_js_dict_node_t *)
-                   ((char *) rn - offsetof(ngx_js_dict_node_t, expire));
-
-        next = ngx_rbtree_next(rbtree, rn);
+    if (node->journal.prev != NULL) {
+        ngx_queue_remove(&node->journal);
+        node->journal.prev = NULL;
+    }
 
-        ngx_rbtree_delete(rbtree, rn);
+    ts = ngx_slab_alloc(dict->shpool,
+                        sizeof(ngx_js_dict_tombstone_t) + node->key.len);
+    if (ts == NULL) {
+        /* the deletion will be stored with the next snapshot */
+        dict->sh->compact = 1;
+        return;
+    }
 
-        ngx_rbtree_delete(&dict->sh->rbtree, (ngx_rbtree_node_t *) node);
+    ts->key.data = (u_char *) ts + sizeof(ngx_js_dict_tombstone_t);
+    ts->key.len = node->key.len;
+    ngx_memcpy(ts->key.data, node->key.data, node->key.len);
 
-        ngx_js_dict_node_free(dict, node);
-    }
+    ngx_queue_insert_tail(&shard->tombstones, &ts->queue);
 }
 
 
 static void
-ngx_js_dict_evict(ngx_js_dict_t *dict, ngx_int_t count)
+ngx_js_dict_journal_reset(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard)
 {
-    ngx_rbtree_t        *rbtree;
-    ngx_rbtree_node_t   *rn, *next;
+    ngx_queue_t         *q;
     ngx_js_dict_node_t  *node;
 
-    rbtree = &dict->sh->rbtree_expire;
+    while (!ngx_queue_empty(&shard->journal)) {
+        q = ngx_queue_head(&shard->journal);
+        ngx_queue_remove(q);
 
-    if (rbtree->root == rbtree->sentinel) {
-        return;
+        node = ngx_queue_data(q, ngx_js_dict_node_t, journal);
+        node->journal.prev = NULL;
     }
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = next)
-    {
-        if (count-- == 0) {
-            return;
-        }
+    while (!ngx_queue_empty(&shard->tombstones)) {
+        q = ngx_queue_head(&shard->tombstones);
+        ngx_queue_remove(q);
 
-        node = (ngx_js_dict_node_t *)
-                   ((char *) rn - offsetof(ngx_js_dict_node_t, expire));
+        ngx_slab_free(dict->shpool,
+                      ngx_queue_data(q, ngx_js_dict_tombstone_t, queue));
+    }
+}
 
-        next = ngx_rbtree_next(rbtree, rn);
 
-        ngx_rbtree_delete(rbtree, rn);
+static size_t
+ngx_js_dict_free_space(ngx_js_dict_t *dict)
+{
+    size_t  bytes;
 
-        ngx_rbtree_delete(&dict->sh->rbtree, (ngx_rbtree_node_t *) node);
+    ngx_shmtx_lock(&dict->shpool->mutex);
+    bytes = dict->shpool->pfree * ngx_pagesize;
+    ngx_shmtx_unlock(&dict->shpool->mutex);
 
-        ngx_js_dict_node_free(dict, node);
-    }
+    return bytes;
 }
 
 
-static ngx_int_t
-ngx_js_render_string(njs_chb_t *chain, ngx_str_t *str)
+static ngx_uint_t
+ngx_js_dict_size(ngx_js_dict_t *dict)
 {
-    size_t        size;
-    u_char        c, *dst, *dst_end;
-    const u_char  *p, *end;
+    ngx_uint_t            i, items;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_shard_t  *shard;
 
-    static char  hex2char[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
-                                  '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
 
-    p = str->data;
-    end = p + str->len;
-    size = str->len + 2;
+    items = 0;
 
-    dst = njs_chb_reserve(chain, size);
-    if (dst == NULL) {
-        return NGX_ERROR;
-    }
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
 
-    dst_end = dst + size;
+        if (dict->timeout) {
+            ngx_js_dict_write_lock(shard);
+            ngx_js_dict_expire(dict, shard, now);
+            ngx_js_dict_write_unlock(shard);
+        }
 
-    *dst++ = '\"';
-    njs_chb_written(chain, 1);
+        ngx_rwlock_rlock(&shard->rwlock);
 
-    while (p < end) {
-        if (dst_end <= dst + sizeof("\\uXXXX")) {
-            size = ngx_max(end - p + 1, 6);
-            dst = njs_chb_reserve(chain, size);
-            if (dst == NULL) {
-                return NGX_ERROR;
-            }
+        items += shard->used;
 
-            dst_end = dst + size;
-        }
+        ngx_rwlock_unlock(&shard->rwlock);
+    }
 
-        if (*p < ' ' || *p == '\\' || *p == '\"') {
-            c = (u_char) *p++;
-            *dst++ = '\\';
-            njs_chb_written(chain, 2);
+    return items;
+}
 
-            switch (c) {
-            case '\\':
-                *dst++ = '\\';
-                break;
-            case '"':
-                *dst++ = '\"';
-                break;
-            case '\r':
-                *dst++ = 'r';
-                break;
-            case '\n':
-                *dst++ = 'n';
-                break;
-            case '\t':
-                *dst++ = 't';
-                break;
-            case '\b':
-                *dst++ = 'b';
-                break;
-            case '\f':
-                *dst++ = 'f';
-                break;
-            default:
-                *dst++ = 'u';
-                *dst++ = '0';
-                *dst++ = '0';
-                *dst++ = hex2char[(c & 0xf0) >> 4];
-                *dst++ = hex2char[c & 0x0f];
-                njs_chb_written(chain, 4);
-            }
 
-            continue;
+static ngx_int_t
+ngx_js_dict_set(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
+    njs_value_t *value, ngx_msec_t timeout, unsigned flags)
+{
+    uint32_t              hash;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    ngx_js_dict_write_lock(shard);
+
+    node = ngx_js_dict_lookup(shard, key, hash);
+
+    if (node == NULL) {
+        if (flags & NGX_JS_DICT_FLAG_MUST_EXIST) {
+            ngx_js_dict_write_unlock(shard);
+            return NGX_DECLINED;
         }
 
-        dst = njs_utf8_copy(dst, &p, end);
+        if (ngx_js_dict_add(vm, dict, shard, key, hash, value, timeout, now)
+            != NGX_OK)
+        {
+            goto memory_error;
+        }
 
-        njs_chb_written(chain, dst - chain->last->pos);
+    } else {
+        if (flags & NGX_JS_DICT_FLAG_MUST_NOT_EXIST) {
+            if (!dict->timeout || now < node->expire.key) {
+                ngx_js_dict_write_unlock(shard);
+                return NGX_DECLINED;
+            }
+        }
+
+        if (ngx_js_dict_update(vm, dict, shard, node, value, timeout, now)
+            != NGX_OK)
+        {
+            goto memory_error;
+        }
     }
 
-    njs_chb_append_literal(chain, "\"");
+    dict->sh->dirty = 1;
+
+    ngx_js_dict_write_unlock(shard);
+
+    if (dict->state_file.data && !dict->save_event.timer_set) {
+        ngx_add_timer(&dict->save_event, 1000);
+    }
 
     return NGX_OK;
+
+memory_error:
+
+    ngx_js_dict_write_unlock(shard);
+
+    njs_vm_error3(vm, ngx_js_shared_dict_error_id, "", 0);
+
+    return NGX_ERROR;
 }
 
 
 static ngx_int_t
-ngx_js_dict_render_json(ngx_js_dict_t *dict, njs_chb_t *chain)
+ngx_js_dict_add_value(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_str_t *key, uint32_t hash, ngx_js_dict_value_t *value,
+    ngx_msec_t timeout, ngx_msec_t now)
 {
-    u_char              *p, *dst;
-    size_t               len;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_rbtree_t        *rbtree;
-    ngx_rbtree_node_t   *rn, *next;
+    size_t               n;
     ngx_js_dict_node_t  *node;
 
-    tp = ngx_timeofday();
-    now = tp->sec * 1000 + tp->msec;
+    if (dict->timeout) {
+        ngx_js_dict_expire(dict, shard, now);
+    }
 
-    rbtree = &dict->sh->rbtree;
+    n = sizeof(ngx_js_dict_node_t) + key->len;
 
-    njs_chb_append_literal(chain,"{");
+    node = ngx_js_dict_alloc(dict, shard, n);
+    if (node == NULL) {
+        return NGX_ERROR;
+    }
 
-    if (rbtree->root == rbtree->sentinel) {
-        njs_chb_append_literal(chain, "}");
-        return NGX_OK;
+    node->key.data = (u_char *) node + sizeof(ngx_js_dict_node_t);
+    node->journal.prev = NULL;
+
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        node->value.str.data = ngx_js_dict_alloc(dict, shard, value->str.len);
+        if (node->value.str.data == NULL) {
+            ngx_slab_free(dict->shpool, node);
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(node->value.str.data, value->str.data, value->str.len);
+        node->value.str.len = value->str.len;
+
+    } else {
+        node->value.number = value->number;
     }
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = next)
-    {
-        node = (ngx_js_dict_node_t *) rn;
+    node->hash = hash;
+    node->accessed = 1;
 
-        next = ngx_rbtree_next(rbtree, rn);
+    ngx_memcpy(node->key.data, key->data, key->len);
+    node->key.len = key->len;
 
-        if (dict->timeout && now >= node->expire.key) {
-            continue;
-        }
+    if (ngx_js_dict_index_insert(dict, shard, node) != NGX_OK) {
+        ngx_js_dict_node_free(dict, node);
+        return NGX_ERROR;
+    }
 
-        if (ngx_js_render_string(chain, &node->sn.str) != NGX_OK) {
-            return NGX_ERROR;
-        }
+    if (dict->timeout) {
+        node->expire.key = now + timeout;
+        ngx_rbtree_insert(&shard->rbtree_expire, &node->expire);
+    }
 
-        njs_chb_append_literal(chain,":{");
+    ngx_js_dict_journal_add(dict, shard, node);
 
-        if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-            njs_chb_append_literal(chain,"\"value\":");
+    return NGX_OK;
+}
 
-            if (ngx_js_render_string(chain, &node->value.str) != NGX_OK) {
-                return NGX_ERROR;
-            }
 
-        } else {
-            len = sizeof("\"value\":.") + 18 + 6;
-            dst = njs_chb_reserve(chain, len);
-            if (dst == NULL) {
-                return NGX_ERROR;
-            }
+static ngx_int_t
+ngx_js_dict_update_value(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_js_dict_node_t *node, ngx_js_dict_value_t *value, ngx_msec_t timeout,
+    ngx_msec_t now)
+{
+    u_char     *p;
+    ngx_int_t   rc;
 
-            p = njs_sprintf(dst, dst + len, "\"value\":%.6f",
-                            node->value.number);
-            njs_chb_written(chain, p - dst);
-        }
+    /*
+     * allocating the new value may evict entries,
+     * the node is pinned so that it is not evicted itself
+     */
 
-        if (dict->timeout) {
-            len = sizeof(",\"expire\":1000000000");
-            dst = njs_chb_reserve(chain, len);
-            if (dst == NULL) {
-                return NGX_ERROR;
-            }
+    if (dict->timeout) {
+        ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+    }
 
-            p = njs_sprintf(dst, dst + len, ",\"expire\":%ui",
-                            node->expire.key);
-            njs_chb_written(chain, p - dst);
+    node->accessed = NGX_JS_DICT_NODE_PINNED;
+
+    rc = NGX_OK;
+
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        p = ngx_js_dict_alloc(dict, shard, value->str.len);
+
+        if (p != NULL) {
+            ngx_slab_free(dict->shpool, node->value.str.data);
+            ngx_memcpy(p, value->str.data, value->str.len);
+
+            node->value.str.data = p;
+            node->value.str.len = value->str.len;
+
+        } else {
+            rc = NGX_ERROR;
         }
 
-        njs_chb_append_literal(chain, "}");
+    } else {
+        node->value.number = value->number;
+    }
+
+    node->accessed = 1;
 
-        if (next != NULL) {
-            njs_chb_append_literal(chain, ",");
+    if (dict->timeout) {
+        if (rc == NGX_OK) {
+            node->expire.key = now + timeout;
         }
+
+        ngx_rbtree_insert(&shard->rbtree_expire, &node->expire);
     }
 
-    njs_chb_append_literal(chain, "}");
+    if (rc == NGX_OK) {
+        ngx_js_dict_journal_add(dict, shard, node);
+    }
 
-    return NGX_OK;
+    return rc;
 }
 
 
-static u_char *
-ngx_js_skip_space(u_char *start, u_char *end)
+static ngx_int_t
+ngx_js_dict_batch_item(ngx_js_dict_t *dict, ngx_js_dict_batch_t *batch,
+    ngx_js_dict_shard_t *shard, ngx_uint_t i, ngx_msec_t now)
 {
-    u_char  *p;
+    ngx_js_dict_node_t        *node;
+    ngx_js_dict_batch_item_t  *item;
 
-    for (p = start; p != end; p++) {
+    item = &batch->items[i];
 
-        switch (*p) {
-        case ' ':
-        case '\t':
-        case '\r':
-        case '\n':
-            continue;
+    node = ngx_js_dict_lookup(shard, &item->key, item->hash);
+
+    switch (batch->op) {
+
+    case NGX_JS_DICT_BATCH_GET:
+        if (node == NULL || (dict->timeout && now >= node->expire.key)) {
+            return NGX_OK;
         }
 
-        break;
-    }
+        if (dict->evict == NGX_JS_DICT_EVICT_LRU) {
+            node->accessed = 1;
+        }
 
-    return p;
-}
+        return batch->handler(dict, batch, node, i);
 
+    case NGX_JS_DICT_BATCH_SET:
+        if (node == NULL) {
+            return ngx_js_dict_add_value(dict, shard, &item->key, item->hash,
+                                         &item->value, batch->timeout, now);
+        }
 
-static uint32_t
-ngx_js_unicode(const u_char *p)
-{
-    u_char      c;
-    uint32_t    utf;
-    njs_uint_t  i;
+        return ngx_js_dict_update_value(dict, shard, node, &item->value,
+                                        batch->timeout, now);
 
-    utf = 0;
+    default: /* NGX_JS_DICT_BATCH_INCR */
+        if (node == NULL) {
+            item->value.number += batch->init;
 
-    for (i = 0; i < 4; i++) {
-        utf <<= 4;
-        c = p[i] | 0x20;
-        c -= '0';
-        if (c > 9) {
-            c += '0' - 'a' + 10;
+            return ngx_js_dict_add_value(dict, shard, &item->key, item->hash,
+                                         &item->value, batch->timeout, now);
         }
 
-        utf |= c;
-    }
+        node->value.number += item->value.number;
+        node->accessed = 1;
+        item->value.number = node->value.number;
 
-    return utf;
+        if (dict->timeout) {
+            ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+            node->expire.key = now + batch->timeout;
+            ngx_rbtree_insert(&shard->rbtree_expire, &node->expire);
+        }
+
+        ngx_js_dict_journal_add(dict, shard, node);
+
+        return NGX_OK;
+    }
 }
 
 
-static u_char *
-ngx_js_dict_parse_string(ngx_pool_t *pool, u_char *p, u_char *end,
-    ngx_str_t *str, const char **err, u_char **at)
+/*
+ * Performs the batch operation taking the lock of each involved shard
+ * once: all keys of a shard are processed on the first encounter.
+ */
+
+static ngx_int_t
+ngx_js_dict_batch(ngx_js_dict_t *dict, ngx_js_dict_batch_t *batch)
 {
-    u_char    ch, *s, *dst, *start, *last;
-    size_t    size, surplus;
-    uint32_t  utf, utf_low;
+    ngx_int_t                  rc;
+    ngx_uint_t                 i, j;
+    ngx_msec_t                 now;
+    ngx_time_t                *tp;
+    ngx_js_dict_shard_t       *shard;
+    ngx_js_dict_batch_item_t  *item;
 
-    enum {
-        sw_usual = 0,
-        sw_escape,
-        sw_encoded1,
-        sw_encoded2,
-        sw_encoded3,
-        sw_encoded4,
-    } state;
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
 
-    if (*p != '"') {
-        *err = "unexpected character, expected '\"'";
-        goto error;
+    for (i = 0; i < batch->n; i++) {
+        item = &batch->items[i];
+
+        item->shard = ngx_js_dict_shard(dict, &item->key, &item->hash);
+        item->done = 0;
     }
 
-    start = p + 1;
+    rc = NGX_OK;
 
-    dst = NULL;
-    state = 0;
-    surplus = 0;
+    for (i = 0; i < batch->n && rc == NGX_OK; i++) {
+        if (batch->items[i].done) {
+            continue;
+        }
 
-    for (p = start; p < end; p++) {
-        ch = *p;
+        shard = batch->items[i].shard;
 
-        switch (state) {
+        if (batch->op == NGX_JS_DICT_BATCH_GET) {
+            ngx_rwlock_rlock(&shard->rwlock);
 
-        case sw_usual:
+        } else {
+            ngx_js_dict_write_lock(shard);
+        }
 
-            if (ch == '"') {
-                break;
-            }
+        for (j = i; j < batch->n; j++) {
+            item = &batch->items[j];
 
-            if (ch == '\\') {
-                state = sw_escape;
+            if (item->shard != shard) {
                 continue;
             }
 
-            if (ch >= ' ') {
-                continue;
+            item->done = 1;
+
+            rc = ngx_js_dict_batch_item(dict, batch, shard, j, now);
+            if (rc != NGX_OK) {
+                break;
             }
+        }
 
-            *err = "Invalid source char";
-            goto error;
+        if (batch->op == NGX_JS_DICT_BATCH_GET) {
+            ngx_rwlock_unlock(&shard->rwlock);
 
-        case sw_escape:
+        } else {
+            dict->sh->dirty = 1;
+            ngx_js_dict_write_unlock(shard);
+        }
+    }
 
-            switch (ch) {
-            case '"':
-            case '\\':
-            case '/':
-            case 'n':
-            case 'r':
+    if (batch->op != NGX_JS_DICT_BATCH_GET
+        && batch->n != 0
+        && dict->state_file.data
+        && !dict->save_event.timer_set)
+    {
+        ngx_add_timer(&dict->save_event, 1000);
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_js_dict_add(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_str_t *key, uint32_t hash, njs_value_t *value, ngx_msec_t timeout,
+    ngx_msec_t now)
+{
+    njs_str_t            string;
+    ngx_js_dict_value_t  entry;
+
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        njs_value_string_get(vm, value, &string);
+
+        entry.str.data = string.start;
+        entry.str.len = string.length;
+
+    } else {
+        /* GCC complains about uninitialized entry.str.data. */
+        entry.str.data = NULL;
+        entry.number = njs_value_number(value);
+    }
+
+    return ngx_js_dict_add_value(dict, shard, key, hash, &entry, timeout, now);
+}
+
+
+static ngx_int_t
+ngx_js_dict_update(njs_vm_t *vm, ngx_js_dict_t *dict,
+    ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node, njs_value_t *value,
+    ngx_msec_t timeout, ngx_msec_t now)
+{
+    njs_str_t            string;
+    ngx_js_dict_value_t  entry;
+
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        njs_value_string_get(vm, value, &string);
+
+        entry.str.data = string.start;
+        entry.str.len = string.length;
+
+    } else {
+        entry.number = njs_value_number(value);
+    }
+
+    return ngx_js_dict_update_value(dict, shard, node, &entry, timeout, now);
+}
+
+
+static ngx_int_t
+ngx_js_dict_delete(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
+    njs_value_t *retval)
+{
+    uint32_t              hash;
+    ngx_int_t             rc;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    ngx_js_dict_write_lock(shard);
+
+    node = ngx_js_dict_lookup(shard, key, hash);
+
+    if (node == NULL) {
+        ngx_js_dict_write_unlock(shard);
+        return NGX_DECLINED;
+    }
+
+    if (dict->timeout) {
+        ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+    }
+
+    ngx_js_dict_index_delete(shard, node);
+    ngx_js_dict_journal_delete(dict, shard, node);
+
+    if (retval != NULL) {
+        tp = ngx_timeofday();
+        now = tp->sec * 1000 + tp->msec;
+
+        if (!dict->timeout || now < node->expire.key) {
+            rc = ngx_js_dict_copy_value_locked(vm, dict, node, retval);
+
+        } else {
+            rc = NGX_DECLINED;
+        }
+
+    } else {
+        rc = NGX_OK;
+    }
+
+    ngx_js_dict_node_free(dict, node);
+
+    dict->sh->dirty = 1;
+
+    ngx_js_dict_write_unlock(shard);
+
+    if (dict->state_file.data && !dict->save_event.timer_set) {
+        ngx_add_timer(&dict->save_event, 1000);
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_js_dict_incr(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
+    njs_value_t *delta, njs_value_t *init, double *value, ngx_msec_t timeout)
+{
+    uint32_t              hash;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    ngx_js_dict_write_lock(shard);
+
+    node = ngx_js_dict_lookup(shard, key, hash);
+
+    if (node == NULL) {
+        njs_value_number_set(init, njs_value_number(init)
+                                   + njs_value_number(delta));
+        if (ngx_js_dict_add(vm, dict, shard, key, hash, init, timeout, now)
+            != NGX_OK)
+        {
+            ngx_js_dict_write_unlock(shard);
+            return NGX_ERROR;
+        }
+
+        *value = njs_value_number(init);
+
+    } else {
+        node->value.number += njs_value_number(delta);
+        node->accessed = 1;
+        *value = node->value.number;
+
+        if (dict->timeout) {
+            ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+            node->expire.key = now + timeout;
+            ngx_rbtree_insert(&shard->rbtree_expire, &node->expire);
+        }
+
+        ngx_js_dict_journal_add(dict, shard, node);
+    }
+
+    dict->sh->dirty = 1;
+
+    ngx_js_dict_write_unlock(shard);
+
+    if (dict->state_file.data && !dict->save_event.timer_set) {
+        ngx_add_timer(&dict->save_event, 1000);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_get(njs_vm_t *vm, ngx_js_dict_t *dict, ngx_str_t *key,
+    njs_value_t *retval)
+{
+    uint32_t              hash;
+    ngx_int_t             rc;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_value_t   value;
+    ngx_js_dict_shard_t  *shard;
+    u_char                buf[NGX_JS_DICT_OPTIMISTIC_MAX];
+
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    rc = ngx_js_dict_lookup_optimistic(dict, shard, key, hash, &value, buf,
+                                       sizeof(buf));
+
+    if (rc == NGX_DECLINED) {
+        njs_value_undefined_set(retval);
+        return NGX_OK;
+    }
+
+    if (rc == NGX_OK) {
+        if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+            if (njs_vm_value_string_create(vm, retval, value.str.data,
+                                           value.str.len)
+                != NJS_OK)
+            {
+                return NGX_ERROR;
+            }
+
+        } else {
+            njs_value_number_set(retval, value.number);
+        }
+
+        return NGX_OK;
+    }
+
+    /* NGX_AGAIN */
+
+    ngx_rwlock_rlock(&shard->rwlock);
+
+    node = ngx_js_dict_lookup(shard, key, hash);
+
+    if (node == NULL) {
+        goto not_found;
+    }
+
+    if (dict->timeout) {
+        tp = ngx_timeofday();
+        now = tp->sec * 1000 + tp->msec;
+
+        if (now >= node->expire.key) {
+            goto not_found;
+        }
+    }
+
+    if (dict->evict == NGX_JS_DICT_EVICT_LRU) {
+        node->accessed = 1;
+    }
+
+    rc = ngx_js_dict_copy_value_locked(vm, dict, node, retval);
+    ngx_rwlock_unlock(&shard->rwlock);
+
+    return rc;
+
+not_found:
+
+    ngx_rwlock_unlock(&shard->rwlock);
+    njs_value_undefined_set(retval);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_batch_keys(njs_vm_t *vm, njs_value_t *keys,
+    ngx_js_dict_batch_t *batch)
+{
+    int64_t              i, length;
+    njs_value_t         *key;
+    njs_opaque_value_t   lvalue;
+
+    ngx_memzero(batch, sizeof(ngx_js_dict_batch_t));
+
+    if (!njs_value_is_array(keys)) {
+        njs_vm_type_error(vm, "keys is not an array");
+        return NGX_ERROR;
+    }
+
+    if (njs_vm_array_length(vm, keys, &length) != NJS_OK) {
+        return NGX_ERROR;
+    }
+
+    if (length == 0) {
+        return NGX_OK;
+    }
+
+    batch->items = ngx_alloc(length * sizeof(ngx_js_dict_batch_item_t),
+                             ngx_cycle->log);
+    if (batch->items == NULL) {
+        njs_vm_memory_error(vm);
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < length; i++) {
+        key = njs_vm_array_prop(vm, keys, i, &lvalue);
+
+        if (key == NULL
+            || ngx_js_ngx_string(vm, key, &batch->items[i].key) != NGX_OK)
+        {
+            ngx_free(batch->items);
+            batch->items = NULL;
+            return NGX_ERROR;
+        }
+    }
+
+    batch->n = length;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_batch_timeout(njs_vm_t *vm, ngx_js_dict_t *dict,
+    njs_value_t *value, ngx_msec_t *timeout)
+{
+    if (njs_value_is_undefined(value)) {
+        *timeout = dict->timeout;
+        return NGX_OK;
+    }
+
+    if (!njs_value_is_number(value)) {
+        njs_vm_type_error(vm, "timeout is not a number");
+        return NGX_ERROR;
+    }
+
+    if (!dict->timeout) {
+        njs_vm_type_error(vm, "shared dict must be declared with timeout");
+        return NGX_ERROR;
+    }
+
+    *timeout = (ngx_msec_t) njs_value_number(value);
+
+    if (*timeout < 1) {
+        njs_vm_type_error(vm, "timeout must be greater than or equal to 1");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_batch_get(ngx_js_dict_t *dict, ngx_js_dict_batch_t *batch,
+    ngx_js_dict_node_t *node, ngx_uint_t i)
+{
+    njs_opaque_value_t  *values;
+
+    values = batch->retval;
+
+    return ngx_js_dict_copy_value_locked(batch->vm, dict, node,
+                                         njs_value_arg(&values[i]));
+}
+
+
+static ngx_int_t
+ngx_js_dict_copy_value_locked(njs_vm_t *vm, ngx_js_dict_t *dict,
+    ngx_js_dict_node_t *node, njs_value_t *retval)
+{
+    njs_int_t   ret;
+    ngx_uint_t  type;
+
+    type = dict->type;
+
+    if (type == NGX_JS_DICT_TYPE_STRING) {
+        ret = njs_vm_value_string_create(vm, retval, node->value.str.data,
+                                         node->value.str.len);
+        if (ret != NJS_OK) {
+            return NGX_ERROR;
+        }
+
+    } else {
+        njs_value_number_set(retval, node->value.number);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_js_dict_expire(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_msec_t now)
+{
+    ngx_rbtree_t        *rbtree;
+    ngx_rbtree_node_t   *rn, *next;
+    ngx_js_dict_node_t  *node;
+
+    rbtree = &shard->rbtree_expire;
+
+    if (rbtree->root == rbtree->sentinel) {
+        return;
+    }
+
+    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
+         rn != NULL;
+         rn = next)
+    {
+        if (rn->key > now) {
+            return;
+        }
+
+        node = (ngx_js_dict_node_t *)
+                   ((char *) rn - offsetof(ngx_js_dict_node_t, expire));
+
+        next = ngx_rbtree_next(rbtree, rn);
+
+        ngx_rbtree_delete(rbtree, rn);
+
+        ngx_js_dict_index_delete(shard, node);
+        ngx_js_dict_journal_delete(dict, shard, node);
+
+        ngx_js_dict_node_free(dict, node);
+    }
+}
+
+
+static void
+ngx_js_dict_evict(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_int_t count)
+{
+    ngx_rbtree_t        *rbtree;
+    ngx_rbtree_node_t   *rn, *next;
+    ngx_js_dict_node_t  *node;
+
+    if (dict->evict == NGX_JS_DICT_EVICT_LRU) {
+        ngx_js_dict_evict_lru(dict, shard, count);
+        return;
+    }
+
+    rbtree = &shard->rbtree_expire;
+
+    if (rbtree->root == rbtree->sentinel) {
+        return;
+    }
+
+    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
+         rn != NULL;
+         rn = next)
+    {
+        if (count-- == 0) {
+            return;
+        }
+
+        node = (ngx_js_dict_node_t *)
+                   ((char *) rn - offsetof(ngx_js_dict_node_t, expire));
+
+        next = ngx_rbtree_next(rbtree, rn);
+
+        ngx_rbtree_delete(rbtree, rn);
+
+        ngx_js_dict_index_delete(shard, node);
+        ngx_js_dict_journal_delete(dict, shard, node);
+
+        ngx_js_dict_node_free(dict, node);
+    }
+}
+
+
+/*
+ * An approximation of LRU with the CLOCK algorithm: the hand walks over
+ * the index slots, entries accessed since the previous pass get a second
+ * chance, the others are evicted.
+ */
+
+static void
+ngx_js_dict_evict_lru(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_int_t count)
+{
+    ngx_uint_t           n;
+    ngx_js_dict_node_t  *node;
+
+    for (n = 2 * shard->size; n != 0 && count != 0; n--) {
+
+        if (shard->used == 0) {
+            return;
+        }
+
+        shard->hand = (shard->hand + 1) & (shard->size - 1);
+
+        node = shard->slots[shard->hand].node;
+
+        if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+            continue;
+        }
+
+        if (node->accessed) {
+            if (node->accessed != NGX_JS_DICT_NODE_PINNED) {
+                node->accessed = 0;
+            }
+
+            continue;
+        }
+
+        if (dict->timeout) {
+            ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+        }
+
+        ngx_js_dict_index_delete(shard, node);
+        ngx_js_dict_journal_delete(dict, shard, node);
+
+        ngx_js_dict_node_free(dict, node);
+
+        count--;
+    }
+}
+
+
+static ngx_int_t
+ngx_js_render_string(njs_chb_t *chain, ngx_str_t *str)
+{
+    size_t        size;
+    u_char        c, *dst, *dst_end;
+    const u_char  *p, *end;
+
+    static char  hex2char[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                  '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+
+    p = str->data;
+    end = p + str->len;
+    size = str->len + 2;
+
+    dst = njs_chb_reserve(chain, size);
+    if (dst == NULL) {
+        return NGX_ERROR;
+    }
+
+    dst_end = dst + size;
+
+    *dst++ = '\"';
+    njs_chb_written(chain, 1);
+
+    while (p < end) {
+        if (dst_end <= dst + sizeof("\\uXXXX")) {
+            size = ngx_max(end - p + 1, 6);
+            dst = njs_chb_reserve(chain, size);
+            if (dst == NULL) {
+                return NGX_ERROR;
+            }
+
+            dst_end = dst + size;
+        }
+
+        if (*p < ' ' || *p == '\\' || *p == '\"') {
+            c = (u_char) *p++;
+            *dst++ = '\\';
+            njs_chb_written(chain, 2);
+
+            switch (c) {
+            case '\\':
+                *dst++ = '\\';
+                break;
+            case '"':
+                *dst++ = '\"';
+                break;
+            case '\r':
+                *dst++ = 'r';
+                break;
+            case '\n':
+                *dst++ = 'n';
+                break;
+            case '\t':
+                *dst++ = 't';
+                break;
+            case '\b':
+                *dst++ = 'b';
+                break;
+            case '\f':
+                *dst++ = 'f';
+                break;
+            default:
+                *dst++ = 'u';
+                *dst++ = '0';
+                *dst++ = '0';
+                *dst++ = hex2char[(c & 0xf0) >> 4];
+                *dst++ = hex2char[c & 0x0f];
+                njs_chb_written(chain, 4);
+            }
+
+            continue;
+        }
+
+        dst = njs_utf8_copy(dst, &p, end);
+
+        njs_chb_written(chain, dst - chain->last->pos);
+    }
+
+    njs_chb_append_literal(chain, "\"");
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_render_node(ngx_js_dict_t *dict, njs_chb_t *chain,
+    ngx_js_dict_node_t *node)
+{
+    u_char  *p, *dst;
+    size_t   len;
+
+    if (ngx_js_render_string(chain, &node->key) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    njs_chb_append_literal(chain,":{");
+
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        njs_chb_append_literal(chain,"\"value\":");
+
+        if (ngx_js_render_string(chain, &node->value.str) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+    } else {
+        len = sizeof("\"value\":.") + 18 + 6;
+        dst = njs_chb_reserve(chain, len);
+        if (dst == NULL) {
+            return NGX_ERROR;
+        }
+
+        p = njs_sprintf(dst, dst + len, "\"value\":%.6f",
+                        node->value.number);
+        njs_chb_written(chain, p - dst);
+    }
+
+    if (dict->timeout) {
+        len = sizeof(",\"expire\":1000000000");
+        dst = njs_chb_reserve(chain, len);
+        if (dst == NULL) {
+            return NGX_ERROR;
+        }
+
+        p = njs_sprintf(dst, dst + len, ",\"expire\":%ui",
+                        node->expire.key);
+        njs_chb_written(chain, p - dst);
+    }
+
+    njs_chb_append_literal(chain, "}");
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_render_json(ngx_js_dict_t *dict, njs_chb_t *chain)
+{
+    ngx_uint_t            i, j, n;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
+    njs_chb_append_literal(chain,"{");
+
+    n = 0;
+
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
+
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
+
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
+
+            if (dict->timeout && now >= node->expire.key) {
+                continue;
+            }
+
+            if (n++ != 0) {
+                njs_chb_append_literal(chain, ",");
+            }
+
+            if (ngx_js_dict_render_node(dict, chain, node) != NGX_OK) {
+                return NGX_ERROR;
+            }
+        }
+    }
+
+    njs_chb_append_literal(chain, "}");
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_render_binary(ngx_js_dict_t *dict, njs_chb_t *chain)
+{
+    uint32_t              n32;
+    uint64_t              n64;
+    ngx_uint_t            i, j;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
+    njs_chb_append_literal(chain, NGX_JS_DICT_BINARY_MAGIC);
+
+    n32 = NGX_JS_DICT_BINARY_VERSION;
+    njs_chb_append(chain, &n32, sizeof(uint32_t));
+
+    n32 = dict->type;
+    njs_chb_append(chain, &n32, sizeof(uint32_t));
+
+    n32 = dict->timeout ? NGX_JS_DICT_BINARY_TIMEOUT : 0;
+    njs_chb_append(chain, &n32, sizeof(uint32_t));
+
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
+
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
+
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
+
+            if (dict->timeout && now >= node->expire.key) {
+                continue;
+            }
+
+            n32 = node->key.len;
+            njs_chb_append(chain, &n32, sizeof(uint32_t));
+            njs_chb_append(chain, node->key.data, node->key.len);
+
+            if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+                n32 = node->value.str.len;
+                njs_chb_append(chain, &n32, sizeof(uint32_t));
+                njs_chb_append(chain, node->value.str.data,
+                               node->value.str.len);
+
+            } else {
+                njs_chb_append(chain, &node->value.number, sizeof(double));
+            }
+
+            if (dict->timeout) {
+                n64 = node->expire.key;
+                njs_chb_append(chain, &n64, sizeof(uint64_t));
+            }
+        }
+    }
+
+    return chain->error ? NGX_ERROR : NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_js_dict_render_journal(ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    njs_chb_t *chain, ngx_uint_t *n, ngx_msec_t now)
+{
+    ngx_queue_t              *q;
+    ngx_js_dict_node_t       *node;
+    ngx_js_dict_tombstone_t  *ts;
+
+    /*
+     * a key set again after its deletion is in the journal,
+     * so tombstones are replayed first
+     */
+
+    for (q = ngx_queue_head(&shard->tombstones);
+         q != ngx_queue_sentinel(&shard->tombstones);
+         q = ngx_queue_next(q))
+    {
+        ts = ngx_queue_data(q, ngx_js_dict_tombstone_t, queue);
+
+        if ((*n)++ != 0) {
+            njs_chb_append_literal(chain, ",");
+        }
+
+        if (ngx_js_render_string(chain, &ts->key) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        njs_chb_append_literal(chain, ":{\"deleted\":1}");
+    }
+
+    for (q = ngx_queue_head(&shard->journal);
+         q != ngx_queue_sentinel(&shard->journal);
+         q = ngx_queue_next(q))
+    {
+        node = ngx_queue_data(q, ngx_js_dict_node_t, journal);
+
+        if ((*n)++ != 0) {
+            njs_chb_append_literal(chain, ",");
+        }
+
+        if (dict->timeout && now >= node->expire.key) {
+            if (ngx_js_render_string(chain, &node->key) != NGX_OK) {
+                return NGX_ERROR;
+            }
+
+            njs_chb_append_literal(chain, ":{\"deleted\":1}");
+            continue;
+        }
+
+        if (ngx_js_dict_render_node(dict, chain, node) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static u_char *
+ngx_js_skip_space(u_char *start, u_char *end)
+{
+    u_char  *p;
+
+    for (p = start; p != end; p++) {
+
+        switch (*p) {
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            continue;
+        }
+
+        break;
+    }
+
+    return p;
+}
+
+
+static uint32_t
+ngx_js_unicode(const u_char *p)
+{
+    u_char      c;
+    uint32_t    utf;
+    njs_uint_t  i;
+
+    utf = 0;
+
+    for (i = 0; i < 4; i++) {
+        utf <<= 4;
+        c = p[i] | 0x20;
+        c -= '0';
+        if (c > 9) {
+            c += '0' - 'a' + 10;
+        }
+
+        utf |= c;
+    }
+
+    return utf;
+}
+
+
+static u_char *
+ngx_js_dict_parse_string(ngx_pool_t *pool, u_char *p, u_char *end,
+    ngx_str_t *str, const char **err, u_char **at)
+{
+    u_char    ch, *s, *dst, *start, *last;
+    size_t    size, surplus;
+    uint32_t  utf, utf_low;
+
+    enum {
+        sw_usual = 0,
+        sw_escape,
+        sw_encoded1,
+        sw_encoded2,
+        sw_encoded3,
+        sw_encoded4,
+    } state;
+
+    if (*p != '"') {
+        *err = "unexpected character, expected '\"'";
+        goto error;
+    }
+
+    start = p + 1;
+
+    dst = NULL;
+    state = 0;
+    surplus = 0;
+
+    for (p = start; p < end; p++) {
+        ch = *p;
+
+        switch (state) {
+
+        case sw_usual:
+
+            if (ch == '"') {
+                break;
+            }
+
+            if (ch == '\\') {
+                state = sw_escape;
+                continue;
+            }
+
+            if (ch >= ' ') {
+                continue;
+            }
+
+            *err = "Invalid source char";
+            goto error;
+
+        case sw_escape:
+
+            switch (ch) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'n':
+            case 'r':
             case 't':
             case 'b':
             case 'f':
@@ -2013,657 +3495,1191 @@ ngx_js_dict_parse_string(ngx_pool_t *pool, u_char *p, u_char *end,
                 state = sw_usual;
                 continue;
 
-            case 'u':
-                /*
-                 * Basic unicode 6 bytes "\uXXXX" in JSON
-                 * and up to 3 bytes in UTF-8.
-                 *
-                 * Surrogate pair: 12 bytes "\uXXXX\uXXXX" in JSON
-                 * and 3 or 4 bytes in UTF-8.
-                 */
-                surplus += 3;
-                state = sw_encoded1;
-                continue;
+            case 'u':
+                /*
+                 * Basic unicode 6 bytes "\uXXXX" in JSON
+                 * and up to 3 bytes in UTF-8.
+                 *
+                 * Surrogate pair: 12 bytes "\uXXXX\uXXXX" in JSON
+                 * and 3 or 4 bytes in UTF-8.
+                 */
+                surplus += 3;
+                state = sw_encoded1;
+                continue;
+            }
+
+            *err = "Invalid escape char";
+            goto error;
+
+        case sw_encoded1:
+        case sw_encoded2:
+        case sw_encoded3:
+        case sw_encoded4:
+
+            if ((ch >= '0' && ch <= '9')
+                || (ch >= 'A' && ch <= 'F')
+                || (ch >= 'a' && ch <= 'f'))
+            {
+                state = (state == sw_encoded4) ? sw_usual : state + 1;
+                continue;
+            }
+
+            *err = "Invalid Unicode escape sequence";
+            goto error;
+        }
+
+        break;
+    }
+
+    if (p == end) {
+        *err = "unexpected end of input";
+        goto error;
+    }
+
+    /* Points to the ending quote mark. */
+    last = p;
+
+    size = last - start - surplus;
+
+    if (surplus != 0) {
+        p = start;
+
+        dst = ngx_palloc(pool, size);
+        if (dst == NULL) {
+            *err = "out of memory";
+            goto error;
+        }
+
+        s = dst;
+
+        do {
+            ch = *p++;
+
+            if (ch != '\\') {
+                *s++ = ch;
+                continue;
+            }
+
+            ch = *p++;
+
+            switch (ch) {
+            case '"':
+            case '\\':
+            case '/':
+                *s++ = ch;
+                continue;
+
+            case 'n':
+                *s++ = '\n';
+                continue;
+
+            case 'r':
+                *s++ = '\r';
+                continue;
+
+            case 't':
+                *s++ = '\t';
+                continue;
+
+            case 'b':
+                *s++ = '\b';
+                continue;
+
+            case 'f':
+                *s++ = '\f';
+                continue;
+            }
+
+            /* "\uXXXX": Unicode escape sequence. */
+
+            utf = ngx_js_unicode(p);
+            p += 4;
+
+            if (njs_surrogate_any(utf)) {
+
+                if (utf > 0xdbff || p[0] != '\\' || p[1] != 'u') {
+                    s = njs_utf8_encode(s, NJS_UNICODE_REPLACEMENT);
+                    continue;
+                }
+
+                p += 2;
+
+                utf_low = ngx_js_unicode(p);
+                p += 4;
+
+                if (njs_fast_path(njs_surrogate_trailing(utf_low))) {
+                    utf = njs_surrogate_pair(utf, utf_low);
+
+                } else if (njs_surrogate_leading(utf_low)) {
+                    utf = NJS_UNICODE_REPLACEMENT;
+                    s = njs_utf8_encode(s, NJS_UNICODE_REPLACEMENT);
+
+                } else {
+                    utf = utf_low;
+                    s = njs_utf8_encode(s, NJS_UNICODE_REPLACEMENT);
+                }
+            }
+
+            s = njs_utf8_encode(s, utf);
+
+        } while (p != last);
+
+        size = s - dst;
+        start = dst;
+    }
+
+    str->data = start;
+    str->len = size;
+
+    return p + 1;
+
+error:
+
+    *at = p;
+
+    return NULL;
+}
+
+
+static u_char *
+ngx_js_dict_parse_entry(ngx_js_dict_t *dict, ngx_pool_t *pool,
+    ngx_js_dict_entry_t *entry, u_char *buf, u_char *end, const char **err,
+    u_char **at)
+{
+    int         see_value;
+    u_char     *p, *pp;
+    double      number;
+    ngx_str_t   key, str;
+
+    p = buf;
+
+    if (*p++ != '{') {
+        *err = "unexpected character, expected '{'";
+        goto error;
+    }
+
+    see_value = 0;
+
+    while (1) {
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p == '}') {
+            break;
+        }
+
+        p = ngx_js_dict_parse_string(pool, p, end, &key, err, at);
+        if (p == NULL) {
+            return NULL;
+        }
+
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p++ != ':') {
+            *err = "unexpected character, expected ':'";
+            goto error;
+        }
+
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p == '\"') {
+            p = ngx_js_dict_parse_string(pool, p, end, &str, err, at);
+            if (p == NULL) {
+                return NULL;
+            }
+
+            if (key.len == 5 && ngx_strncmp(key.data, "value", 5) == 0) {
+                if (dict->type != NGX_JS_DICT_TYPE_STRING) {
+                    *err = "expected string value";
+                    goto error;
+                }
+
+                entry->value.str = str;
+                see_value = 1;
+            }
+
+        } else {
+            pp = p;
+            number = strtod((char *) p, (char **) &p);
+            if (pp == p) {
+                *err = "invalid number value";
+                goto error;
+            }
+
+            if (key.len == 5 && ngx_strncmp(key.data, "value", 5) == 0) {
+                if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+                    *err = "expected number value";
+                    goto error;
+                }
+
+                entry->value.number = number;
+                see_value = 1;
+
+            } else if (key.len == 6
+                       && ngx_strncmp(key.data, "expire", 6) == 0)
+            {
+                entry->expire = number;
+
+            } else if (key.len == 7
+                       && ngx_strncmp(key.data, "deleted", 7) == 0)
+            {
+                entry->deleted = (number != 0);
             }
+        }
+
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    if (!see_value && !entry->deleted) {
+        *err = "missing value";
+        goto error;
+    }
+
+    return p + 1;
+
+error:
+
+    *at = p;
+
+    return NULL;
+}
+
+
+static u_char *
+ngx_js_dict_parse_object(ngx_js_dict_t *dict, ngx_pool_t *pool,
+    ngx_array_t *entries, u_char *buf, u_char *end, const char **err,
+    u_char **at)
+{
+    u_char               *p;
+    ngx_js_dict_entry_t  *e;
+
+    p = buf;
+
+    if (*p++ != '{') {
+        *err = "json must start with '{'";
+        goto error;
+    }
+
+    while (1) {
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p == '}') {
+            p++;
+            break;
+        }
+
+        e = ngx_array_push(entries);
+        if (e == NULL) {
+            *err = "out of memory";
+            goto error;
+        }
+
+        ngx_memzero(e, sizeof(ngx_js_dict_entry_t));
+
+        p = ngx_js_dict_parse_string(pool, p, end, &e->key, err, at);
+        if (p == NULL) {
+            return NULL;
+        }
+
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p++ != ':') {
+            *err = "unexpected character, expected ':'";
+            goto error;
+        }
+
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        p = ngx_js_dict_parse_entry(dict, pool, e, p, end, err, at);
+        if (p == NULL) {
+            return NULL;
+        }
+
+        p = ngx_js_skip_space(p, end);
+        if (p == end) {
+            *err = "unexpected end of json";
+            goto error;
+        }
+
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    return p;
+
+error:
+
+    *at = p;
+
+    return NULL;
+}
+
+
+/*
+ * The state file contains a single json object, the journal is a sequence
+ * of objects appended by each save.  A journal may end with an incomplete
+ * object if a save was interrupted, it is ignored.
+ */
+
+static ngx_int_t
+ngx_js_dict_parse_state(ngx_js_dict_t *dict, ngx_pool_t *pool,
+    ngx_array_t *entries, u_char *buf, u_char *end, u_char *name,
+    ngx_uint_t journal)
+{
+    u_char      *p, *at;
+    ngx_uint_t   nelts;
+    const char  *err;
+
+    /* GCC complains about uninitialized err, at. */
+
+    err = "";
+    at = NULL;
+
+    p = ngx_js_skip_space(buf, end);
+    if (p == end) {
+        if (journal) {
+            return NGX_OK;
+        }
 
-            *err = "Invalid escape char";
-            goto error;
+        err = "empty json";
+        goto error;
+    }
 
-        case sw_encoded1:
-        case sw_encoded2:
-        case sw_encoded3:
-        case sw_encoded4:
+    for ( ;; ) {
+        nelts = entries->nelts;
 
-            if ((ch >= '0' && ch <= '9')
-                || (ch >= 'A' && ch <= 'F')
-                || (ch >= 'a' && ch <= 'f'))
-            {
-                state = (state == sw_encoded4) ? sw_usual : state + 1;
-                continue;
+        p = ngx_js_dict_parse_object(dict, pool, entries, p, end, &err, &at);
+        if (p == NULL) {
+            p = at;
+
+            if (journal) {
+                entries->nelts = nelts;
+
+                ngx_log_error(NGX_LOG_WARN, dict->shm_zone->shm.log, 0,
+                              "ignoring the tail of journal \"%s\" of "
+                              "js_shared_dict_zone \"%V\": %s at offset %z",
+                              name, &dict->shm_zone->shm.name, err, p - buf);
+                return NGX_OK;
             }
 
-            *err = "Invalid Unicode escape sequence";
             goto error;
         }
 
-        break;
+        p = ngx_js_skip_space(p, end);
+
+        if (p == end) {
+            break;
+        }
+
+        if (!journal) {
+            err = "unexpected character, expected end of json";
+            goto error;
+        }
     }
 
-    if (p == end) {
-        *err = "unexpected end of input";
-        goto error;
+    return NGX_OK;
+
+error:
+
+    ngx_log_error(NGX_LOG_EMERG, dict->shm_zone->shm.log, 0,
+                  "invalid format while loading js_shared_dict_zone \"%V\""
+                  " from state file \"%s\": %s at offset %z",
+                  &dict->shm_zone->shm.name, name, err, p - buf);
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_js_dict_write_file(ngx_js_dict_t *dict, ngx_pool_t *pool,
+    njs_chb_t *chain, ngx_str_t *name, ngx_uint_t append)
+{
+    off_t             offset;
+    ngx_int_t         rc;
+    ngx_log_t        *log;
+    ngx_file_t        file;
+    ngx_chain_t      *out, *cl, **ll;
+    njs_chb_node_t   *node;
+    ngx_file_info_t   fi;
+
+    log = dict->shm_zone->shm.log;
+
+    out = NULL;
+    ll = &out;
+
+    for (node = chain->nodes; node != NULL; node = node->next) {
+        cl = ngx_alloc_chain_link(pool);
+        if (cl == NULL) {
+            return NGX_ERROR;
+        }
+
+        cl->buf = ngx_calloc_buf(pool);
+        if (cl->buf == NULL) {
+            return NGX_ERROR;
+        }
+
+        cl->buf->pos = node->start;
+        cl->buf->last = node->pos;
+        cl->buf->memory = 1;
+        cl->buf->last_buf = (node->next == NULL) ? 1 : 0;
+
+        *ll = cl;
+        ll = &cl->next;
     }
 
-    /* Points to the ending quote mark. */
-    last = p;
+    *ll = NULL;
 
-    size = last - start - surplus;
+    ngx_memzero(&file, sizeof(ngx_file_t));
+    file.name = *name;
+    file.log = log;
 
-    if (surplus != 0) {
-        p = start;
+    file.fd = ngx_open_file(file.name.data, NGX_FILE_WRONLY,
+                            append ? NGX_FILE_CREATE_OR_OPEN
+                                   : NGX_FILE_TRUNCATE,
+                            NGX_FILE_DEFAULT_ACCESS);
 
-        dst = ngx_palloc(pool, size);
-        if (dst == NULL) {
-            *err = "out of memory";
-            goto error;
+    if (file.fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", file.name.data);
+        return NGX_ERROR;
+    }
+
+    offset = 0;
+
+    if (append) {
+        if (ngx_fd_info(file.fd, &fi) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          ngx_fd_info_n " \"%s\" failed", file.name.data);
+            rc = NGX_ERROR;
+            goto done;
         }
 
-        s = dst;
+        offset = ngx_file_size(&fi);
+    }
 
-        do {
-            ch = *p++;
+    rc = ngx_write_chain_to_file(&file, out, offset, pool);
 
-            if (ch != '\\') {
-                *s++ = ch;
-                continue;
-            }
+    if (rc == NGX_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_write_fd_n " \"%s\" failed", file.name.data);
 
-            ch = *p++;
+    } else {
+        rc = NGX_OK;
+    }
 
-            switch (ch) {
-            case '"':
-            case '\\':
-            case '/':
-                *s++ = ch;
-                continue;
+done:
 
-            case 'n':
-                *s++ = '\n';
-                continue;
+    if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", file.name.data);
+    }
 
-            case 'r':
-                *s++ = '\r';
-                continue;
+    return rc;
+}
 
-            case 't':
-                *s++ = '\t';
-                continue;
 
-            case 'b':
-                *s++ = '\b';
-                continue;
+static ngx_int_t
+ngx_js_dict_save_journal(ngx_js_dict_t *dict, ngx_pool_t *pool)
+{
+    int64_t               size;
+    ngx_int_t             rc;
+    ngx_uint_t            i, n;
+    njs_chb_t             chain;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_shard_t  *shard;
 
-            case 'f':
-                *s++ = '\f';
-                continue;
-            }
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
 
-            /* "\uXXXX": Unicode escape sequence. */
+    NGX_CHB_CTX_INIT(&chain, pool);
 
-            utf = ngx_js_unicode(p);
-            p += 4;
+    njs_chb_append_literal(&chain, "{");
 
-            if (njs_surrogate_any(utf)) {
+    n = 0;
+    rc = NGX_OK;
 
-                if (utf > 0xdbff || p[0] != '\\' || p[1] != 'u') {
-                    s = njs_utf8_encode(s, NJS_UNICODE_REPLACEMENT);
-                    continue;
-                }
+    dict->sh->dirty = 0;
 
-                p += 2;
+    /*
+     * Only writers and the process holding sh->writing modify the journal
+     * queues, so the read lock is enough.  Unlike a snapshot, the journal
+     * does not require all the shards to be locked at once.
+     */
 
-                utf_low = ngx_js_unicode(p);
-                p += 4;
+    for (i = 0; i < dict->sh->nshards; i++) {
+        shard = dict->sh->shards[i];
 
-                if (njs_fast_path(njs_surrogate_trailing(utf_low))) {
-                    utf = njs_surrogate_pair(utf, utf_low);
+        ngx_rwlock_rlock(&shard->rwlock);
 
-                } else if (njs_surrogate_leading(utf_low)) {
-                    utf = NJS_UNICODE_REPLACEMENT;
-                    s = njs_utf8_encode(s, NJS_UNICODE_REPLACEMENT);
+        if (rc == NGX_OK) {
+            rc = ngx_js_dict_render_journal(dict, shard, &chain, &n, now);
+        }
 
-                } else {
-                    utf = utf_low;
-                    s = njs_utf8_encode(s, NJS_UNICODE_REPLACEMENT);
-                }
-            }
+        ngx_js_dict_journal_reset(dict, shard);
 
-            s = njs_utf8_encode(s, utf);
+        ngx_rwlock_unlock(&shard->rwlock);
+    }
 
-        } while (p != last);
+    njs_chb_append_literal(&chain, "}\n");
 
-        size = s - dst;
-        start = dst;
+    size = njs_chb_size(&chain);
+
+    if (rc != NGX_OK || size < 0) {
+        goto failed;
     }
 
-    str->data = start;
-    str->len = size;
+    if (n == 0) {
+        return NGX_OK;
+    }
 
-    return p + 1;
+    if (ngx_js_dict_write_file(dict, pool, &chain, &dict->journal_file, 1)
+        != NGX_OK)
+    {
+        goto failed;
+    }
 
-error:
+    dict->sh->journal_size += size;
 
-    *at = p;
+    return NGX_OK;
 
-    return NULL;
+failed:
+
+    /* the changes are lost from the journal, a snapshot will have them */
+
+    dict->sh->compact = 1;
+    dict->sh->dirty = 1;
+
+    return NGX_ERROR;
 }
 
 
-static u_char *
-ngx_js_dict_parse_entry(ngx_js_dict_t *dict, ngx_pool_t *pool,
-    ngx_js_dict_entry_t *entry, u_char *buf, u_char *end, const char **err,
-    u_char **at)
+static ngx_int_t
+ngx_js_dict_delete_file(ngx_log_t *log, ngx_str_t *name)
 {
-    int         see_value;
-    u_char     *p, *pp;
-    double      number;
-    ngx_str_t   key, str;
+    if (ngx_delete_file(name->data) == NGX_FILE_ERROR
+        && ngx_errno != NGX_ENOENT)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_delete_file_n " \"%s\" failed", name->data);
+        return NGX_ERROR;
+    }
 
-    p = buf;
+    return NGX_OK;
+}
 
-    if (*p++ != '{') {
-        *err = "unexpected character, expected '{'";
-        goto error;
+
+static ngx_int_t
+ngx_js_dict_save(ngx_js_dict_t *dict)
+{
+
+    int64_t                 size;
+    ngx_int_t               rc;
+    ngx_log_t              *log;
+    ngx_uint_t              i;
+    njs_chb_t               chain;
+    ngx_pool_t             *pool;
+    ngx_ext_rename_file_t   ext;
+
+    log = dict->shm_zone->shm.log;
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NGX_ERROR;
     }
 
-    see_value = 0;
+    if (!dict->sh->dirty) {
+        ngx_destroy_pool(pool);
+        return NGX_OK;
+    }
 
-    while (1) {
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            *err = "unexpected end of json";
-            goto error;
-        }
+    if (!ngx_atomic_cmp_set(&dict->sh->writing, 0, 1)) {
+        ngx_destroy_pool(pool);
+        return NGX_AGAIN;
+    }
 
-        if (*p == '}') {
-            break;
-        }
+    if (dict->journal
+        && !dict->sh->compact
+        && dict->sh->journal_size < dict->sh->snapshot_size)
+    {
+        rc = ngx_js_dict_save_journal(dict, pool);
 
-        p = ngx_js_dict_parse_string(pool, p, end, &key, err, at);
-        if (p == NULL) {
-            return NULL;
-        }
+        /* no lock required */
+        dict->sh->writing = 0;
+        ngx_destroy_pool(pool);
+
+        return rc;
+    }
+
+    /* a consistent snapshot requires all the shards to be locked */
+
+    for (i = 0; i < dict->sh->nshards; i++) {
+        ngx_rwlock_rlock(&dict->sh->shards[i]->rwlock);
+    }
+
+    NGX_CHB_CTX_INIT(&chain, pool);
+
+    if (dict->state_format == NGX_JS_DICT_STATE_BINARY) {
+        rc = ngx_js_dict_render_binary(dict, &chain);
+
+    } else {
+        rc = ngx_js_dict_render_json(dict, &chain);
+    }
 
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            *err = "unexpected end of json";
-            goto error;
-        }
+    if (rc == NGX_OK) {
+        dict->sh->dirty = 0;
 
-        if (*p++ != ':') {
-            *err = "unexpected character, expected ':'";
-            goto error;
-        }
+        if (dict->journal) {
+            for (i = 0; i < dict->sh->nshards; i++) {
+                ngx_js_dict_journal_reset(dict, dict->sh->shards[i]);
+            }
 
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            *err = "unexpected end of json";
-            goto error;
+            dict->sh->compact = 0;
         }
+    }
 
-        if (*p == '\"') {
-            p = ngx_js_dict_parse_string(pool, p, end, &str, err, at);
-            if (p == NULL) {
-                return NULL;
-            }
+    for (i = 0; i < dict->sh->nshards; i++) {
+        ngx_rwlock_unlock(&dict->sh->shards[i]->rwlock);
+    }
 
-            if (key.len == 5 && ngx_strncmp(key.data, "value", 5) == 0) {
-                if (dict->type != NGX_JS_DICT_TYPE_STRING) {
-                    *err = "expected string value";
-                    goto error;
-                }
+    if (rc != NGX_OK) {
+        dict->sh->writing = 0;
+        ngx_destroy_pool(pool);
+        return rc;
+    }
 
-                entry->value.str = str;
-                see_value = 1;
-            }
+    size = njs_chb_size(&chain);
+    if (size < 0) {
+        goto error;
+    }
 
-        } else {
-            pp = p;
-            number = strtod((char *) p, (char **) &p);
-            if (pp == p) {
-                *err = "invalid number value";
-                goto error;
-            }
+    if (dict->journal
+        && ngx_js_dict_delete_file(log, &dict->journal_old_file) != NGX_OK)
+    {
+        goto error;
+    }
 
-            if (key.len == 5 && ngx_strncmp(key.data, "value", 5) == 0) {
-                if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-                    *err = "expected number value";
-                    goto error;
-                }
+    if (ngx_js_dict_write_file(dict, pool, &chain, &dict->state_temp_file, 0)
+        != NGX_OK)
+    {
+        goto error;
+    }
 
-                entry->value.number = number;
-                see_value = 1;
+    if (dict->journal) {
 
-            } else if (key.len == 6
-                       && ngx_strncmp(key.data, "expire", 6) == 0)
-            {
-                entry->expire = number;
-            }
-        }
+        /*
+         * The journal is moved aside before the snapshot is renamed
+         * into place, so its records are never replayed over a newer
+         * snapshot.  See ngx_js_dict_load_interrupted().
+         */
 
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            *err = "unexpected end of json";
+        if (ngx_rename_file(dict->journal_file.data,
+                            dict->journal_old_file.data)
+            == NGX_FILE_ERROR
+            && ngx_errno != NGX_ENOENT)
+        {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          ngx_rename_file_n " \"%s\" to \"%s\" failed",
+                          dict->journal_file.data,
+                          dict->journal_old_file.data);
             goto error;
         }
-
-        if (*p == ',') {
-            p++;
-        }
     }
 
-    if (!see_value) {
-        *err = "missing value";
+    ext.access = 0;
+    ext.time = -1;
+    ext.create_path = 0;
+    ext.delete_file = 0;
+    ext.log = log;
+
+    if (ngx_ext_rename_file(&dict->state_temp_file, &dict->state_file, &ext)
+        != NGX_OK)
+    {
         goto error;
     }
 
-    return p + 1;
+    if (dict->journal) {
+        (void) ngx_js_dict_delete_file(log, &dict->journal_old_file);
+
+        dict->sh->snapshot_size = size;
+        dict->sh->journal_size = 0;
+    }
+
+    /* no lock required */
+    dict->sh->writing = 0;
+    ngx_destroy_pool(pool);
+
+    return NGX_OK;
 
 error:
 
-    *at = p;
+    ngx_destroy_pool(pool);
 
-    return NULL;
+    /* no lock required */
+    if (dict->journal) {
+        dict->sh->compact = 1;
+    }
+
+    dict->sh->writing = 0;
+    dict->sh->dirty = 1;
+
+    return NGX_ERROR;
 }
 
 
 static ngx_int_t
-ngx_js_dict_parse_state(ngx_js_dict_t *dict, ngx_pool_t *pool,
-    ngx_array_t *entries, u_char *buf, u_char *end)
+ngx_js_dict_read_file(ngx_js_dict_t *dict, ngx_pool_t *pool, u_char *name,
+    ngx_str_t *content)
 {
-    u_char               *p, *at;
-    const char           *err;
-    ngx_js_dict_entry_t  *e;
-
-    /* GCC complains about uninitialized err, at. */
+    off_t             size;
+    ssize_t           n;
+    ngx_fd_t          fd;
+    ngx_err_t         err;
+    ngx_log_t        *log;
+    ngx_file_info_t   fi;
 
-    err = "";
-    at = NULL;
+    log = dict->shm_zone->shm.log;
 
-    p = ngx_js_skip_space(buf, end);
-    if (p == end) {
-        err = "empty json";
-        goto error;
-    }
+    content->data = NULL;
+    content->len = 0;
 
-    if (*p++ != '{') {
-        err = "json must start with '{'";
-        goto error;
-    }
+    fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+    if (fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
 
-    while (1) {
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            err = "unexpected end of json";
-            goto error;
+        if (err == NGX_ENOENT || err == NGX_ENOPATH) {
+            return NGX_OK;
         }
 
-        if (*p == '}') {
-            p++;
-            break;
-        }
+        ngx_log_error(NGX_LOG_EMERG, log, err,
+                      ngx_open_file_n " \"%s\" failed", name);
+        return NGX_ERROR;
+    }
 
-        e = ngx_array_push(entries);
-        if (e == NULL) {
-            return NGX_ERROR;
-        }
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", name);
+        goto failed;
+    }
 
-        p = ngx_js_dict_parse_string(pool, p, end, &e->key, &err, &at);
-        if (p == NULL) {
-            p = at;
-            goto error;
-        }
+    size = ngx_file_size(&fi);
 
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            err = "unexpected end of json";
-            goto error;
-        }
+    if (size == 0) {
 
-        if (*p++ != ':') {
-            err = "unexpected character, expected ':'";
-            goto error;
+        if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                          ngx_close_file_n " \"%s\" failed", name);
         }
 
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            err = "unexpected end of json";
-            goto error;
-        }
+        return NGX_OK;
+    }
 
-        p = ngx_js_dict_parse_entry(dict, pool, e, p, end, &err, &at);
-        if (p == NULL) {
-            p = at;
-            goto error;
-        }
+    content->len = size;
 
-        p = ngx_js_skip_space(p, end);
-        if (p == end) {
-            err = "unexpected end of json";
-            goto error;
-        }
+    content->data = ngx_pnalloc(pool, content->len);
+    if (content->data == NULL) {
+        goto failed;
+    }
 
-        if (*p == ',') {
-            p++;
-        }
+    n = ngx_read_fd(fd, content->data, content->len);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      ngx_read_fd_n " \"%s\" failed", name);
+        goto failed;
     }
 
-    p = ngx_js_skip_space(p, end);
+    if ((size_t) n != content->len) {
+        ngx_log_error(NGX_LOG_EMERG, log, 0,
+                      ngx_read_fd_n " has read only %z of %uz from %s",
+                      n, content->len, name);
+        goto failed;
+    }
 
-    if (p != end) {
-        err = "unexpected character, expected end of json";
-        goto error;
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name);
+        return NGX_ERROR;
     }
 
     return NGX_OK;
 
-error:
+failed:
 
-    ngx_log_error(NGX_LOG_EMERG, dict->shm_zone->shm.log, 0,
-                  "invalid format while loading js_shared_dict_zone \"%V\""
-                  " from state file \"%s\": %s at offset %z",
-                  &dict->shm_zone->shm.name, dict->state_file.data, err,
-                  p - buf);
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name);
+    }
 
     return NGX_ERROR;
 }
 
 
 static ngx_int_t
-ngx_js_dict_save(ngx_js_dict_t *dict)
+ngx_js_dict_load_entry(ngx_js_dict_t *dict, ngx_js_dict_entry_t *entry,
+    ngx_msec_t now, ngx_uint_t replace)
 {
+    uint32_t              hash;
+    ngx_msec_t            expire;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
-    u_char                 *name;
-    ngx_int_t               rc;
-    ngx_log_t              *log;
-    njs_chb_t               chain;
-    ngx_file_t              file;
-    ngx_pool_t             *pool;
-    ngx_chain_t            *out, *cl, **ll;
-    njs_chb_node_t         *node;
-    ngx_ext_rename_file_t   ext;
+    shard = ngx_js_dict_shard(dict, &entry->key, &hash);
 
-    log = dict->shm_zone->shm.log;
+    node = ngx_js_dict_lookup(shard, &entry->key, hash);
 
-    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
-    if (pool == NULL) {
-        return NGX_ERROR;
-    }
+    if (node != NULL) {
+        if (!replace) {
+            return NGX_ERROR;
+        }
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
+        /* a journal record replaces the previous one */
 
-    if (!dict->sh->dirty) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        ngx_destroy_pool(pool);
-        return NGX_OK;
+        if (dict->timeout) {
+            ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
+        }
+
+        ngx_js_dict_index_delete(shard, node);
+        ngx_js_dict_node_free(dict, node);
     }
 
-    if (dict->sh->writing) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        ngx_destroy_pool(pool);
-        return NGX_AGAIN;
+    if (entry->deleted) {
+        return NGX_OK;
     }
 
-    ngx_rwlock_downgrade(&dict->sh->rwlock);
+    if (dict->timeout) {
+        expire = entry->expire;
 
-    NGX_CHB_CTX_INIT(&chain, pool);
+        if (expire && now >= expire) {
+            dict->sh->dirty = 1;
+            return NGX_OK;
+        }
 
-    rc = ngx_js_dict_render_json(dict, &chain);
+        if (expire == 0) {
+            /* treat state without expire as new */
+            expire = now + dict->timeout;
+            dict->sh->dirty = 1;
+        }
 
-    if (rc != NGX_OK) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        ngx_destroy_pool(pool);
-        return rc;
+    } else {
+        expire = 0;
     }
 
-    dict->sh->writing = 1;
-    dict->sh->dirty = 0;
-
-    ngx_rwlock_unlock(&dict->sh->rwlock);
-
-    name = dict->state_temp_file.data;
+    return ngx_js_dict_add_value(dict, shard, &entry->key, hash,
+                                 &entry->value, expire, 1);
+}
 
-    out = NULL;
-    ll = &out;
 
-    for (node = chain.nodes; node != NULL; node = node->next) {
-        cl = ngx_alloc_chain_link(pool);
-        if (cl == NULL) {
-            goto error;
-        }
+static u_char *
+ngx_js_dict_binary_read(u_char *p, u_char *end, void *dst, size_t size)
+{
+    if ((size_t) (end - p) < size) {
+        return NULL;
+    }
 
-        cl->buf = ngx_calloc_buf(pool);
-        if (cl->buf == NULL) {
-            goto error;
-        }
+    ngx_memcpy(dst, p, size);
 
-        cl->buf->pos = node->start;
-        cl->buf->last = node->pos;
-        cl->buf->memory = 1;
-        cl->buf->last_buf = (node->next == NULL) ? 1 : 0;
+    return p + size;
+}
 
-        *ll = cl;
-        ll = &cl->next;
+
+static u_char *
+ngx_js_dict_binary_str(u_char *p, u_char *end, ngx_str_t *str)
+{
+    uint32_t  len;
+
+    p = ngx_js_dict_binary_read(p, end, &len, sizeof(uint32_t));
+    if (p == NULL || (size_t) (end - p) < len) {
+        return NULL;
     }
 
-    *ll = NULL;
+    str->data = p;
+    str->len = len;
 
-    ngx_memzero(&file, sizeof(ngx_file_t));
-    file.name = dict->state_temp_file;
-    file.log = log;
+    return p + len;
+}
 
-    file.fd = ngx_open_file(file.name.data, NGX_FILE_WRONLY, NGX_FILE_TRUNCATE,
-                            NGX_FILE_DEFAULT_ACCESS);
 
-    if (file.fd == NGX_INVALID_FILE) {
-        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
-                      ngx_open_file_n " \"%s\" failed", name);
+static ngx_int_t
+ngx_js_dict_load_binary(ngx_js_dict_t *dict, u_char *buf, u_char *end,
+    ngx_msec_t now)
+{
+    u_char               *p;
+    uint32_t              version, type, flags;
+    uint64_t              expire;
+    const char           *err;
+    ngx_js_dict_entry_t   entry;
+
+    p = buf + sizeof(NGX_JS_DICT_BINARY_MAGIC) - 1;
+
+    if (end - buf < NGX_JS_DICT_BINARY_HEADER) {
+        err = "truncated header";
         goto error;
     }
 
-    rc = ngx_write_chain_to_file(&file, out, 0, pool);
+    p = ngx_js_dict_binary_read(p, end, &version, sizeof(uint32_t));
+    p = ngx_js_dict_binary_read(p, end, &type, sizeof(uint32_t));
+    p = ngx_js_dict_binary_read(p, end, &flags, sizeof(uint32_t));
 
-    if (rc == NGX_ERROR) {
-        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
-                      ngx_write_fd_n " \"%s\" failed", file.name.data);
+    if (version != NGX_JS_DICT_BINARY_VERSION) {
+        err = "unsupported version";
         goto error;
     }
 
-    if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
-        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
-                     ngx_close_file_n " \"%s\" failed", file.name.data);
+    if (type != dict->type) {
+        err = "different dict type";
+        goto error;
     }
 
-    file.fd = NGX_INVALID_FILE;
+    while (p != end) {
+        ngx_memzero(&entry, sizeof(ngx_js_dict_entry_t));
 
-    ext.access = 0;
-    ext.time = -1;
-    ext.create_path = 0;
-    ext.delete_file = 0;
-    ext.log = log;
+        p = ngx_js_dict_binary_str(p, end, &entry.key);
+        if (p == NULL) {
+            goto truncated;
+        }
 
-    if (ngx_ext_rename_file(&dict->state_temp_file, &dict->state_file, &ext)
-        != NGX_OK)
-    {
-        goto error;
-    }
+        if (type == NGX_JS_DICT_TYPE_STRING) {
+            p = ngx_js_dict_binary_str(p, end, &entry.value.str);
 
-    /* no lock required */
-    dict->sh->writing = 0;
-    ngx_destroy_pool(pool);
+        } else {
+            p = ngx_js_dict_binary_read(p, end, &entry.value.number,
+                                        sizeof(double));
+        }
 
-    return NGX_OK;
+        if (p == NULL) {
+            goto truncated;
+        }
 
-error:
+        if (flags & NGX_JS_DICT_BINARY_TIMEOUT) {
+            p = ngx_js_dict_binary_read(p, end, &expire, sizeof(uint64_t));
+            if (p == NULL) {
+                goto truncated;
+            }
 
-    if (file.fd != NGX_INVALID_FILE
-        && ngx_close_file(file.fd) == NGX_FILE_ERROR)
-    {
-        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
-                      ngx_close_file_n " \"%s\" failed", name);
+            entry.expire = expire;
+        }
+
+        if (ngx_js_dict_load_entry(dict, &entry, now, 0) != NGX_OK) {
+            err = "duplicate key or no memory";
+            goto error;
+        }
     }
 
-    ngx_destroy_pool(pool);
+    return NGX_OK;
 
-    /* no lock required */
-    dict->sh->writing = 0;
-    dict->sh->dirty = 1;
+truncated:
+
+    err = "unexpected end of file";
+
+error:
+
+    ngx_log_error(NGX_LOG_EMERG, dict->shm_zone->shm.log, 0,
+                  "invalid format while loading js_shared_dict_zone \"%V\""
+                  " from state file \"%s\": %s",
+                  &dict->shm_zone->shm.name, dict->state_file.data, err);
 
     return NGX_ERROR;
 }
 
 
+/*
+ * A snapshot save writes "*.tmp", renames the journal to "*.journal.old",
+ * renames "*.tmp" to the state file and removes "*.journal.old".  If the
+ * old journal exists on load, the save was interrupted after the first
+ * rename.  Its records are in "*.tmp" if it still exists, or in the state
+ * file otherwise, so the old journal is never replayed.
+ */
+
 static ngx_int_t
-ngx_js_dict_load(ngx_js_dict_t *dict)
+ngx_js_dict_load_interrupted(ngx_js_dict_t *dict)
 {
-    off_t                        size;
-    u_char                      *name, *buf;
-    size_t                       len;
-    ssize_t                      n;
-    ngx_fd_t                     fd;
-    ngx_err_t                    err;
-    ngx_int_t                    rc;
-    ngx_log_t                   *log;
-    ngx_uint_t                   i;
-    ngx_msec_t                   now, expire;
-    ngx_time_t                  *tp;
-    ngx_pool_t                  *pool;
-    ngx_array_t                  data;
-    ngx_file_info_t              fi;
-    ngx_js_dict_entry_t         *entries;
-
-    if (dict->state_file.data == NULL) {
-        return NGX_OK;
-    }
+    ngx_log_t        *log;
+    ngx_file_info_t   fi;
 
     log = dict->shm_zone->shm.log;
 
-    name = dict->state_file.data;
-
-    fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
-    if (fd == NGX_INVALID_FILE) {
-        err = ngx_errno;
-
-        if (err == NGX_ENOENT || err == NGX_ENOPATH) {
+    if (ngx_file_info(dict->journal_old_file.data, &fi) == NGX_FILE_ERROR) {
+        if (ngx_errno == NGX_ENOENT) {
             return NGX_OK;
         }
 
-        ngx_log_error(NGX_LOG_EMERG, log, err,
-                      ngx_open_file_n " \"%s\" failed", name);
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      ngx_file_info_n " \"%s\" failed",
+                      dict->journal_old_file.data);
         return NGX_ERROR;
     }
 
-    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+    ngx_log_error(NGX_LOG_WARN, log, 0,
+                  "completing interrupted save of js_shared_dict_zone \"%V\"",
+                  &dict->shm_zone->shm.name);
+
+    if (ngx_rename_file(dict->state_temp_file.data, dict->state_file.data)
+        == NGX_FILE_ERROR
+        && ngx_errno != NGX_ENOENT)
+    {
         ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
-                      ngx_fd_info_n " \"%s\" failed", name);
-        pool = NULL;
-        goto failed;
+                      ngx_rename_file_n " \"%s\" to \"%s\" failed",
+                      dict->state_temp_file.data, dict->state_file.data);
+        return NGX_ERROR;
     }
 
-    size = ngx_file_size(&fi);
+    if (ngx_delete_file(dict->journal_old_file.data) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      ngx_delete_file_n " \"%s\" failed",
+                      dict->journal_old_file.data);
+        return NGX_ERROR;
+    }
 
-    if (size == 0) {
+    return NGX_OK;
+}
 
-        if (ngx_close_file(fd) == NGX_FILE_ERROR) {
-            ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
-                          ngx_close_file_n " \"%s\" failed", name);
-        }
 
+static ngx_int_t
+ngx_js_dict_load(ngx_js_dict_t *dict)
+{
+    ngx_int_t             rc;
+    ngx_str_t             content;
+    ngx_uint_t            i;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_pool_t           *pool;
+    ngx_array_t           data;
+    ngx_js_dict_entry_t  *entries;
+
+    if (dict->state_file.data == NULL) {
         return NGX_OK;
     }
 
-    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, dict->shm_zone->shm.log);
     if (pool == NULL) {
-        goto failed;
+        return NGX_ERROR;
     }
 
-    len = size;
-
-    buf = ngx_pnalloc(pool, len);
-    if (buf == NULL) {
+    if (ngx_array_init(&data, pool, 4, sizeof(ngx_js_dict_entry_t))
+        != NGX_OK)
+    {
         goto failed;
     }
 
-    n = ngx_read_fd(fd, buf, len);
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
 
-    if (n == -1) {
-        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
-                      ngx_read_fd_n " \"%s\" failed", name);
+    if (dict->journal && ngx_js_dict_load_interrupted(dict) != NGX_OK) {
         goto failed;
     }
 
-    if ((size_t) n != len) {
-        ngx_log_error(NGX_LOG_EMERG, log, 0,
-                      ngx_read_fd_n " has read only %z of %uz from %s",
-                      n, len, name);
+    if (ngx_js_dict_read_file(dict, pool, dict->state_file.data, &content)
+        != NGX_OK)
+    {
         goto failed;
     }
 
-    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
-        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
-                      ngx_close_file_n " \"%s\" failed", name);
-        fd = NGX_INVALID_FILE;
-        goto failed;
-    }
+    dict->sh->snapshot_size = content.len;
 
-    fd = NGX_INVALID_FILE;
+    /* the format is detected, so either format can be loaded */
 
-    if (ngx_array_init(&data, pool, 4, sizeof(ngx_js_dict_entry_t))
-        != NGX_OK)
+    if (content.len >= sizeof(NGX_JS_DICT_BINARY_MAGIC) - 1
+        && ngx_strncmp(content.data, NGX_JS_DICT_BINARY_MAGIC,
+                       sizeof(NGX_JS_DICT_BINARY_MAGIC) - 1) == 0)
     {
-        goto failed;
-    }
+        if (ngx_js_dict_load_binary(dict, content.data,
+                                    content.data + content.len, now)
+            != NGX_OK)
+        {
+            goto failed;
+        }
 
-    rc = ngx_js_dict_parse_state(dict, pool, &data, buf, buf + len);
+    } else if (content.len) {
+        rc = ngx_js_dict_parse_state(dict, pool, &data, content.data,
+                                     content.data + content.len,
+                                     dict->state_file.data, 0);
+        if (rc != NGX_OK) {
+            goto failed;
+        }
 
-    if (rc != NGX_OK) {
-        goto failed;
-    }
+        entries = data.elts;
 
-    entries = data.elts;
+        for (i = 0; i < data.nelts; i++) {
+            if (ngx_js_dict_load_entry(dict, &entries[i], now, 0) != NGX_OK) {
+                goto failed;
+            }
+        }
 
-    tp = ngx_timeofday();
-    now = tp->sec * 1000 + tp->msec;
+        if (dict->state_format != NGX_JS_DICT_STATE_JSON) {
+            /* convert the state file */
+            dict->sh->dirty = 1;
+        }
+    }
 
-    for (i = 0; i < data.nelts; i++) {
+    if (dict->journal) {
+        data.nelts = 0;
 
-        if (dict->timeout) {
-            expire = entries[i].expire;
+        if (ngx_js_dict_read_file(dict, pool, dict->journal_file.data,
+                                  &content)
+            != NGX_OK)
+        {
+            goto failed;
+        }
 
-            if (expire && now >= expire) {
-                dict->sh->dirty = 1;
-                continue;
+        if (content.len) {
+            rc = ngx_js_dict_parse_state(dict, pool, &data, content.data,
+                                         content.data + content.len,
+                                         dict->journal_file.data, 1);
+            if (rc != NGX_OK) {
+                goto failed;
             }
+        }
 
-            if (expire == 0) {
-                /* treat state without expire as new */
-                expire = now + dict->timeout;
-                dict->sh->dirty = 1;
-            }
+        dict->sh->journal_size = content.len;
 
-        } else {
-            expire = 0;
+        entries = data.elts;
+
+        for (i = 0; i < data.nelts; i++) {
+            if (ngx_js_dict_load_entry(dict, &entries[i], now, 1) != NGX_OK) {
+                goto failed;
+            }
         }
 
-        if (ngx_js_dict_lookup(dict, &entries[i].key) != NULL) {
-            goto failed;
+        for (i = 0; i < dict->sh->nshards; i++) {
+            ngx_js_dict_journal_reset(dict, dict->sh->shards[i]);
         }
 
-        if (ngx_js_dict_add_value(dict, &entries[i].key, &entries[i].value,
-                                  expire, 1)
-            != NGX_OK)
-        {
-            goto failed;
+        if (dict->sh->dirty) {
+            /* entries were dropped while loading */
+            dict->sh->compact = 1;
         }
     }
 
@@ -2673,18 +4689,106 @@ ngx_js_dict_load(ngx_js_dict_t *dict)
 
 failed:
 
-    if (fd != NGX_INVALID_FILE && ngx_close_file(fd) == NGX_FILE_ERROR) {
-        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
-                      ngx_close_file_n " \"%s\" failed", name);
+    ngx_destroy_pool(pool);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_js_dict_save_done(ngx_js_dict_t *dict, ngx_int_t rc)
+{
+    if (rc == NGX_OK) {
+        return;
     }
 
-    if (pool) {
-        ngx_destroy_pool(pool);
+    if (rc == NGX_ERROR && (ngx_terminate || ngx_exiting)) {
+        ngx_log_error(NGX_LOG_ALERT, dict->save_event.log, 0,
+                      "failed to save the state of shared dict zone \"%V\"",
+                      &dict->shm_zone->shm.name);
+        return;
     }
 
-    return NGX_ERROR;
+    /* NGX_ERROR, NGX_AGAIN */
+
+    ngx_add_timer(&dict->save_event, 1000);
+}
+
+
+#if (NGX_THREADS)
+
+typedef struct {
+    ngx_js_dict_t  *dict;
+    ngx_int_t       rc;
+} ngx_js_dict_save_ctx_t;
+
+
+static void
+ngx_js_dict_save_thread(void *data, ngx_log_t *log)
+{
+    ngx_js_dict_save_ctx_t  *ctx = data;
+
+    ctx->rc = ngx_js_dict_save(ctx->dict);
+}
+
+
+static void
+ngx_js_dict_save_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_js_dict_save_ctx_t  *ctx;
+
+    ctx = ev->data;
+
+    ngx_js_dict_save_done(ctx->dict, ctx->rc);
+}
+
+
+static ngx_int_t
+ngx_js_dict_save_post(ngx_js_dict_t *dict)
+{
+    ngx_thread_task_t       *task;
+    ngx_js_dict_save_ctx_t  *ctx;
+
+    task = dict->save_task;
+
+    if (task == NULL) {
+        task = ngx_thread_task_alloc(ngx_cycle->pool,
+                                     sizeof(ngx_js_dict_save_ctx_t));
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        ctx = task->ctx;
+        ctx->dict = dict;
+
+        task->handler = ngx_js_dict_save_thread;
+        task->event.handler = ngx_js_dict_save_thread_event_handler;
+        task->event.data = ctx;
+
+        dict->save_task = task;
+    }
+
+    if (task->event.active) {
+        /* the previous save is still in progress */
+        ngx_add_timer(&dict->save_event, 1000);
+        return NGX_OK;
+    }
+
+    if (!dict->sh->dirty) {
+        return NGX_OK;
+    }
+
+    return ngx_thread_task_post(dict->thread_pool, task);
 }
 
+#endif
+
+
+/*
+ * With thread_pool= the snapshot is rendered and written by a thread,
+ * the lock is still held while the snapshot is rendered.  While exiting,
+ * the state is saved synchronously as the task may not complete in time.
+ */
 
 static void
 ngx_js_dict_save_handler(ngx_event_t *ev)
@@ -2694,22 +4798,26 @@ ngx_js_dict_save_handler(ngx_event_t *ev)
 
     dict = ev->data;
 
-    rc = ngx_js_dict_save(dict);
+#if (NGX_THREADS)
 
-    if (rc == NGX_OK) {
+    if (dict->thread_pool != NULL
+        && !ngx_terminate
+        && !ngx_exiting
+        && ngx_js_dict_save_post(dict) == NGX_OK)
+    {
         return;
     }
 
-    if (rc == NGX_ERROR && (ngx_terminate || ngx_exiting)) {
-        ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
-                      "failed to save the state of shared dict zone \"%V\"",
-                      &dict->shm_zone->shm.name);
+    if (dict->save_task != NULL && dict->save_task->event.active) {
+        ngx_add_timer(ev, 1000);
         return;
     }
 
-    /* NGX_ERROR, NGX_AGAIN */
+#endif
+
+    rc = ngx_js_dict_save(dict);
 
-    ngx_add_timer(ev, 1000);
+    ngx_js_dict_save_done(dict, rc);
 }
 
 
@@ -2746,8 +4854,10 @@ ngx_js_dict_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 {
     ngx_js_dict_t  *prev = data;
 
-    size_t          len;
-    ngx_js_dict_t  *dict;
+    size_t                len;
+    ngx_uint_t            i;
+    ngx_js_dict_t        *dict;
+    ngx_js_dict_shard_t  *shard;
 
     dict = shm_zone->data;
 
@@ -2768,9 +4878,22 @@ ngx_js_dict_init_zone(ngx_shm_zone_t *shm_zone, void *data)
             return NGX_ERROR;
         }
 
+        if (dict->nshards != prev->nshards) {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "js_shared_dict_zone \"%V\" had previously "
+                          "%ui shards", &shm_zone->shm.name, prev->nshards);
+            return NGX_ERROR;
+        }
+
         dict->sh = prev->sh;
         dict->shpool = prev->shpool;
 
+        if (dict->journal && !prev->journal) {
+            /* the journal is started from a snapshot */
+            dict->sh->compact = 1;
+            dict->sh->dirty = 1;
+        }
+
         return NGX_OK;
     }
 
@@ -2788,13 +4911,37 @@ ngx_js_dict_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 
     dict->shpool->data = dict->sh;
 
-    ngx_rbtree_init(&dict->sh->rbtree, &dict->sh->sentinel,
-                    ngx_str_rbtree_insert_value);
+    dict->sh->nshards = dict->nshards;
+    dict->sh->shards = ngx_slab_alloc(dict->shpool,
+                                      dict->nshards
+                                      * sizeof(ngx_js_dict_shard_t *));
+    if (dict->sh->shards == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < dict->nshards; i++) {
+        shard = ngx_slab_calloc(dict->shpool, sizeof(ngx_js_dict_shard_t));
+        if (shard == NULL) {
+            return NGX_ERROR;
+        }
+
+        shard->slots = ngx_slab_calloc(dict->shpool, NGX_JS_DICT_INDEX_SIZE
+                                       * sizeof(ngx_js_dict_slot_t));
+        if (shard->slots == NULL) {
+            return NGX_ERROR;
+        }
+
+        shard->size = NGX_JS_DICT_INDEX_SIZE;
+
+        ngx_queue_init(&shard->journal);
+        ngx_queue_init(&shard->tombstones);
+
+        if (dict->timeout) {
+            ngx_rbtree_init(&shard->rbtree_expire, &shard->sentinel_expire,
+                            ngx_rbtree_insert_timer_value);
+        }
 
-    if (dict->timeout) {
-        ngx_rbtree_init(&dict->sh->rbtree_expire,
-                        &dict->sh->sentinel_expire,
-                        ngx_rbtree_insert_timer_value);
+        dict->sh->shards[i] = shard;
     }
 
     len = sizeof(" in js shared dict zone \"\"") + shm_zone->shm.name.len;
@@ -2821,18 +4968,28 @@ ngx_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
 {
     ngx_js_main_conf_t  *jmcf = conf;
 
-    u_char          *p;
-    ssize_t          size;
-    ngx_str_t       *value, name, file, s;
-    ngx_flag_t       evict;
-    ngx_msec_t       timeout;
-    ngx_uint_t       i, type;
-    ngx_js_dict_t   *dict;
-    ngx_shm_zone_t  *shm_zone;
+    u_char             *p;
+    ssize_t             size;
+    ngx_int_t           n;
+    ngx_str_t          *value, name, file, s;
+    ngx_msec_t          timeout;
+    ngx_flag_t          journal;
+    ngx_uint_t          i, type, evict, nshards, state_format;
+    ngx_js_dict_t      *dict;
+    ngx_shm_zone_t     *shm_zone;
+#if (NGX_THREADS)
+    ngx_thread_pool_t  *thread_pool;
+#endif
 
     size = 0;
-    evict = 0;
+    evict = NGX_JS_DICT_EVICT_OFF;
+    journal = 0;
+    state_format = NGX_JS_DICT_STATE_JSON;
     timeout = 0;
+#if (NGX_THREADS)
+    thread_pool = NULL;
+#endif
+    nshards = 1;
     name.len = 0;
     ngx_str_null(&file);
     type = NGX_JS_DICT_TYPE_STRING;
@@ -2881,8 +5038,35 @@ ngx_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
             continue;
         }
 
-        if (ngx_strncmp(value[i].data, "evict", 5) == 0) {
-            evict = 1;
+        if (ngx_strcmp(value[i].data, "evict") == 0
+            || ngx_strcmp(value[i].data, "evict=expire") == 0)
+        {
+            evict = NGX_JS_DICT_EVICT_EXPIRE;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "evict=lru") == 0) {
+            evict = NGX_JS_DICT_EVICT_LRU;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "journal") == 0) {
+            journal = 1;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "shards=", 7) == 0) {
+
+            n = ngx_atoi(value[i].data + 7, value[i].len - 7);
+
+            if (n == NGX_ERROR || n == 0 || n > NGX_JS_DICT_MAX_SHARDS) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid shards value \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            nshards = n;
+
             continue;
         }
 
@@ -2897,6 +5081,43 @@ ngx_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "state_format=", 13) == 0) {
+
+            if (ngx_strcmp(&value[i].data[13], "json") == 0) {
+                state_format = NGX_JS_DICT_STATE_JSON;
+
+            } else if (ngx_strcmp(&value[i].data[13], "binary") == 0) {
+                state_format = NGX_JS_DICT_STATE_BINARY;
+
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid state format \"%s\"",
+                                   &value[i].data[13]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "thread_pool=", 12) == 0) {
+#if (NGX_THREADS)
+            s.data = value[i].data + 12;
+            s.len = value[i].len - 12;
+
+            thread_pool = ngx_thread_pool_add(cf, &s);
+            if (thread_pool == NULL) {
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"thread_pool\" is unsupported "
+                               "on this platform");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
         if (ngx_strncmp(value[i].data, "timeout=", 8) == 0) {
 
             s.data = value[i].data + 8;
@@ -2937,12 +5158,26 @@ ngx_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
         return NGX_CONF_ERROR;
     }
 
-    if (evict && timeout == 0) {
+    if (evict == NGX_JS_DICT_EVICT_EXPIRE && timeout == 0) {
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                            "evict requires timeout=");
         return NGX_CONF_ERROR;
     }
 
+    if (journal && file.data == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "journal requires state=");
+        return NGX_CONF_ERROR;
+    }
+
+#if (NGX_THREADS)
+    if (thread_pool != NULL && file.data == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "thread_pool requires state=");
+        return NGX_CONF_ERROR;
+    }
+#endif
+
     shm_zone = ngx_shared_memory_add(cf, &name, size, tag);
     if (shm_zone == NULL) {
         return NGX_CONF_ERROR;
@@ -2967,8 +5202,13 @@ ngx_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
     shm_zone->init = ngx_js_dict_init_zone;
 
     dict->evict = evict;
+    dict->state_format = state_format;
+#if (NGX_THREADS)
+    dict->thread_pool = thread_pool;
+#endif
     dict->timeout = timeout;
     dict->type = type;
+    dict->nshards = nshards;
 
     dict->save_event.handler = ngx_js_dict_save_handler;
     dict->save_event.data = dict;
@@ -2985,6 +5225,28 @@ ngx_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf,
 
         dict->state_temp_file.data = p;
         dict->state_temp_file.len = ngx_sprintf(p, "%V.tmp%Z", &file) - p - 1;
+
+        if (journal) {
+            p = ngx_pnalloc(cf->pool, file.len + sizeof(".journal"));
+            if (p == NULL) {
+                return NGX_CONF_ERROR;
+            }
+
+            dict->journal_file.data = p;
+            dict->journal_file.len = ngx_sprintf(p, "%V.journal%Z", &file)
+                                     - p - 1;
+
+            p = ngx_pnalloc(cf->pool, file.len + sizeof(".journal.old"));
+            if (p == NULL) {
+                return NGX_CONF_ERROR;
+            }
+
+            dict->journal_old_file.data = p;
+            dict->journal_old_file.len = ngx_sprintf(p, "%V.journal.old%Z",
+                                                     &file)
+                                         - p - 1;
+            dict->journal = 1;
+        }
     }
 
     return NGX_CONF_OK;
@@ -3148,51 +5410,14 @@ static JSValue
 ngx_qjs_ext_shared_dict_clear(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv)
 {
-    ngx_rbtree_t       *rbtree;
-    ngx_js_dict_t      *dict;
-    ngx_shm_zone_t     *shm_zone;
-    ngx_rbtree_node_t  *rn, *next;
+    ngx_shm_zone_t  *shm_zone;
 
     shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
     if (shm_zone == NULL) {
         return JS_ThrowTypeError(cx, "\"this\" is not a shared dict");
     }
 
-    dict = shm_zone->data;
-
-    ngx_rwlock_wlock(&dict->sh->rwlock);
-
-    if (dict->timeout) {
-        ngx_js_dict_evict(dict, 0x7fffffff /* INT_MAX */);
-
-    } else {
-        rbtree = &dict->sh->rbtree;
-
-        if (rbtree->root == rbtree->sentinel) {
-            goto done;
-        }
-
-        for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-             rn != NULL;
-             rn = next)
-        {
-            next = ngx_rbtree_next(rbtree, rn);
-
-            ngx_rbtree_delete(rbtree, rn);
-
-            ngx_js_dict_node_free(dict, (ngx_js_dict_node_t *) rn);
-        }
-    }
-
-done:
-
-    dict->sh->dirty = 1;
-
-    ngx_rwlock_unlock(&dict->sh->rwlock);
-
-    if (dict->state_file.data && !dict->save_event.timer_set) {
-        ngx_add_timer(&dict->save_event, 1000);
-    }
+    ngx_js_dict_clear(shm_zone->data);
 
     return JS_UNDEFINED;
 }
@@ -3229,7 +5454,6 @@ ngx_qjs_ext_shared_dict_free_space(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv)
 {
     size_t           bytes;
-    ngx_js_dict_t   *dict;
     ngx_shm_zone_t  *shm_zone;
 
     shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
@@ -3237,11 +5461,7 @@ ngx_qjs_ext_shared_dict_free_space(JSContext *cx, JSValueConst this_val,
         return JS_ThrowTypeError(cx, "\"this\" is not a shared dict");
     }
 
-    dict = shm_zone->data;
-
-    ngx_rwlock_rlock(&dict->sh->rwlock);
-    bytes = dict->shpool->pfree * ngx_pagesize;
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    bytes = ngx_js_dict_free_space(shm_zone->data);
 
     return JS_NewInt32(cx, bytes);
 }
@@ -3273,16 +5493,77 @@ ngx_qjs_ext_shared_dict_get(JSContext *cx, JSValueConst this_val,
 }
 
 
+static JSValue
+ngx_qjs_ext_shared_dict_get_many(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    JSValue               arr;
+    ngx_int_t             rc;
+    ngx_uint_t            i;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_batch_t   batch;
+
+    shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
+    if (shm_zone == NULL) {
+        return JS_ThrowTypeError(cx, "\"this\" is not a shared dict");
+    }
+
+    dict = shm_zone->data;
+
+    if (ngx_qjs_dict_batch_keys(cx, argv[0], &batch) != NGX_OK) {
+        return JS_EXCEPTION;
+    }
+
+    arr = JS_NewArray(cx);
+    if (JS_IsException(arr)) {
+        goto fail;
+    }
+
+    for (i = 0; i < batch.n; i++) {
+        if (JS_SetPropertyUint32(cx, arr, i, JS_UNDEFINED) < 0) {
+            JS_FreeValue(cx, arr);
+            goto fail;
+        }
+    }
+
+    batch.op = NGX_JS_DICT_BATCH_GET;
+    batch.handler = ngx_qjs_dict_batch_get;
+    batch.vm = cx;
+    batch.retval = &arr;
+
+    rc = ngx_js_dict_batch(dict, &batch);
+
+    ngx_qjs_dict_batch_free(cx, dict, &batch);
+
+    if (rc == NGX_ERROR) {
+        JS_FreeValue(cx, arr);
+        return JS_EXCEPTION;
+    }
+
+    return arr;
+
+fail:
+
+    ngx_qjs_dict_batch_free(cx, dict, &batch);
+
+    return JS_EXCEPTION;
+}
+
+
 static JSValue
 ngx_qjs_ext_shared_dict_has(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv)
 {
-    ngx_str_t            key;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_t       *dict;
-    ngx_shm_zone_t      *shm_zone;
-    ngx_js_dict_node_t  *node;
+    uint32_t              hash;
+    ngx_int_t             rc;
+    ngx_str_t             key;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
     shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
     if (shm_zone == NULL) {
@@ -3295,10 +5576,18 @@ ngx_qjs_ext_shared_dict_has(JSContext *cx, JSValueConst this_val,
     }
 
     dict = shm_zone->data;
+    shard = ngx_js_dict_shard(dict, &key, &hash);
+
+    rc = ngx_js_dict_lookup_optimistic(dict, shard, &key, hash, NULL, NULL, 0);
+
+    if (rc != NGX_AGAIN) {
+        JS_FreeCString(cx, (char *) key.data);
+        return JS_NewBool(cx, rc == NGX_OK);
+    }
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    ngx_rwlock_rlock(&shard->rwlock);
 
-    node = ngx_qjs_dict_lookup(dict, &key);
+    node = ngx_js_dict_lookup(shard, &key, hash);
 
     if (node != NULL && dict->timeout) {
         tp = ngx_timeofday();
@@ -3309,7 +5598,7 @@ ngx_qjs_ext_shared_dict_has(JSContext *cx, JSValueConst this_val,
         }
     }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_rwlock_unlock(&shard->rwlock);
 
     JS_FreeCString(cx, (char *) key.data);
 
@@ -3383,18 +5672,16 @@ ngx_qjs_ext_shared_dict_incr(JSContext *cx, JSValueConst this_val,
 
 
 static JSValue
-ngx_qjs_ext_shared_dict_items(JSContext *cx, JSValueConst this_val,
+ngx_qjs_ext_shared_dict_incr_many(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv)
 {
-    JSValue              arr, kv, v;
-    uint32_t             max_count, i;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_rbtree_t        *rbtree;
-    ngx_js_dict_t       *dict;
-    ngx_shm_zone_t      *shm_zone;
-    ngx_rbtree_node_t   *rn;
-    ngx_js_dict_node_t  *node;
+    double                delta;
+    JSValue               arr, v;
+    int64_t               length;
+    ngx_uint_t            i;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_batch_t   batch;
 
     shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
     if (shm_zone == NULL) {
@@ -3403,92 +5690,213 @@ ngx_qjs_ext_shared_dict_items(JSContext *cx, JSValueConst this_val,
 
     dict = shm_zone->data;
 
-    max_count = 1024;
+    if (dict->type != NGX_JS_DICT_TYPE_NUMBER) {
+        return JS_ThrowTypeError(cx, "shared dict is not a number dict");
+    }
 
-    if (argc > 0) {
-        if (JS_ToUint32(cx, &max_count, argv[0]) < 0) {
-            return JS_EXCEPTION;
+    if (ngx_qjs_dict_batch_keys(cx, argv[0], &batch) != NGX_OK) {
+        return JS_EXCEPTION;
+    }
+
+    if (qjs_is_array(cx, argv[1])) {
+        v = JS_GetPropertyStr(cx, argv[1], "length");
+        if (JS_IsException(v)) {
+            goto fail;
+        }
+
+        if (JS_ToInt64(cx, &length, v) < 0) {
+            JS_FreeValue(cx, v);
+            goto fail;
+        }
+
+        JS_FreeValue(cx, v);
+
+        if ((ngx_uint_t) length != batch.n) {
+            JS_ThrowTypeError(cx, "deltas length does not match keys");
+            goto fail;
+        }
+
+        for (i = 0; i < batch.n; i++) {
+            v = JS_GetPropertyUint32(cx, argv[1], i);
+            if (JS_IsException(v)) {
+                goto fail;
+            }
+
+            if (JS_ToFloat64(cx, &batch.items[i].value.number, v) < 0) {
+                JS_FreeValue(cx, v);
+                goto fail;
+            }
+
+            JS_FreeValue(cx, v);
+        }
+
+    } else {
+        if (JS_ToFloat64(cx, &delta, argv[1]) < 0) {
+            goto fail;
+        }
+
+        for (i = 0; i < batch.n; i++) {
+            batch.items[i].value.number = delta;
         }
     }
 
-    rbtree = &dict->sh->rbtree;
+    if (JS_IsUndefined(argv[2])) {
+        batch.init = 0;
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    } else if (JS_ToFloat64(cx, &batch.init, argv[2]) < 0) {
+        goto fail;
+    }
 
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
-        ngx_js_dict_expire(dict, now);
+    if (ngx_qjs_dict_batch_timeout(cx, dict, (argc > 3) ? argv[3]
+                                                        : JS_UNDEFINED,
+                                   &batch.timeout)
+        != NGX_OK)
+    {
+        goto fail;
     }
 
-    if (rbtree->root == rbtree->sentinel) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        return JS_NewArray(cx);
+    batch.op = NGX_JS_DICT_BATCH_INCR;
+
+    if (ngx_js_dict_batch(dict, &batch) != NGX_OK) {
+        ngx_qjs_dict_batch_free(cx, dict, &batch);
+        return ngx_qjs_throw_shared_memory_error(cx);
     }
 
     arr = JS_NewArray(cx);
     if (JS_IsException(arr)) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        return JS_EXCEPTION;
+        goto fail;
     }
 
-    i = 0;
+    for (i = 0; i < batch.n; i++) {
+        v = JS_NewFloat64(cx, batch.items[i].value.number);
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = ngx_rbtree_next(rbtree, rn))
-    {
-        if (max_count-- == 0) {
-            break;
+        if (JS_SetPropertyUint32(cx, arr, i, v) < 0) {
+            JS_FreeValue(cx, arr);
+            goto fail;
         }
+    }
 
-        node = (ngx_js_dict_node_t *) rn;
+    ngx_qjs_dict_batch_free(cx, dict, &batch);
 
-        kv = JS_NewArray(cx);
-        if (JS_IsException(kv)) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, arr);
+    return arr;
+
+fail:
+
+    ngx_qjs_dict_batch_free(cx, dict, &batch);
+
+    return JS_EXCEPTION;
+}
+
+
+static JSValue
+ngx_qjs_ext_shared_dict_items(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    JSValue               arr, kv, v;
+    uint32_t              max_count, i;
+    ngx_uint_t            n, j;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
+    if (shm_zone == NULL) {
+        return JS_ThrowTypeError(cx, "\"this\" is not a shared dict");
+    }
+
+    dict = shm_zone->data;
+
+    max_count = 1024;
+
+    if (argc > 0) {
+        if (JS_ToUint32(cx, &max_count, argv[0]) < 0) {
             return JS_EXCEPTION;
         }
+    }
 
-        v = JS_NewStringLen(cx, (const char *) node->sn.str.data,
-                            node->sn.str.len);
-        if (JS_IsException(v)) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, kv);
-            JS_FreeValue(cx, arr);
-            return JS_EXCEPTION;
+    arr = JS_NewArray(cx);
+    if (JS_IsException(arr)) {
+        return JS_EXCEPTION;
+    }
+
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
+    i = 0;
+
+    for (n = 0; n < dict->sh->nshards; n++) {
+        shard = dict->sh->shards[n];
+
+        if (dict->timeout) {
+            ngx_js_dict_write_lock(shard);
+            ngx_js_dict_expire(dict, shard, now);
+            ngx_js_dict_write_unlock(shard);
         }
 
-        if (JS_DefinePropertyValueUint32(cx, kv, 0, v, JS_PROP_C_W_E) < 0) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, v);
-            JS_FreeValue(cx, kv);
-            JS_FreeValue(cx, arr);
-            return JS_EXCEPTION;
-        }
+        ngx_rwlock_rlock(&shard->rwlock);
+
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
+
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
+
+            if (max_count-- == 0) {
+                ngx_rwlock_unlock(&shard->rwlock);
+                return arr;
+            }
+
+            kv = JS_NewArray(cx);
+            if (JS_IsException(kv)) {
+                goto fail;
+            }
+
+            v = JS_NewStringLen(cx, (const char *) node->key.data,
+                                node->key.len);
+            if (JS_IsException(v)) {
+                JS_FreeValue(cx, kv);
+                goto fail;
+            }
+
+            if (JS_DefinePropertyValueUint32(cx, kv, 0, v, JS_PROP_C_W_E) < 0)
+            {
+                JS_FreeValue(cx, v);
+                JS_FreeValue(cx, kv);
+                goto fail;
+            }
+
+            v = ngx_qjs_dict_copy_value_locked(cx, dict, node);
 
-        v = ngx_qjs_dict_copy_value_locked(cx, dict, node);
+            if (JS_DefinePropertyValueUint32(cx, kv, 1, v, JS_PROP_C_W_E) < 0)
+            {
+                JS_FreeValue(cx, v);
+                JS_FreeValue(cx, kv);
+                goto fail;
+            }
 
-        if (JS_DefinePropertyValueUint32(cx, kv, 1, v, JS_PROP_C_W_E) < 0) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, v);
-            JS_FreeValue(cx, kv);
-            JS_FreeValue(cx, arr);
-            return JS_EXCEPTION;
+            if (JS_DefinePropertyValueUint32(cx, arr, i++, kv,
+                                             JS_PROP_C_W_E) < 0)
+            {
+                JS_FreeValue(cx, kv);
+                goto fail;
+            }
         }
 
-        if (JS_DefinePropertyValueUint32(cx, arr, i++, kv, JS_PROP_C_W_E) < 0) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, kv);
-            JS_FreeValue(cx, arr);
-            return JS_EXCEPTION;
-        }
+        ngx_rwlock_unlock(&shard->rwlock);
     }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
-
     return arr;
+
+fail:
+
+    ngx_rwlock_unlock(&shard->rwlock);
+    JS_FreeValue(cx, arr);
+
+    return JS_EXCEPTION;
 }
 
 
@@ -3496,15 +5904,15 @@ static JSValue
 ngx_qjs_ext_shared_dict_keys(JSContext *cx, JSValueConst this_val, int argc,
     JSValueConst *argv)
 {
-    JSValue              arr, key;
-    uint32_t             max_count, i;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_rbtree_t        *rbtree;
-    ngx_js_dict_t       *dict;
-    ngx_shm_zone_t      *shm_zone;
-    ngx_rbtree_node_t   *rn;
-    ngx_js_dict_node_t  *node;
+    JSValue               arr, key;
+    uint32_t              max_count, i;
+    ngx_uint_t            n, j;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_t        *dict;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
     shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
     if (shm_zone == NULL) {
@@ -3521,60 +5929,64 @@ ngx_qjs_ext_shared_dict_keys(JSContext *cx, JSValueConst this_val, int argc,
         }
     }
 
-    rbtree = &dict->sh->rbtree;
-
-    ngx_rwlock_rlock(&dict->sh->rwlock);
-
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
-        ngx_js_dict_expire(dict, now);
-    }
-
-    if (rbtree->root == rbtree->sentinel) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        return JS_NewArray(cx);
-    }
-
     arr = JS_NewArray(cx);
     if (JS_IsException(arr)) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
         return JS_EXCEPTION;
     }
 
+    tp = ngx_timeofday();
+    now = tp->sec * 1000 + tp->msec;
+
     i = 0;
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = ngx_rbtree_next(rbtree, rn))
-    {
-        if (max_count-- == 0) {
-            break;
+    for (n = 0; n < dict->sh->nshards; n++) {
+        shard = dict->sh->shards[n];
+
+        if (dict->timeout) {
+            ngx_js_dict_write_lock(shard);
+            ngx_js_dict_expire(dict, shard, now);
+            ngx_js_dict_write_unlock(shard);
         }
 
-        node = (ngx_js_dict_node_t *) rn;
+        ngx_rwlock_rlock(&shard->rwlock);
 
-        key = JS_NewStringLen(cx, (const char *) node->sn.str.data,
-                              node->sn.str.len);
-        if (JS_IsException(key)) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, arr);
-            return JS_EXCEPTION;
-        }
+        for (j = 0; j < shard->size; j++) {
+            node = shard->slots[j].node;
 
-        if (JS_DefinePropertyValueUint32(cx, arr, i++, key,
-                                         JS_PROP_C_W_E) < 0)
-        {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
-            JS_FreeValue(cx, key);
-            JS_FreeValue(cx, arr);
-            return JS_EXCEPTION;
+            if (node == NULL || node == NGX_JS_DICT_SLOT_DELETED) {
+                continue;
+            }
+
+            if (max_count-- == 0) {
+                ngx_rwlock_unlock(&shard->rwlock);
+                return arr;
+            }
+
+            key = JS_NewStringLen(cx, (const char *) node->key.data,
+                                  node->key.len);
+            if (JS_IsException(key)) {
+                goto fail;
+            }
+
+            if (JS_DefinePropertyValueUint32(cx, arr, i++, key,
+                                             JS_PROP_C_W_E) < 0)
+            {
+                JS_FreeValue(cx, key);
+                goto fail;
+            }
         }
-    }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+        ngx_rwlock_unlock(&shard->rwlock);
+    }
 
     return arr;
+
+fail:
+
+    ngx_rwlock_unlock(&shard->rwlock);
+    JS_FreeValue(cx, arr);
+
+    return JS_EXCEPTION;
 }
 
 
@@ -3697,16 +6109,16 @@ done:
 
 
 static JSValue
-ngx_qjs_ext_shared_dict_size(JSContext *cx, JSValueConst this_val,
+ngx_qjs_ext_shared_dict_set_many(JSContext *cx, JSValueConst this_val,
     int argc, JSValueConst *argv)
 {
-    njs_int_t           items;
-    ngx_msec_t          now;
-    ngx_time_t         *tp;
-    ngx_rbtree_t       *rbtree;
-    ngx_js_dict_t      *dict;
-    ngx_shm_zone_t     *shm_zone;
-    ngx_rbtree_node_t  *rn;
+    JSValue                    v;
+    int64_t                    length;
+    ngx_uint_t                 i;
+    ngx_js_dict_t             *dict;
+    ngx_shm_zone_t            *shm_zone;
+    ngx_js_dict_batch_t        batch;
+    ngx_js_dict_batch_item_t  *item;
 
     shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
     if (shm_zone == NULL) {
@@ -3715,33 +6127,103 @@ ngx_qjs_ext_shared_dict_size(JSContext *cx, JSValueConst this_val,
 
     dict = shm_zone->data;
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    if (ngx_qjs_dict_batch_keys(cx, argv[0], &batch) != NGX_OK) {
+        return JS_EXCEPTION;
+    }
 
-    if (dict->timeout) {
-        tp = ngx_timeofday();
-        now = tp->sec * 1000 + tp->msec;
-        ngx_js_dict_expire(dict, now);
+    batch.op = NGX_JS_DICT_BATCH_SET;
+
+    if (!qjs_is_array(cx, argv[1])) {
+        JS_ThrowTypeError(cx, "values is not an array");
+        goto fail;
     }
 
-    rbtree = &dict->sh->rbtree;
+    v = JS_GetPropertyStr(cx, argv[1], "length");
+    if (JS_IsException(v)) {
+        goto fail;
+    }
 
-    if (rbtree->root == rbtree->sentinel) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
-        return JS_NewInt32(cx, 0);
+    if (JS_ToInt64(cx, &length, v) < 0) {
+        JS_FreeValue(cx, v);
+        goto fail;
     }
 
-    items = 0;
+    JS_FreeValue(cx, v);
 
-    for (rn = ngx_rbtree_min(rbtree->root, rbtree->sentinel);
-         rn != NULL;
-         rn = ngx_rbtree_next(rbtree, rn))
+    if ((ngx_uint_t) length != batch.n) {
+        JS_ThrowTypeError(cx, "values length does not match keys");
+        goto fail;
+    }
+
+    for (i = 0; i < batch.n; i++) {
+        item = &batch.items[i];
+
+        v = JS_GetPropertyUint32(cx, argv[1], i);
+        if (JS_IsException(v)) {
+            goto fail;
+        }
+
+        if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+            if (!JS_IsString(v)) {
+                JS_FreeValue(cx, v);
+                JS_ThrowTypeError(cx, "string value is expected");
+                goto fail;
+            }
+
+            item->value.str.data = (u_char *) JS_ToCStringLen(cx,
+                                                    &item->value.str.len, v);
+            JS_FreeValue(cx, v);
+
+            if (item->value.str.data == NULL) {
+                goto fail;
+            }
+
+        } else {
+            if (!JS_IsNumber(v)) {
+                JS_FreeValue(cx, v);
+                JS_ThrowTypeError(cx, "number value is expected");
+                goto fail;
+            }
+
+            (void) JS_ToFloat64(cx, &item->value.number, v);
+        }
+    }
+
+    if (ngx_qjs_dict_batch_timeout(cx, dict, argv[2], &batch.timeout)
+        != NGX_OK)
     {
-        items++;
+        goto fail;
+    }
+
+    if (ngx_js_dict_batch(dict, &batch) != NGX_OK) {
+        ngx_qjs_dict_batch_free(cx, dict, &batch);
+        return ngx_qjs_throw_shared_memory_error(cx);
     }
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_qjs_dict_batch_free(cx, dict, &batch);
+
+    return JS_DupValue(cx, this_val);
+
+fail:
+
+    ngx_qjs_dict_batch_free(cx, dict, &batch);
+
+    return JS_EXCEPTION;
+}
+
+
+static JSValue
+ngx_qjs_ext_shared_dict_size(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    ngx_shm_zone_t  *shm_zone;
+
+    shm_zone = JS_GetOpaque(this_val, NGX_QJS_CLASS_ID_SHARED_DICT);
+    if (shm_zone == NULL) {
+        return JS_ThrowTypeError(cx, "\"this\" is not a shared dict");
+    }
 
-    return JS_NewInt32(cx, items);
+    return JS_NewInt32(cx, ngx_js_dict_size(shm_zone->data));
 }
 
 
@@ -3788,23 +6270,166 @@ ngx_qjs_dict_copy_value_locked(JSContext *cx, ngx_js_dict_t *dict,
 }
 
 
-static ngx_js_dict_node_t *
-ngx_qjs_dict_lookup(ngx_js_dict_t *dict, ngx_str_t *key)
+static ngx_int_t
+ngx_qjs_dict_batch_keys(JSContext *cx, JSValueConst keys,
+    ngx_js_dict_batch_t *batch)
+{
+    JSValue     v;
+    int64_t     length;
+    ngx_uint_t  i;
+
+    ngx_memzero(batch, sizeof(ngx_js_dict_batch_t));
+
+    if (!qjs_is_array(cx, keys)) {
+        JS_ThrowTypeError(cx, "keys is not an array");
+        return NGX_ERROR;
+    }
+
+    v = JS_GetPropertyStr(cx, keys, "length");
+    if (JS_IsException(v)) {
+        return NGX_ERROR;
+    }
+
+    if (JS_ToInt64(cx, &length, v) < 0) {
+        JS_FreeValue(cx, v);
+        return NGX_ERROR;
+    }
+
+    JS_FreeValue(cx, v);
+
+    if (length <= 0) {
+        return NGX_OK;
+    }
+
+    batch->items = ngx_calloc(length * sizeof(ngx_js_dict_batch_item_t),
+                              ngx_cycle->log);
+    if (batch->items == NULL) {
+        JS_ThrowOutOfMemory(cx);
+        return NGX_ERROR;
+    }
+
+    batch->n = length;
+
+    for (i = 0; i < batch->n; i++) {
+        v = JS_GetPropertyUint32(cx, keys, i);
+        if (JS_IsException(v)) {
+            goto fail;
+        }
+
+        batch->items[i].key.data = (u_char *) JS_ToCStringLen(cx,
+                                                 &batch->items[i].key.len, v);
+        JS_FreeValue(cx, v);
+
+        if (batch->items[i].key.data == NULL) {
+            goto fail;
+        }
+    }
+
+    return NGX_OK;
+
+fail:
+
+    ngx_qjs_dict_batch_free(cx, NULL, batch);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_qjs_dict_batch_free(JSContext *cx, ngx_js_dict_t *dict,
+    ngx_js_dict_batch_t *batch)
+{
+    ngx_uint_t                 i;
+    ngx_js_dict_batch_item_t  *item;
+
+    if (batch->items == NULL) {
+        return;
+    }
+
+    for (i = 0; i < batch->n; i++) {
+        item = &batch->items[i];
+
+        if (item->key.data != NULL) {
+            JS_FreeCString(cx, (char *) item->key.data);
+        }
+
+        if (dict != NULL
+            && dict->type == NGX_JS_DICT_TYPE_STRING
+            && batch->op == NGX_JS_DICT_BATCH_SET
+            && item->value.str.data != NULL)
+        {
+            JS_FreeCString(cx, (char *) item->value.str.data);
+        }
+    }
+
+    ngx_free(batch->items);
+    batch->items = NULL;
+}
+
+
+static ngx_int_t
+ngx_qjs_dict_batch_timeout(JSContext *cx, ngx_js_dict_t *dict,
+    JSValueConst value, ngx_msec_t *timeout)
+{
+    uint32_t  n;
+
+    if (JS_IsUndefined(value)) {
+        *timeout = dict->timeout;
+        return NGX_OK;
+    }
+
+    if (!JS_IsNumber(value)) {
+        JS_ThrowTypeError(cx, "timeout is not a number");
+        return NGX_ERROR;
+    }
+
+    if (!dict->timeout) {
+        JS_ThrowTypeError(cx, "shared dict must be declared with timeout");
+        return NGX_ERROR;
+    }
+
+    if (JS_ToUint32(cx, &n, value) < 0) {
+        return NGX_ERROR;
+    }
+
+    if (n < 1) {
+        JS_ThrowTypeError(cx, "timeout must be greater than or equal to 1");
+        return NGX_ERROR;
+    }
+
+    *timeout = n;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_qjs_dict_batch_get(ngx_js_dict_t *dict, ngx_js_dict_batch_t *batch,
+    ngx_js_dict_node_t *node, ngx_uint_t i)
 {
-    uint32_t       hash;
-    ngx_rbtree_t  *rbtree;
+    JSValue     v, *arr;
+    JSContext  *cx;
+
+    cx = batch->vm;
+    arr = batch->retval;
 
-    rbtree = &dict->sh->rbtree;
+    v = ngx_qjs_dict_copy_value_locked(cx, dict, node);
+    if (JS_IsException(v)) {
+        return NGX_ERROR;
+    }
 
-    hash = ngx_crc32_long(key->data, key->len);
+    if (JS_SetPropertyUint32(cx, *arr, i, v) < 0) {
+        return NGX_ERROR;
+    }
 
-    return (ngx_js_dict_node_t *) ngx_str_rbtree_lookup(rbtree, key, hash);
+    return NGX_OK;
 }
 
 
 static ngx_int_t
-ngx_qjs_dict_add(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
-    JSValue value, ngx_msec_t timeout, ngx_msec_t now)
+ngx_qjs_dict_add(JSContext *cx, ngx_js_dict_t *dict, ngx_js_dict_shard_t *shard,
+    ngx_str_t *key, uint32_t hash, JSValue value, ngx_msec_t timeout,
+    ngx_msec_t now)
 {
     ngx_int_t           rc;
     ngx_js_dict_value_t  entry;
@@ -3824,7 +6449,7 @@ ngx_qjs_dict_add(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
         }
     }
 
-    rc = ngx_js_dict_add_value(dict, key, &entry, timeout, now);
+    rc = ngx_js_dict_add_value(dict, shard, key, hash, &entry, timeout, now);
 
     if (dict->type == NGX_JS_DICT_TYPE_STRING) {
         JS_FreeCString(cx, (char *) entry.str.data);
@@ -3838,25 +6463,30 @@ static JSValue
 ngx_qjs_dict_delete(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
     int retval)
 {
-    JSValue              ret;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_node_t  *node;
+    JSValue               ret;
+    uint32_t              hash;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
+
+    shard = ngx_js_dict_shard(dict, key, &hash);
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
+    ngx_js_dict_write_lock(shard);
 
-    node = ngx_qjs_dict_lookup(dict, key);
+    node = ngx_js_dict_lookup(shard, key, hash);
 
     if (node == NULL) {
-        ngx_rwlock_unlock(&dict->sh->rwlock);
+        ngx_js_dict_write_unlock(shard);
         return JS_UNDEFINED;
     }
 
     if (dict->timeout) {
-        ngx_rbtree_delete(&dict->sh->rbtree_expire, &node->expire);
+        ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
     }
 
-    ngx_rbtree_delete(&dict->sh->rbtree, (ngx_rbtree_node_t *) node);
+    ngx_js_dict_index_delete(shard, node);
+    ngx_js_dict_journal_delete(dict, shard, node);
 
     if (retval) {
         tp = ngx_timeofday();
@@ -3877,7 +6507,7 @@ ngx_qjs_dict_delete(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
 
     dict->sh->dirty = 1;
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_js_dict_write_unlock(shard);
 
     if (dict->state_file.data && !dict->save_event.timer_set) {
         ngx_add_timer(&dict->save_event, 1000);
@@ -3890,14 +6520,39 @@ ngx_qjs_dict_delete(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
 static JSValue
 ngx_qjs_dict_get(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key)
 {
-    JSValue              ret;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_node_t  *node;
+    JSValue               ret;
+    uint32_t              hash;
+    ngx_int_t             rc;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_value_t   value;
+    ngx_js_dict_shard_t  *shard;
+    u_char                buf[NGX_JS_DICT_OPTIMISTIC_MAX];
+
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    rc = ngx_js_dict_lookup_optimistic(dict, shard, key, hash, &value, buf,
+                                       sizeof(buf));
+
+    if (rc == NGX_DECLINED) {
+        return JS_UNDEFINED;
+    }
 
-    ngx_rwlock_rlock(&dict->sh->rwlock);
+    if (rc == NGX_OK) {
+        if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+            return JS_NewStringLen(cx, (const char *) value.str.data,
+                                   value.str.len);
+        }
+
+        return JS_NewFloat64(cx, value.number);
+    }
+
+    /* NGX_AGAIN */
 
-    node = ngx_qjs_dict_lookup(dict, key);
+    ngx_rwlock_rlock(&shard->rwlock);
+
+    node = ngx_js_dict_lookup(shard, key, hash);
 
     if (node == NULL) {
         goto not_found;
@@ -3912,14 +6567,18 @@ ngx_qjs_dict_get(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key)
         }
     }
 
+    if (dict->evict == NGX_JS_DICT_EVICT_LRU) {
+        node->accessed = 1;
+    }
+
     ret = ngx_qjs_dict_copy_value_locked(cx, dict, node);
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_rwlock_unlock(&shard->rwlock);
 
     return ret;
 
 not_found:
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_rwlock_unlock(&shard->rwlock);
 
     return JS_UNDEFINED;
 }
@@ -3929,40 +6588,49 @@ static JSValue
 ngx_qjs_dict_incr(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
     double delta, double init, ngx_msec_t timeout)
 {
-    JSValue              value;
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_node_t  *node;
+    JSValue               value;
+    uint32_t              hash;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
     tp = ngx_timeofday();
     now = tp->sec * 1000 + tp->msec;
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    ngx_js_dict_write_lock(shard);
 
-    node = ngx_qjs_dict_lookup(dict, key);
+    node = ngx_js_dict_lookup(shard, key, hash);
 
     if (node == NULL) {
         value = JS_NewFloat64(cx, init + delta);
-        if (ngx_qjs_dict_add(cx, dict, key, value, timeout, now) != NGX_OK) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
+        if (ngx_qjs_dict_add(cx, dict, shard, key, hash, value, timeout, now)
+            != NGX_OK)
+        {
+            ngx_js_dict_write_unlock(shard);
             JS_FreeValue(cx, value);
             return ngx_qjs_throw_shared_memory_error(cx);
         }
 
     } else {
         node->value.number += delta;
+        node->accessed = 1;
         value = JS_NewFloat64(cx, node->value.number);
 
         if (dict->timeout) {
-            ngx_rbtree_delete(&dict->sh->rbtree_expire, &node->expire);
+            ngx_rbtree_delete(&shard->rbtree_expire, &node->expire);
             node->expire.key = now + timeout;
-            ngx_rbtree_insert(&dict->sh->rbtree_expire, &node->expire);
+            ngx_rbtree_insert(&shard->rbtree_expire, &node->expire);
         }
+
+        ngx_js_dict_journal_add(dict, shard, node);
     }
 
     dict->sh->dirty = 1;
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_js_dict_write_unlock(shard);
 
     if (dict->state_file.data && !dict->save_event.timer_set) {
         ngx_add_timer(&dict->save_event, 1000);
@@ -3976,24 +6644,30 @@ static JSValue
 ngx_qjs_dict_set(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
     JSValue value, ngx_msec_t timeout, unsigned flags)
 {
-    ngx_msec_t           now;
-    ngx_time_t          *tp;
-    ngx_js_dict_node_t  *node;
+    uint32_t              hash;
+    ngx_msec_t            now;
+    ngx_time_t           *tp;
+    ngx_js_dict_node_t   *node;
+    ngx_js_dict_shard_t  *shard;
 
     tp = ngx_timeofday();
     now = tp->sec * 1000 + tp->msec;
 
-    ngx_rwlock_wlock(&dict->sh->rwlock);
+    shard = ngx_js_dict_shard(dict, key, &hash);
+
+    ngx_js_dict_write_lock(shard);
 
-    node = ngx_qjs_dict_lookup(dict, key);
+    node = ngx_js_dict_lookup(shard, key, hash);
 
     if (node == NULL) {
         if (flags & NGX_JS_DICT_FLAG_MUST_EXIST) {
-            ngx_rwlock_unlock(&dict->sh->rwlock);
+            ngx_js_dict_write_unlock(shard);
             return JS_FALSE;
         }
 
-        if (ngx_qjs_dict_add(cx, dict, key, value, timeout, now) != NGX_OK) {
+        if (ngx_qjs_dict_add(cx, dict, shard, key, hash, value, timeout, now)
+            != NGX_OK)
+        {
             goto memory_error;
         }
 
@@ -4001,12 +6675,12 @@ ngx_qjs_dict_set(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
 
         if (flags & NGX_JS_DICT_FLAG_MUST_NOT_EXIST) {
             if (!dict->timeout || now < node->expire.key) {
-                ngx_rwlock_unlock(&dict->sh->rwlock);
+                ngx_js_dict_write_unlock(shard);
                 return JS_FALSE;
             }
         }
 
-        if (ngx_qjs_dict_update(cx, dict, node, value, timeout, now)
+        if (ngx_qjs_dict_update(cx, dict, shard, node, value, timeout, now)
             != NGX_OK)
         {
             goto memory_error;
@@ -4015,7 +6689,7 @@ ngx_qjs_dict_set(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
 
     dict->sh->dirty = 1;
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_js_dict_write_unlock(shard);
 
     if (dict->state_file.data && !dict->save_event.timer_set) {
         ngx_add_timer(&dict->save_event, 1000);
@@ -4025,7 +6699,7 @@ ngx_qjs_dict_set(JSContext *cx, ngx_js_dict_t *dict, ngx_str_t *key,
 
 memory_error:
 
-    ngx_rwlock_unlock(&dict->sh->rwlock);
+    ngx_js_dict_write_unlock(shard);
 
     return ngx_qjs_throw_shared_memory_error(cx);
 }
@@ -4033,44 +6707,31 @@ memory_error:
 
 static ngx_int_t
 ngx_qjs_dict_update(JSContext *cx, ngx_js_dict_t *dict,
-    ngx_js_dict_node_t *node, JSValue value, ngx_msec_t timeout, ngx_msec_t now)
+    ngx_js_dict_shard_t *shard, ngx_js_dict_node_t *node, JSValue value,
+    ngx_msec_t timeout, ngx_msec_t now)
 {
-    u_char     *p;
-    ngx_str_t   string;
+    ngx_int_t            rc;
+    ngx_js_dict_value_t  entry;
 
     if (dict->type == NGX_JS_DICT_TYPE_STRING) {
-        string.data = (u_char *) JS_ToCStringLen(cx, &string.len, value);
-        if (string.data == NULL) {
-            return NGX_ERROR;
-        }
-
-        p = ngx_js_dict_alloc(dict, string.len);
-        if (p == NULL) {
-            JS_FreeCString(cx, (char *) string.data);
+        entry.str.data = (u_char *) JS_ToCStringLen(cx, &entry.str.len, value);
+        if (entry.str.data == NULL) {
             return NGX_ERROR;
         }
 
-        ngx_slab_free_locked(dict->shpool, node->value.str.data);
-        ngx_memcpy(p, string.data, string.len);
-
-        node->value.str.data = p;
-        node->value.str.len = string.len;
-
-        JS_FreeCString(cx, (char *) string.data);
-
     } else {
-        if (JS_ToFloat64(cx, &node->value.number, value) < 0) {
+        if (JS_ToFloat64(cx, &entry.number, value) < 0) {
             return NGX_ERROR;
         }
     }
 
-    if (dict->timeout) {
-        ngx_rbtree_delete(&dict->sh->rbtree_expire, &node->expire);
-        node->expire.key = now + timeout;
-        ngx_rbtree_insert(&dict->sh->rbtree_expire, &node->expire);
+    rc = ngx_js_dict_update_value(dict, shard, node, &entry, timeout, now);
+
+    if (dict->type == NGX_JS_DICT_TYPE_STRING) {
+        JS_FreeCString(cx, (char *) entry.str.data);
     }
 
-    return NGX_OK;
+    return rc;
 }
 
 
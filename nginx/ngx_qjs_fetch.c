@@ -15,19 +15,57 @@ typedef struct {
 } ngx_qjs_entry_t;
 
 
+typedef struct ngx_qjs_fetch_batch_s  ngx_qjs_fetch_batch_t;
+
+
 typedef struct {
-    ngx_js_http_t    http;
+    ngx_js_http_t           http;
 
-    JSContext        *cx;
-    ngx_qjs_event_t  *event;
+    JSContext              *cx;
+    ngx_qjs_event_t        *event;
 
-    JSValue           response_value;
+    JSValue                 response_value;
 
-    JSValue           promise;
-    JSValue           promise_callbacks[2];
+    JSValue                 promise;
+    JSValue                 promise_callbacks[2];
+
+    uint8_t                 reading;
+    JSValue                 read_callbacks[2];
+
+    JSValue                 body_stream;
+
+    ngx_qjs_fetch_batch_t  *batch;
+    ngx_uint_t              index;
 } ngx_qjs_fetch_t;
 
 
+/*
+ * remaining: the number of responses not received yet,
+ * 0 once the promise is settled;
+ * count: the number of fetches referencing the batch,
+ * plus one for fetchAll() itself.
+ */
+
+struct ngx_qjs_fetch_batch_s {
+    ngx_js_http_batch_t     http;
+
+    JSValue                 promise;
+    JSValue                 promise_callbacks[2];
+    JSValue                 results;
+
+    ngx_uint_t              remaining;
+    ngx_uint_t              count;
+    ngx_qjs_fetch_t       **fetches;
+};
+
+
+typedef struct {
+    JSValue           response;
+} ngx_qjs_fetch_body_t;
+
+
+static JSValue ngx_qjs_fetch(JSContext *cx, int argc, JSValueConst *argv,
+    ngx_qjs_fetch_batch_t *batch, ngx_uint_t index);
 static ngx_int_t ngx_qjs_method_process(JSContext *cx,
     ngx_js_request_t *request);
 static ngx_int_t ngx_qjs_headers_inherit(JSContext *cx,
@@ -40,14 +78,27 @@ static void ngx_qjs_fetch_error(ngx_js_http_t *http, const char *err);
 static void ngx_qjs_fetch_destructor(ngx_qjs_event_t *event);
 static void ngx_qjs_fetch_done(ngx_qjs_fetch_t *fetch, JSValue retval,
     ngx_int_t rc);
+static ngx_int_t ngx_qjs_fetch_batch_settle(ngx_qjs_fetch_t *fetch,
+    JSValue retval, ngx_int_t rc);
+static void ngx_qjs_fetch_batch_release(JSContext *cx,
+    ngx_qjs_fetch_batch_t *batch);
 
 static ngx_int_t ngx_qjs_request_ctor(JSContext *cx, ngx_js_request_t *request,
     ngx_url_t *u, int argc, JSValueConst *argv);
+static ngx_int_t ngx_qjs_request_body_stream(JSContext *cx,
+    ngx_js_request_t *request, ngx_js_response_t *response);
 
 static ngx_int_t ngx_qjs_fetch_append_headers(ngx_js_http_t *http,
     ngx_js_headers_t *headers, u_char *name, size_t len, u_char *value,
     size_t vlen);
 static void ngx_qjs_fetch_process_done(ngx_js_http_t *http);
+static ngx_int_t ngx_qjs_fetch_stream_handler(ngx_js_http_t *http,
+    ngx_uint_t event);
+static ngx_int_t ngx_qjs_fetch_stream_finalize(ngx_qjs_fetch_t *fetch,
+    ngx_int_t rc);
+static ngx_int_t ngx_qjs_fetch_read_settle(ngx_qjs_fetch_t *fetch);
+static ngx_int_t ngx_qjs_fetch_read_result(JSContext *cx,
+    ngx_js_response_t *response, JSValue *result);
 static ngx_int_t ngx_qjs_headers_append(JSContext *cx,
     ngx_js_headers_t *headers, u_char *name, size_t len, u_char *value,
     size_t vlen);
@@ -109,8 +160,24 @@ static JSValue ngx_qjs_ext_fetch_response_redirected(JSContext *cx,
     JSValueConst this_val);
 static JSValue ngx_qjs_ext_fetch_response_field(JSContext *cx,
     JSValueConst this_val, int magic);
+static JSValue ngx_qjs_ext_fetch_response_body_stream(JSContext *cx,
+    JSValueConst this_val);
 static void ngx_qjs_fetch_response_finalizer(JSRuntime *rt, JSValue val);
 
+static ngx_js_response_t *ngx_qjs_fetch_body(JSContext *cx,
+    JSValueConst this_val);
+static JSValue ngx_qjs_ext_fetch_body_cancel(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue ngx_qjs_ext_fetch_body_get_reader(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue ngx_qjs_ext_fetch_body_iterator(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue ngx_qjs_ext_fetch_body_read(JSContext *cx,
+    JSValueConst this_val, int argc, JSValueConst *argv);
+static void ngx_qjs_fetch_body_mark(JSRuntime *rt, JSValueConst val,
+    JS_MarkFunc *mark_func);
+static void ngx_qjs_fetch_body_finalizer(JSRuntime *rt, JSValue val);
+
 static JSValue ngx_qjs_fetch_flag(JSContext *cx, const ngx_qjs_entry_t *entries,
     ngx_int_t value);
 static ngx_int_t ngx_qjs_fetch_flag_set(JSContext *cx,
@@ -155,6 +222,7 @@ static const JSCFunctionListEntry  ngx_qjs_ext_fetch_request_proto[] = {
 static const JSCFunctionListEntry  ngx_qjs_ext_fetch_response_proto[] = {
     JS_CFUNC_MAGIC_DEF("arrayBuffer", 0, ngx_qjs_ext_fetch_response_body,
                        NGX_QJS_BODY_ARRAY_BUFFER),
+    JS_CGETSET_DEF("body", ngx_qjs_ext_fetch_response_body_stream, NULL),
     JS_CGETSET_DEF("bodyUsed", ngx_qjs_ext_fetch_response_body_used, NULL),
     JS_CGETSET_DEF("headers", ngx_qjs_ext_fetch_response_headers, NULL ),
     JS_CFUNC_MAGIC_DEF("json", 0, ngx_qjs_ext_fetch_response_body,
@@ -171,6 +239,18 @@ static const JSCFunctionListEntry  ngx_qjs_ext_fetch_response_proto[] = {
 };
 
 
+static const JSCFunctionListEntry  ngx_qjs_ext_fetch_body_proto[] = {
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "ReadableStream",
+                       JS_PROP_CONFIGURABLE),
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0,
+                 ngx_qjs_ext_fetch_body_iterator),
+    JS_CFUNC_DEF("cancel", 0, ngx_qjs_ext_fetch_body_cancel),
+    JS_CFUNC_DEF("getReader", 0, ngx_qjs_ext_fetch_body_get_reader),
+    JS_CFUNC_DEF("next", 0, ngx_qjs_ext_fetch_body_read),
+    JS_CFUNC_DEF("read", 0, ngx_qjs_ext_fetch_body_read),
+};
+
+
 static const JSClassDef  ngx_qjs_fetch_headers_class = {
     "Headers",
     .finalizer = NULL,
@@ -193,6 +273,13 @@ static const JSClassDef  ngx_qjs_fetch_response_class = {
 };
 
 
+static const JSClassDef  ngx_qjs_fetch_body_class = {
+    "ReadableStream",
+    .finalizer = ngx_qjs_fetch_body_finalizer,
+    .gc_mark = ngx_qjs_fetch_body_mark,
+};
+
+
 static const ngx_qjs_entry_t  ngx_qjs_fetch_cache_modes[] = {
     { ngx_string("default"), CACHE_MODE_DEFAULT },
     { ngx_string("no-store"), CACHE_MODE_NO_STORE },
@@ -231,6 +318,171 @@ qjs_module_t  ngx_qjs_ngx_fetch_module = {
 JSValue
 ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
     JSValueConst *argv)
+{
+    return ngx_qjs_fetch(cx, argc, argv, NULL, 0);
+}
+
+
+JSValue
+ngx_qjs_ext_fetch_all(JSContext *cx, JSValueConst this_val, int argc,
+    JSValueConst *argv)
+{
+    void                   *external;
+    JSValue                 value, promise, arguments[2];
+    uint32_t                i, length;
+    ngx_int_t               connections, timeout;
+    ngx_pool_t             *pool;
+    ngx_js_ctx_t           *ctx;
+    ngx_connection_t       *c;
+    ngx_qjs_fetch_batch_t  *batch;
+
+    if (!qjs_is_array(cx, argv[0])) {
+        return JS_ThrowTypeError(cx, "\"resources\" is not an array");
+    }
+
+    if (qjs_array_length(cx, argv[0], &length) < 0) {
+        return JS_EXCEPTION;
+    }
+
+    connections = NGX_JS_HTTP_BATCH_CONNECTIONS;
+    timeout = 0;
+
+    if (JS_IsObject(argv[1])) {
+        value = JS_GetPropertyStr(cx, argv[1], "connections");
+        if (JS_IsException(value)) {
+            return JS_EXCEPTION;
+        }
+
+        if (!JS_IsUndefined(value)) {
+            if (ngx_qjs_integer(cx, value, &connections) != NGX_OK) {
+                JS_FreeValue(cx, value);
+                return JS_EXCEPTION;
+            }
+
+            if (connections <= 0) {
+                return JS_ThrowRangeError(cx,
+                                          "\"connections\" must be positive");
+            }
+        }
+
+        value = JS_GetPropertyStr(cx, argv[1], "timeout");
+        if (JS_IsException(value)) {
+            return JS_EXCEPTION;
+        }
+
+        if (!JS_IsUndefined(value)) {
+            if (ngx_qjs_integer(cx, value, &timeout) != NGX_OK) {
+                JS_FreeValue(cx, value);
+                return JS_EXCEPTION;
+            }
+
+            if (timeout < 0) {
+                return JS_ThrowRangeError(cx,
+                                          "\"timeout\" must be non-negative");
+            }
+        }
+
+        value = JS_GetPropertyStr(cx, argv[1], "stream");
+        if (JS_IsException(value)) {
+            return JS_EXCEPTION;
+        }
+
+        if (JS_ToBool(cx, value)) {
+            JS_FreeValue(cx, value);
+            return JS_ThrowTypeError(cx,
+                                  "\"stream\" is not supported by fetchAll()");
+        }
+
+        JS_FreeValue(cx, value);
+    }
+
+    external = JS_GetContextOpaque(cx);
+    c = ngx_qjs_external_connection(cx, external);
+    pool = ngx_qjs_external_pool(cx, external);
+
+    batch = ngx_pcalloc(pool, sizeof(ngx_qjs_fetch_batch_t)
+                              + length * sizeof(ngx_qjs_fetch_t *));
+    if (batch == NULL) {
+        return JS_ThrowOutOfMemory(cx);
+    }
+
+    batch->fetches = (ngx_qjs_fetch_t **) &batch[1];
+    batch->remaining = length;
+
+    batch->promise = JS_NewPromiseCapability(cx, batch->promise_callbacks);
+    if (JS_IsException(batch->promise)) {
+        return JS_EXCEPTION;
+    }
+
+    batch->results = JS_NewArray(cx);
+    if (JS_IsException(batch->results)) {
+        JS_FreeValue(cx, batch->promise);
+        JS_FreeValue(cx, batch->promise_callbacks[0]);
+        JS_FreeValue(cx, batch->promise_callbacks[1]);
+        return JS_EXCEPTION;
+    }
+
+    batch->count = 1;
+
+    ngx_js_http_batch_init(&batch->http, c->log, connections);
+
+    /* the options are also the init argument of every request */
+
+    arguments[1] = argv[1];
+
+    for (i = 0; i < length; i++) {
+        arguments[0] = JS_GetPropertyUint32(cx, argv[0], i);
+        if (JS_IsException(arguments[0])) {
+            goto fail;
+        }
+
+        value = ngx_qjs_fetch(cx, 2, arguments, batch, i);
+
+        JS_FreeValue(cx, arguments[0]);
+
+        if (JS_IsException(value)) {
+            goto fail;
+        }
+
+        JS_FreeValue(cx, value);
+    }
+
+    if (batch->remaining == 0) {
+        /* all the responses are served from cache */
+
+        promise = qjs_promise_result(cx, JS_DupValue(cx, batch->results));
+
+    } else {
+        ngx_js_http_batch_run(&batch->http, timeout);
+
+        promise = JS_DupValue(cx, batch->promise);
+    }
+
+    ngx_qjs_fetch_batch_release(cx, batch);
+
+    return promise;
+
+fail:
+
+    batch->remaining = 0;
+
+    ctx = ngx_qjs_external_ctx(cx, external);
+
+    while (i-- > 0) {
+        if (batch->fetches[i] != NULL) {
+            ngx_js_del_event(ctx, batch->fetches[i]->event);
+        }
+    }
+
+    ngx_qjs_fetch_batch_release(cx, batch);
+
+    return qjs_promise_result(cx, JS_EXCEPTION);
+}
+
+
+static JSValue
+ngx_qjs_fetch(JSContext *cx, int argc, JSValueConst *argv,
+    ngx_qjs_fetch_batch_t *batch, ngx_uint_t index)
 {
     void                *external;
     JSValue              init, value, promise;
@@ -240,10 +492,9 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
     ngx_pool_t          *pool;
     ngx_js_ctx_t        *ctx;
     ngx_js_http_t       *http;
-    ngx_qjs_fetch_t     *fetch;
+    ngx_qjs_fetch_t     *fetch, *source;
     ngx_connection_t    *c;
     ngx_js_request_t     request;
-    ngx_resolver_ctx_t  *rs;
 
     external = JS_GetContextOpaque(cx);
     c = ngx_qjs_external_connection(cx, external);
@@ -257,11 +508,26 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
 
     promise = JS_DupValue(cx, fetch->promise);
 
+    if (batch != NULL) {
+        fetch->batch = batch;
+        fetch->index = index;
+
+        batch->fetches[index] = fetch;
+        batch->count++;
+    }
+
     rc = ngx_qjs_request_ctor(cx, &request, &u, argc, argv);
     if (rc != NGX_OK) {
         goto fail;
     }
 
+    if (request.body_stream != NULL) {
+        /* keeps the source response alive while the body is relayed */
+
+        source = (ngx_qjs_fetch_t *) request.body_stream;
+        fetch->body_stream = JS_DupValue(cx, source->response_value);
+    }
+
     if (u.host.len >= NGX_JS_HOST_MAX_LEN) {
         JS_ThrowInternalError(cx, "Host name too long");
         goto fail;
@@ -310,6 +576,26 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
             }
         }
 
+        value = JS_GetPropertyStr(cx, init, "stream");
+        if (JS_IsException(value)) {
+            goto fail;
+        }
+
+        if (!JS_IsUndefined(value)) {
+            http->stream = JS_ToBool(cx, value);
+            JS_FreeValue(cx, value);
+        }
+
+        value = JS_GetPropertyStr(cx, init, "coalesce");
+        if (JS_IsException(value)) {
+            goto fail;
+        }
+
+        if (!JS_IsUndefined(value)) {
+            http->coalesce = JS_ToBool(cx, value);
+            JS_FreeValue(cx, value);
+        }
+
 #if (NGX_SSL)
         value = JS_GetPropertyStr(cx, init, "verify");
         if (JS_IsException(value)) {
@@ -333,6 +619,47 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
     NJS_CHB_MP_INIT(&http->chain, ctx->engine->pool);
     NJS_CHB_MP_INIT(&http->response.chain, ctx->engine->pool);
 
+    rc = ngx_js_fetch_cache_lookup(http, &request);
+
+    if (rc == NGX_OK) {
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                       "js http fetch:%p served from cache", fetch);
+
+        value = JS_NewObjectClass(cx, NGX_QJS_CLASS_ID_FETCH_RESPONSE);
+        if (JS_IsException(value)) {
+            goto fail;
+        }
+
+        JS_SetOpaque(value, &http->response);
+
+        ngx_js_del_event(ctx, fetch->event);
+
+        JS_FreeValue(cx, promise);
+
+        if (batch != NULL) {
+            batch->fetches[index] = NULL;
+            batch->remaining--;
+
+            if (JS_SetPropertyUint32(cx, batch->results, index, value) < 0) {
+                return JS_EXCEPTION;
+            }
+
+            return JS_UNDEFINED;
+        }
+
+        return qjs_promise_result(cx, value);
+    }
+
+    if (rc == NGX_BUSY) {
+        JS_ThrowInternalError(cx, "fetch response is not cached");
+        goto fail;
+    }
+
+    if (rc == NGX_ERROR) {
+        JS_ThrowOutOfMemory(cx);
+        goto fail;
+    }
+
     resolve_host = NULL;
     http->connect_port = http->port;
 
@@ -343,7 +670,7 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
                 != NGX_OK)
             {
                 JS_ThrowInternalError(cx, "failed to evaluate proxy URL");
-                return JS_EXCEPTION;
+                goto fail;
             }
 
         } else {
@@ -364,20 +691,57 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
     ngx_js_fetch_build_request(http, &request, &u.uri, &u,
                                ngx_js_http_proxy(http) && !ngx_js_https(&u));
 
+    if (resolve_host == NULL) {
+        http->naddrs = 1;
+        http->addrs = &http->addr;
+
+        if (ngx_js_http_proxy(http)) {
+            ngx_memcpy(&http->addr, &http->proxy.url->addrs[0],
+                       sizeof(ngx_addr_t));
+
+        } else {
+            ngx_memcpy(&http->addr, &u.addrs[0], sizeof(ngx_addr_t));
+        }
+    }
+
+    if (http->coalesce) {
+        rc = ngx_js_http_coalesce(http, &request,
+                               ngx_qjs_external_resolver(cx, external),
+                               resolve_host,
+                               ngx_qjs_external_resolver_timeout(cx, external));
+
+        if (rc == NGX_ERROR) {
+            JS_ThrowOutOfMemory(cx);
+            goto fail;
+        }
+
+        if (rc == NGX_OK) {
+            return promise;
+        }
+    }
+
+    if (batch != NULL) {
+        ngx_js_http_batch_add(&batch->http, http,
+                              ngx_qjs_external_resolver(cx, external),
+                              resolve_host,
+                              ngx_qjs_external_resolver_timeout(cx, external));
+        return promise;
+    }
+
     if (resolve_host != NULL) {
         ngx_log_debug0(NGX_LOG_DEBUG_EVENT, http->log, 0,
                        "js http fetch: resolving");
 
-        rs = ngx_js_http_resolve(http, ngx_qjs_external_resolver(cx, external),
+        rc = ngx_js_http_resolve(http, ngx_qjs_external_resolver(cx, external),
                                resolve_host,
                                ngx_qjs_external_resolver_timeout(cx, external));
 
-        if (rs == NULL) {
+        if (rc == NGX_ERROR) {
             JS_FreeValue(cx, promise);
             return JS_ThrowOutOfMemory(cx);
         }
 
-        if (rs == NGX_NO_RESOLVER) {
+        if (rc == NGX_DECLINED) {
             JS_ThrowInternalError(cx, "no resolver defined");
             goto fail;
         }
@@ -385,16 +749,6 @@ ngx_qjs_ext_fetch(JSContext *cx, JSValueConst this_val, int argc,
         return promise;
     }
 
-    http->naddrs = 1;
-    http->addrs = &http->addr;
-
-    if (ngx_js_http_proxy(http)) {
-        ngx_memcpy(&http->addr, &http->proxy.url->addrs[0], sizeof(ngx_addr_t));
-
-    } else {
-        ngx_memcpy(&http->addr, &u.addrs[0], sizeof(ngx_addr_t));
-    }
-
     ngx_js_http_connect(http);
 
     return promise;
@@ -408,6 +762,11 @@ fail:
 
     JS_FreeValue(cx, promise);
 
+    if (batch != NULL) {
+        batch->fetches[index] = NULL;
+        return JS_EXCEPTION;
+    }
+
     return qjs_promise_result(cx, JS_EXCEPTION);
 }
 
@@ -485,6 +844,11 @@ ngx_qjs_fetch_request_ctor(JSContext *cx, JSValueConst new_target, int argc,
         return JS_EXCEPTION;
     }
 
+    if (request->body_stream != NULL) {
+        return JS_ThrowInternalError(cx, "body stream is supported "
+                                     "only by fetch()");
+    }
+
     proto = JS_GetPropertyStr(cx, new_target, "prototype");
     if (JS_IsException(proto)) {
         return JS_EXCEPTION;
@@ -507,10 +871,12 @@ static ngx_int_t
 ngx_qjs_request_ctor(JSContext *cx, ngx_js_request_t *request,
     ngx_url_t *u, int argc, JSValueConst *argv)
 {
-    JSValue            input, init, value;
-    ngx_int_t          rc;
-    ngx_pool_t        *pool;
-    ngx_js_request_t  *orig;
+    JSValue                input, init, value;
+    ngx_int_t              rc;
+    ngx_pool_t            *pool;
+    ngx_js_request_t      *orig;
+    ngx_js_response_t     *response;
+    ngx_qjs_fetch_body_t  *body;
 
     input = argv[0];
     if (JS_IsUndefined(input)) {
@@ -699,6 +1065,15 @@ ngx_qjs_request_ctor(JSContext *cx, ngx_js_request_t *request,
             return NGX_ERROR;
         }
 
+        body = JS_GetOpaque(value, NGX_QJS_CLASS_ID_FETCH_BODY);
+        if (body != NULL) {
+            response = JS_GetOpaque(body->response,
+                                    NGX_QJS_CLASS_ID_FETCH_RESPONSE);
+            JS_FreeValue(cx, value);
+
+            return ngx_qjs_request_body_stream(cx, request, response);
+        }
+
         if (!JS_IsUndefined(value)) {
             if (ngx_qjs_string(cx, pool, value, &request->body) != NGX_OK) {
                 JS_FreeValue(cx, value);
@@ -726,6 +1101,37 @@ ngx_qjs_request_ctor(JSContext *cx, ngx_js_request_t *request,
 }
 
 
+static ngx_int_t
+ngx_qjs_request_body_stream(JSContext *cx, ngx_js_request_t *request,
+    ngx_js_response_t *response)
+{
+    njs_str_t  str;
+
+    if (response->body_used) {
+        JS_ThrowInternalError(cx, "body stream already read");
+        return NGX_ERROR;
+    }
+
+    response->body_used = 1;
+
+    if (response->stream != NULL) {
+        /* relayed by ngx_js_http_write_handler() as it is received */
+        request->body_stream = response->stream;
+        return NGX_OK;
+    }
+
+    if (njs_chb_join(&response->chain, &str) != NJS_OK) {
+        JS_ThrowOutOfMemory(cx);
+        return NGX_ERROR;
+    }
+
+    request->body.data = str.start;
+    request->body.len = str.length;
+
+    return NGX_OK;
+}
+
+
 static JSValue
 ngx_qjs_fetch_response_ctor(JSContext *cx, JSValueConst new_target, int argc,
     JSValueConst *argv)
@@ -1149,10 +1555,12 @@ ngx_qjs_fetch_alloc(JSContext *cx, ngx_pool_t *pool, ngx_log_t *log,
     http->keepalive = (conf->fetch_keepalive > 0);
 
     ngx_qjs_arg(http->response.header_value) = JS_UNDEFINED;
+    fetch->body_stream = JS_UNDEFINED;
 
     http->append_headers = ngx_qjs_fetch_append_headers;
     http->ready_handler = ngx_qjs_fetch_process_done;
     http->error_handler = ngx_qjs_fetch_error;
+    http->stream_handler = ngx_qjs_fetch_stream_handler;
 
     fetch->promise = JS_NewPromiseCapability(cx, fetch->promise_callbacks);
     if (JS_IsException(fetch->promise)) {
@@ -1199,6 +1607,16 @@ ngx_qjs_fetch_error(ngx_js_http_t *http, const char *err)
 
     fetch = (ngx_qjs_fetch_t *) http;
 
+    if (http->response.stream != NULL) {
+        /* the response is already passed to JS, failing the body read */
+
+        ngx_js_http_close_peer(http);
+
+        (void) ngx_qjs_fetch_stream_finalize(fetch,
+                                             ngx_qjs_fetch_read_settle(fetch));
+        return;
+    }
+
     JS_ThrowInternalError(fetch->cx, "%s", err);
 
     fetch->response_value = JS_GetException(fetch->cx);
@@ -1221,6 +1639,7 @@ ngx_qjs_fetch_destructor(ngx_qjs_event_t *event)
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, http->log, 0, "js http destructor:%p",
                    fetch);
 
+    ngx_js_http_coalesce_leave(http);
     ngx_js_http_resolve_done(http);
     ngx_js_http_close_peer(http);
 
@@ -1228,6 +1647,18 @@ ngx_qjs_fetch_destructor(ngx_qjs_event_t *event)
     JS_FreeValue(cx, fetch->promise_callbacks[1]);
     JS_FreeValue(cx, fetch->promise);
     JS_FreeValue(cx, fetch->response_value);
+    JS_FreeValue(cx, fetch->body_stream);
+
+    if (fetch->reading) {
+        fetch->reading = 0;
+        JS_FreeValue(cx, fetch->read_callbacks[0]);
+        JS_FreeValue(cx, fetch->read_callbacks[1]);
+    }
+
+    if (fetch->batch != NULL) {
+        ngx_qjs_fetch_batch_release(cx, fetch->batch);
+        fetch->batch = NULL;
+    }
 }
 
 
@@ -1249,12 +1680,16 @@ ngx_qjs_fetch_done(ngx_qjs_fetch_t *fetch, JSValue retval, ngx_int_t rc)
     ngx_js_http_close_peer(http);
 
     if (fetch->event != NULL) {
-        action = fetch->promise_callbacks[(rc != NGX_OK)];
-
         cx = fetch->cx;
         event = fetch->event;
 
-        rc = ngx_qjs_call(cx, action, &retval, 1);
+        if (fetch->batch != NULL) {
+            rc = ngx_qjs_fetch_batch_settle(fetch, retval, rc);
+
+        } else {
+            action = fetch->promise_callbacks[(rc != NGX_OK)];
+            rc = ngx_qjs_call(cx, action, &retval, 1);
+        }
 
         external = JS_GetContextOpaque(cx);
         ctx = ngx_qjs_external_ctx(cx, external);
@@ -1265,6 +1700,62 @@ ngx_qjs_fetch_done(ngx_qjs_fetch_t *fetch, JSValue retval, ngx_int_t rc)
 }
 
 
+static ngx_int_t
+ngx_qjs_fetch_batch_settle(ngx_qjs_fetch_t *fetch, JSValue retval,
+    ngx_int_t rc)
+{
+    JSValue                 value;
+    JSContext              *cx;
+    ngx_qjs_fetch_batch_t  *batch;
+
+    cx = fetch->cx;
+    batch = fetch->batch;
+
+    if (batch->remaining == 0) {
+        /* the batch is already rejected */
+        return NGX_OK;
+    }
+
+    if (rc != NGX_OK) {
+        batch->remaining = 0;
+        return ngx_qjs_call(cx, batch->promise_callbacks[1], &retval, 1);
+    }
+
+    if (JS_SetPropertyUint32(cx, batch->results, fetch->index,
+                             JS_DupValue(cx, retval))
+        < 0)
+    {
+        batch->remaining = 0;
+
+        value = JS_GetException(cx);
+        rc = ngx_qjs_call(cx, batch->promise_callbacks[1], &value, 1);
+        JS_FreeValue(cx, value);
+
+        return rc;
+    }
+
+    if (--batch->remaining != 0) {
+        return NGX_OK;
+    }
+
+    return ngx_qjs_call(cx, batch->promise_callbacks[0], &batch->results, 1);
+}
+
+
+static void
+ngx_qjs_fetch_batch_release(JSContext *cx, ngx_qjs_fetch_batch_t *batch)
+{
+    if (--batch->count != 0) {
+        return;
+    }
+
+    JS_FreeValue(cx, batch->promise);
+    JS_FreeValue(cx, batch->promise_callbacks[0]);
+    JS_FreeValue(cx, batch->promise_callbacks[1]);
+    JS_FreeValue(cx, batch->results);
+}
+
+
 static ngx_int_t
 ngx_qjs_fetch_append_headers(ngx_js_http_t *http, ngx_js_headers_t *headers,
     u_char *name, size_t len, u_char *value, size_t vlen)
@@ -1298,6 +1789,173 @@ ngx_qjs_fetch_process_done(ngx_js_http_t *http)
 }
 
 
+static ngx_int_t
+ngx_qjs_fetch_stream_handler(ngx_js_http_t *http, ngx_uint_t event)
+{
+    JSContext        *cx;
+    ngx_int_t         rc;
+    ngx_qjs_fetch_t  *fetch;
+
+    fetch = (ngx_qjs_fetch_t *) http;
+    cx = fetch->cx;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, http->log, 0,
+                   "js http stream fetch:%p event:%ui", fetch, event);
+
+    switch (event) {
+
+    case NGX_JS_HTTP_STREAM_HEADERS:
+        fetch->response_value = JS_NewObjectClass(cx,
+                                              NGX_QJS_CLASS_ID_FETCH_RESPONSE);
+        if (JS_IsException(fetch->response_value)) {
+            http->response.stream = NULL;
+            ngx_qjs_fetch_error(http, "fetch response creation failed");
+            return NGX_DONE;
+        }
+
+        JS_SetOpaque(fetch->response_value, &http->response);
+
+        rc = ngx_qjs_call(cx, fetch->promise_callbacks[0],
+                          &fetch->response_value, 1);
+
+        return ngx_qjs_fetch_stream_finalize(fetch, rc);
+
+    case NGX_JS_HTTP_STREAM_DATA:
+        return ngx_qjs_fetch_stream_finalize(fetch,
+                                             ngx_qjs_fetch_read_settle(fetch));
+
+    default:
+        /* NGX_JS_HTTP_STREAM_LAST */
+
+        ngx_js_http_close_peer(http);
+
+        (void) ngx_qjs_fetch_stream_finalize(fetch,
+                                             ngx_qjs_fetch_read_settle(fetch));
+        return NGX_DONE;
+    }
+}
+
+
+static ngx_int_t
+ngx_qjs_fetch_stream_finalize(ngx_qjs_fetch_t *fetch, ngx_int_t rc)
+{
+    void       *external;
+    JSContext  *cx;
+
+    if (rc != NGX_ERROR && !fetch->http.finished) {
+        return NGX_OK;
+    }
+
+    cx = fetch->cx;
+    external = JS_GetContextOpaque(cx);
+
+    if (fetch->event != NULL) {
+        ngx_js_del_event(ngx_qjs_external_ctx(cx, external), fetch->event);
+        fetch->event = NULL;
+    }
+
+    ngx_qjs_external_event_finalize(cx)(external, rc);
+
+    return NGX_DONE;
+}
+
+
+static ngx_int_t
+ngx_qjs_fetch_read_settle(ngx_qjs_fetch_t *fetch)
+{
+    JSValue     result, callbacks[2];
+    JSContext  *cx;
+    ngx_int_t   rc;
+
+    if (!fetch->reading) {
+        return NGX_OK;
+    }
+
+    cx = fetch->cx;
+
+    rc = ngx_qjs_fetch_read_result(cx, &fetch->http.response, &result);
+    if (rc == NGX_DECLINED) {
+        return NGX_OK;
+    }
+
+    if (rc != NGX_OK) {
+        result = JS_GetException(cx);
+    }
+
+    fetch->reading = 0;
+    callbacks[0] = fetch->read_callbacks[0];
+    callbacks[1] = fetch->read_callbacks[1];
+
+    rc = ngx_qjs_call(cx, callbacks[(rc != NGX_OK)], &result, 1);
+
+    JS_FreeValue(cx, result);
+    JS_FreeValue(cx, callbacks[0]);
+    JS_FreeValue(cx, callbacks[1]);
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_qjs_fetch_read_result(JSContext *cx, ngx_js_response_t *response,
+    JSValue *result)
+{
+    int             done;
+    JSValue         obj, value;
+    ssize_t         size;
+    ngx_js_http_t  *http;
+
+    http = response->stream;
+
+    size = njs_chb_size(&response->chain);
+    if (size < 0) {
+        JS_ThrowOutOfMemory(cx);
+        return NGX_ERROR;
+    }
+
+    if (size != 0) {
+        value = qjs_buffer_chb_alloc(cx, &response->chain);
+        if (JS_IsException(value)) {
+            return NGX_ERROR;
+        }
+
+        ngx_js_http_stream_consumed(response);
+
+        done = 0;
+
+    } else if (http != NULL && http->error.len != 0) {
+        JS_ThrowInternalError(cx, "%.*s", (int) http->error.len,
+                              http->error.data);
+        return NGX_ERROR;
+
+    } else if (http == NULL || http->finished) {
+        value = JS_UNDEFINED;
+        done = 1;
+
+    } else {
+        return NGX_DECLINED;
+    }
+
+    obj = JS_NewObject(cx);
+    if (JS_IsException(obj)) {
+        JS_FreeValue(cx, value);
+        return NGX_ERROR;
+    }
+
+    if (JS_DefinePropertyValueStr(cx, obj, "value", value, JS_PROP_C_W_E) < 0
+        || JS_DefinePropertyValueStr(cx, obj, "done", JS_NewBool(cx, done),
+                                     JS_PROP_C_W_E) < 0)
+    {
+        JS_FreeValue(cx, obj);
+        return NGX_ERROR;
+    }
+
+    *result = obj;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_qjs_headers_append(JSContext *cx, ngx_js_headers_t *headers,
     u_char *name, size_t len, u_char *value, size_t vlen)
@@ -2278,6 +2936,7 @@ ngx_qjs_ext_fetch_response_body(JSContext *cx, JSValueConst this_val,
     JSValue             result;
     njs_int_t           ret;
     njs_str_t           string;
+    ngx_js_http_t      *http;
     ngx_js_response_t  *response;
 
     response = JS_GetOpaque2(cx, this_val, NGX_QJS_CLASS_ID_FETCH_RESPONSE);
@@ -2289,6 +2948,17 @@ ngx_qjs_ext_fetch_response_body(JSContext *cx, JSValueConst this_val,
         return JS_ThrowInternalError(cx, "body stream already read");
     }
 
+    http = response->stream;
+
+    if (http != NULL && http->error.len != 0) {
+        return JS_ThrowInternalError(cx, "%.*s", (int) http->error.len,
+                                     http->error.data);
+    }
+
+    if (http != NULL && !http->finished) {
+        return JS_ThrowInternalError(cx, "body stream is not fully received");
+    }
+
     response->body_used = 1;
 
     switch (magic) {
@@ -2372,6 +3042,37 @@ ngx_qjs_ext_fetch_response_field(JSContext *cx, JSValueConst this_val, int magic
 }
 
 
+static JSValue
+ngx_qjs_ext_fetch_response_body_stream(JSContext *cx, JSValueConst this_val)
+{
+    JSValue                obj;
+    ngx_js_response_t     *response;
+    ngx_qjs_fetch_body_t  *body;
+
+    response = JS_GetOpaque2(cx, this_val, NGX_QJS_CLASS_ID_FETCH_RESPONSE);
+    if (response == NULL) {
+        return JS_UNDEFINED;
+    }
+
+    body = js_malloc(cx, sizeof(ngx_qjs_fetch_body_t));
+    if (body == NULL) {
+        return JS_ThrowOutOfMemory(cx);
+    }
+
+    obj = JS_NewObjectClass(cx, NGX_QJS_CLASS_ID_FETCH_BODY);
+    if (JS_IsException(obj)) {
+        js_free(cx, body);
+        return obj;
+    }
+
+    body->response = JS_DupValue(cx, this_val);
+
+    JS_SetOpaque(obj, body);
+
+    return obj;
+}
+
+
 static void
 ngx_qjs_fetch_response_finalizer(JSRuntime *rt, JSValue val)
 {
@@ -2384,6 +3085,165 @@ ngx_qjs_fetch_response_finalizer(JSRuntime *rt, JSValue val)
 }
 
 
+static ngx_js_response_t *
+ngx_qjs_fetch_body(JSContext *cx, JSValueConst this_val)
+{
+    ngx_qjs_fetch_body_t  *body;
+
+    body = JS_GetOpaque2(cx, this_val, NGX_QJS_CLASS_ID_FETCH_BODY);
+    if (body == NULL) {
+        return NULL;
+    }
+
+    return JS_GetOpaque(body->response, NGX_QJS_CLASS_ID_FETCH_RESPONSE);
+}
+
+
+static JSValue
+ngx_qjs_ext_fetch_body_cancel(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    void               *external;
+    JSValue             ret, result;
+    ngx_int_t           rc;
+    ngx_qjs_fetch_t    *fetch;
+    ngx_js_response_t  *response;
+
+    response = ngx_qjs_fetch_body(cx, this_val);
+    if (response == NULL) {
+        return JS_EXCEPTION;
+    }
+
+    response->body_used = 1;
+
+    fetch = (ngx_qjs_fetch_t *) response->stream;
+
+    if (fetch != NULL && !fetch->http.finished) {
+        ngx_js_http_stream_cancel(&fetch->http);
+
+        if (fetch->reading) {
+            fetch->reading = 0;
+
+            rc = ngx_qjs_fetch_read_result(cx, response, &result);
+            if (rc != NGX_OK) {
+                result = JS_GetException(cx);
+            }
+
+            ret = JS_Call(cx, fetch->read_callbacks[(rc != NGX_OK)],
+                          JS_UNDEFINED, 1, &result);
+
+            JS_FreeValue(cx, ret);
+            JS_FreeValue(cx, result);
+            JS_FreeValue(cx, fetch->read_callbacks[0]);
+            JS_FreeValue(cx, fetch->read_callbacks[1]);
+        }
+
+        external = JS_GetContextOpaque(cx);
+
+        ngx_js_del_event(ngx_qjs_external_ctx(cx, external), fetch->event);
+        fetch->event = NULL;
+    }
+
+    ngx_js_http_stream_consumed(response);
+
+    return qjs_promise_result(cx, JS_UNDEFINED);
+}
+
+
+static JSValue
+ngx_qjs_ext_fetch_body_get_reader(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    ngx_js_response_t  *response;
+
+    response = ngx_qjs_fetch_body(cx, this_val);
+    if (response == NULL) {
+        return JS_EXCEPTION;
+    }
+
+    if (response->body_used) {
+        return JS_ThrowInternalError(cx, "body stream already read");
+    }
+
+    response->body_used = 1;
+
+    return JS_DupValue(cx, this_val);
+}
+
+
+static JSValue
+ngx_qjs_ext_fetch_body_iterator(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    return JS_DupValue(cx, this_val);
+}
+
+
+static JSValue
+ngx_qjs_ext_fetch_body_read(JSContext *cx, JSValueConst this_val,
+    int argc, JSValueConst *argv)
+{
+    JSValue             promise, result;
+    ngx_int_t           rc;
+    ngx_qjs_fetch_t    *fetch;
+    ngx_js_response_t  *response;
+
+    response = ngx_qjs_fetch_body(cx, this_val);
+    if (response == NULL) {
+        return JS_EXCEPTION;
+    }
+
+    fetch = (ngx_qjs_fetch_t *) response->stream;
+
+    if (fetch != NULL && fetch->reading) {
+        return JS_ThrowInternalError(cx,
+                                     "body stream read is already pending");
+    }
+
+    response->body_used = 1;
+
+    rc = ngx_qjs_fetch_read_result(cx, response, &result);
+    if (rc != NGX_DECLINED) {
+        return qjs_promise_result(cx, (rc == NGX_OK) ? result : JS_EXCEPTION);
+    }
+
+    promise = JS_NewPromiseCapability(cx, fetch->read_callbacks);
+    if (JS_IsException(promise)) {
+        return promise;
+    }
+
+    fetch->reading = 1;
+
+    return promise;
+}
+
+
+static void
+ngx_qjs_fetch_body_mark(JSRuntime *rt, JSValueConst val,
+    JS_MarkFunc *mark_func)
+{
+    ngx_qjs_fetch_body_t  *body;
+
+    body = JS_GetOpaque(val, NGX_QJS_CLASS_ID_FETCH_BODY);
+    if (body != NULL) {
+        JS_MarkValue(rt, body->response, mark_func);
+    }
+}
+
+
+static void
+ngx_qjs_fetch_body_finalizer(JSRuntime *rt, JSValue val)
+{
+    ngx_qjs_fetch_body_t  *body;
+
+    body = JS_GetOpaque(val, NGX_QJS_CLASS_ID_FETCH_BODY);
+    if (body != NULL) {
+        JS_FreeValueRT(rt, body->response);
+        js_free_rt(rt, body);
+    }
+}
+
+
 static JSValue
 ngx_qjs_fetch_flag(JSContext *cx, const ngx_qjs_entry_t *entries,
     ngx_int_t value)
@@ -2516,5 +3376,21 @@ ngx_qjs_fetch_init(JSContext *cx, const char *name)
 
     JS_FreeValue(cx, global_obj);
 
+    if (JS_NewClass(JS_GetRuntime(cx), NGX_QJS_CLASS_ID_FETCH_BODY,
+                    &ngx_qjs_fetch_body_class) < 0)
+    {
+        return NULL;
+    }
+
+    proto = JS_NewObject(cx);
+    if (JS_IsException(proto)) {
+        return NULL;
+    }
+
+    JS_SetPropertyFunctionList(cx, proto, ngx_qjs_ext_fetch_body_proto,
+                               njs_nitems(ngx_qjs_ext_fetch_body_proto));
+
+    JS_SetClassProto(cx, NGX_QJS_CLASS_ID_FETCH_BODY, proto);
+
     return JS_NewCModule(cx, name, NULL);
 }
@@ -226,6 +226,8 @@ static char *ngx_stream_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_stream_js_fetch_proxy(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_stream_js_fetch_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 
 static ngx_conf_bitmask_t  ngx_stream_js_engines[] = {
@@ -271,6 +273,13 @@ static ngx_command_t  ngx_stream_js_commands[] = {
       offsetof(ngx_stream_js_srv_conf_t, reuse_max_size),
       NULL },
 
+    { ngx_string("js_bytecode_cache"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_js_bytecode_cache,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("js_import"),
       NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE13,
       ngx_js_import,
@@ -383,6 +392,13 @@ static ngx_command_t  ngx_stream_js_commands[] = {
       offsetof(ngx_stream_js_srv_conf_t, fetch_keepalive_timeout),
       NULL },
 
+    { ngx_string("js_fetch_max_conns"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_js_srv_conf_t, fetch_max_conns),
+      NULL },
+
 #if (NGX_SSL)
 
     { ngx_string("js_fetch_ciphers"),
@@ -436,6 +452,20 @@ static ngx_command_t  ngx_stream_js_commands[] = {
       0,
       NULL },
 
+    { ngx_string("js_fetch_cache"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_1MORE,
+      ngx_stream_js_fetch_cache,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("js_fetch_resolver_cache"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_1MORE,
+      ngx_js_fetch_resolver_cache,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -3504,6 +3534,7 @@ ngx_stream_js_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     data->fname = value[2];
     data->file_name = cf->conf_file->file.name.data;
     data->line = cf->conf_file->line;
+    data->cache = NULL;
 
     if (v->get_handler == ngx_stream_js_variable_set) {
         prev = (ngx_js_set_t *) v->data;
@@ -3686,6 +3717,13 @@ ngx_stream_js_shared_dict_zone(ngx_conf_t *cf, ngx_command_t *cmd,
 }
 
 
+static char *
+ngx_stream_js_fetch_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    return ngx_js_fetch_cache(cf, cmd, conf, &ngx_stream_js_module);
+}
+
+
 static ngx_int_t
 ngx_stream_js_eval_proxy_url(ngx_pool_t *pool, void *request,
     void *module_conf, ngx_url_t **url_out, ngx_str_t *auth_out)
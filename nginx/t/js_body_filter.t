@@ -80,6 +80,18 @@ http {
             js_body_filter test.prepend;
             proxy_pass http://127.0.0.1:8081/source;
         }
+
+        location /retain {
+            js_header_filter test.clear_content_length;
+            js_body_filter test.retain;
+            proxy_pass http://127.0.0.1:8081/source;
+        }
+
+        location /tamper {
+            js_header_filter test.clear_content_length;
+            js_body_filter test.tamper;
+            proxy_pass http://127.0.0.1:8081/source;
+        }
     }
 }
 
@@ -131,12 +143,37 @@ $t->write_file('test.js', <<EOF);
         r.done();
     }
 
+    var retained = [];
+    function retain(r, data, flags) {
+        retained.push(flags);
+
+        if (flags.last) {
+            let v = retained.map(f => f.last).join(',');
+            retained = [];
+            r.sendBuffer(v, flags);
+        }
+    }
+
+    var seen = [];
+    function tamper(r, data, flags) {
+        let last = flags.last;
+
+        seen.push(last);
+        flags.last = true;
+
+        if (last) {
+            let v = seen.join(',');
+            seen = [];
+            r.sendBuffer(v, {last: true});
+        }
+    }
+
     export default {njs: test_njs, append, buffer_type, filter, forward,
-                    prepend, clear_content_length};
+                    prepend, retain, tamper, clear_content_length};
 
 EOF
 
-$t->try_run('no njs body filter')->plan(8);
+$t->try_run('no njs body filter')->plan(10);
 
 $t->run_daemon(\&http_daemon, port(8081));
 $t->waitforsocket('127.0.0.1:' . port(8081));
@@ -153,6 +190,8 @@ like(http_get('/filter?len=3'), qr/AAA#DDDD##$/, 'filter 3');
 like(http_get('/filter?len=2&dup=1'), qr/AAA#AAABB#BBDDDD#DDDD#$/,
 	'filter 2 dup');
 like(http_get('/prepend'), qr/XXXAAABBCDDDD$/, 'prepend');
+like(http_get('/retain'), qr/\n(false,)+true$/, 'retained flags');
+like(http_get('/tamper'), qr/\n(false,)+true$/, 'changed flags');
 
 ###############################################################################
 
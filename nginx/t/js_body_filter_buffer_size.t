@@ -0,0 +1,104 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, js_body_filter buffer_size= parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        sendfile        off;
+        output_buffers  2 8;
+
+        js_header_filter test.clear_content_length;
+
+        location /unbuffered/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.sizes;
+        }
+
+        location /buffered/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.sizes buffer_size=32;
+        }
+
+        location /buffered_type/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.sizes buffer_type=buffer buffer_size=32;
+        }
+
+        location /done/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.done buffer_size=12;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<EOF);
+    function clear_content_length(r) {
+        delete r.headersOut['Content-Length'];
+    }
+
+    function sizes(r, data, flags) {
+        r.sendBuffer(`\${data.length}\${flags.last ? '.' : ','}`, flags);
+    }
+
+    function done(r, data, flags) {
+        r.sendBuffer(`[\${data}]`, flags);
+        r.done();
+    }
+
+    export default {clear_content_length, sizes, done};
+
+EOF
+
+$t->write_file('data.txt', join('', map { chr(ord('a') + $_ % 26) } 0 .. 99));
+
+$t->try_run('no js_body_filter buffer_size=')->plan(4);
+
+###############################################################################
+
+like(http_get('/unbuffered/data.txt'), qr/\x0d\x0a(8,){12}4\.$/,
+	'unbuffered');
+like(http_get('/buffered/data.txt'), qr/\x0d\x0a32,32,32,4\.$/, 'buffered');
+like(http_get('/buffered_type/data.txt'), qr/\x0d\x0a32,32,32,4\.$/,
+	'buffered buffer_type');
+like(http_get('/done/data.txt'), qr/\x0d\x0a\[abcdefghijkl\]mnopqrstuv/,
+	'done passes the rest');
+
+###############################################################################
@@ -0,0 +1,106 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, body filter of file buffers.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        sendfile  on;
+
+        js_header_filter test.clear_content_length;
+
+        location /file/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.sizes;
+        }
+
+        location /parts/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.sizes buffer_size=32;
+        }
+
+        location /upper/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.upper buffer_type=buffer buffer_size=16;
+        }
+
+        location /done/ {
+            alias %%TESTDIR%%/;
+            js_body_filter test.done buffer_size=12;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<EOF);
+    function clear_content_length(r) {
+        delete r.headersOut['Content-Length'];
+    }
+
+    function sizes(r, data, flags) {
+        r.sendBuffer(`\${data.length}\${flags.last ? '.' : ','}`, flags);
+    }
+
+    function upper(r, data, flags) {
+        r.sendBuffer(data.toString().toUpperCase(), flags);
+    }
+
+    function done(r, data, flags) {
+        r.sendBuffer(`[\${data}]`, flags);
+        r.done();
+    }
+
+    export default {clear_content_length, sizes, upper, done};
+
+EOF
+
+$t->write_file('data.txt', join('', map { chr(ord('a') + $_ % 26) } 0 .. 99));
+
+$t->try_run('no js_body_filter file buffers')->plan(4);
+
+###############################################################################
+
+like(http_get('/file/data.txt'), qr/\x0d\x0a100\.$/, 'file');
+like(http_get('/parts/data.txt'), qr/\x0d\x0a32,32,32,4\.$/, 'file parts');
+like(http_get('/upper/data.txt'), qr/\x0d\x0aABCDEFGHIJKLMNOPQRSTUVWXYZABC/,
+	'file transformed');
+like(http_get('/done/data.txt'),
+	qr/\x0d\x0a\[abcdefghijkl\]mnopqrstuvwxyzab.*uv$/s, 'file rest as is');
+
+###############################################################################
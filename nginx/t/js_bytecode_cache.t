@@ -0,0 +1,165 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, js_bytecode_cache directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_engine qjs;
+    js_bytecode_cache %%TESTDIR%%/cache;
+
+    js_import test.js;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /test {
+            js_content test.test;
+        }
+
+        location /off {
+            js_bytecode_cache off;
+            js_import lib.js;
+            js_content lib.test;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<EOF);
+    import helper from 'helper.js';
+
+    function test(r) {
+        r.return(200, helper.greet('cache'));
+    }
+
+    export default {test};
+
+EOF
+
+$t->write_file('helper.js', <<EOF);
+    function greet(s) {
+        return 'hello ' + s;
+    }
+
+    export default {greet};
+
+EOF
+
+$t->write_file('lib.js', <<EOF);
+    function test(r) {
+        r.return(200, 'off');
+    }
+
+    export default {test};
+
+EOF
+
+mkdir($t->testdir() . '/cache');
+
+$t->try_run('no js_bytecode_cache')->plan(10);
+
+###############################################################################
+
+like(http_get('/test'), qr/hello cache$/, 'compiled');
+like(http_get('/off'), qr/off$/, 'cache off');
+
+my @files = glob($t->testdir() . '/cache/*.qjsbc');
+is(scalar @files, 2, 'cache files');
+
+$t->stop();
+
+# a file is rewritten only if it was not used
+
+utime(1000000, 1000000, @files);
+
+$t->run();
+
+like(http_get('/test'), qr/hello cache$/, 'loaded from cache');
+is(scalar(grep { (stat($_))[9] == 1000000 } @files), 2, 'cache hit');
+
+$t->stop();
+
+# corrupted bytecode and a different build are recompiled
+
+for my $file (@files) {
+	open my $fh, '+<:raw', $file or die "Can't open $file: $!";
+	local $/;
+	my $data = <$fh>;
+
+	# the module path follows the 40-byte header
+
+	if (unpack('x40 Z*', $data) =~ /helper\.js$/) {
+		substr($data, 8, 4) = ~substr($data, 8, 4);
+
+	} else {
+		substr($data, -1) = ~substr($data, -1);
+	}
+
+	seek $fh, 0, 0;
+	print $fh $data;
+	close $fh;
+}
+
+utime(1000000, 1000000, @files);
+
+$t->run();
+
+like(http_get('/test'), qr/hello cache$/, 'corrupted cache recompiled');
+is(scalar(grep { (stat($_))[9] != 1000000 } @files), 2,
+	'corrupted cache replaced');
+like($t->read_file('error.log'), qr/bytecode cache .* is corrupted/,
+	'corrupted cache logged');
+
+$t->stop();
+
+$t->write_file('helper.js', <<EOF);
+    function greet(s) {
+        return 'hello again ' + s;
+    }
+
+    export default {greet};
+
+EOF
+
+utime(time() + 10, time() + 10, $t->testdir() . '/helper.js');
+
+$t->run();
+
+like(http_get('/test'), qr/hello again cache$/, 'stale cache recompiled');
+
+@files = glob($t->testdir() . '/cache/*.qjsbc');
+is(scalar @files, 2, 'stale cache replaced');
+
+###############################################################################
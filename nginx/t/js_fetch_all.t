@@ -0,0 +1,181 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, ngx.fetchAll() method.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=conns:32k type=number;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /order {
+            js_content test.order;
+        }
+
+        location /limited {
+            js_content test.limited;
+        }
+
+        location /keepalive {
+            js_fetch_keepalive 4;
+            js_content test.keepalive;
+        }
+
+        location /timeout {
+            js_content test.timeout;
+        }
+
+        location /empty {
+            js_content test.empty;
+        }
+
+        location /invalid {
+            js_content test.invalid;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+        keepalive_requests 100;
+
+        location /echo {
+            return 200 $arg_i;
+        }
+
+        location /active {
+            js_content test.active;
+        }
+
+        location /count {
+            return 200 $connection_requests;
+        }
+
+        location /slow {
+            js_content test.slow;
+        }
+    }
+}
+
+EOF
+
+my $p1 = port(8081);
+
+$t->write_file('test.js', <<EOF);
+    const base = 'http://127.0.0.1:$p1';
+
+    async function texts(rs) {
+        return Promise.all(rs.map(resp => resp.text()));
+    }
+
+    async function order(r) {
+        let urls = [0, 1, 2, 3, 4].map(i => `\${base}/echo?i=\${i}`);
+        let rs = await ngx.fetchAll(urls, {connections: 1});
+
+        r.return(200, (await texts(rs)).join(','));
+    }
+
+    async function limited(r) {
+        let urls = Array(6).fill(`\${base}/active`);
+        let rs = await ngx.fetchAll(urls, {connections: 2});
+        let bodies = await texts(rs);
+
+        r.return(200, `max: \${Math.max(...bodies.map(Number))}`);
+    }
+
+    async function keepalive(r) {
+        let urls = Array(6).fill(`\${base}/count`);
+        let rs = await ngx.fetchAll(urls, {connections: 2});
+
+        r.return(200, (await texts(rs)).sort().join(','));
+    }
+
+    async function timeout(r) {
+        try {
+            let urls = [`\${base}/echo?i=0`, `\${base}/slow`];
+            await ngx.fetchAll(urls, {timeout: 100});
+            r.return(200, 'no timeout');
+
+        } catch (e) {
+            r.return(200, e.message);
+        }
+    }
+
+    async function empty(r) {
+        let rs = await ngx.fetchAll([]);
+        r.return(200, `length: \${rs.length}`);
+    }
+
+    async function invalid(r) {
+        try {
+            await ngx.fetchAll([`\${base}/echo?i=0`, 'invalid']);
+            r.return(200, 'no error');
+
+        } catch (e) {
+            r.return(200, e.message);
+        }
+    }
+
+    function active(r) {
+        let n = ngx.shared.conns.incr('active', 1);
+
+        setTimeout(() => {
+            ngx.shared.conns.incr('active', -1);
+            r.return(200, n);
+        }, 20);
+    }
+
+    function slow(r) {
+        setTimeout(() => r.return(200, 'slow'), 1000);
+    }
+
+    export default {order, limited, keepalive, timeout, empty, invalid,
+                    active, slow};
+EOF
+
+$t->try_run('no ngx.fetchAll')->plan(6);
+
+###############################################################################
+
+like(http_get('/order'), qr/0,1,2,3,4$/, 'responses order');
+like(http_get('/limited'), qr/max: 2$/, 'connections limit');
+like(http_get('/keepalive'), qr/1,1,2,2,3,3$/, 'connections reused');
+like(http_get('/timeout'), qr/fetch batch timed out$/, 'batch timeout');
+like(http_get('/empty'), qr/length: 0$/, 'empty batch');
+unlike(http_get('/invalid'), qr/no error$/, 'invalid url');
+
+###############################################################################
@@ -0,0 +1,185 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, js_fetch_cache directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=hits:32k type=number;
+
+    js_fetch_cache zone=fetch:1m max_size=64k;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /twice {
+            js_content test.twice;
+        }
+
+        location /reload {
+            js_content test.reload;
+        }
+
+        location /only {
+            js_content test.only;
+        }
+
+        location /off {
+            js_fetch_cache off;
+            js_content test.twice;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+            js_content test.backend;
+        }
+    }
+}
+
+EOF
+
+my $p1 = port(8081);
+
+$t->write_file('test.js', <<EOF);
+    function url(path) {
+        return 'http://127.0.0.1:$p1/' + path;
+    }
+
+    async function twice(r) {
+        let a = await ngx.fetch(url(r.args.path));
+        let b = await ngx.fetch(url(r.args.path));
+
+        r.return(200, `\${a.status} \${await a.text()} `
+                      + `\${b.status} \${await b.text()}`);
+    }
+
+    async function reload(r) {
+        let a = await ngx.fetch(url('reload'));
+        let b = await ngx.fetch(url('reload'), {cache: 'reload'});
+        let c = await ngx.fetch(url('reload'));
+
+        r.return(200, `\${await a.text()} \${await b.text()} `
+                      + `\${await c.text()}`);
+    }
+
+    async function only(r) {
+        let v = await ngx.fetch(url('missing'), {cache: 'only-if-cached'})
+                         .then(resp => resp.text(), e => e.message);
+
+        r.return(200, v);
+    }
+
+    function backend(r) {
+        let path = r.uri.substring(1);
+        let n = ngx.shared.hits.incr(path, 1);
+
+        switch (path) {
+        case 'etag':
+            r.headersOut['Cache-Control'] = 'no-cache';
+            r.headersOut['ETag'] = '"v1"';
+
+            if (r.headersIn['If-None-Match'] == '"v1"') {
+                r.return(304);
+                return;
+            }
+
+            break;
+
+        case 'nostore':
+            r.headersOut['Cache-Control'] = 'no-store';
+            break;
+
+        case 'private':
+            r.headersOut['Cache-Control'] = 'private, max-age=100';
+            break;
+
+        case 'nocache_nostore':
+            r.headersOut['Cache-Control'] = 'no-cache, no-store';
+            r.headersOut['ETag'] = '"v1"';
+            break;
+
+        case 'nocache_private':
+            r.headersOut['Cache-Control'] = 'no-cache, private';
+            r.headersOut['ETag'] = '"v1"';
+            break;
+
+        case 'private_nocache':
+            r.headersOut['Cache-Control'] = 'private, no-cache';
+            r.headersOut['ETag'] = '"v1"';
+            break;
+
+        case 'cookie':
+            r.headersOut['Cache-Control'] = 'max-age=100';
+            r.headersOut['Set-Cookie'] = 'id=' + n;
+            break;
+
+        default:
+            r.headersOut['Cache-Control'] = 'max-age=100';
+        }
+
+        r.return(200, `\${path}:\${n}`);
+    }
+
+    export default {twice, reload, only, backend};
+EOF
+
+$t->try_run('no js_fetch_cache')->plan(11);
+
+###############################################################################
+
+like(http_get('/twice?path=fresh'), qr/200 fresh:1 200 fresh:1$/, 'fresh');
+like(http_get('/twice?path=etag'), qr/200 etag:1 200 etag:1$/, 'revalidated');
+like(http_get('/twice?path=nostore'), qr/200 nostore:1 200 nostore:2$/,
+	'no-store');
+like(http_get('/twice?path=private'), qr/200 private:1 200 private:2$/,
+	'private');
+like(http_get('/twice?path=nocache_nostore'),
+	qr/200 nocache_nostore:1 200 nocache_nostore:2$/, 'no-cache, no-store');
+like(http_get('/twice?path=nocache_private'),
+	qr/200 nocache_private:1 200 nocache_private:2$/, 'no-cache, private');
+like(http_get('/twice?path=private_nocache'),
+	qr/200 private_nocache:1 200 private_nocache:2$/, 'private, no-cache');
+like(http_get('/twice?path=cookie'), qr/200 cookie:1 200 cookie:2$/,
+	'set-cookie');
+like(http_get('/off?path=fresh_off'), qr/fresh_off:1 200 fresh_off:2$/,
+	'cache off');
+like(http_get('/reload'), qr/reload:1 reload:2 reload:2$/, 'reload');
+like(http_get('/only'), qr/not cached$/, 'only-if-cached');
+
+###############################################################################
@@ -0,0 +1,122 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, fetch method, coalesce option.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=hits:32k type=number;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /all {
+            js_content test.all;
+        }
+
+        location /headers {
+            js_content test.headers;
+        }
+
+        location /failed {
+            js_content test.failed;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+            js_content test.backend;
+        }
+    }
+}
+
+EOF
+
+my $p1 = port(8081);
+my $p2 = port(8082);
+
+$t->write_file('test.js', <<EOF);
+    async function all(r) {
+        let coalesce = r.args.coalesce == '1';
+        let urls = ['a', 'a', 'a', 'b'].map(v =>
+                        'http://127.0.0.1:$p1/' + r.args.prefix + v);
+
+        let rs = await Promise.all(urls.map(u =>
+                                       ngx.fetch(u, {coalesce})));
+        let bodies = await Promise.all(rs.map(resp => resp.text()));
+
+        r.return(200, bodies.sort().join(' '));
+    }
+
+    async function headers(r) {
+        let rs = await Promise.all(['1', '1', '2'].map(v =>
+                    ngx.fetch('http://127.0.0.1:$p1/ha',
+                              {coalesce: true, headers: {'X-V': v}})));
+        let bodies = await Promise.all(rs.map(resp => resp.text()));
+
+        r.return(200, bodies.sort().join(' '));
+    }
+
+    async function failed(r) {
+        let rs = await Promise.allSettled([1, 2].map(() =>
+                    ngx.fetch('http://127.0.0.1:$p2/', {coalesce: true})));
+
+        r.return(200, rs.map(v => v.status).join(' '));
+    }
+
+    function backend(r) {
+        let path = r.uri.substring(1);
+        let n = ngx.shared.hits.incr(path, 1);
+
+        setTimeout(() => r.return(200, `\${path}:\${n}`), 50);
+    }
+
+    export default {all, headers, failed, backend};
+EOF
+
+$t->try_run('no fetch coalesce')->plan(4);
+
+###############################################################################
+
+like(http_get('/all?prefix=c&coalesce=1'), qr/ca:1 ca:1 ca:1 cb:1$/,
+	'coalesced');
+like(http_get('/all?prefix=n'), qr/na:1 na:2 na:3 nb:1$/, 'not coalesced');
+like(http_get('/headers'), qr/ha:1 ha:1 ha:2$/, 'not coalesced headers');
+like(http_get('/failed'), qr/rejected rejected$/, 'coalesced error');
+
+###############################################################################
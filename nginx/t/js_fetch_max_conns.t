@@ -0,0 +1,115 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, js_fetch_max_conns directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=conns:32k type=number;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /unlimited {
+            js_content test.simultaneous;
+        }
+
+        location /limited {
+            js_fetch_max_conns 1;
+            js_content test.simultaneous;
+        }
+
+        location /keepalive {
+            js_fetch_keepalive 4;
+            js_fetch_max_conns 2;
+            js_content test.simultaneous;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+        keepalive_requests 100;
+
+        location /active {
+            js_content test.active;
+        }
+
+        location /count {
+            return 200 $connection_requests;
+        }
+    }
+}
+
+EOF
+
+my $p1 = port(8081);
+
+$t->write_file('test.js', <<EOF);
+    async function simultaneous(r) {
+        let promises = [];
+
+        for (let i = 0; i < 6; i++) {
+            promises.push(ngx.fetch('http://127.0.0.1:$p1/' + r.args.path));
+        }
+
+        let rs = await Promise.all(promises);
+        let bodies = await Promise.all(rs.map(resp => resp.text()));
+
+        r.return(200, bodies.sort().join(','));
+    }
+
+    function active(r) {
+        let n = ngx.shared.conns.incr('active', 1);
+
+        setTimeout(() => {
+            ngx.shared.conns.incr('active', -1);
+            r.return(200, n);
+        }, 20);
+    }
+
+    export default {simultaneous, active};
+EOF
+
+$t->try_run('no js_fetch_max_conns')->plan(3);
+
+###############################################################################
+
+like(http_get('/unlimited?path=active'), qr/1,2,3,4,5,6$/, 'unlimited');
+like(http_get('/limited?path=active'), qr/1,1,1,1,1,1$/, 'limited');
+like(http_get('/keepalive?path=count'), qr/1,1,2,2,3,3$/,
+	'limited keepalive');
+
+###############################################################################
@@ -0,0 +1,190 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, fetch method, streaming response body.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /read {
+            js_fetch_buffer_size 4k;
+            js_fetch_max_response_buffer_size 8k;
+            js_content test.read;
+        }
+
+        location /text {
+            js_content test.text;
+        }
+
+        location /cancel {
+            js_content test.cancel;
+        }
+
+        location /slow {
+            js_fetch_timeout 1s;
+            js_fetch_buffer_size 4k;
+            js_content test.slow;
+        }
+
+        location /limit {
+            js_fetch_max_response_buffer_size 8k;
+            js_content test.limit;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location /chunked {
+            js_content test.chunked;
+        }
+
+        location / {
+            root %%TESTDIR%%;
+        }
+    }
+}
+
+EOF
+
+my $p1 = port(8081);
+
+$t->write_file('test.js', <<EOF);
+    async function consume(body) {
+        let reader = body.getReader();
+        let size = 0;
+        let chunks = 0;
+
+        while (true) {
+            let chunk = await reader.read();
+            if (chunk.done) {
+                break;
+            }
+
+            size += chunk.value.length;
+            chunks++;
+        }
+
+        return {size, chunks};
+    }
+
+    async function read(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/' + r.args.path,
+                                   {stream: true});
+        let v = await consume(resp.body);
+
+        r.return(200, `\${resp.status} \${v.size} \${v.chunks > 1} `
+                      + `\${resp.bodyUsed}`);
+    }
+
+    async function text(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/small.txt',
+                                   {stream: true});
+        let v = await consume(resp.body);
+        let reader = resp.body;
+        let last = await reader.read();
+
+        r.return(200, `\${v.size} \${v.chunks} \${last.done}`);
+    }
+
+    async function cancel(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/big.txt',
+                                   {stream: true, buffer_size: 1024});
+        let reader = resp.body.getReader();
+        let chunk = await reader.read();
+
+        await reader.cancel();
+
+        let last = await reader.read();
+
+        r.return(200, `\${chunk.value.length > 0} \${last.done}`);
+    }
+
+    async function slow(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/big.txt',
+                                   {stream: true});
+        let reader = resp.body.getReader();
+        let chunk = await reader.read();
+
+        /* the stream is paused for longer than js_fetch_timeout */
+
+        await new Promise(resolve => setTimeout(resolve, 1500));
+
+        let v = await consume(reader);
+
+        r.return(200, `\${chunk.value.length + v.size}`);
+    }
+
+    async function limit(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/big.txt')
+                            .catch(e => e.message);
+
+        r.return(200, resp);
+    }
+
+    function chunked(r) {
+        r.status = 200;
+        r.sendHeader();
+
+        for (let i = 0; i < 20; i++) {
+            r.send('x'.repeat(10000));
+        }
+
+        r.finish();
+    }
+
+    export default {read, text, cancel, slow, limit, chunked};
+EOF
+
+$t->write_file('big.txt', 'x' x 200000);
+$t->write_file('small.txt', 'hello');
+
+$t->try_run('no fetch body streaming')->plan(6);
+
+###############################################################################
+
+like(http_get('/read?path=big.txt'), qr/200 200000 true true$/,
+	'stream content-length body');
+like(http_get('/read?path=chunked'), qr/200 200000 true true$/,
+	'stream chunked body');
+like(http_get('/text'), qr/5 1 true$/, 'stream small body');
+like(http_get('/cancel'), qr/true true$/, 'stream cancel');
+like(http_get('/slow'), qr/200000$/, 'stream paused longer than timeout');
+like(http_get('/limit'), qr/too large$/, 'buffered body limit');
+
+###############################################################################
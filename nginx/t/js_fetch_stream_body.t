@@ -0,0 +1,164 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for http njs module, fetch method, streaming request body.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /pipe {
+            js_fetch_buffer_size 4k;
+            js_content test.pipe;
+        }
+
+        location /buffer {
+            js_content test.buffer;
+        }
+
+        location /used {
+            js_content test.used;
+        }
+
+        location /request {
+            js_content test.request;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location /echo {
+            client_body_buffer_size 512k;
+            js_content test.echo;
+        }
+
+        location /chunked {
+            js_content test.chunked;
+        }
+
+        location / {
+            root %%TESTDIR%%;
+        }
+    }
+}
+
+EOF
+
+my $p1 = port(8081);
+
+$t->write_file('test.js', <<EOF);
+    async function pipe(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/' + r.args.path,
+                                   {stream: true});
+        let echo = await ngx.fetch('http://127.0.0.1:$p1/echo',
+                                   {method: 'POST', body: resp.body});
+
+        r.return(200, `\${echo.status} \${await echo.text()}`);
+    }
+
+    async function buffer(r) {
+        let echo = await ngx.fetch('http://127.0.0.1:$p1/echo',
+                                   {method: 'POST',
+                                    body: Buffer.alloc(100000, 'x')});
+
+        r.return(200, await echo.text());
+    }
+
+    async function used(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/small.txt',
+                                   {stream: true});
+        await ngx.fetch('http://127.0.0.1:$p1/echo',
+                        {method: 'POST', body: resp.body});
+
+        let v = await ngx.fetch('http://127.0.0.1:$p1/echo',
+                                {method: 'POST', body: resp.body})
+                         .catch(e => e.message);
+
+        r.return(200, v);
+    }
+
+    async function request(r) {
+        let resp = await ngx.fetch('http://127.0.0.1:$p1/small.txt',
+                                   {stream: true});
+        try {
+            new Request('http://127.0.0.1:$p1/echo',
+                        {method: 'POST', body: resp.body});
+
+        } catch (e) {
+            r.return(200, e.message);
+        }
+    }
+
+    function echo(r) {
+        r.return(200, `\${r.headersIn['Transfer-Encoding']} `
+                      + `\${r.headersIn['Content-Length']} `
+                      + `\${r.requestBuffer.length}`);
+    }
+
+    function chunked(r) {
+        r.status = 200;
+        r.sendHeader();
+
+        for (let i = 0; i < 20; i++) {
+            r.send('x'.repeat(10000));
+        }
+
+        r.finish();
+    }
+
+    export default {pipe, buffer, used, request, echo, chunked};
+EOF
+
+$t->write_file('big.txt', 'x' x 200000);
+$t->write_file('small.txt', 'hello');
+
+$t->try_run('no fetch request body streaming')->plan(6);
+
+###############################################################################
+
+like(http_get('/pipe?path=big.txt'), qr/200 chunked undefined 200000$/,
+	'pipe content-length body');
+like(http_get('/pipe?path=chunked'), qr/200 chunked undefined 200000$/,
+	'pipe chunked body');
+like(http_get('/pipe?path=small.txt'), qr/200 chunked undefined 5$/,
+	'pipe small body');
+like(http_get('/buffer'), qr/undefined 100000 100000$/, 'buffer body');
+like(http_get('/used'), qr/already read$/, 'body stream used');
+like(http_get('/request'), qr/only by fetch\(\)$/, 'request body stream');
+
+###############################################################################
@@ -0,0 +1,141 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_shared_dict_zone directive, batch methods.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=counters:64k type=number shards=4;
+    js_shared_dict_zone zone=strings:64k timeout=1000s;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /incr {
+            js_content test.incr;
+        }
+
+        location /set {
+            js_content test.set;
+        }
+
+        location /get {
+            js_content test.get;
+        }
+
+        location /errors {
+            js_content test.errors;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<'EOF');
+    function incr(r) {
+        var dict = ngx.shared.counters;
+        var keys = ['a', 'b', 'c', 'a'];
+
+        var v1 = dict.incrMany(keys, 1);
+        var v2 = dict.incrMany(keys, [1, 2, 3, 4], 10);
+
+        r.return(200, `${v1} ${v2} ${dict.getMany(['a', 'b', 'c', 'd'])}`);
+    }
+
+    function set(r) {
+        var dict = ngx.shared.strings;
+
+        dict.setMany(['x', 'y', 'z'], ['1', '22', '333'])
+            .setMany(['z'], ['3'], 5000);
+
+        r.return(200, `${dict.size()} ${dict.getMany(['z', 'y', 'x'])}`);
+    }
+
+    function get(r) {
+        var v = ngx.shared.strings.getMany(['x', 'nonexistent']);
+
+        r.return(200, `${v.length} ${v[0]} ${v[1]} `
+                      + `${ngx.shared.strings.getMany([]).length}`);
+    }
+
+    function errors(r) {
+        var errors = [];
+
+        try {
+            ngx.shared.strings.incrMany(['x'], 1);
+
+        } catch (e) {
+            errors.push(e.message);
+        }
+
+        try {
+            ngx.shared.strings.setMany(['x', 'y'], ['1']);
+
+        } catch (e) {
+            errors.push(e.message);
+        }
+
+        try {
+            ngx.shared.counters.setMany(['x'], ['1']);
+
+        } catch (e) {
+            errors.push(e.message);
+        }
+
+        try {
+            ngx.shared.counters.getMany('x');
+
+        } catch (e) {
+            errors.push(e.message);
+        }
+
+        r.return(200, errors.join('|'));
+    }
+
+    export default { incr, set, get, errors };
+EOF
+
+$t->try_run('no js_shared_dict batch methods')->plan(4);
+
+###############################################################################
+
+like(http_get('/incr'), qr/1,1,1,2 3,3,4,7 7,3,4,$/, 'incrMany');
+like(http_get('/set'), qr/3 3,22,1$/, 'setMany');
+like(http_get('/get'), qr/2 1 undefined 0$/, 'getMany');
+like(http_get('/errors'),
+	qr/not a number dict\|values length.*\|number value.*\|keys is not an array$/,
+	'errors');
+
+###############################################################################
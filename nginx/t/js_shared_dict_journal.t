@@ -0,0 +1,204 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_shared_dict_zone directive, journal parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+eval { require JSON::PP; };
+plan(skip_all => "JSON::PP not installed") if $@;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=foo:64k state=foo.json journal;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /set {
+            js_content test.set;
+        }
+
+        location /delete {
+            js_content test.del;
+        }
+
+        location /get {
+            js_content test.get;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<'EOF');
+    function set(r) {
+        var value = r.args.value;
+
+        if (r.args.repeat) {
+            value = value.repeat(Number(r.args.repeat));
+        }
+
+        ngx.shared.foo.set(r.args.key, value);
+        r.return(200, 'ok');
+    }
+
+    function del(r) {
+        r.return(200, ngx.shared.foo.delete(r.args.key));
+    }
+
+    function get(r) {
+        var keys = r.args.keys.split(',');
+
+        r.return(200, ngx.shared.foo.getMany(keys)
+                      .map(v => (v === undefined) ? 'undefined' : v.length)
+                      .join(','));
+    }
+
+    export default { set, del, get };
+EOF
+
+$t->try_run('no js_shared_dict_zone journal')->plan(14);
+
+###############################################################################
+
+# the first save writes a snapshot
+
+http_get('/set?key=a&value=1');
+http_get('/set?key=b&value=2');
+http_get('/set?key=pad&value=x&repeat=200');
+
+select undef, undef, undef, 1.1;
+
+my $state = read_state($t, 'foo.json');
+is(length($state->{pad}->{value}), 200, 'snapshot');
+
+# then changes are appended to the journal
+
+http_get('/set?key=a&value=333');
+http_get('/delete?key=b');
+
+select undef, undef, undef, 1.1;
+
+$state = read_state($t, 'foo.json');
+is($state->{a}->{value}, '1', 'snapshot unchanged');
+like($t->read_file('foo.json.journal'),
+	qr/^\{"a":\{"value":"333"\},"b":\{"deleted":1\}\}$/m, 'journal');
+
+# the journal is replayed on start
+
+$t->stop();
+$t->run();
+
+like(http_get('/get?keys=a,b,pad'), qr/3,undefined,200$/, 'replayed');
+
+# the journal is compacted once it outgrows the snapshot
+
+http_get('/set?key=c&value=y&repeat=300');
+
+select undef, undef, undef, 1.1;
+
+$state = read_state($t, 'foo.json');
+is($state->{c}, undef, 'journal appended');
+
+http_get('/set?key=d&value=4');
+
+select undef, undef, undef, 1.1;
+
+$state = read_state($t, 'foo.json');
+is($state->{a}->{value}, '333', 'compacted a');
+is($state->{b}, undef, 'compacted b');
+is(length($state->{c}->{value}), 300, 'compacted c');
+ok(!-e $t->testdir() . '/foo.json.journal', 'journal rotated');
+
+$t->stop();
+$t->run();
+
+like(http_get('/get?keys=a,b,c,d'), qr/3,undefined,300,1$/, 'compacted load');
+
+# a snapshot save interrupted before the snapshot is renamed into place
+
+$t->stop();
+
+$t->write_file('foo.json', '{"a":{"value":"1"}}');
+$t->write_file('foo.json.tmp', '{"a":{"value":"22"}}');
+$t->write_file('foo.json.journal.old', '{"a":{"value":"4444"}}');
+
+$t->run();
+
+like(http_get('/get?keys=a,b,c'), qr/2,undefined,undefined$/,
+	'interrupted before rename');
+
+# interrupted after the rename, the old journal is stale
+
+$t->stop();
+
+$t->write_file('foo.json', '{"a":{"value":"22"}}');
+$t->write_file('foo.json.journal.old', '{"a":{"value":"4444"}}');
+
+$t->run();
+
+like(http_get('/get?keys=a'), qr/2$/, 'interrupted after rename');
+
+# a key deleted and set again before the save stays set
+
+http_get('/set?key=pad&value=x&repeat=200');
+
+select undef, undef, undef, 1.1;
+
+http_get('/delete?key=a');
+http_get('/set?key=a&value=55555');
+
+select undef, undef, undef, 1.1;
+
+like($t->read_file('foo.json.journal'),
+	qr/^\{"a":\{"deleted":1\},"a":\{"value":"55555"\}\}$/m,
+	'delete then set journal');
+
+$t->stop();
+$t->run();
+
+like(http_get('/get?keys=a'), qr/5$/, 'delete then set replayed');
+
+###############################################################################
+
+sub read_state {
+	my ($self, $file) = @_;
+	my $json;
+
+	eval { $json = JSON::PP::decode_json($self->read_file($file)) };
+
+	return $json;
+}
+
+###############################################################################
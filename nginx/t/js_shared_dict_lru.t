@@ -0,0 +1,110 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_shared_dict_zone directive, evict=lru parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=lru:32k evict=lru;
+    js_shared_dict_zone zone=big:64k evict=lru;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /fill {
+            js_content test.fill;
+        }
+
+        location /get {
+            js_content test.get;
+        }
+
+        location /update {
+            js_content test.update;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<'EOF');
+    function fill(r) {
+        var dict = ngx.shared.lru;
+        var value = 'x'.repeat(100);
+
+        dict.set('hot', 'hot value');
+
+        for (var i = 0; i < 2000; i++) {
+            dict.get('hot');
+            dict.set(`key${i}`, value);
+        }
+
+        r.return(200, `hot: ${dict.get('hot')} first: ${dict.has('key0')} `
+                      + `last: ${dict.has('key1999')}`);
+    }
+
+    function get(r) {
+        r.return(200, ngx.shared.lru.get(r.args.key));
+    }
+
+    function update(r) {
+        var dict = ngx.shared.big;
+
+        dict.set('a', 'x'.repeat(20000));
+
+        /* no room for both values, the updated entry is not evicted */
+
+        try {
+            dict.set('a', 'y'.repeat(40000));
+
+        } catch (e) {
+        }
+
+        r.return(200, `a: ${dict.get('a').length}`);
+    }
+
+    export default { fill, get, update };
+EOF
+
+$t->try_run('no js_shared_dict_zone evict=lru')->plan(3);
+
+###############################################################################
+
+like(http_get('/fill'), qr/hot: hot value first: false last: true$/,
+	'hot key kept');
+like(http_get('/get?key=hot'), qr/hot value$/, 'hot key get');
+like(http_get('/update'), qr/a: [24]0000$/, 'updated key not evicted');
+
+###############################################################################
@@ -0,0 +1,135 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_shared_dict_zone directive, shards= parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=counters:64k type=number shards=8;
+    js_shared_dict_zone zone=cache:64k timeout=1000s shards=4 evict;
+    js_shared_dict_zone zone=big:128k timeout=1000s shards=2 evict;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /incr {
+            js_content test.incr;
+        }
+
+        location /strings {
+            js_content test.strings;
+        }
+
+        location /clear {
+            js_content test.clear;
+        }
+
+        location /evict {
+            js_content test.evict;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<'EOF');
+    function incr(r) {
+        var dict = ngx.shared.counters;
+
+        for (var i = 0; i < 100; i++) {
+            dict.incr(`k${i % 20}`, 1);
+        }
+
+        var sum = dict.items().reduce((a, kv) => a + kv[1], 0);
+
+        r.return(200, `size: ${dict.size()} sum: ${sum} `
+                      + `keys: ${dict.keys().length} k7: ${dict.get('k7')}`);
+    }
+
+    function strings(r) {
+        var dict = ngx.shared.cache;
+
+        for (var i = 0; i < 32; i++) {
+            dict.set(`key${i}`, `value${i}`);
+        }
+
+        dict.delete('key3');
+
+        r.return(200, `size: ${dict.size()} key5: ${dict.get('key5')} `
+                      + `key3: ${dict.has('key3')} `
+                      + `pop: ${dict.pop('key9')} ${dict.has('key9')}`);
+    }
+
+    function clear(r) {
+        ngx.shared.counters.clear();
+        ngx.shared.cache.clear();
+
+        r.return(200, `size: ${ngx.shared.counters.size()} `
+                      + `${ngx.shared.cache.size()}`);
+    }
+
+    function evict(r) {
+        var dict = ngx.shared.big;
+        var value = 'x'.repeat(40000);
+
+        try {
+            for (var i = 0; i < 10; i++) {
+                dict.set(`big${i}`, value);
+            }
+
+        } catch (e) {
+            r.return(200, e.message);
+            return;
+        }
+
+        r.return(200, `big9: ${dict.get('big9').length}`);
+    }
+
+    export default { incr, strings, clear, evict };
+EOF
+
+$t->try_run('no js_shared_dict_zone shards=')->plan(5);
+
+###############################################################################
+
+like(http_get('/incr'), qr/size: 20 sum: 100 keys: 20 k7: 5$/, 'incr');
+like(http_get('/strings'),
+	qr/size: 31 key5: value5 key3: false pop: value9 false$/, 'strings');
+like(http_get('/clear'), qr/size: 0 0$/, 'clear');
+like(http_get('/incr'), qr/size: 20 sum: 100 keys: 20 k7: 5$/,
+	'incr after clear');
+like(http_get('/evict'), qr/big9: 40000$/, 'evict other shards');
+
+###############################################################################
@@ -0,0 +1,106 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_shared_dict_zone directive, state_format= parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=strings:64k state=strings.bin
+                        state_format=binary;
+    js_shared_dict_zone zone=numbers:64k type=number timeout=1000s
+                        state=numbers.bin state_format=binary;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /set {
+            js_content test.set;
+        }
+
+        location /get {
+            js_content test.get;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('strings.bin', <<EOF);
+{"json":{"value":"converted"}}
+EOF
+
+$t->write_file('test.js', <<'EOF');
+    function set(r) {
+        ngx.shared.strings.set('a', 'value a');
+        ngx.shared.strings.set('empty', '');
+        ngx.shared.strings.set('é\n', 'unicode');
+        ngx.shared.numbers.set('x', 1.5);
+        ngx.shared.numbers.incr('y', 2);
+
+        r.return(200, 'ok');
+    }
+
+    function get(r) {
+        var s = ngx.shared.strings;
+        var n = ngx.shared.numbers;
+
+        r.return(200, `${s.get('json')} ${s.get('a')} [${s.get('empty')}] `
+                      + `${s.get('é\n')} ${n.get('x')} ${n.get('y')} `
+                      + `${s.size()} ${n.size()}`);
+    }
+
+    export default { set, get };
+EOF
+
+$t->try_run('no js_shared_dict_zone state_format=')->plan(4);
+
+###############################################################################
+
+like(http_get('/get'), qr/converted undefined \[undefined\]/, 'json loaded');
+
+http_get('/set');
+
+select undef, undef, undef, 1.1;
+
+like($t->read_file('strings.bin'), qr/^NJSD/, 'binary strings');
+like($t->read_file('numbers.bin'), qr/^NJSD/, 'binary numbers');
+
+$t->stop();
+$t->run();
+
+like(http_get('/get'), qr/converted value a \[\] unicode 1.5 2 4 2$/,
+	'binary loaded');
+
+###############################################################################
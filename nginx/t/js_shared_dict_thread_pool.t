@@ -0,0 +1,116 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_shared_dict_zone directive, thread_pool= parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+eval { require JSON::PP; };
+plan(skip_all => "JSON::PP not installed") if $@;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+thread_pool js threads=1;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_import test.js;
+
+    js_shared_dict_zone zone=foo:64k state=foo.json thread_pool=js;
+    js_shared_dict_zone zone=bar:64k state=bar.json thread_pool=js journal;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /set {
+            js_content test.set;
+        }
+
+        location /get {
+            js_content test.get;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<'EOF');
+    function set(r) {
+        ngx.shared[r.args.dict].set(r.args.key, r.args.value);
+        r.return(200, 'ok');
+    }
+
+    function get(r) {
+        r.return(200, ngx.shared[r.args.dict].get(r.args.key));
+    }
+
+    export default { set, get };
+EOF
+
+$t->try_run('no js_shared_dict_zone thread_pool=')->plan(5);
+
+###############################################################################
+
+http_get('/set?dict=foo&key=a&value=1');
+http_get('/set?dict=bar&key=a&value=1');
+
+select undef, undef, undef, 1.1;
+
+is(read_state($t, 'foo.json')->{a}->{value}, '1', 'saved');
+is(read_state($t, 'bar.json')->{a}->{value}, '1', 'snapshot saved');
+
+http_get('/set?dict=bar&key=a&value=2');
+
+select undef, undef, undef, 1.1;
+
+like($t->read_file('bar.json.journal'), qr/"a":\{"value":"2"\}/,
+	'journal saved');
+
+http_get('/set?dict=foo&key=a&value=3');
+
+$t->stop();
+
+is(read_state($t, 'foo.json')->{a}->{value}, '3', 'saved on exit');
+
+$t->run();
+
+like(http_get('/get?dict=bar&key=a'), qr/2$/, 'loaded');
+
+###############################################################################
+
+sub read_state {
+	my ($self, $file) = @_;
+	my $json;
+
+	eval { $json = JSON::PP::decode_json($self->read_file($file)) };
+
+	return $json;
+}
+
+###############################################################################
@@ -0,0 +1,116 @@
+#!/usr/bin/perl
+
+# (C) Nginx, Inc.
+
+# Tests for js_set directive, cache= parameter.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    js_set $cached_var  test.variable cache=$arg_k size=2;
+    js_set $expired_var test.variable cache=$arg_k ttl=1s;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        js_import test.js;
+
+        location /cached {
+            return 200 '"$cached_var"';
+        }
+
+        location /expired {
+            return 200 '"$expired_var"';
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        js_import test from scoped.js;
+
+        location /cached {
+            return 200 '"$cached_var"';
+        }
+    }
+}
+
+EOF
+
+$t->write_file('test.js', <<EOF);
+    function variable(r) {
+        return `\${r.args.k}:\${Math.random().toFixed(16)}`;
+    }
+
+    export default {variable};
+
+EOF
+
+$t->write_file('scoped.js', <<EOF);
+    function variable(r) {
+        return `scoped:\${r.args.k}`;
+    }
+
+    export default {variable};
+
+EOF
+
+$t->try_run('no js_set cache=')->plan(6);
+
+###############################################################################
+
+my ($a1) = http_get('/cached?k=a') =~ /"(.+)"/;
+my ($a2) = http_get('/cached?k=a') =~ /"(.+)"/;
+my ($b1) = http_get('/cached?k=b') =~ /"(.+)"/;
+
+is($a2, $a1, 'cached value');
+like($b1, qr/^b:/, 'cache key');
+
+http_get('/cached?k=c');
+
+my ($a3) = http_get('/cached?k=a') =~ /"(.+)"/;
+isnt($a3, $a1, 'least recently used evicted');
+
+my ($e1) = http_get('/expired?k=a') =~ /"(.+)"/;
+my ($e2) = http_get('/expired?k=a') =~ /"(.+)"/;
+
+select undef, undef, undef, 1.5;
+
+my ($e3) = http_get('/expired?k=a') =~ /"(.+)"/;
+
+ok($e1 eq $e2 && $e2 ne $e3, 'ttl');
+like($e3, qr/^a:/, 'value after ttl');
+
+like(http_get('/cached?k=a', PeerAddr => '127.0.0.1:' . port(8081)),
+	qr/"scoped:a"$/, 'cache scoped to imports');
+
+###############################################################################
@@ -323,6 +323,14 @@ NJS_EXPORT njs_mod_t *njs_vm_compile_module(njs_vm_t *vm, njs_str_t *name,
     u_char **start, u_char *end);
 NJS_EXPORT njs_int_t njs_vm_reuse(njs_vm_t *vm);
 NJS_EXPORT njs_vm_t *njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external);
+/*
+ * Frees all the memory of a cloned VM, keeping the memory pool clusters.
+ * The returned pool can be passed to njs_vm_clone_reuse() or destroyed
+ * with njs_mp_destroy().
+ */
+NJS_EXPORT njs_mp_t *njs_vm_release(njs_vm_t *vm);
+NJS_EXPORT njs_vm_t *njs_vm_clone_reuse(njs_vm_t *vm, njs_mp_t *mp,
+    njs_external_ptr_t external);
 
 NJS_EXPORT njs_int_t njs_vm_enqueue_job(njs_vm_t *vm, njs_function_t *function,
     const njs_value_t *args, njs_uint_t nargs);
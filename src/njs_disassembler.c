@@ -19,8 +19,6 @@ static njs_code_name_t  code_names[] = {
 
     { NJS_VMCODE_PUT_ARG, sizeof(njs_vmcode_1addr_t),
           njs_str("PUT ARG         ") },
-    { NJS_VMCODE_OBJECT, sizeof(njs_vmcode_object_t),
-          njs_str("OBJECT          ") },
     { NJS_VMCODE_FUNCTION, sizeof(njs_vmcode_function_t),
           njs_str("FUNCTION        ") },
     { NJS_VMCODE_ARGUMENTS, sizeof(njs_vmcode_arguments_t),
@@ -32,7 +30,7 @@ static njs_code_name_t  code_names[] = {
 
     { NJS_VMCODE_PROPERTY_GET, sizeof(njs_vmcode_prop_get_t),
           njs_str("PROP GET        ") },
-    { NJS_VMCODE_PROPERTY_ATOM_GET, sizeof(njs_vmcode_prop_get_t),
+    { NJS_VMCODE_PROPERTY_ATOM_GET, sizeof(njs_vmcode_prop_atom_t),
           njs_str("PROP ATOM GET   ") },
     { NJS_VMCODE_GLOBAL_GET, sizeof(njs_vmcode_prop_get_t),
           njs_str("GLOBAL GET      ") },
@@ -42,7 +40,7 @@ static njs_code_name_t  code_names[] = {
           njs_str("PROTO INIT      ") },
     { NJS_VMCODE_PROPERTY_SET, sizeof(njs_vmcode_prop_set_t),
           njs_str("PROP SET        ") },
-    { NJS_VMCODE_PROPERTY_ATOM_SET, sizeof(njs_vmcode_prop_set_t),
+    { NJS_VMCODE_PROPERTY_ATOM_SET, sizeof(njs_vmcode_prop_atom_t),
           njs_str("PROP ATOM SET   ") },
     { NJS_VMCODE_PROPERTY_IN, sizeof(njs_vmcode_3addr_t),
           njs_str("PROP IN         ") },
@@ -200,6 +198,7 @@ njs_disassemble(u_char *start, u_char *end, njs_int_t count, njs_arr_t *lines)
     njs_vmcode_2addr_t           *code2;
     njs_vmcode_3addr_t           *code3;
     njs_vmcode_array_t           *array;
+    njs_vmcode_object_t          *object;
     njs_vmcode_catch_t           *catch;
     njs_vmcode_import_t          *import;
     njs_vmcode_finally_t         *finally;
@@ -228,6 +227,18 @@ njs_disassemble(u_char *start, u_char *end, njs_int_t count, njs_arr_t *lines)
         operation = *(njs_vmcode_t *) p;
         line = njs_lookup_line(lines, p - start);
 
+        if (operation == NJS_VMCODE_OBJECT) {
+            object = (njs_vmcode_object_t *) p;
+
+            njs_printf("%5uD | %05uz OBJECT            %04Xz%s\n",
+                       line, p - start, (size_t) object->retval,
+                       (object->shape != NULL) ? " SHAPE" : "");
+
+            p += sizeof(njs_vmcode_object_t);
+
+            continue;
+        }
+
         if (operation == NJS_VMCODE_ARRAY) {
             array = (njs_vmcode_array_t *) p;
 
@@ -518,7 +529,9 @@ njs_disassemble(u_char *start, u_char *end, njs_int_t count, njs_arr_t *lines)
             if (operation == code_name->operation) {
                 name = &code_name->name;
 
-                if (code_name->size == sizeof(njs_vmcode_3addr_t)) {
+                if (code_name->size == sizeof(njs_vmcode_3addr_t)
+                    || code_name->size == sizeof(njs_vmcode_prop_atom_t))
+                {
                     code3 = (njs_vmcode_3addr_t *) p;
 
                     njs_printf("%5uD | %05uz %*s  %04Xz %04Xz %04Xz\n",
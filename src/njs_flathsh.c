@@ -147,6 +147,30 @@ njs_flathsh_new(njs_flathsh_query_t *fhq)
 }
 
 
+njs_flathsh_descr_t *
+njs_flathsh_copy(njs_flathsh_query_t *fhq, const njs_flathsh_descr_t *h)
+{
+    void                 *chunk;
+    size_t               size, hash_size;
+    njs_flathsh_descr_t  *copy;
+
+    hash_size = h->hash_mask + 1;
+    size = njs_flathsh_chunk_size(hash_size, h->elts_count);
+
+    chunk = njs_flathsh_malloc(fhq, size);
+    if (njs_slow_path(chunk == NULL)) {
+        return NULL;
+    }
+
+    memcpy(chunk, (uint32_t *) h - hash_size, size);
+
+    copy = njs_flathsh_descr(chunk, hash_size);
+    copy->elts_size = h->elts_count;
+
+    return copy;
+}
+
+
 void
 njs_flathsh_destroy(njs_flathsh_t *fh, njs_flathsh_query_t *fhq)
 {
@@ -160,6 +160,12 @@ NJS_EXPORT njs_flathsh_elt_t *njs_flathsh_add_elt(njs_flathsh_t *fh,
     njs_flathsh_query_t *fhq);
 
 NJS_EXPORT njs_flathsh_descr_t *njs_flathsh_new(njs_flathsh_query_t *fhq);
+/*
+ * Copy flat hash with its elements into a single chunk sized
+ * exactly for the elements present.
+ */
+NJS_EXPORT njs_flathsh_descr_t *njs_flathsh_copy(njs_flathsh_query_t *fhq,
+    const njs_flathsh_descr_t *h);
 NJS_EXPORT void njs_flathsh_destroy(njs_flathsh_t *fh, njs_flathsh_query_t *fhq);
 
 
@@ -11,6 +11,7 @@
 
 
 #define NJS_FUNCTION_MAX_DEPTH  128
+#define NJS_OBJECT_SHAPE_MAX    32
 
 
 typedef struct njs_generator_patch_s   njs_generator_patch_t;
@@ -256,6 +257,8 @@ static njs_int_t njs_generate_operation_assignment_end(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
 static njs_int_t njs_generate_object(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node);
+static njs_int_t njs_generate_object_shape(njs_vm_t *vm,
+    njs_parser_node_t *node, njs_flathsh_descr_t **shape);
 static njs_int_t njs_generate_property_accessor(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
 static njs_int_t njs_generate_property_accessor_end(njs_vm_t *vm,
@@ -395,6 +398,29 @@ static njs_int_t njs_generate_index_release(njs_vm_t *vm,
     } while (0)
 
 
+/*
+ * PROPERTY_ATOM_GET and PROPERTY_ATOM_SET instructions carry an inline
+ * property cache after the common operands.
+ */
+
+#define njs_generate_code_prop(generator, type, _code, _op, nd)               \
+    do {                                                                      \
+        njs_vmcode_prop_atom_t  *_atom;                                       \
+                                                                              \
+        if (_op == NJS_VMCODE_PROPERTY_ATOM_GET                               \
+            || _op == NJS_VMCODE_PROPERTY_ATOM_SET)                           \
+        {                                                                     \
+            njs_generate_code(generator, njs_vmcode_prop_atom_t, _atom, _op,  \
+                              nd);                                            \
+            njs_memzero(&_atom->cache, sizeof(njs_property_cache_t));         \
+            _code = (type *) _atom;                                           \
+                                                                              \
+        } else {                                                              \
+            njs_generate_code(generator, type, _code, _op, nd);               \
+        }                                                                     \
+    } while (0)
+
+
 #define njs_generate_code_jump(generator, _code, _offset)                     \
     do {                                                                      \
         njs_generate_code(generator, njs_vmcode_jump_t, _code,                \
@@ -2300,8 +2326,8 @@ njs_generate_for_in_set_prop_block(njs_vm_t *vm, njs_generator_t *generator,
         opcode = NJS_VMCODE_PROPERTY_SET;
     }
 
-    njs_generate_code(generator, njs_vmcode_prop_set_t, prop_set,
-                      opcode, foreach);
+    njs_generate_code_prop(generator, njs_vmcode_prop_set_t, prop_set,
+                           opcode, foreach);
     prop_set->object = foreach->left->left->index;
     prop_set->property = prop->index;
     prop_set->value = ctx->index_next_value;
@@ -3019,8 +3045,8 @@ njs_generate_global_property_set(njs_vm_t *vm, njs_generator_t *generator,
 
     var = njs_variable_reference(vm, node_dst);
     if (var == NULL) {
-        njs_generate_code(generator, njs_vmcode_prop_set_t, prop_set,
-                          NJS_VMCODE_PROPERTY_ATOM_SET, node_src);
+        njs_generate_code_prop(generator, njs_vmcode_prop_set_t, prop_set,
+                               NJS_VMCODE_PROPERTY_ATOM_SET, node_src);
 
         prop_set->value = node_dst->index;
         prop_set->object = njs_scope_global_this_index();
@@ -3253,8 +3279,8 @@ njs_generate_assignment_end(njs_vm_t *vm, njs_generator_t *generator,
             opcode = NJS_VMCODE_PROPERTY_SET;
         }
 
-        njs_generate_code(generator, njs_vmcode_prop_set_t, prop_set,
-                          opcode, expr);
+        njs_generate_code_prop(generator, njs_vmcode_prop_set_t, prop_set,
+                               opcode, expr);
     }
 
     prop_set->value = expr->index;
@@ -3470,8 +3496,8 @@ njs_generate_operation_assignment_prop(njs_vm_t *vm, njs_generator_t *generator,
         opcode = NJS_VMCODE_PROPERTY_GET;
     }
 
-    njs_generate_code(generator, njs_vmcode_prop_get_t, prop_get,
-                      opcode, property);
+    njs_generate_code_prop(generator, njs_vmcode_prop_get_t, prop_get,
+                           opcode, property);
 
     prop_get->value = index;
     prop_get->object = object->index;
@@ -3520,8 +3546,8 @@ njs_generate_operation_assignment_end(njs_vm_t *vm, njs_generator_t *generator,
         opcode = NJS_VMCODE_PROPERTY_SET;
     }
 
-    njs_generate_code(generator, njs_vmcode_prop_set_t, prop_set,
-                      opcode, expr);
+    njs_generate_code_prop(generator, njs_vmcode_prop_set_t, prop_set,
+                           opcode, expr);
 
     prop_set->value = node->index;
     prop_set->object = lvalue->left->index;
@@ -3551,6 +3577,10 @@ njs_generate_object(njs_vm_t *vm, njs_generator_t *generator,
                       NJS_VMCODE_OBJECT, node);
     object->retval = node->index;
 
+    if (njs_generate_object_shape(vm, node, &object->shape) != NJS_OK) {
+        return NJS_ERROR;
+    }
+
     /* Initialize object. */
 
     njs_generator_next(generator, njs_generate, node->left);
@@ -3561,6 +3591,87 @@ njs_generate_object(njs_vm_t *vm, njs_generator_t *generator,
 }
 
 
+/*
+ * An object literal with a few constant keys gets a prebuilt property
+ * hash.  Every object created by the literal starts with a copy of it,
+ * so the properties are laid out in the same order without growing the
+ * hash, and property caches hit across all such objects.
+ */
+
+static njs_int_t
+njs_generate_object_shape(njs_vm_t *vm, njs_parser_node_t *node,
+    njs_flathsh_descr_t **shape)
+{
+    uint32_t             atoms[NJS_OBJECT_SHAPE_MAX];
+    njs_int_t            ret;
+    njs_uint_t           n;
+    njs_flathsh_t        hash;
+    njs_object_prop_t    *prop;
+    njs_parser_node_t    *stmt, *assign, *property;
+    njs_flathsh_query_t  fhq;
+
+    *shape = NULL;
+
+    n = 0;
+
+    for (stmt = node->left; stmt != NULL; stmt = stmt->left) {
+        assign = stmt->right;
+
+        if (n == NJS_OBJECT_SHAPE_MAX
+            || stmt->token_type != NJS_TOKEN_STATEMENT
+            || assign == NULL
+            || assign->token_type != NJS_TOKEN_ASSIGNMENT
+            || assign->left->token_type != NJS_TOKEN_PROPERTY_INIT)
+        {
+            return NJS_OK;
+        }
+
+        property = assign->left->right;
+
+        if (property->token_type != NJS_TOKEN_STRING
+            || property->u.value.atom_id == NJS_ATOM_STRING_unknown)
+        {
+            return NJS_OK;
+        }
+
+        atoms[n++] = property->u.value.atom_id;
+    }
+
+    if (n == 0) {
+        return NJS_OK;
+    }
+
+    njs_flathsh_init(&hash);
+
+    fhq.replace = 1;
+    fhq.proto = &njs_object_hash_proto;
+    fhq.pool = vm->mem_pool;
+
+    /* The statements are linked in reverse order. */
+
+    while (n != 0) {
+        fhq.key_hash = atoms[--n];
+
+        ret = njs_flathsh_unique_insert(&hash, &fhq);
+        if (njs_slow_path(ret != NJS_OK)) {
+            return NJS_ERROR;
+        }
+
+        prop = fhq.value;
+
+        prop->type = NJS_PROPERTY;
+        prop->enumerable = 1;
+        prop->configurable = 1;
+        prop->writable = 1;
+        njs_set_undefined(njs_prop_value(prop));
+    }
+
+    *shape = hash.slot;
+
+    return NJS_OK;
+}
+
+
 static njs_int_t
 njs_generate_property_accessor(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node)
@@ -3924,8 +4035,8 @@ njs_generate_3addr_operation_end(njs_vm_t *vm, njs_generator_t *generator,
         opcode = node->u.operation;
     }
 
-    njs_generate_code(generator, njs_vmcode_3addr_t, code,
-                      opcode, node);
+    njs_generate_code_prop(generator, njs_vmcode_3addr_t, code,
+                           opcode, node);
 
     swap = *((njs_bool_t *) generator->context);
 
@@ -4179,8 +4290,8 @@ found:
         opcode = NJS_VMCODE_PROPERTY_GET;
     }
 
-    njs_generate_code(generator, njs_vmcode_prop_get_t, prop_get,
-                      opcode, node);
+    njs_generate_code_prop(generator, njs_vmcode_prop_get_t, prop_get,
+                           opcode, node);
 
     prop_get->value = index;
     prop_get->object = lvalue->left->index;
@@ -4199,8 +4310,8 @@ found:
         opcode = NJS_VMCODE_PROPERTY_SET;
     }
 
-    njs_generate_code(generator, njs_vmcode_prop_set_t, prop_set,
-                      opcode, node);
+    njs_generate_code_prop(generator, njs_vmcode_prop_set_t, prop_set,
+                           opcode, node);
 
     prop_set->value = index;
     prop_set->object = lvalue->left->index;
@@ -285,6 +285,72 @@ njs_mp_destroy(njs_mp_t *mp)
 }
 
 
+void
+njs_mp_reset(njs_mp_t *mp)
+{
+    void               *p;
+    njs_uint_t         n;
+    njs_mp_slot_t      *slot;
+    njs_mp_block_t     *block;
+    njs_mp_cleanup_t   *c;
+    njs_rbtree_node_t  *node, *next;
+
+    njs_debug_alloc("mp reset\n");
+
+    for (c = mp->cleanup; c != NULL; c = c->next) {
+        if (c->handler != NULL) {
+            njs_debug_alloc("mp run cleanup: @%p\n", c);
+            c->handler(c->data);
+        }
+    }
+
+    mp->cleanup = NULL;
+
+    slot = mp->slots;
+
+    do {
+        njs_queue_init(&slot->pages);
+    } while ((slot++)->size < mp->page_size / 2);
+
+    njs_queue_init(&mp->free_pages);
+
+    /*
+     * Large allocations are returned to the system, clusters are kept
+     * with all their pages marked as free.
+     */
+
+    node = njs_rbtree_min(&mp->blocks);
+
+    while (njs_rbtree_is_there_successor(&mp->blocks, node)) {
+        next = njs_rbtree_node_successor(&mp->blocks, node);
+        block = (njs_mp_block_t *) node;
+
+        if (block->type == NJS_MP_CLUSTER_BLOCK) {
+            n = mp->cluster_size >> mp->page_size_shift;
+
+            while (n != 0) {
+                n--;
+                block->pages[n].size = 0;
+                njs_queue_insert_head(&mp->free_pages, &block->pages[n].link);
+            }
+
+        } else {
+            njs_rbtree_delete(&mp->blocks, &block->node);
+
+            p = block->start;
+
+            if (block->type == NJS_MP_DISCRETE_BLOCK) {
+                njs_free(block);
+            }
+
+            njs_free(p);
+        }
+
+        node = next;
+    }
+}
+
+
 void
 njs_mp_stat(njs_mp_t *mp, njs_mp_stat_t *stat)
 {
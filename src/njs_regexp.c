@@ -423,6 +423,11 @@ njs_regexp_pattern_compile(njs_vm_t *vm, njs_regex_t *regex, u_char *source,
     njs_int_t            ret;
     njs_trace_handler_t  handler;
 
+    ret = njs_regexp_ctx(vm);
+    if (njs_slow_path(ret != NJS_OK)) {
+        return NJS_ERROR;
+    }
+
     handler = vm->trace.handler;
     vm->trace.handler = njs_regexp_compile_trace_handler;
 
@@ -464,6 +469,11 @@ njs_regexp_match(njs_vm_t *vm, njs_regex_t *regex, const u_char *subject,
     njs_int_t            ret;
     njs_trace_handler_t  handler;
 
+    ret = njs_regexp_ctx(vm);
+    if (njs_slow_path(ret != NJS_OK)) {
+        return NJS_ERROR;
+    }
+
     handler = vm->trace.handler;
     vm->trace.handler = njs_regexp_match_trace_handler;
 
@@ -902,6 +912,11 @@ njs_regexp_builtin_exec(njs_vm_t *vm, njs_value_t *r, njs_value_t *s,
         goto not_found;
     }
 
+    ret = njs_regexp_ctx(vm);
+    if (njs_slow_path(ret != NJS_OK)) {
+        return NJS_ERROR;
+    }
+
     match_data = njs_regex_match_data(&pattern->regex[type],
                                       vm->regex_generic_ctx);
     if (njs_slow_path(match_data == NULL)) {
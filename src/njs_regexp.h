@@ -27,6 +27,17 @@ njs_int_t njs_regexp_to_string(njs_vm_t *vm, njs_value_t *retval,
     const njs_value_t *regexp);
 
 
+njs_inline njs_int_t
+njs_regexp_ctx(njs_vm_t *vm)
+{
+    if (njs_fast_path(vm->regex_generic_ctx != NULL)) {
+        return NJS_OK;
+    }
+
+    return njs_regexp_init(vm);
+}
+
+
 extern const njs_object_init_t  njs_regexp_instance_init;
 extern const njs_object_type_init_t  njs_regexp_type_init;
 
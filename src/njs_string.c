@@ -2578,6 +2578,11 @@ njs_string_prototype_search(njs_vm_t *vm, njs_value_t *args, njs_uint_t nargs,
         n = (string.length != 0);
 
         if (njs_regex_is_valid(&pattern->regex[n])) {
+            ret = njs_regexp_ctx(vm);
+            if (njs_slow_path(ret != NJS_OK)) {
+                return NJS_ERROR;
+            }
+
             ret = njs_regexp_match(vm, &pattern->regex[n], string.start,
                                    0, string.size, vm->single_match_data);
             if (ret >= 0) {
@@ -2699,6 +2704,11 @@ njs_string_match_multiple(njs_vm_t *vm, njs_value_t *args,
             return NJS_ERROR;
         }
 
+        ret = njs_regexp_ctx(vm);
+        if (njs_slow_path(ret != NJS_OK)) {
+            return NJS_ERROR;
+        }
+
         p = string.start;
         end = p + string.size;
 
@@ -20,6 +20,13 @@ static njs_int_t njs_string_property_query(njs_vm_t *vm,
     njs_property_query_t *pq, njs_value_t *object, uint32_t index);
 static njs_int_t njs_external_property_query(njs_vm_t *vm,
     njs_property_query_t *pq, njs_value_t *value);
+static njs_int_t njs_value_property_lookup(njs_vm_t *vm, njs_value_t *value,
+    uint32_t atom_id, njs_value_t *retval, njs_property_cache_t *cache);
+static njs_int_t njs_value_property_store(njs_vm_t *vm, njs_value_t *value,
+    uint32_t atom_id, njs_value_t *setval, njs_property_cache_t *cache);
+static void njs_property_cache_update(njs_vm_t *vm,
+    njs_property_cache_t *cache, njs_value_t *value, uint32_t atom_id,
+    njs_object_prop_t *prop);
 
 
 const njs_value_t  njs_value_null =         njs_value(NJS_NULL, 0, 0.0);
@@ -1049,12 +1056,9 @@ njs_int_t
 njs_value_property(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
     njs_value_t *retval)
 {
-    uint32_t              index;
-    njs_int_t             ret;
-    njs_array_t          *array;
-    njs_object_prop_t     *prop;
-    njs_typed_array_t     *tarray;
-    njs_property_query_t  pq;
+    uint32_t           index;
+    njs_array_t        *array;
+    njs_typed_array_t  *tarray;
 
     if (njs_fast_path(njs_atom_is_number(atom_id))) {
         index = njs_atom_number(atom_id);
@@ -1063,7 +1067,8 @@ njs_value_property(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
             tarray = njs_typed_array(value);
 
             if (njs_slow_path(njs_is_detached_buffer(tarray->buffer))) {
-                goto not_found;
+                njs_set_undefined(retval);
+                return NJS_DECLINED;
             }
 
             if (njs_slow_path(index >= njs_typed_array_length(tarray))) {
@@ -1098,61 +1103,85 @@ njs_value_property(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
 
 slow_path:
 
-    njs_property_query_init(&pq, NJS_PROPERTY_QUERY_GET, 0);
+    return njs_value_property_lookup(vm, value, atom_id, retval, NULL);
+}
 
-    ret = njs_property_query(vm, &pq, value, atom_id);
 
-    switch (ret) {
+njs_inline njs_int_t
+njs_value_property_get(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
+    njs_object_prop_t *prop, njs_value_t *retval)
+{
+    njs_int_t          ret;
+    njs_object_prop_t  scratch;
 
-    case NJS_OK:
-        prop = pq.fhq.value;
+    switch (prop->type) {
+    case NJS_PROPERTY:
+    case NJS_ACCESSOR:
+        if (njs_is_data_descriptor(prop)) {
+            njs_value_assign(retval, njs_prop_value(prop));
+            break;
+        }
 
-        switch (prop->type) {
-        case NJS_PROPERTY:
-        case NJS_ACCESSOR:
-            if (njs_is_data_descriptor(prop)) {
-                njs_value_assign(retval, njs_prop_value(prop));
-                break;
-            }
+        if (njs_prop_getter(prop) == NULL) {
+            njs_set_undefined(retval);
+            break;
+        }
 
-            if (njs_prop_getter(prop) == NULL) {
-                njs_set_undefined(retval);
-                break;
+        return njs_function_apply(vm, njs_prop_getter(prop), value, 1, retval);
+
+    case NJS_PROPERTY_HANDLER:
+        scratch = *prop;
+        prop = &scratch;
+        ret = njs_prop_handler(prop)(vm, prop, atom_id, value, NULL,
+                                     njs_prop_value(prop));
+
+        if (njs_slow_path(ret != NJS_OK)) {
+            if (ret == NJS_ERROR) {
+                return ret;
             }
 
-            return njs_function_apply(vm, njs_prop_getter(prop), value, 1,
-                                      retval);
+            njs_set_undefined(njs_prop_value(prop));
+        }
 
-        case NJS_PROPERTY_HANDLER:
-            pq.scratch = *prop;
-            prop = &pq.scratch;
-            ret = njs_prop_handler(prop)(vm, prop, atom_id, value, NULL,
-                                         njs_prop_value(prop));
+        njs_value_assign(retval, njs_prop_value(prop));
 
-            if (njs_slow_path(ret != NJS_OK)) {
-                if (ret == NJS_ERROR) {
-                    return ret;
-                }
+        break;
 
-                njs_set_undefined(njs_prop_value(prop));
-            }
+    default:
+        njs_internal_error(vm, "unexpected property type \"%s\" "
+                           "while getting",
+                           njs_prop_type_string(prop->type));
 
-            njs_value_assign(retval, njs_prop_value(prop));
+        return NJS_ERROR;
+    }
 
-            break;
+    return NJS_OK;
+}
 
-        default:
-            njs_internal_error(vm, "unexpected property type \"%s\" "
-                               "while getting",
-                               njs_prop_type_string(prop->type));
 
-            return NJS_ERROR;
+static njs_int_t
+njs_value_property_lookup(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
+    njs_value_t *retval, njs_property_cache_t *cache)
+{
+    njs_int_t             ret;
+    njs_property_query_t  pq;
+
+    njs_property_query_init(&pq, NJS_PROPERTY_QUERY_GET, 0);
+
+    ret = njs_property_query(vm, &pq, value, atom_id);
+
+    switch (ret) {
+
+    case NJS_OK:
+        if (cache != NULL) {
+            njs_property_cache_update(vm, cache, value, atom_id,
+                                      pq.fhq.value);
         }
 
-        break;
+        return njs_value_property_get(vm, value, atom_id, pq.fhq.value,
+                                      retval);
 
     case NJS_DECLINED:
-not_found:
         njs_set_undefined(retval);
 
         return NJS_DECLINED;
@@ -1162,8 +1191,158 @@ not_found:
 
         return NJS_ERROR;
     }
+}
 
-    return NJS_OK;
+
+njs_inline njs_object_t *
+njs_property_cache_object(njs_vm_t *vm, njs_value_t *value)
+{
+    if (njs_fast_path(njs_is_object(value))) {
+        return njs_object(value);
+    }
+
+    if (njs_is_string(value)) {
+        return &vm->string_object;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * The cache entry is not tied to a particular hash, so a hit only means
+ * that the element at the cached position holds the same atom.  Objects
+ * with different histories may keep different kinds of properties there,
+ * the callers must check the property type they can handle.
+ */
+
+njs_inline njs_object_prop_t *
+njs_property_cache_find(njs_property_cache_t *cache, njs_object_t *object,
+    uint32_t atom_id)
+{
+    njs_object_prop_t    *prop;
+    njs_flathsh_descr_t  *h;
+    njs_flathsh_query_t  fhq;
+
+    if (cache->elt_num == 0) {
+        return NULL;
+    }
+
+    if (cache->proto != NULL) {
+        if (object->__proto__ != cache->proto
+            || object->shared_hash.slot != cache->shared)
+        {
+            return NULL;
+        }
+
+        if (!njs_flathsh_is_empty(&object->hash)) {
+            fhq.key_hash = atom_id;
+            fhq.proto = &njs_object_hash_proto;
+
+            if (njs_flathsh_unique_find(&object->hash, &fhq) == NJS_OK) {
+                return NULL;
+            }
+        }
+
+        object = cache->proto;
+    }
+
+    h = object->hash.slot;
+
+    if (h == NULL || cache->elt_num > h->elts_count) {
+        return NULL;
+    }
+
+    prop = (njs_object_prop_t *) &njs_hash_elts(h)[cache->elt_num - 1];
+
+    if (prop->atom_id != atom_id || prop->type == NJS_FREE_FLATHSH_ELEMENT) {
+        return NULL;
+    }
+
+    return prop;
+}
+
+
+static void
+njs_property_cache_update(njs_vm_t *vm, njs_property_cache_t *cache,
+    njs_value_t *value, uint32_t atom_id, njs_object_prop_t *prop)
+{
+    njs_int_t            ret;
+    njs_value_t          key;
+    njs_object_t         *object, *holder;
+    njs_flathsh_elt_t    *elts, *elt;
+    njs_flathsh_descr_t  *h;
+
+    cache->elt_num = 0;
+
+    object = njs_property_cache_object(vm, value);
+    if (object == NULL) {
+        return;
+    }
+
+    elt = (njs_flathsh_elt_t *) prop;
+    holder = object;
+
+    for ( ;; ) {
+        h = holder->hash.slot;
+
+        if (h != NULL) {
+            elts = njs_hash_elts(h);
+
+            if (elt >= elts && elt < elts + h->elts_count) {
+                break;
+            }
+        }
+
+        if (holder != object || holder->__proto__ == NULL) {
+            return;
+        }
+
+        holder = holder->__proto__;
+    }
+
+    /*
+     * Canonical numeric keys of arrays and typed arrays are resolved
+     * before the hash is looked up, so they are not cached.
+     */
+
+    ret = njs_atom_to_value(vm, &key, atom_id);
+    if (njs_slow_path(ret != NJS_OK || !isnan(njs_key_to_index(&key)))) {
+        return;
+    }
+
+    cache->elt_num = elt - elts + 1;
+    cache->proto = (holder != object) ? holder : NULL;
+    cache->shared = object->shared_hash.slot;
+}
+
+
+njs_int_t
+njs_value_property_cached(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
+    njs_value_t *retval, njs_property_cache_t *cache)
+{
+    njs_object_t       *object;
+    njs_object_prop_t  *prop;
+
+    if (njs_slow_path(njs_atom_is_number(atom_id))) {
+        return njs_value_property(vm, value, atom_id, retval);
+    }
+
+    object = njs_property_cache_object(vm, value);
+
+    if (njs_fast_path(object != NULL)) {
+        prop = njs_property_cache_find(cache, object, atom_id);
+
+        if (njs_fast_path(prop != NULL
+                          && (prop->type == NJS_PROPERTY
+                              || prop->type == NJS_ACCESSOR
+                              || prop->type == NJS_PROPERTY_HANDLER)))
+        {
+            return njs_value_property_get(vm, value, atom_id, prop, retval);
+        }
+    }
+
+    return njs_value_property_lookup(vm, value, atom_id, retval, cache);
 }
 
 
@@ -1171,15 +1350,9 @@ njs_int_t
 njs_value_property_set(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
     njs_value_t *setval)
 {
-    uint32_t              index;
-    njs_int_t             ret;
-    njs_array_t           *array;
-    njs_value_t           retval, key;
-    njs_object_prop_t     *prop;
-    njs_typed_array_t     *tarray;
-    njs_flathsh_elt_t     *elt;
-    njs_flathsh_descr_t   *h;
-    njs_property_query_t  pq;
+    uint32_t           index;
+    njs_array_t        *array;
+    njs_typed_array_t  *tarray;
 
     if (njs_fast_path(njs_atom_is_number(atom_id))) {
         index = njs_atom_number(atom_id);
@@ -1215,6 +1388,21 @@ njs_value_property_set(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
 
 slow_path:
 
+    return njs_value_property_store(vm, value, atom_id, setval, NULL);
+}
+
+
+static njs_int_t
+njs_value_property_store(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
+    njs_value_t *setval, njs_property_cache_t *cache)
+{
+    njs_int_t             ret;
+    njs_value_t           retval, key;
+    njs_object_prop_t     *prop;
+    njs_flathsh_elt_t     *elt;
+    njs_flathsh_descr_t   *h;
+    njs_property_query_t  pq;
+
     if (njs_is_primitive(value)) {
         njs_type_error(vm, "property set on primitive %s type",
                        njs_type_string(value->type));
@@ -1387,6 +1575,10 @@ slow_path:
 
 found:
 
+    if (cache != NULL) {
+        njs_property_cache_update(vm, cache, value, atom_id, prop);
+    }
+
     njs_value_assign(njs_prop_value(prop), setval);
 
     return NJS_OK;
@@ -1401,6 +1593,34 @@ fail:
 }
 
 
+njs_int_t
+njs_value_property_set_cached(njs_vm_t *vm, njs_value_t *value,
+    uint32_t atom_id, njs_value_t *setval, njs_property_cache_t *cache)
+{
+    njs_object_prop_t  *prop;
+
+    if (njs_slow_path(njs_atom_is_number(atom_id) || !njs_is_object(value))) {
+        return njs_value_property_set(vm, value, atom_id, setval);
+    }
+
+    if (cache->proto == NULL) {
+        prop = njs_property_cache_find(cache, njs_object(value), atom_id);
+
+        if (prop != NULL
+            && prop->type == NJS_PROPERTY
+            && njs_is_valid(njs_prop_value(prop))
+            && prop->writable
+            && !(atom_id == NJS_ATOM_STRING_length && njs_is_array(value)))
+        {
+            njs_value_assign(njs_prop_value(prop), setval);
+            return NJS_OK;
+        }
+    }
+
+    return njs_value_property_store(vm, value, atom_id, setval, cache);
+}
+
+
 njs_int_t
 njs_value_property_delete(njs_vm_t *vm, njs_value_t *value, uint32_t atom_id,
     njs_value_t *removed, njs_bool_t thrw)
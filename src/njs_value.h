@@ -364,6 +364,22 @@ typedef struct {
 } njs_property_query_t;
 
 
+/*
+ * Inline cache of a PROPERTY_ATOM_GET/SET instruction.  It remembers where
+ * the property was found last time: the element number in the private hash
+ * of either the receiver itself or its immediate prototype, 0 if none.
+ * Objects which got their properties in the same order share the element
+ * numbers, so a hit is validated against the current object by the element
+ * key only and stale entries are simply missed.
+ */
+
+typedef struct {
+    njs_object_t                *proto;
+    void                        *shared;
+    uint32_t                    elt_num;
+} njs_property_cache_t;
+
+
 #define njs_value(_type, _truth, _number) (njs_value_t) {                     \
     .data = {                                                                 \
         .type = _type,                                                        \
@@ -970,6 +986,10 @@ njs_int_t njs_property_query(njs_vm_t *vm, njs_property_query_t *pq,
     njs_value_t *value, uint32_t atom_id);
 njs_int_t njs_value_property_set(njs_vm_t *vm, njs_value_t *value,
     uint32_t atom_id, njs_value_t *setval);
+njs_int_t njs_value_property_cached(njs_vm_t *vm, njs_value_t *value,
+    uint32_t atom_id, njs_value_t *retval, njs_property_cache_t *cache);
+njs_int_t njs_value_property_set_cached(njs_vm_t *vm, njs_value_t *value,
+    uint32_t atom_id, njs_value_t *setval, njs_property_cache_t *cache);
 njs_int_t njs_value_property_delete(njs_vm_t *vm, njs_value_t *value,
     uint32_t atom_id, njs_value_t *removed, njs_bool_t thrw);
 njs_int_t njs_value_to_object(njs_vm_t *vm, njs_value_t *value);
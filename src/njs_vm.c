@@ -8,6 +8,8 @@
 #include <njs_main.h>
 
 
+static njs_vm_t *njs_vm_clone_pool(njs_vm_t *vm, njs_mp_t *nmp,
+    njs_external_ptr_t external);
 static njs_int_t njs_vm_protos_init(njs_vm_t *vm, njs_value_t *global);
 
 
@@ -49,11 +51,6 @@ njs_vm_create(njs_vm_opt_t *options)
 
     vm->mem_pool = mp;
 
-    ret = njs_regexp_init(vm);
-    if (njs_slow_path(ret != NJS_OK)) {
-        return NULL;
-    }
-
     njs_flathsh_init(&vm->values_hash);
 
     vm->options = *options;
@@ -392,12 +389,8 @@ njs_vm_reuse(njs_vm_t *vm)
 njs_vm_t *
 njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
 {
-    njs_mp_t     *nmp;
-    njs_vm_t     *nvm;
-    njs_int_t    ret;
-    njs_value_t  **global, **value;
-
-    njs_thread_log_debug("CLONE:");
+    njs_mp_t  *nmp;
+    njs_vm_t  *nvm;
 
     if (vm->options.interactive) {
         return NULL;
@@ -408,9 +401,60 @@ njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
         return NULL;
     }
 
+    nvm = njs_vm_clone_pool(vm, nmp, external);
+    if (njs_slow_path(nvm == NULL)) {
+        njs_mp_destroy(nmp);
+        return NULL;
+    }
+
+    return nvm;
+}
+
+
+njs_mp_t *
+njs_vm_release(njs_vm_t *vm)
+{
+    njs_mp_t  *mp;
+
+    mp = vm->mem_pool;
+
+    njs_mp_reset(mp);
+
+    return mp;
+}
+
+
+njs_vm_t *
+njs_vm_clone_reuse(njs_vm_t *vm, njs_mp_t *mp, njs_external_ptr_t external)
+{
+    njs_vm_t  *nvm;
+
+    if (vm->options.interactive) {
+        return NULL;
+    }
+
+    nvm = njs_vm_clone_pool(vm, mp, external);
+    if (njs_slow_path(nvm == NULL)) {
+        njs_mp_reset(mp);
+        return NULL;
+    }
+
+    return nvm;
+}
+
+
+static njs_vm_t *
+njs_vm_clone_pool(njs_vm_t *vm, njs_mp_t *nmp, njs_external_ptr_t external)
+{
+    njs_vm_t     *nvm;
+    njs_int_t    ret;
+    njs_value_t  **global, **value;
+
+    njs_thread_log_debug("CLONE:");
+
     nvm = njs_mp_align(nmp, sizeof(njs_value_t), sizeof(njs_vm_t));
     if (njs_slow_path(nvm == NULL)) {
-        goto fail;
+        return NULL;
     }
 
     *nvm = *vm;
@@ -421,22 +465,31 @@ njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
 
     nvm->shared_atom_count = vm->atom_id_generator;
 
+    /*
+     * Regex contexts are allocated from the VM memory pool,
+     * they are created on first use, most clones never need them.
+     */
+
+    nvm->regex_generic_ctx = NULL;
+    nvm->regex_compile_ctx = NULL;
+    nvm->single_match_data = NULL;
+
     njs_flathsh_init(&nvm->atom_hash);
     nvm->atom_hash_current = &nvm->atom_hash;
 
     ret = njs_vm_runtime_init(nvm);
     if (njs_slow_path(ret != NJS_OK)) {
-        goto fail;
+        return NULL;
     }
 
     ret = njs_vm_protos_init(nvm, &nvm->global_value);
     if (njs_slow_path(ret != NJS_OK)) {
-        goto fail;
+        return NULL;
     }
 
     global = njs_scope_make(nvm, nvm->global_scope->items);
     if (njs_slow_path(global == NULL)) {
-        goto fail;
+        return NULL;
     }
 
     if (nvm->options.unsafe) {
@@ -444,13 +497,13 @@ njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
                                              vm->scope_absolute->items,
                                              sizeof(njs_value_t *));
         if (njs_slow_path(nvm->scope_absolute == NULL)) {
-            goto fail;
+            return NULL;
         }
 
         value = njs_arr_add_multiple(nvm->scope_absolute,
                                      vm->scope_absolute->items);
         if (njs_slow_path(value == NULL)) {
-            goto fail;
+            return NULL;
         }
 
         memcpy(value, vm->scope_absolute->start,
@@ -465,19 +518,12 @@ njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
     nvm->levels[NJS_LEVEL_LOCAL] = NULL;
 
     return nvm;
-
-fail:
-
-    njs_mp_destroy(nmp);
-
-    return NULL;
 }
 
 
 njs_int_t
 njs_vm_runtime_init(njs_vm_t *vm)
 {
-    njs_int_t    ret;
     njs_frame_t  *frame;
 
     if (vm->active_frame == NULL) {
@@ -494,11 +540,6 @@ njs_vm_runtime_init(njs_vm_t *vm)
         vm->active_frame = frame;
     }
 
-    ret = njs_regexp_init(vm);
-    if (njs_slow_path(ret != NJS_OK)) {
-        return NJS_ERROR;
-    }
-
     njs_flathsh_init(&vm->values_hash);
 
     njs_flathsh_init(&vm->modules_hash);
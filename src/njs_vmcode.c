@@ -13,7 +13,8 @@ struct njs_property_next_s {
     njs_array_t  *array;
 };
 
-static njs_jump_off_t njs_vmcode_object(njs_vm_t *vm, njs_value_t *retval);
+static njs_jump_off_t njs_vmcode_object(njs_vm_t *vm, u_char *pc,
+    njs_value_t *retval);
 static njs_jump_off_t njs_vmcode_array(njs_vm_t *vm, u_char *pc,
     njs_value_t *retval);
 static njs_jump_off_t njs_vmcode_function(njs_vm_t *vm, u_char *pc);
@@ -104,6 +105,7 @@ njs_vmcode_interpreter(njs_vm_t *vm, u_char *pc, njs_value_t *rval,
     njs_vmcode_variable_t        *var;
     njs_vmcode_prop_get_t        *get;
     njs_vmcode_prop_set_t        *set;
+    njs_vmcode_prop_atom_t       *atom;
     njs_vmcode_prop_next_t       *pnext;
     njs_vmcode_test_jump_t       *test_jump;
     njs_vmcode_equal_jump_t      *equal;
@@ -250,15 +252,16 @@ NEXT_LBL;
 
         njs_vmcode_operand(vm, vmcode->operand3, value2);
         njs_vmcode_operand(vm, vmcode->operand2, value1);
-        get = (njs_vmcode_prop_get_t *) pc;
-        njs_vmcode_operand(vm, get->value, retval);
+        atom = (njs_vmcode_prop_atom_t *) pc;
+        njs_vmcode_operand(vm, atom->value, retval);
 
-        ret = njs_value_property(vm, value1, value2->atom_id, retval);
+        ret = njs_value_property_cached(vm, value1, value2->atom_id, retval,
+                                        &atom->cache);
         if (njs_slow_path(ret == NJS_ERROR)) {
             goto error;
         }
 
-        pc += sizeof(njs_vmcode_prop_get_t);
+        pc += sizeof(njs_vmcode_prop_atom_t);
         NEXT;
 
     CASE (NJS_VMCODE_PROPERTY_GET):
@@ -1173,7 +1176,7 @@ NEXT_LBL;
 
         njs_vmcode_operand(vm, vmcode->operand1, retval);
 
-        ret = njs_vmcode_object(vm, retval);
+        ret = njs_vmcode_object(vm, pc, retval);
         if (njs_slow_path(ret < 0 && ret >= NJS_PREEMPT)) {
             goto error;
         }
@@ -1309,13 +1312,15 @@ NEXT_LBL;
         njs_vmcode_operand(vm, vmcode->operand3, value2);
         njs_vmcode_operand(vm, vmcode->operand2, value1);
         njs_vmcode_operand(vm, vmcode->operand1, retval);
+        atom = (njs_vmcode_prop_atom_t *) pc;
 
-        ret = njs_value_property_set(vm, value1, value2->atom_id, retval);
+        ret = njs_value_property_set_cached(vm, value1, value2->atom_id,
+                                            retval, &atom->cache);
         if (njs_slow_path(ret == NJS_ERROR)) {
             goto error;
         }
 
-        ret = sizeof(njs_vmcode_prop_set_t);
+        ret = sizeof(njs_vmcode_prop_atom_t);
         BREAK;
 
     CASE (NJS_VMCODE_PROPERTY_SET):
@@ -1897,19 +1902,33 @@ error:
 
 
 static njs_jump_off_t
-njs_vmcode_object(njs_vm_t *vm, njs_value_t *retval)
+njs_vmcode_object(njs_vm_t *vm, u_char *pc, njs_value_t *retval)
 {
-    njs_object_t  *object;
+    njs_object_t         *object;
+    njs_flathsh_query_t  fhq;
+    njs_vmcode_object_t  *code;
+
+    code = (njs_vmcode_object_t *) pc;
 
     object = njs_object_alloc(vm);
+    if (njs_slow_path(object == NULL)) {
+        return NJS_ERROR;
+    }
 
-    if (njs_fast_path(object != NULL)) {
-        njs_set_object(retval, object);
+    if (code->shape != NULL) {
+        fhq.proto = &njs_object_hash_proto;
+        fhq.pool = vm->mem_pool;
 
-        return sizeof(njs_vmcode_object_t);
+        object->hash.slot = njs_flathsh_copy(&fhq, code->shape);
+        if (njs_slow_path(object->hash.slot == NULL)) {
+            njs_memory_error(vm);
+            return NJS_ERROR;
+        }
     }
 
-    return NJS_ERROR;
+    njs_set_object(retval, object);
+
+    return sizeof(njs_vmcode_object_t);
 }
 
 
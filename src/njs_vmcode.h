@@ -154,6 +154,7 @@ typedef struct {
 typedef struct {
     njs_vmcode_t               code;
     njs_index_t                retval;
+    njs_flathsh_descr_t        *shape;
 } njs_vmcode_object_t;
 
 
@@ -250,6 +251,15 @@ typedef struct {
 } njs_vmcode_prop_set_t;
 
 
+typedef struct {
+    njs_vmcode_t               code;
+    njs_index_t                value;
+    njs_index_t                object;
+    njs_index_t                property;
+    njs_property_cache_t       cache;
+} njs_vmcode_prop_atom_t;
+
+
 typedef struct {
     njs_vmcode_t               code;
     njs_index_t                value;
@@ -13053,6 +13053,80 @@ static njs_unit_test_t  njs_test[] =
     { njs_str("var o = {}; var o2 = Object.create(o); o.__proto__ = o2"),
       njs_str("TypeError: Cyclic __proto__ value") },
 
+    { njs_str("var p = {x:1}; var a = Object.create(p); var r = [];"
+              "for (var i = 0; i < 4; i++) {"
+              "    if (i == 2) { a.x = 'own' }"
+              "    if (i == 3) { delete a.x; p.x = 2 }"
+              "    r.push(a.x)"
+              "}; r"),
+      njs_str("1,1,own,2") },
+
+    { njs_str("var a = {__proto__: {x:1}}; var r = [];"
+              "for (var i = 0; i < 3; i++) {"
+              "    if (i == 2) { a.__proto__ = {x:3} }"
+              "    r.push(a.x)"
+              "}; r"),
+      njs_str("1,1,3") },
+
+    { njs_str("var o = {x:1}; var r = [];"
+              "for (var i = 0; i < 3; i++) {"
+              "    if (i == 2) {"
+              "        Object.defineProperty(o, 'x', {get() { return 'g' }})"
+              "    }"
+              "    r.push(o.x)"
+              "}; r"),
+      njs_str("1,1,g") },
+
+    { njs_str("var o = {a:1, b:2}; function f() { return o.b }"
+              "f(); delete o.b; var r = [f()]; o.b = 3; r.push(f()); r"),
+      njs_str(",3") },
+
+    { njs_str("function get(o) { return o.x }"
+              "[{x:1}, {y:2, x:3}, Object.create({x:4}), 'str', {x:5}]"
+              ".map(get)"),
+      njs_str("1,3,4,,5") },
+
+    { njs_str("var o = {x:1}; function f(v) { o.x = v }"
+              "f(2); f(3); Object.freeze(o); var e;"
+              "try { f(4) } catch (ex) { e = ex.constructor.name }; [o.x, e]"),
+      njs_str("3,TypeError") },
+
+    { njs_str("var p = {set x(v) { this._x = v * 2 }};"
+              "var o = Object.create(p); function f(o, v) { o.x = v }"
+              "f(o, 1); f(o, 2); [o._x, o.hasOwnProperty('x')]"),
+      njs_str("4,false") },
+
+    { njs_str("var a = [1,2,3]; function f(o, v) { o.length = v }"
+              "f({}, 1); f(a, 1); a"),
+      njs_str("1") },
+
+    { njs_str("function f(i) { return {b:i, a:1, c:2, b:3} }"
+              "var o = f(0); delete o.a; o.d = 4; var p = f(1);"
+              "[Object.keys(o), Object.keys(p), p.b, p.a]"),
+      njs_str("b,c,d,b,a,c,3,1") },
+
+    { njs_str("var r = [];"
+              "for (var i = 0; i < 3; i++) {"
+              "    var o = {x:i, y:i * 2};"
+              "    if (i == 1) { Object.defineProperty(o, 'y', {value:'c'}) }"
+              "    r.push(o.y)"
+              "}; r"),
+      njs_str("0,c,4") },
+
+    { njs_str("var o = Object.freeze({x:1}); var e;"
+              "try { o.x = 2 } catch (ex) { e = ex.constructor.name };"
+              "[{x:3}.x, o.x, e]"),
+      njs_str("3,1,TypeError") },
+
+    { njs_str("function set(o, v) { o.__proto__ = v }"
+              "var t = ({}).__proto__, a = {};"
+              "Object.defineProperty(a, '__proto__', {value:0, writable:true,"
+              "                                       enumerable:true,"
+              "                                       configurable:true});"
+              "set(a, 1); set(Object.prototype, 42);"
+              "[a.__proto__, ({}).__proto__ === t]"),
+      njs_str("1,true") },
+
     { njs_str("Object.prototype.__proto__.f()"),
       njs_str("TypeError: cannot get property \"f\" of null") },
 
@@ -23071,6 +23145,98 @@ njs_string_to_index_test(njs_vm_t *vm, njs_opts_t *opts, njs_stat_t *stat)
 }
 
 
+static njs_int_t
+njs_vm_clone_reuse_test(njs_vm_t *vm, njs_opts_t *opts, njs_stat_t *stat)
+{
+    u_char              *start;
+    size_t              nblocks;
+    njs_mp_t            *mp;
+    njs_vm_t            *nvm;
+    njs_str_t           s;
+    njs_int_t           ret;
+    njs_uint_t          i;
+    njs_mp_stat_t       mp_stat;
+    njs_opaque_value_t  retval;
+
+    static const njs_str_t  script =
+        njs_str("var a = Array(1024).fill('abc'); a.push('d');"
+                "/b+c/.test(a.join('')) + ':' + a.length");
+    static const njs_str_t  expected = njs_str("true:1025");
+
+    start = script.start;
+
+    ret = njs_vm_compile(vm, &start, start + script.length);
+    if (ret != NJS_OK) {
+        njs_printf("njs_vm_clone_reuse_test: njs_vm_compile() failed\n");
+        return NJS_ERROR;
+    }
+
+    mp = NULL;
+    nvm = NULL;
+    nblocks = 0;
+
+    for (i = 0; i < 8; i++) {
+        if (mp == NULL) {
+            nvm = njs_vm_clone(vm, NULL);
+
+        } else {
+            nvm = njs_vm_clone_reuse(vm, mp, NULL);
+        }
+
+        if (nvm == NULL) {
+            njs_printf("njs_vm_clone_reuse_test: clone failed\n");
+            goto fail;
+        }
+
+        mp = NULL;
+
+        ret = njs_vm_start(nvm, njs_value_arg(&retval));
+        if (ret != NJS_OK) {
+            njs_printf("njs_vm_clone_reuse_test: njs_vm_start() failed\n");
+            goto fail;
+        }
+
+        ret = njs_vm_value_string(nvm, &s, njs_value_arg(&retval));
+        if (ret != NJS_OK || !njs_strstr_eq(&expected, &s)) {
+            njs_printf("njs_vm_clone_reuse_test:\n"
+                       "expected: \"%V\"\n     got: \"%V\"\n",
+                       &expected, &s);
+            stat->failed++;
+            goto fail;
+        }
+
+        mp = njs_vm_release(nvm);
+        nvm = NULL;
+
+        njs_mp_stat(mp, &mp_stat);
+
+        if (i == 0) {
+            nblocks = mp_stat.nblocks;
+
+        } else if (mp_stat.nblocks != nblocks) {
+            njs_printf("njs_vm_clone_reuse_test: pool grew from %uz to %uz "
+                       "blocks\n", nblocks, mp_stat.nblocks);
+            stat->failed++;
+            goto fail;
+        }
+    }
+
+    stat->passed++;
+
+fail:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    if (mp != NULL) {
+        njs_mp_destroy(mp);
+    }
+
+    return NJS_OK;
+}
+
+
 #ifdef NJS_HAVE_ADDR2LINE
 static njs_int_t
 njs_addr2line_test(njs_vm_t *vm, njs_opts_t *opts, njs_stat_t *stat)
@@ -23130,6 +23296,8 @@ njs_vm_internal_api_test(njs_unit_test_t unused[], size_t num, njs_str_t *name,
           njs_str("njs_sort_test") },
         { njs_string_to_index_test,
           njs_str("njs_string_to_index_test") },
+        { njs_vm_clone_reuse_test,
+          njs_str("njs_vm_clone_reuse_test") },
 #ifdef NJS_HAVE_ADDR2LINE
         { njs_addr2line_test,
           njs_str("njs_addr2line_test") },
@@ -100,6 +100,8 @@ async function http_module(r: NginxHTTPRequest) {
 
     let req = new Request("http://nginx.org", {method: "POST", headers: new Headers(["Foo", "bar"])});
     let response3 = await ngx.fetch(req);
+    let responses: Response[] = await ngx.fetchAll(['http://nginx.org/', req],
+                                                   {connections: 2});
 
     // js_body_filter
     r.sendBuffer(Buffer.from("xxx"), {last:true});
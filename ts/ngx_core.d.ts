@@ -148,12 +148,51 @@ interface NgxResponseOptions {
     statusText?: string;
 }
 
+interface NgxReadableStreamResult {
+    /**
+     * The next chunk of the body, undefined when the body is over.
+     */
+    value?: Buffer;
+    /**
+     * True when the body is over.
+     */
+    done: boolean;
+}
+
+/**
+ * Reader of a response body.
+ * @since 0.9.5
+ */
+interface NgxReadableStream {
+    /**
+     * Stops receiving the body and closes the upstream connection.
+     */
+    cancel(): Promise<void>;
+    /**
+     * Locks the body and returns the stream itself as the reader.
+     */
+    getReader(): NgxReadableStream;
+    /**
+     * Returns a Promise that resolves with the next chunk of the body.
+     * Receiving of the body is suspended while more than
+     * js_fetch_buffer_size bytes wait to be read.
+     */
+    read(): Promise<NgxReadableStreamResult>;
+}
+
 declare class Response {
     /**
      * Takes a Response stream and reads it to completion.
      * Returns a Promise that resolves with an ArrayBuffer.
      */
     arrayBuffer(): Promise<ArrayBuffer>;
+    /**
+     * The body of the response as a stream of Buffer chunks.
+     * With the `stream` fetch option the body is received
+     * while it is being read.
+     * @since 0.9.5
+     */
+    readonly body: NgxReadableStream;
     /**
      * A boolean value, true if the body has been used.
      */
@@ -212,8 +251,25 @@ declare class Response {
 interface NgxFetchOptions {
     /**
      * Request body, by default is empty.
+     * A Response.body stream of a streamed fetch is relayed
+     * with chunked transfer encoding as it is received (since 0.9.5).
+     */
+    body?: NjsStringOrBuffer | NgxReadableStream,
+    /**
+     * Cache mode, used when the js_fetch_cache directive is configured,
+     * by default is "default".
+     * @since 0.9.5
+     */
+    cache?: "default" | "no-store" | "reload" | "no-cache" | "force-cache" | "only-if-cached";
+    /**
+     * Joins an identical GET request already in flight in the same worker
+     * instead of sending a new one, the response is shared by all callers.
+     * Requests are identical when their URL, Authorization and Cookie
+     * headers match, by default is false.
+     * Nginx specific.
+     * @since 0.9.5
      */
-    body?: string,
+    coalesce?: boolean;
     /**
      * The buffer size for reading the response, by default is 16384 (4096 before 0.7.4).
      * Nginx specific.
@@ -234,6 +290,14 @@ interface NgxFetchOptions {
      * Request method, by default the GET method is used.
      */
     method?: string;
+    /**
+     * Resolves the fetch Promise as soon as the response headers are
+     * received, the body is then read using Response.body.
+     * The max_response_body_size limit does not apply.
+     * Nginx specific.
+     * @since 0.9.5
+     */
+    stream?: boolean;
     /**
      * Enables or disables verification of the HTTPS server certificate,
      * by default is true.
@@ -242,6 +306,25 @@ interface NgxFetchOptions {
     verify?: boolean;
 }
 
+interface NgxFetchAllOptions extends NgxFetchOptions {
+    /**
+     * The maximum number of requests of the batch sent at once,
+     * by default is 4.  The other requests are sent as soon as
+     * a connection is released and reuse it if it is kept alive
+     * (see the js_fetch_keepalive directive).
+     */
+    connections?: number;
+    /**
+     * The timeout for the whole batch in milliseconds,
+     * by default is 0 (no batch timeout).
+     */
+    timeout?: number;
+    /**
+     * Streaming responses are not supported by fetchAll().
+     */
+    stream?: false;
+}
+
 /**
  * This Error object is thrown when adding an item to a shared dictionary
  * that does not have enough free space.
@@ -317,6 +400,29 @@ interface NgxSharedDict<V extends string | number = string | number> {
     incr: V extends number
       ? (key: string, delta: V, init?: number, timeout?: number) => number
       : never;
+    /**
+     * Increments the values associated with the `keys` taking the lock
+     * of each involved shard once.
+     *
+     * **Important:** This method can be used only if the dictionary was
+     * declared with `type=number`!
+     *
+     * @param keys An array of string keys.
+     * @param deltas The numbers to increment/decrement the values by, either
+     *   an array of the same length as `keys` or a single number for all keys.
+     * @param init The number to initialize the items with if they didn't exist
+     *   (default is `0`).
+     * @param timeout Overrides the default timeout for the items in
+     *   milliseconds.
+     * @returns An array of the new values.
+     * @throws {SharedMemoryError} if there's not enough free space in this
+     *   dictionary.
+     * @throws {TypeError} if this dictionary does not expect numbers.
+     * @since 0.9.5
+     */
+    incrMany: V extends number
+      ? (keys: string[], deltas: V[] | V, init?: number, timeout?: number) => number[]
+      : never;
     /**
      * @param maxCount The maximum number of pairs to retrieve (default is 1024).
      * @returns An array of the key-value pairs.
@@ -334,6 +440,13 @@ interface NgxSharedDict<V extends string | number = string | number> {
      *   is none.
      */
     get(key: string): V | undefined;
+    /**
+     * @param keys The keys of the items to retrieve.
+     * @returns An array of the values associated with the `keys`, with
+     *   `undefined` for the keys that are not found.
+     * @since 0.9.5
+     */
+    getMany(keys: string[]): (V | undefined)[];
     /**
      * @param key The key to search for.
      * @returns `true` if an item with the specified `key` exists, `false`
@@ -381,6 +494,22 @@ interface NgxSharedDict<V extends string | number = string | number> {
      *   by this dictionary.
      */
     set(key: string, value: V, timeout?: number): this;
+    /**
+     * Sets the `values` for the specified `keys` in the dictionary taking
+     * the lock of each involved shard once.
+     *
+     * @param keys The keys of the items to set.
+     * @param values The values of the items, in the order of `keys`.
+     * @param timeout Overrides the default timeout for the items in
+     *   milliseconds.
+     * @returns This dictionary (for method chaining).
+     * @throws {SharedMemoryError} if there's not enough free space in this
+     *   dictionary.
+     * @throws {TypeError} if a value is of a different type than expected
+     *   by this dictionary.
+     * @since 0.9.5
+     */
+    setMany(keys: string[], values: V[], timeout?: number): this;
     /**
      * @returns The number of items in this shared dictionary.
      */
@@ -437,6 +566,16 @@ interface NgxObject {
      * @since 0.5.1
      */
     fetch(init: NjsStringOrBuffer | Request, options?: NgxFetchOptions): Promise<Response>;
+    /**
+     * Makes a batch of requests with a limited number of connections.
+     * Returns a Promise that resolves with the array of Response objects
+     * in the order of the resources, or rejects with the first error.
+     * @param resources URLs of resources to fetch or Request objects.
+     * @param options Batch settings, also used as fetch() options
+     * for every request.
+     * @since 0.9.5
+     */
+    fetchAll(resources: (NjsStringOrBuffer | Request)[], options?: NgxFetchAllOptions): Promise<Response[]>;
     /**
      * Writes a string to the error log with the specified level
      * of logging.